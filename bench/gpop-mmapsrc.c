@@ -0,0 +1,172 @@
+/*
+ * GStreamer Prince of Parser
+ *
+ * Copyright (C) 2020 Stéphane Cerveau
+ *
+ * SPDX-License-Identifier: LGPL
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation
+ * version 2.1 of the License.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301 USA
+ *
+ */
+
+/* Throughput of gpopmmapsrc against filesrc: reads a large file with both
+ * elements into a fakesink and reports the bandwidth and the cpu time
+ * spent. The file is read once beforehand so that both runs are served
+ * from the page cache. */
+
+#include <string.h>
+#include <sys/resource.h>
+#include <glib/gstdio.h>
+
+#include "gpop-private.h"
+
+static gdouble
+get_cpu_seconds (void)
+{
+  struct rusage usage;
+
+  getrusage (RUSAGE_SELF, &usage);
+  return usage.ru_utime.tv_sec + usage.ru_stime.tv_sec +
+      (usage.ru_utime.tv_usec + usage.ru_stime.tv_usec) / 1e6;
+}
+
+static gboolean
+create_file (const gchar * path, guint size_mb)
+{
+  FILE *file = fopen (path, "wb");
+  guint8 *block = g_malloc (1024 * 1024);
+  guint i;
+
+  if (!file) {
+    g_free (block);
+    return FALSE;
+  }
+  for (i = 0; i < 1024 * 1024; i++)
+    block[i] = i * 31;
+  for (i = 0; i < size_mb; i++)
+    fwrite (block, 1, 1024 * 1024, file);
+  fclose (file);
+  g_free (block);
+
+  return TRUE;
+}
+
+static gboolean
+run (const gchar * element, const gchar * path, guint blocksize,
+    guint size_mb, gboolean report)
+{
+  GstElement *pipeline;
+  GstMessage *msg;
+  GError *err = NULL;
+  gchar *desc;
+  gint64 start;
+  gdouble cpu, seconds;
+
+  desc = g_strdup_printf ("%s location=%s blocksize=%u ! fakesink sync=false",
+      element, path, blocksize);
+  pipeline = gst_parse_launch (desc, &err);
+  g_free (desc);
+  if (!pipeline) {
+    g_printerr ("Unable to create the %s pipeline: %s\n", element,
+        err->message);
+    g_error_free (err);
+    return FALSE;
+  }
+
+  start = g_get_monotonic_time ();
+  cpu = get_cpu_seconds ();
+  gst_element_set_state (pipeline, GST_STATE_PLAYING);
+  msg = gst_bus_timed_pop_filtered (GST_ELEMENT_BUS (pipeline),
+      GST_CLOCK_TIME_NONE, GST_MESSAGE_EOS | GST_MESSAGE_ERROR);
+  seconds = (gdouble) (g_get_monotonic_time () - start) / G_USEC_PER_SEC;
+  cpu = get_cpu_seconds () - cpu;
+  gst_element_set_state (pipeline, GST_STATE_NULL);
+  gst_object_unref (pipeline);
+
+  if (GST_MESSAGE_TYPE (msg) == GST_MESSAGE_ERROR) {
+    gst_message_parse_error (msg, &err, NULL);
+    g_printerr ("%s failed: %s\n", element, err->message);
+    g_error_free (err);
+    gst_message_unref (msg);
+    return FALSE;
+  }
+  gst_message_unref (msg);
+
+  if (report)
+    g_print ("%-12s %8.1f MB/s  %6.3f s cpu  (%u bytes blocks)\n", element,
+        size_mb / seconds, cpu, blocksize);
+  return TRUE;
+}
+
+gint
+main (gint argc, gchar * argv[])
+{
+  GOptionContext *ctx;
+  GError *err = NULL;
+  gint size_mb = 1024, blocksize = GPOP_MMAP_SRC_DEFAULT_BLOCKSIZE, res = 0;
+  gchar *path = NULL;
+  gboolean created = FALSE;
+
+  GOptionEntry options[] = {
+    {"size", 's', 0, G_OPTION_ARG_INT, &size_mb,
+        "Size of the test file in MB (default 1024)", "MB"}
+    ,
+    {"blocksize", 'b', 0, G_OPTION_ARG_INT, &blocksize,
+        "Size of the buffers (default 1MB)", "BYTES"}
+    ,
+    {"file", 'f', 0, G_OPTION_ARG_FILENAME, &path,
+        "Existing file to read instead of a generated one", "FILE"}
+    ,
+    {NULL}
+  };
+
+  ctx = g_option_context_new ("- gpopmmapsrc throughput");
+  g_option_context_add_main_entries (ctx, options, NULL);
+  g_option_context_add_group (ctx, gst_init_get_option_group ());
+  if (!g_option_context_parse (ctx, &argc, &argv, &err)) {
+    g_printerr ("Error initializing: %s\n", err->message);
+    return -1;
+  }
+  g_option_context_free (ctx);
+  gpop_mmap_src_register ();
+
+  if (!path) {
+    path = g_build_filename (g_get_tmp_dir (), "gpop-mmapsrc.bin", NULL);
+    if (!create_file (path, size_mb)) {
+      g_printerr ("Unable to create %s\n", path);
+      return -1;
+    }
+    created = TRUE;
+  } else {
+    GStatBuf st;
+    if (g_stat (path, &st) < 0) {
+      g_printerr ("Unable to stat %s\n", path);
+      return -1;
+    }
+    size_mb = st.st_size / (1024 * 1024);
+  }
+
+  /* The first run warms up the page cache */
+  if (!run ("filesrc", path, blocksize, size_mb, FALSE)
+      || !run ("filesrc", path, blocksize, size_mb, TRUE)
+      || !run (GPOP_MMAP_SRC_NAME, path, blocksize, size_mb, TRUE))
+    res = 1;
+
+  if (created)
+    g_unlink (path);
+  g_free (path);
+
+  return res;
+}
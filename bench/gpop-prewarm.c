@@ -0,0 +1,204 @@
+/*
+ * GStreamer Prince of Parser
+ *
+ * Copyright (C) 2020 Stéphane Cerveau
+ *
+ * SPDX-License-Identifier: LGPL
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation
+ * version 2.1 of the License.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301 USA
+ *
+ */
+
+/* Early frames with and without buffer pool pre-warming: plays --pipeline
+ * --runs times in each mode, alternating, and reports the latency of the
+ * first frame reaching the sink from the PLAYING request, and the jitter of
+ * the arrival of the --frames following ones (standard deviation of their
+ * intervals). */
+
+#include <math.h>
+#include <stdlib.h>
+
+#include "gpop-private.h"
+
+#define DEFAULT_PIPELINE \
+  "videotestsrc num-buffers=120 ! video/x-raw,width=1920,height=1080 " \
+  "! videoconvert ! video/x-raw,format=NV12 ! queue max-size-buffers=8 " \
+  "! fakesink sync=false"
+
+typedef struct
+{
+  gint64 start;
+  GArray *arrivals;
+} Run;
+
+static GstPadProbeReturn
+on_buffer (GstPad * pad, GstPadProbeInfo * info, gpointer user_data)
+{
+  Run *run = (Run *) user_data;
+  gint64 now = g_get_monotonic_time ();
+
+  g_array_append_val (run->arrivals, now);
+  return GST_PAD_PROBE_OK;
+}
+
+static GstPad *
+get_sink_pad (GstElement * pipeline)
+{
+  GstIterator *it = gst_bin_iterate_sinks (GST_BIN (pipeline));
+  GValue item = G_VALUE_INIT;
+  GstPad *pad = NULL;
+
+  if (gst_iterator_next (it, &item) == GST_ITERATOR_OK) {
+    pad = gst_element_get_static_pad (g_value_get_object (&item), "sink");
+    g_value_unset (&item);
+  }
+  gst_iterator_free (it);
+  return pad;
+}
+
+/* Returns the first frame latency and the jitter in us, FALSE on error */
+static gboolean
+run_once (const gchar * description, gboolean prewarm, guint frames,
+    gdouble * first_frame, gdouble * jitter)
+{
+  Run run = { 0, g_array_new (FALSE, FALSE, sizeof (gint64)) };
+  GstElement *pipeline;
+  GstMessage *msg;
+  GError *err = NULL;
+  gdouble sum = 0, sum2 = 0;
+  gboolean res;
+  GstPad *pad;
+  guint i, n;
+
+  pipeline = gst_parse_launch (description, &err);
+  if (!pipeline) {
+    g_printerr ("Unable to create the pipeline: %s\n", err->message);
+    g_error_free (err);
+    g_array_unref (run.arrivals);
+    return FALSE;
+  }
+  pad = get_sink_pad (pipeline);
+  if (pad) {
+    gst_pad_add_probe (pad, GST_PAD_PROBE_TYPE_BUFFER, on_buffer, &run, NULL);
+    gst_object_unref (pad);
+  }
+  if (prewarm)
+    gpop_prewarm_attach (pipeline);
+
+  run.start = g_get_monotonic_time ();
+  gst_element_set_state (pipeline, GST_STATE_PLAYING);
+  msg = gst_bus_timed_pop_filtered (GST_ELEMENT_BUS (pipeline),
+      GST_CLOCK_TIME_NONE, GST_MESSAGE_EOS | GST_MESSAGE_ERROR);
+  res = GST_MESSAGE_TYPE (msg) == GST_MESSAGE_EOS && run.arrivals->len > 1;
+  gst_message_unref (msg);
+  gst_element_set_state (pipeline, GST_STATE_NULL);
+  gst_object_unref (pipeline);
+
+  if (res) {
+    gint64 *arrivals = (gint64 *) run.arrivals->data;
+
+    n = MIN (frames, run.arrivals->len - 1);
+    for (i = 1; i <= n; i++) {
+      gdouble interval = arrivals[i] - arrivals[i - 1];
+
+      sum += interval;
+      sum2 += interval * interval;
+    }
+    *first_frame = arrivals[0] - run.start;
+    *jitter = sqrt (MAX (sum2 / n - (sum / n) * (sum / n), 0));
+  }
+  g_array_unref (run.arrivals);
+  return res;
+}
+
+static gint
+compare_double (gconstpointer a, gconstpointer b)
+{
+  gdouble va = *(const gdouble *) a, vb = *(const gdouble *) b;
+
+  return va < vb ? -1 : va > vb;
+}
+
+static void
+report (const gchar * mode, gdouble * first_frames, gdouble * jitters,
+    guint n)
+{
+  qsort (first_frames, n, sizeof (gdouble), compare_double);
+  qsort (jitters, n, sizeof (gdouble), compare_double);
+  g_print ("%-12s first frame p50 %7.2f ms  p90 %7.2f ms   "
+      "jitter p50 %7.3f ms  p90 %7.3f ms\n", mode,
+      first_frames[n / 2] / 1000.0, first_frames[n * 9 / 10] / 1000.0,
+      jitters[n / 2] / 1000.0, jitters[n * 9 / 10] / 1000.0);
+}
+
+gint
+main (gint argc, gchar * argv[])
+{
+  GOptionContext *ctx;
+  GError *err = NULL;
+  gint runs = 20, frames = 30, i;
+  gchar *description = NULL;
+  gdouble *first_frames[2], *jitters[2];
+  gint res = 0;
+
+  GOptionEntry options[] = {
+    {"runs", 'n', 0, G_OPTION_ARG_INT, &runs,
+        "Runs in each mode (default 20)", "N"}
+    ,
+    {"frames", 'f', 0, G_OPTION_ARG_INT, &frames,
+        "Early frames measured for the jitter (default 30)", "N"}
+    ,
+    {"pipeline", 'p', 0, G_OPTION_ARG_STRING, &description,
+        "Pipeline to play (default " DEFAULT_PIPELINE ")", "DESC"}
+    ,
+    {NULL}
+  };
+
+  ctx = g_option_context_new ("- buffer pool pre-warming");
+  g_option_context_add_main_entries (ctx, options, NULL);
+  g_option_context_add_group (ctx, gst_init_get_option_group ());
+  if (!g_option_context_parse (ctx, &argc, &argv, &err)) {
+    g_printerr ("Error initializing: %s\n", err->message);
+    return -1;
+  }
+  g_option_context_free (ctx);
+  gpop_register_elements ();
+  if (!description)
+    description = g_strdup (DEFAULT_PIPELINE);
+  runs = MAX (runs, 1);
+  frames = MAX (frames, 1);
+
+  for (i = 0; i < 2; i++) {
+    first_frames[i] = g_new0 (gdouble, runs);
+    jitters[i] = g_new0 (gdouble, runs);
+  }
+  /* the modes alternate so that both see the same system state */
+  for (i = 0; i < runs * 2 && !res; i++) {
+    if (!run_once (description, i % 2, frames, &first_frames[i % 2][i / 2],
+            &jitters[i % 2][i / 2]))
+      res = 1;
+  }
+  if (!res) {
+    report ("on demand", first_frames[0], jitters[0], runs);
+    report ("pre-warmed", first_frames[1], jitters[1], runs);
+  }
+
+  for (i = 0; i < 2; i++) {
+    g_free (first_frames[i]);
+    g_free (jitters[i]);
+  }
+  g_free (description);
+  return res;
+}
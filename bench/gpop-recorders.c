@@ -0,0 +1,215 @@
+/*
+ * GStreamer Prince of Parser
+ *
+ * Copyright (C) 2020 Stéphane Cerveau
+ *
+ * SPDX-License-Identifier: LGPL
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation
+ * version 2.1 of the License.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301 USA
+ *
+ */
+
+/* Many concurrent recorders: runs --recorders pipelines writing
+ * --buffers buffers each, first into filesink then into gpopuringsink, and
+ * reports the aggregate write throughput and the distribution of the time
+ * taken to push a buffer to the sink. */
+
+#include <stdlib.h>
+#include <string.h>
+#include <glib/gstdio.h>
+
+#include "gpop-private.h"
+
+typedef struct
+{
+  GMutex lock;
+  GArray *latencies;
+} Latencies;
+
+typedef struct
+{
+  Latencies *latencies;
+  gint64 last;
+} Recorder;
+
+static GstPadProbeReturn
+on_buffer (GstPad * pad, GstPadProbeInfo * info, gpointer user_data)
+{
+  Recorder *recorder = (Recorder *) user_data;
+  gint64 now = g_get_monotonic_time ();
+
+  /* fakesrc does not fill the buffers: the time between two pushes is the
+   * time spent in the sink */
+  if (recorder->last) {
+    gint64 latency = now - recorder->last;
+    g_mutex_lock (&recorder->latencies->lock);
+    g_array_append_val (recorder->latencies->latencies, latency);
+    g_mutex_unlock (&recorder->latencies->lock);
+  }
+  recorder->last = now;
+
+  return GST_PAD_PROBE_OK;
+}
+
+static gint
+compare_latency (gconstpointer a, gconstpointer b)
+{
+  gint64 la = *(const gint64 *) a, lb = *(const gint64 *) b;
+  return (la > lb) - (la < lb);
+}
+
+static gboolean
+run (const gchar * sink, const gchar * dir, gint n_recorders, gint n_buffers,
+    gint buffer_size)
+{
+  GstElement **pipelines = g_new0 (GstElement *, n_recorders);
+  Recorder *recorders = g_new0 (Recorder, n_recorders);
+  Latencies latencies;
+  gboolean res = TRUE;
+  gint64 start;
+  gdouble seconds, total_mb;
+  gint i;
+
+  g_mutex_init (&latencies.lock);
+  latencies.latencies = g_array_new (FALSE, FALSE, sizeof (gint64));
+
+  for (i = 0; i < n_recorders && res; i++) {
+    GError *err = NULL;
+    GstElement *src;
+    GstPad *pad;
+    gchar *desc;
+
+    desc = g_strdup_printf ("fakesrc name=src num-buffers=%d sizetype=fixed "
+        "sizemax=%d filltype=nothing ! %s location=%s/rec-%d.bin", n_buffers,
+        buffer_size, sink, dir, i);
+    pipelines[i] = gst_parse_launch (desc, &err);
+    g_free (desc);
+    if (!pipelines[i]) {
+      g_printerr ("Unable to create the %s pipeline: %s\n", sink,
+          err->message);
+      g_error_free (err);
+      res = FALSE;
+      break;
+    }
+    recorders[i].latencies = &latencies;
+    src = gst_bin_get_by_name (GST_BIN (pipelines[i]), "src");
+    pad = gst_element_get_static_pad (src, "src");
+    gst_pad_add_probe (pad, GST_PAD_PROBE_TYPE_BUFFER, on_buffer,
+        &recorders[i], NULL);
+    gst_object_unref (pad);
+    gst_object_unref (src);
+  }
+
+  start = g_get_monotonic_time ();
+  for (i = 0; i < n_recorders && res; i++)
+    gst_element_set_state (pipelines[i], GST_STATE_PLAYING);
+  for (i = 0; i < n_recorders && res; i++) {
+    GstMessage *msg = gst_bus_timed_pop_filtered (GST_ELEMENT_BUS
+        (pipelines[i]), GST_CLOCK_TIME_NONE,
+        GST_MESSAGE_EOS | GST_MESSAGE_ERROR);
+    if (GST_MESSAGE_TYPE (msg) == GST_MESSAGE_ERROR) {
+      GError *err = NULL;
+      gst_message_parse_error (msg, &err, NULL);
+      g_printerr ("%s recorder %d failed: %s\n", sink, i, err->message);
+      g_error_free (err);
+      res = FALSE;
+    }
+    gst_message_unref (msg);
+  }
+  seconds = (gdouble) (g_get_monotonic_time () - start) / G_USEC_PER_SEC;
+
+  for (i = 0; i < n_recorders; i++) {
+    gchar *path = g_strdup_printf ("%s/rec-%d.bin", dir, i);
+    if (pipelines[i]) {
+      gst_element_set_state (pipelines[i], GST_STATE_NULL);
+      gst_object_unref (pipelines[i]);
+    }
+    g_unlink (path);
+    g_free (path);
+  }
+
+  if (res && latencies.latencies->len) {
+    GArray *l = latencies.latencies;
+
+    g_array_sort (l, compare_latency);
+    total_mb = (gdouble) n_recorders * n_buffers * buffer_size / (1024 * 1024);
+    g_print ("%-14s %8.1f MB/s  push p50 %6" G_GINT64_FORMAT " us  p99 %6"
+        G_GINT64_FORMAT " us  max %6" G_GINT64_FORMAT " us\n", sink,
+        total_mb / seconds, g_array_index (l, gint64, l->len / 2),
+        g_array_index (l, gint64, l->len * 99 / 100),
+        g_array_index (l, gint64, l->len - 1));
+  }
+
+  g_array_unref (latencies.latencies);
+  g_mutex_clear (&latencies.lock);
+  g_free (recorders);
+  g_free (pipelines);
+
+  return res;
+}
+
+gint
+main (gint argc, gchar * argv[])
+{
+  GOptionContext *ctx;
+  GError *err = NULL;
+  gint n_recorders = 64, n_buffers = 64, buffer_size = 256 * 1024, res = 0;
+  gboolean direct = FALSE;
+  gchar *dir = NULL, *sink;
+
+  GOptionEntry options[] = {
+    {"recorders", 'n', 0, G_OPTION_ARG_INT, &n_recorders,
+        "Number of concurrent recorders (default 64)", "N"}
+    ,
+    {"buffers", 'b', 0, G_OPTION_ARG_INT, &n_buffers,
+        "Buffers written by each recorder (default 64)", "N"}
+    ,
+    {"buffer-size", 's', 0, G_OPTION_ARG_INT, &buffer_size,
+        "Size of the buffers (default 256KB)", "BYTES"}
+    ,
+    {"dir", 'd', 0, G_OPTION_ARG_FILENAME, &dir,
+        "Directory of the recordings (default the temporary directory)",
+        "DIR"}
+    ,
+    {"direct", 0, 0, G_OPTION_ARG_NONE, &direct,
+        "Write with O_DIRECT in gpopuringsink", NULL}
+    ,
+    {NULL}
+  };
+
+  ctx = g_option_context_new ("- concurrent recorders throughput");
+  g_option_context_add_main_entries (ctx, options, NULL);
+  g_option_context_add_group (ctx, gst_init_get_option_group ());
+  if (!g_option_context_parse (ctx, &argc, &argv, &err)) {
+    g_printerr ("Error initializing: %s\n", err->message);
+    return -1;
+  }
+  g_option_context_free (ctx);
+  gpop_uring_sink_register ();
+
+  if (!dir)
+    dir = g_strdup (g_get_tmp_dir ());
+
+  sink = g_strdup_printf ("%s%s", GPOP_URING_SINK_NAME,
+      direct ? " o-direct=true" : "");
+  if (!run ("filesink", dir, n_recorders, n_buffers, buffer_size)
+      || !run (sink, dir, n_recorders, n_buffers, buffer_size))
+    res = 1;
+
+  g_free (sink);
+  g_free (dir);
+
+  return res;
+}
@@ -0,0 +1,320 @@
+/*
+ * GStreamer Prince of Parser
+ *
+ * Copyright (C) 2020 Stéphane Cerveau
+ *
+ * SPDX-License-Identifier: LGPL
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation
+ * version 2.1 of the License.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301 USA
+ *
+ */
+
+/* Footprint of idle pipelines: creates --count pipelines registered on a
+ * peer-to-peer D-Bus connection and reports what each of them costs in heap,
+ * RSS, file descriptors and threads. With --budget-bytes, the compact mode
+ * must stay under the given bytes per pipeline and must not use any extra fd
+ * nor thread. With --idle-seconds, the main loop then runs idle and the
+ * wakeups per second are reported, failing above --max-wakeups. */
+
+#include <errno.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#if defined(__GLIBC__)
+#include <malloc.h>
+#endif
+
+#include "gpop-private.h"
+
+typedef struct
+{
+  gint64 heap;
+  gint64 rss;
+  gint fds;
+  gint threads;
+} Footprint;
+
+static gint64
+get_heap_bytes (void)
+{
+#if defined(__GLIBC__) && (__GLIBC__ > 2 || (__GLIBC__ == 2 && __GLIBC_MINOR__ >= 33))
+  struct mallinfo2 info = mallinfo2 ();
+  return (gint64) info.uordblks + (gint64) info.hblkhd;
+#else
+  return 0;
+#endif
+}
+
+static gint64
+get_rss_bytes (void)
+{
+  gchar *contents = NULL;
+  gint64 pages = 0;
+
+  if (g_file_get_contents ("/proc/self/statm", &contents, NULL, NULL)) {
+    gchar **fields = g_strsplit (contents, " ", 3);
+    if (fields[0] && fields[1])
+      pages = g_ascii_strtoll (fields[1], NULL, 10);
+    g_strfreev (fields);
+  }
+  g_free (contents);
+
+  return pages * sysconf (_SC_PAGESIZE);
+}
+
+static gint
+count_dir_entries (const gchar * path)
+{
+  GDir *dir = g_dir_open (path, 0, NULL);
+  gint count = 0;
+
+  if (!dir)
+    return -1;
+  while (g_dir_read_name (dir))
+    count++;
+  g_dir_close (dir);
+
+  return count;
+}
+
+static void
+get_footprint (Footprint * footprint)
+{
+  /* Let the pending state changes and bus messages settle. */
+  while (g_main_context_iteration (NULL, FALSE));
+
+  footprint->heap = get_heap_bytes ();
+  footprint->rss = get_rss_bytes ();
+  footprint->fds = count_dir_entries ("/proc/self/fd");
+  footprint->threads = count_dir_entries ("/proc/self/task");
+}
+
+static void
+on_server_connection (GObject * source, GAsyncResult * res, gpointer user_data)
+{
+  GDBusConnection **server = (GDBusConnection **) user_data;
+  GError *error = NULL;
+
+  *server = g_dbus_connection_new_finish (res, &error);
+  if (!*server)
+    g_error ("Unable to create the server connection: %s", error->message);
+}
+
+/* Peer-to-peer connection over a socketpair, no bus daemon required. */
+static GDBusConnection *
+create_connection (GDBusConnection ** client)
+{
+  GDBusConnection *server = NULL;
+  GSocketConnection *streams[2];
+  GError *error = NULL;
+  gchar *guid;
+  gint fds[2], i;
+
+  if (socketpair (AF_UNIX, SOCK_STREAM, 0, fds) < 0)
+    g_error ("Unable to create the socket pair: %s", g_strerror (errno));
+
+  for (i = 0; i < 2; i++) {
+    GSocket *socket = g_socket_new_from_fd (fds[i], &error);
+    if (!socket)
+      g_error ("Unable to wrap the socket: %s", error->message);
+    streams[i] = g_socket_connection_factory_create_connection (socket);
+    g_object_unref (socket);
+  }
+
+  guid = g_dbus_generate_guid ();
+  g_dbus_connection_new (G_IO_STREAM (streams[0]), guid,
+      G_DBUS_CONNECTION_FLAGS_AUTHENTICATION_SERVER |
+      G_DBUS_CONNECTION_FLAGS_AUTHENTICATION_ALLOW_ANONYMOUS, NULL, NULL,
+      on_server_connection, &server);
+  *client = g_dbus_connection_new_sync (G_IO_STREAM (streams[1]), NULL,
+      G_DBUS_CONNECTION_FLAGS_AUTHENTICATION_CLIENT, NULL, NULL, &error);
+  if (!*client)
+    g_error ("Unable to create the client connection: %s", error->message);
+  while (!server)
+    g_main_context_iteration (NULL, TRUE);
+
+  g_free (guid);
+  g_object_unref (streams[0]);
+  g_object_unref (streams[1]);
+
+  return server;
+}
+
+static void
+silent_print (const gchar * string)
+{
+}
+
+static GPollFunc default_poll;
+static guint64 poll_wakeups;
+
+static gint
+counting_poll (GPollFD * fds, guint nfds, gint timeout)
+{
+  gint res = default_poll (fds, nfds, timeout);
+
+  poll_wakeups++;
+  return res;
+}
+
+static gboolean
+on_idle_deadline (gpointer user_data)
+{
+  *(gboolean *) user_data = TRUE;
+  return G_SOURCE_REMOVE;
+}
+
+/* Returns the wakeups of the main context during seconds, and those of the
+ * shared timer */
+static guint64
+measure_idle_wakeups (gint seconds, guint64 * timer_wakeups)
+{
+  GMainContext *context = g_main_context_default ();
+  gboolean done = FALSE;
+
+  /* Let the pending state changes and bus messages settle. */
+  while (g_main_context_iteration (NULL, FALSE));
+
+  *timer_wakeups = gpop_timers_get_wakeups ();
+  default_poll = g_main_context_get_poll_func (context);
+  g_main_context_set_poll_func (context, counting_poll);
+  poll_wakeups = 0;
+  g_timeout_add_seconds (seconds, on_idle_deadline, &done);
+  while (!done)
+    g_main_context_iteration (context, TRUE);
+  g_main_context_set_poll_func (context, default_poll);
+  *timer_wakeups = gpop_timers_get_wakeups () - *timer_wakeups;
+
+  /* the deadline itself is not counted */
+  return poll_wakeups ? poll_wakeups - 1 : 0;
+}
+
+gint
+main (gint argc, gchar * argv[])
+{
+  GDBusConnection *connection, *client;
+  GPOPManager *manager;
+  GPOPPipeline *pipeline;
+  GOptionContext *ctx;
+  GError *err = NULL;
+  Footprint before, after;
+  gint count = 10000, budget_bytes = 0, idle_seconds = 0, i, res = 0;
+  gdouble max_wakeups = -1;
+  gboolean compact = FALSE;
+  gchar *desc = NULL;
+  gdouble per_heap, per_rss;
+
+  GOptionEntry options[] = {
+    {"count", 'n', 0, G_OPTION_ARG_INT, &count,
+        "Number of idle pipelines to create (default 10000)", "N"}
+    ,
+    {"compact", 'c', 0, G_OPTION_ARG_NONE, &compact,
+        "Create the pipelines in compact mode", NULL}
+    ,
+    {"budget-bytes", 'b', 0, G_OPTION_ARG_INT, &budget_bytes,
+        "Fail if a compact pipeline costs more than this many bytes", "BYTES"}
+    ,
+    {"idle-seconds", 'i', 0, G_OPTION_ARG_INT, &idle_seconds,
+        "Measure the idle wakeups during SECONDS", "SECONDS"}
+    ,
+    {"max-wakeups", 'w', 0, G_OPTION_ARG_DOUBLE, &max_wakeups,
+        "Fail above this many idle wakeups per second", "N"}
+    ,
+    {"desc", 'd', 0, G_OPTION_ARG_STRING, &desc,
+        "Pipeline description (default appsrc ! fakesink)", "DESC"}
+    ,
+    {NULL}
+  };
+
+  ctx = g_option_context_new ("- gpop idle pipeline footprint");
+  g_option_context_add_main_entries (ctx, options, NULL);
+  g_option_context_add_group (ctx, gst_init_get_option_group ());
+  if (!g_option_context_parse (ctx, &argc, &argv, &err)) {
+    g_printerr ("Error initializing: %s\n", err->message);
+    return -1;
+  }
+  g_option_context_free (ctx);
+
+  connection = create_connection (&client);
+  manager = gpop_manager_new (connection);
+  gpop_manager_set_compact (manager, compact);
+
+  /* Warm up the type system, the introspection cache and the plugins. */
+  if (!desc)
+    desc = g_strdup ("appsrc ! fakesink");
+  pipeline = gpop_manager_add_pipeline (manager, 0, desc, NULL);
+  if (!pipeline) {
+    g_printerr ("Unable to create the pipeline '%s'\n", desc);
+    return -1;
+  }
+  gpop_manager_remove_pipeline (manager, pipeline->id);
+
+  g_set_print_handler (silent_print);
+  get_footprint (&before);
+  for (i = 1; i <= count; i++)
+    gpop_manager_add_pipeline (manager, i, desc, NULL);
+  get_footprint (&after);
+  g_set_print_handler (NULL);
+
+  per_heap = (gdouble) (after.heap - before.heap) / count;
+  per_rss = (gdouble) (after.rss - before.rss) / count;
+  g_print ("%d %s pipelines\n", count, compact ? "compact" : "default");
+  g_print ("  heap    %10.1f bytes/pipeline\n", per_heap);
+  g_print ("  rss     %10.1f bytes/pipeline\n", per_rss);
+  g_print ("  fds     %10.3f /pipeline (%d -> %d)\n",
+      (gdouble) (after.fds - before.fds) / count, before.fds, after.fds);
+  g_print ("  threads %10.3f /pipeline (%d -> %d)\n",
+      (gdouble) (after.threads - before.threads) / count, before.threads,
+      after.threads);
+
+  if (compact && budget_bytes > 0) {
+    gdouble bytes = per_heap > 0 ? per_heap : per_rss;
+
+    if (bytes > budget_bytes) {
+      g_printerr ("FAIL: %.1f bytes/pipeline over the %d bytes budget\n",
+          bytes, budget_bytes);
+      res = 1;
+    }
+    if (after.fds != before.fds || after.threads != before.threads) {
+      g_printerr ("FAIL: idle compact pipelines must not use fds nor "
+          "threads\n");
+      res = 1;
+    }
+  }
+
+  if (idle_seconds > 0) {
+    guint64 timer_wakeups;
+    gdouble wakeups;
+
+    g_set_print_handler (silent_print);
+    wakeups = (gdouble) measure_idle_wakeups (idle_seconds, &timer_wakeups)
+        / idle_seconds;
+    g_set_print_handler (NULL);
+    g_print ("  wakeups %10.2f /s idle over %d s (%" G_GUINT64_FORMAT
+        " from the shared timer)\n", wakeups, idle_seconds, timer_wakeups);
+    if (max_wakeups >= 0 && wakeups > max_wakeups) {
+      g_printerr ("FAIL: %.2f idle wakeups/s over %.2f\n", wakeups,
+          max_wakeups);
+      res = 1;
+    }
+  }
+
+  gpop_manage_free (manager);
+  g_object_unref (client);
+  g_object_unref (connection);
+  g_free (desc);
+
+  return res;
+}
@@ -0,0 +1,185 @@
+/*
+ * GStreamer Prince of Parser
+ *
+ * Copyright (C) 2020 Stéphane Cerveau
+ *
+ * SPDX-License-Identifier: LGPL
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation
+ * version 2.1 of the License.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301 USA
+ *
+ */
+
+/* Startup cost of gpop: spawns itself --iterations times, each child
+ * initializes GStreamer and gpop, plays --pipeline to the end and reports
+ * its peak RSS. The wall time of a child includes the dynamic loading of the
+ * libraries and the plugins, so that the static build can be compared to
+ * the dynamic one by running this benchmark from both build directories. */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "gpop-private.h"
+
+#define DEFAULT_PIPELINE \
+  "videotestsrc num-buffers=1 ! videoconvert ! fakesink"
+
+static guint64
+get_peak_rss_kb (void)
+{
+  gchar *status = NULL, *line;
+  guint64 rss = 0;
+
+  if (!g_file_get_contents ("/proc/self/status", &status, NULL, NULL))
+    return 0;
+  line = strstr (status, "VmHWM:");
+  if (line)
+    rss = g_ascii_strtoull (line + strlen ("VmHWM:"), NULL, 10);
+  g_free (status);
+  return rss;
+}
+
+static gint
+run_child (const gchar * description)
+{
+  GstElement *pipeline;
+  GstMessage *msg;
+  GError *err = NULL;
+  gint64 start = g_get_monotonic_time (), initialized;
+  gboolean res;
+
+  gpop_prepare ();
+  gst_init (NULL, NULL);
+  gpop_register_elements ();
+  initialized = g_get_monotonic_time ();
+
+  pipeline = gst_parse_launch (description, &err);
+  if (!pipeline) {
+    g_printerr ("Unable to create the pipeline: %s\n", err->message);
+    g_error_free (err);
+    return 1;
+  }
+  gst_element_set_state (pipeline, GST_STATE_PLAYING);
+  msg = gst_bus_timed_pop_filtered (GST_ELEMENT_BUS (pipeline),
+      GST_CLOCK_TIME_NONE, GST_MESSAGE_EOS | GST_MESSAGE_ERROR);
+  res = GST_MESSAGE_TYPE (msg) == GST_MESSAGE_EOS;
+  gst_message_unref (msg);
+  gst_element_set_state (pipeline, GST_STATE_NULL);
+  gst_object_unref (pipeline);
+
+  g_print ("%" G_GINT64_FORMAT " %" G_GINT64_FORMAT " %" G_GUINT64_FORMAT
+      "\n", initialized - start, g_get_monotonic_time () - initialized,
+      get_peak_rss_kb ());
+  return res ? 0 : 1;
+}
+
+static gint
+compare_int64 (gconstpointer a, gconstpointer b)
+{
+  gint64 va = *(const gint64 *) a, vb = *(const gint64 *) b;
+
+  return va < vb ? -1 : va > vb;
+}
+
+gint
+main (gint argc, gchar * argv[])
+{
+  GOptionContext *ctx;
+  GError *err = NULL;
+  gint iterations = 20, i, n = 0;
+  gboolean child = FALSE;
+  gchar *description = NULL;
+  gint64 *startups, *inits;
+  guint64 rss_max = 0;
+
+  GOptionEntry options[] = {
+    {"iterations", 'n', 0, G_OPTION_ARG_INT, &iterations,
+        "Number of processes to start (default 20)", "N"}
+    ,
+    {"pipeline", 'p', 0, G_OPTION_ARG_STRING, &description,
+        "Pipeline played by each process (default " DEFAULT_PIPELINE ")",
+        "DESC"}
+    ,
+    {"child", 0, G_OPTION_FLAG_HIDDEN, G_OPTION_ARG_NONE, &child, NULL, NULL}
+    ,
+    {NULL}
+  };
+
+  /* GStreamer is only initialized by the children */
+  ctx = g_option_context_new ("- gpop startup time and memory");
+  g_option_context_add_main_entries (ctx, options, NULL);
+  if (!g_option_context_parse (ctx, &argc, &argv, &err)) {
+    g_printerr ("Error initializing: %s\n", err->message);
+    return -1;
+  }
+  g_option_context_free (ctx);
+  if (!description)
+    description = g_strdup (DEFAULT_PIPELINE);
+
+  if (child)
+    return run_child (description);
+
+  startups = g_new0 (gint64, MAX (iterations, 1));
+  inits = g_new0 (gint64, MAX (iterations, 1));
+  for (i = 0; i < iterations; i++) {
+    gchar *child_argv[] = { argv[0], (gchar *) "--child",
+      (gchar *) "--pipeline", description, NULL
+    };
+    gchar *output = NULL;
+    gint64 start = g_get_monotonic_time (), init_us, play_us;
+    guint64 rss;
+    gint status;
+
+    if (!g_spawn_sync (NULL, child_argv, NULL, G_SPAWN_DEFAULT, NULL, NULL,
+            &output, NULL, &status, &err)) {
+      g_printerr ("Unable to start %s: %s\n", argv[0], err->message);
+      g_clear_error (&err);
+      break;
+    }
+    startups[n] = g_get_monotonic_time () - start;
+    if (!g_spawn_check_exit_status (status, NULL) || sscanf (output,
+            "%" G_GINT64_FORMAT " %" G_GINT64_FORMAT " %" G_GUINT64_FORMAT,
+            &init_us, &play_us, &rss) != 3) {
+      g_printerr ("The process failed, is the pipeline available?\n");
+      g_free (output);
+      break;
+    }
+    inits[n++] = init_us;
+    rss_max = MAX (rss_max, rss);
+    g_free (output);
+  }
+
+  if (n) {
+    qsort (startups, n, sizeof (gint64), compare_int64);
+    qsort (inits, n, sizeof (gint64), compare_int64);
+    g_print ("%s build, %d processes\n",
+#ifdef GPOP_STATIC_BUILD
+        "static",
+#else
+        "dynamic",
+#endif
+        n);
+    g_print ("process  p50 %7.1f ms  p90 %7.1f ms\n", startups[n / 2] / 1000.0,
+        startups[n * 9 / 10] / 1000.0);
+    g_print ("gst init p50 %7.1f ms  p90 %7.1f ms\n", inits[n / 2] / 1000.0,
+        inits[n * 9 / 10] / 1000.0);
+    g_print ("peak rss %7" G_GUINT64_FORMAT " kB\n", rss_max);
+  }
+
+  g_free (startups);
+  g_free (inits);
+  g_free (description);
+  return n == iterations ? 0 : 1;
+}
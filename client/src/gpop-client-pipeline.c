@@ -0,0 +1,231 @@
+/*
+ * GStreamer Prince of Parser
+ *
+ * Copyright (C) 2020 Stéphane Cerveau
+ *
+ * SPDX-License-Identifier: LGPL
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation
+ * version 2.1 of the License.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301 USA
+ *
+ */
+
+#include "gpop-client-pipeline.h"
+
+G_DEFINE_TYPE (GPOPClientPipeline, gpop_client_pipeline, G_TYPE_OBJECT);
+#define parent_class gpop_client_pipeline_parent_class
+
+enum
+{
+  SIGNAL_CHANGED,
+  SIGNAL_LAST
+};
+
+static guint gpop_client_pipeline_signals[SIGNAL_LAST] = { 0 };
+
+static gchar *
+gpop_client_pipeline_dup_string_property (GPOPClientPipeline * pipeline,
+    const gchar * property_name)
+{
+  GVariant *value;
+  gchar *ret = NULL;
+
+  value = g_dbus_proxy_get_cached_property (pipeline->proxy, property_name);
+  if (value) {
+    ret = g_variant_dup_string (value, NULL);
+    g_variant_unref (value);
+  }
+  return ret;
+}
+
+static void
+on_properties_changed (GDBusProxy * proxy, GVariant * changed_properties,
+    GStrv invalidated_properties, gpointer user_data)
+{
+  GPOPClientPipeline *pipeline = (GPOPClientPipeline *) user_data;
+  GVariantIter iter;
+  const gchar *property_name;
+  guint i;
+
+  g_variant_iter_init (&iter, changed_properties);
+  while (g_variant_iter_next (&iter, "{&sv}", &property_name, NULL))
+    g_signal_emit (pipeline,
+        gpop_client_pipeline_signals[SIGNAL_CHANGED], 0, property_name);
+
+  for (i = 0; invalidated_properties && invalidated_properties[i]; i++)
+    g_signal_emit (pipeline,
+        gpop_client_pipeline_signals[SIGNAL_CHANGED], 0,
+        invalidated_properties[i]);
+}
+
+static void
+on_call_done (GObject * source, GAsyncResult * res, gpointer user_data)
+{
+  GTask *task = (GTask *) user_data;
+  GError *error = NULL;
+  GVariant *ret;
+
+  ret = g_dbus_proxy_call_finish (G_DBUS_PROXY (source), res, &error);
+  if (ret) {
+    g_variant_unref (ret);
+    g_task_return_boolean (task, TRUE);
+  } else
+    g_task_return_error (task, error);
+  g_object_unref (task);
+}
+
+static void
+gpop_client_pipeline_call (GPOPClientPipeline * pipeline,
+    const gchar * method_name, GCancellable * cancellable,
+    GAsyncReadyCallback callback, gpointer user_data)
+{
+  GTask *task = g_task_new (pipeline, cancellable, callback, user_data);
+
+  g_dbus_proxy_call (pipeline->proxy, method_name, NULL,
+      G_DBUS_CALL_FLAGS_NONE, -1, cancellable, on_call_done, task);
+}
+
+/*----------------------------------------------------------------------------*
+ *                            GObject interface                               *
+ *----------------------------------------------------------------------------*/
+static void
+gpop_client_pipeline_dispose (GObject * object)
+{
+  GPOPClientPipeline *pipeline = GPOP_CLIENT_PIPELINE (object);
+
+  if (pipeline->proxy)
+    g_signal_handlers_disconnect_by_data (pipeline->proxy, pipeline);
+  g_clear_object (&pipeline->proxy);
+  g_clear_pointer (&pipeline->id, g_free);
+
+  if (G_OBJECT_CLASS (parent_class)->dispose)
+    G_OBJECT_CLASS (parent_class)->dispose (object);
+}
+
+static void
+gpop_client_pipeline_class_init (GPOPClientPipelineClass * klass)
+{
+  GObjectClass *gobject_class = G_OBJECT_CLASS (klass);
+
+  gobject_class->dispose = gpop_client_pipeline_dispose;
+
+  gpop_client_pipeline_signals[SIGNAL_CHANGED] =
+      g_signal_new ("changed", G_TYPE_FROM_CLASS (klass),
+      G_SIGNAL_RUN_LAST, G_STRUCT_OFFSET (GPOPClientPipelineClass,
+          changed), NULL, NULL, NULL, G_TYPE_NONE, 1, G_TYPE_STRING);
+}
+
+static void
+gpop_client_pipeline_init (GPOPClientPipeline * pipeline)
+{
+}
+
+/* Public API */
+
+GPOPClientPipeline *
+gpop_client_pipeline_new (GDBusProxy * proxy)
+{
+  GPOPClientPipeline *pipeline = g_object_new (GPOP_TYPE_CLIENT_PIPELINE, NULL);
+
+  pipeline->proxy = g_object_ref (proxy);
+  pipeline->id = gpop_client_pipeline_dup_string_property (pipeline, "id");
+  g_signal_connect (proxy, "g-properties-changed",
+      G_CALLBACK (on_properties_changed), pipeline);
+
+  return pipeline;
+}
+
+const gchar *
+gpop_client_pipeline_get_id (GPOPClientPipeline * pipeline)
+{
+  g_return_val_if_fail (GPOP_IS_CLIENT_PIPELINE (pipeline), NULL);
+
+  return pipeline->id;
+}
+
+const gchar *
+gpop_client_pipeline_get_object_path (GPOPClientPipeline * pipeline)
+{
+  g_return_val_if_fail (GPOP_IS_CLIENT_PIPELINE (pipeline), NULL);
+
+  return g_dbus_proxy_get_object_path (pipeline->proxy);
+}
+
+gchar *
+gpop_client_pipeline_get_desc (GPOPClientPipeline * pipeline)
+{
+  g_return_val_if_fail (GPOP_IS_CLIENT_PIPELINE (pipeline), NULL);
+
+  return gpop_client_pipeline_dup_string_property (pipeline, "parser_desc");
+}
+
+gchar *
+gpop_client_pipeline_get_state (GPOPClientPipeline * pipeline)
+{
+  g_return_val_if_fail (GPOP_IS_CLIENT_PIPELINE (pipeline), NULL);
+
+  return gpop_client_pipeline_dup_string_property (pipeline, "state");
+}
+
+gboolean
+gpop_client_pipeline_is_streaming (GPOPClientPipeline * pipeline)
+{
+  GVariant *value;
+  gboolean ret = FALSE;
+
+  g_return_val_if_fail (GPOP_IS_CLIENT_PIPELINE (pipeline), FALSE);
+
+  value = g_dbus_proxy_get_cached_property (pipeline->proxy, "streaming");
+  if (value) {
+    ret = g_variant_get_boolean (value);
+    g_variant_unref (value);
+  }
+  return ret;
+}
+
+void
+gpop_client_pipeline_play_async (GPOPClientPipeline * pipeline,
+    GCancellable * cancellable, GAsyncReadyCallback callback,
+    gpointer user_data)
+{
+  gpop_client_pipeline_call (pipeline, "Play", cancellable, callback,
+      user_data);
+}
+
+void
+gpop_client_pipeline_pause_async (GPOPClientPipeline * pipeline,
+    GCancellable * cancellable, GAsyncReadyCallback callback,
+    gpointer user_data)
+{
+  gpop_client_pipeline_call (pipeline, "Pause", cancellable, callback,
+      user_data);
+}
+
+void
+gpop_client_pipeline_stop_async (GPOPClientPipeline * pipeline,
+    GCancellable * cancellable, GAsyncReadyCallback callback,
+    gpointer user_data)
+{
+  gpop_client_pipeline_call (pipeline, "Stop", cancellable, callback,
+      user_data);
+}
+
+gboolean
+gpop_client_pipeline_call_finish (GPOPClientPipeline * pipeline,
+    GAsyncResult * res, GError ** error)
+{
+  g_return_val_if_fail (g_task_is_valid (res, pipeline), FALSE);
+
+  return g_task_propagate_boolean (G_TASK (res), error);
+}
@@ -0,0 +1,77 @@
+/*
+ * GStreamer Prince of Parser
+ *
+ * Copyright (C) 2020 Stéphane Cerveau
+ *
+ * SPDX-License-Identifier: LGPL
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation
+ * version 2.1 of the License.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301 USA
+ *
+ */
+
+#ifndef _GPOP_CLIENT_PIPELINE_H_
+#define _GPOP_CLIENT_PIPELINE_H_
+
+#include <gio/gio.h>
+#include <glib-2.0/glib.h>
+
+#define GPOP_TYPE_CLIENT_PIPELINE	           (gpop_client_pipeline_get_type())
+#define GPOP_CLIENT_PIPELINE(obj)            (G_TYPE_CHECK_INSTANCE_CAST((obj),\
+                                              GPOP_TYPE_CLIENT_PIPELINE, GPOPClientPipeline))
+#define GPOP_CLIENT_PIPELINE_CLASS(klass)    (G_TYPE_CHECK_CLASS_CAST((klass),\
+                                              GPOP_TYPE_CLIENT_PIPELINE, GPOPClientPipelineClass))
+#define GPOP_CLIENT_PIPELINE_GET_CLASS(obj)  (G_TYPE_INSTANCE_GET_CLASS ((obj),\
+                                              GPOP_TYPE_CLIENT_PIPELINE, GPOPClientPipelineClass))
+#define GPOP_IS_CLIENT_PIPELINE(obj)         (G_TYPE_CHECK_INSTANCE_TYPE((obj),\
+                                              GPOP_TYPE_CLIENT_PIPELINE))
+#define GPOP_IS_CLIENT_PIPELINE_CLASS(klass) (G_TYPE_CHECK_CLASS_TYPE((klass),\
+                                              GPOP_TYPE_CLIENT_PIPELINE))
+
+typedef struct _GPOPClientPipeline GPOPClientPipeline;
+typedef struct _GPOPClientPipelineClass GPOPClientPipelineClass;
+
+/* Local view of a remote org.gpop pipeline. The properties are served from
+ * the GDBusProxy cache, which is kept up to date by the PropertiesChanged
+ * signals emitted by the daemon, so reading them never hits the bus. */
+struct _GPOPClientPipeline
+{
+  GObject base;
+  GDBusProxy *proxy;
+  gchar *id;
+};
+
+struct _GPOPClientPipelineClass
+{
+  GObjectClass base;
+
+  void (*changed) (GPOPClientPipeline * pipeline, const gchar * property_name);
+};
+
+GType gpop_client_pipeline_get_type (void);
+
+GPOPClientPipeline * gpop_client_pipeline_new (GDBusProxy * proxy);
+
+const gchar * gpop_client_pipeline_get_id (GPOPClientPipeline * pipeline);
+const gchar * gpop_client_pipeline_get_object_path (GPOPClientPipeline * pipeline);
+gchar * gpop_client_pipeline_get_desc (GPOPClientPipeline * pipeline);
+gchar * gpop_client_pipeline_get_state (GPOPClientPipeline * pipeline);
+gboolean gpop_client_pipeline_is_streaming (GPOPClientPipeline * pipeline);
+
+void gpop_client_pipeline_play_async (GPOPClientPipeline * pipeline, GCancellable * cancellable, GAsyncReadyCallback callback, gpointer user_data);
+void gpop_client_pipeline_pause_async (GPOPClientPipeline * pipeline, GCancellable * cancellable, GAsyncReadyCallback callback, gpointer user_data);
+void gpop_client_pipeline_stop_async (GPOPClientPipeline * pipeline, GCancellable * cancellable, GAsyncReadyCallback callback, gpointer user_data);
+gboolean gpop_client_pipeline_call_finish (GPOPClientPipeline * pipeline, GAsyncResult * res, GError ** error);
+
+#endif /* _GPOP_CLIENT_PIPELINE_H_ */
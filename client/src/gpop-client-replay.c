@@ -0,0 +1,511 @@
+/*
+ * GStreamer Prince of Parser
+ *
+ * Copyright (C) 2020 Stéphane Cerveau
+ *
+ * SPDX-License-Identifier: LGPL
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation
+ * version 2.1 of the License.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301 USA
+ *
+ */
+
+#include <string.h>
+
+#include "gpop-client.h"
+#include "gpop-client-replay.h"
+#include "gpop-recording.h"
+
+G_DEFINE_TYPE (GPOPClientReplay, gpop_client_replay, G_TYPE_OBJECT);
+#define parent_class gpop_client_replay_parent_class
+
+typedef struct
+{
+  GPOPClientReplay *replay;
+  gchar *method_name;
+  gint64 sent;
+  gboolean is_add;
+  GPtrArray *created_paths;
+  GPtrArray *created_ids;
+} ReplayCall;
+
+static void gpop_client_replay_tick (GPOPClientReplay * replay);
+
+static void
+replay_call_free (ReplayCall * call)
+{
+  g_free (call->method_name);
+  if (call->created_paths)
+    g_ptr_array_unref (call->created_paths);
+  if (call->created_ids)
+    g_ptr_array_unref (call->created_ids);
+  g_object_unref (call->replay);
+  g_free (call);
+}
+
+static const gchar *
+gpop_client_replay_map (GHashTable * table, const gchar * key)
+{
+  const gchar *value = g_hash_table_lookup (table, key);
+
+  return value ? value : key;
+}
+
+static GVariant *
+gpop_client_replay_map_ids (GPOPClientReplay * replay, GVariant * ids)
+{
+  GVariantBuilder builder;
+  GVariantIter iter;
+  const gchar *id;
+
+  g_variant_builder_init (&builder, G_VARIANT_TYPE ("as"));
+  g_variant_iter_init (&iter, ids);
+  while (g_variant_iter_next (&iter, "&s", &id))
+    g_variant_builder_add (&builder, "s",
+        gpop_client_replay_map (replay->ids, id));
+  return g_variant_builder_end (&builder);
+}
+
+/* Ids are generated by the daemon, the recorded ones are translated to the
+ * ones of the replayed pipelines. The <Method>WithKey variants take the
+ * request id first. */
+static GVariant *
+gpop_client_replay_map_parameters (GPOPClientReplay * replay,
+    const gchar * method_name, GVariant * parameters)
+{
+  const gchar *key, *id;
+  GVariant *ids, *ret;
+
+  if ((!g_strcmp0 (method_name, "RemovePipeline")
+          || !g_strcmp0 (method_name, "GetPipelineDesc"))
+      && g_variant_is_of_type (parameters, G_VARIANT_TYPE ("(s)"))) {
+    g_variant_get (parameters, "(&s)", &id);
+    return g_variant_new ("(s)", gpop_client_replay_map (replay->ids, id));
+  } else if (!g_strcmp0 (method_name, "RemovePipelineWithKey")
+      && g_variant_is_of_type (parameters, G_VARIANT_TYPE ("(ss)"))) {
+    g_variant_get (parameters, "(&s&s)", &key, &id);
+    return g_variant_new ("(ss)", key, gpop_client_replay_map (replay->ids,
+            id));
+  } else if (!g_strcmp0 (method_name, "RemovePipelines")
+      && g_variant_is_of_type (parameters, G_VARIANT_TYPE ("(as)"))) {
+    g_variant_get (parameters, "(@as)", &ids);
+    ret = g_variant_new ("(@as)", gpop_client_replay_map_ids (replay, ids));
+    g_variant_unref (ids);
+    return ret;
+  } else if (!g_strcmp0 (method_name, "RemovePipelinesWithKey")
+      && g_variant_is_of_type (parameters, G_VARIANT_TYPE ("(sas)"))) {
+    g_variant_get (parameters, "(&s@as)", &key, &ids);
+    ret = g_variant_new ("(s@as)", key, gpop_client_replay_map_ids (replay,
+            ids));
+    g_variant_unref (ids);
+    return ret;
+  }
+
+  return g_variant_ref (parameters);
+}
+
+static void
+gpop_client_replay_add_latency (GPOPClientReplay * replay,
+    const gchar * method_name, gint64 latency)
+{
+  GArray *latencies = g_hash_table_lookup (replay->latencies, method_name);
+
+  if (!latencies) {
+    latencies = g_array_new (FALSE, FALSE, sizeof (gint64));
+    g_hash_table_insert (replay->latencies, g_strdup (method_name), latencies);
+  }
+  g_array_append_val (latencies, latency);
+}
+
+static void
+gpop_client_replay_check_done (GPOPClientReplay * replay)
+{
+  GTask *task;
+
+  if (!replay->task || replay->index < replay->records->len
+      || replay->in_flight)
+    return;
+
+  task = replay->task;
+  replay->task = NULL;
+  g_task_return_boolean (task, TRUE);
+  g_object_unref (task);
+}
+
+static void
+gpop_client_replay_map_created (GPOPClientReplay * replay, ReplayCall * call,
+    GVariant * ret)
+{
+  GVariantIter *iter;
+  const gchar *id, *object_path;
+  guint i = 0;
+
+  /* AddPipeline and AddPipelineWithKey */
+  if (g_variant_is_of_type (ret, G_VARIANT_TYPE ("(so)"))) {
+    g_variant_get (ret, "(&s&o)", &id, &object_path);
+    if (call->created_paths->len) {
+      g_hash_table_replace (replay->paths,
+          g_strdup (g_ptr_array_index (call->created_paths, 0)),
+          g_strdup (object_path));
+      g_hash_table_replace (replay->ids,
+          g_strdup (g_ptr_array_index (call->created_ids, 0)), g_strdup (id));
+    }
+    return;
+  }
+
+  /* AddPipelines only reports the created pipelines in the recording, the
+   * failed ones are returned with an empty id by the replay target. */
+  if (!g_variant_is_of_type (ret, G_VARIANT_TYPE ("(a(so))")))
+    return;
+  g_variant_get (ret, "(a(so))", &iter);
+  while (g_variant_iter_next (iter, "(&s&o)", &id, &object_path)) {
+    if (*id == '\0')
+      continue;
+    if (i >= call->created_paths->len)
+      break;
+    g_hash_table_replace (replay->paths,
+        g_strdup (g_ptr_array_index (call->created_paths, i)),
+        g_strdup (object_path));
+    g_hash_table_replace (replay->ids,
+        g_strdup (g_ptr_array_index (call->created_ids, i)), g_strdup (id));
+    i++;
+  }
+  g_variant_iter_free (iter);
+}
+
+static void
+on_call_done (GObject * source, GAsyncResult * res, gpointer user_data)
+{
+  ReplayCall *call = (ReplayCall *) user_data;
+  GPOPClientReplay *replay = call->replay;
+  GError *error = NULL;
+  GVariant *ret;
+
+  ret = g_dbus_connection_call_finish (G_DBUS_CONNECTION (source), res, &error);
+  gpop_client_replay_add_latency (replay, call->method_name,
+      g_get_monotonic_time () - call->sent);
+
+  if (ret) {
+    if (call->is_add)
+      gpop_client_replay_map_created (replay, call, ret);
+    g_variant_unref (ret);
+  } else {
+    replay->errors++;
+    g_error_free (error);
+  }
+
+  replay->in_flight--;
+  if (call->is_add && --replay->adds_in_flight == 0 && replay->task)
+    gpop_client_replay_tick (replay);
+
+  gpop_client_replay_check_done (replay);
+  replay_call_free (call);
+}
+
+static void
+gpop_client_replay_send (GPOPClientReplay * replay, const gchar * object_path,
+    const gchar * method_name, GVariant * parameters)
+{
+  ReplayCall *call = g_new0 (ReplayCall, 1);
+  const gchar *interface_name = GPOP_CLIENT_INTERFACE_NAME;
+  const gchar *member = method_name;
+  GVariant *args;
+  guint i;
+
+  call->replay = g_object_ref (replay);
+  call->method_name = g_strdup (method_name);
+
+  if (!g_strcmp0 (method_name, "Get")) {
+    const gchar *property_name;
+
+    g_variant_get (parameters, "(&s)", &property_name);
+    interface_name = "org.freedesktop.DBus.Properties";
+    args = g_variant_new ("(ss)", GPOP_CLIENT_INTERFACE_NAME, property_name);
+  } else {
+    args = gpop_client_replay_map_parameters (replay, method_name, parameters);
+  }
+
+  if (g_str_has_prefix (method_name, "AddPipeline")) {
+    call->is_add = TRUE;
+    call->created_paths = g_ptr_array_new_with_free_func (g_free);
+    call->created_ids = g_ptr_array_new_with_free_func (g_free);
+    /* The pipelines created by this request are recorded right after it. */
+    for (i = replay->index + 1; i < replay->records->len; i++) {
+      GVariant *record = g_ptr_array_index (replay->records, i);
+      const gchar *created_path, *created_method, *created_id;
+      GVariant *created_params;
+
+      g_variant_get (record, "(t&s&sv)", NULL, &created_path,
+          &created_method, &created_params);
+      if (g_strcmp0 (created_method, GPOP_RECORDER_CREATED)) {
+        g_variant_unref (created_params);
+        break;
+      }
+      g_variant_get (created_params, "(&s)", &created_id);
+      g_ptr_array_add (call->created_paths, g_strdup (created_path));
+      g_ptr_array_add (call->created_ids, g_strdup (created_id));
+      g_variant_unref (created_params);
+    }
+    replay->adds_in_flight++;
+  }
+
+  replay->in_flight++;
+  call->sent = g_get_monotonic_time ();
+  g_dbus_connection_call (replay->connection, replay->bus_name, object_path,
+      interface_name, member, args, NULL, G_DBUS_CALL_FLAGS_NONE, -1, NULL,
+      on_call_done, call);
+}
+
+static gboolean
+gpop_client_replay_timeout (gpointer user_data)
+{
+  GPOPClientReplay *replay = (GPOPClientReplay *) user_data;
+
+  replay->timeout_id = 0;
+  gpop_client_replay_tick (replay);
+
+  return G_SOURCE_REMOVE;
+}
+
+static void
+gpop_client_replay_tick (GPOPClientReplay * replay)
+{
+  gint64 now = g_get_monotonic_time ();
+
+  if (replay->timeout_id)
+    return;
+
+  while (replay->index < replay->records->len) {
+    GVariant *record = g_ptr_array_index (replay->records, replay->index);
+    const gchar *object_path, *method_name, *target;
+    GVariant *parameters;
+    guint64 ts;
+    gint64 due;
+
+    g_variant_get (record, "(t&s&sv)", &ts, &object_path, &method_name,
+        &parameters);
+
+    if (!g_strcmp0 (method_name, GPOP_RECORDER_CREATED)) {
+      replay->index++;
+      g_variant_unref (parameters);
+      continue;
+    }
+
+    due = replay->start + (replay->speed > 0 ? ts / replay->speed : 0);
+    if (due > now) {
+      replay->timeout_id = g_timeout_add ((due - now + 999) / 1000,
+          gpop_client_replay_timeout, replay);
+      g_variant_unref (parameters);
+      return;
+    }
+
+    target = g_hash_table_lookup (replay->paths, object_path);
+    if (!target && replay->adds_in_flight
+        && g_strcmp0 (object_path, GPOP_CLIENT_MANAGER_OBJECT_PATH)) {
+      /* Wait for the pipeline to be created, on_call_done resumes us. */
+      g_variant_unref (parameters);
+      return;
+    }
+
+    gpop_client_replay_send (replay, target ? target : object_path,
+        method_name, parameters);
+    replay->index++;
+    g_variant_unref (parameters);
+  }
+
+  gpop_client_replay_check_done (replay);
+}
+
+/*----------------------------------------------------------------------------*
+ *                            GObject interface                               *
+ *----------------------------------------------------------------------------*/
+static void
+gpop_client_replay_dispose (GObject * object)
+{
+  GPOPClientReplay *replay = GPOP_CLIENT_REPLAY (object);
+
+  if (replay->timeout_id) {
+    g_source_remove (replay->timeout_id);
+    replay->timeout_id = 0;
+  }
+  g_clear_object (&replay->connection);
+  g_clear_pointer (&replay->bus_name, g_free);
+  g_clear_pointer (&replay->records, g_ptr_array_unref);
+  g_clear_pointer (&replay->paths, g_hash_table_unref);
+  g_clear_pointer (&replay->ids, g_hash_table_unref);
+  g_clear_pointer (&replay->latencies, g_hash_table_unref);
+
+  if (G_OBJECT_CLASS (parent_class)->dispose)
+    G_OBJECT_CLASS (parent_class)->dispose (object);
+}
+
+static void
+gpop_client_replay_class_init (GPOPClientReplayClass * klass)
+{
+  GObjectClass *gobject_class = G_OBJECT_CLASS (klass);
+
+  gobject_class->dispose = gpop_client_replay_dispose;
+}
+
+static void
+gpop_client_replay_init (GPOPClientReplay * replay)
+{
+  replay->records =
+      g_ptr_array_new_with_free_func ((GDestroyNotify) g_variant_unref);
+  replay->paths = g_hash_table_new_full (g_str_hash, g_str_equal, g_free,
+      g_free);
+  replay->ids = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, g_free);
+  replay->latencies = g_hash_table_new_full (g_str_hash, g_str_equal, g_free,
+      (GDestroyNotify) g_array_unref);
+}
+
+static gint
+compare_latency (gconstpointer a, gconstpointer b)
+{
+  gint64 la = *(const gint64 *) a, lb = *(const gint64 *) b;
+
+  return la < lb ? -1 : la > lb;
+}
+
+/* Public API */
+
+GPOPClientReplay *
+gpop_client_replay_new (GDBusConnection * connection, const gchar * bus_name)
+{
+  GPOPClientReplay *replay = g_object_new (GPOP_TYPE_CLIENT_REPLAY, NULL);
+
+  replay->connection = g_object_ref (connection);
+  replay->bus_name = g_strdup (bus_name ? bus_name : GPOP_CLIENT_BUS_NAME);
+
+  return replay;
+}
+
+gboolean
+gpop_client_replay_load (GPOPClientReplay * replay, const gchar * path,
+    GError ** error)
+{
+  gsize length, offset, magic_length = strlen (GPOP_RECORDER_MAGIC);
+  gchar *contents;
+
+  g_return_val_if_fail (GPOP_IS_CLIENT_REPLAY (replay), FALSE);
+
+  if (!g_file_get_contents (path, &contents, &length, error))
+    return FALSE;
+
+  if (length < magic_length
+      || memcmp (contents, GPOP_RECORDER_MAGIC, magic_length)) {
+    g_set_error (error, G_FILE_ERROR, G_FILE_ERROR_INVAL,
+        "'%s' is not a gpop recording", path);
+    g_free (contents);
+    return FALSE;
+  }
+
+  offset = magic_length;
+  while (offset + sizeof (guint32) <= length) {
+    GVariant *record;
+    gpointer data;
+    guint32 size;
+
+    memcpy (&size, contents + offset, sizeof (size));
+    size = GUINT32_FROM_LE (size);
+    offset += sizeof (size);
+    if (offset + size > length) {
+      g_set_error (error, G_FILE_ERROR, G_FILE_ERROR_INVAL,
+          "Truncated record at offset %" G_GSIZE_FORMAT " in '%s'", offset,
+          path);
+      g_free (contents);
+      return FALSE;
+    }
+
+    data = g_malloc (size);
+    memcpy (data, contents + offset, size);
+    record = g_variant_new_from_data (G_VARIANT_TYPE
+        (GPOP_RECORDER_RECORD_TYPE), data, size, FALSE, g_free, data);
+    if (G_BYTE_ORDER == G_BIG_ENDIAN) {
+      GVariant *swapped = g_variant_byteswap (record);
+      g_variant_unref (record);
+      record = swapped;
+    }
+    g_ptr_array_add (replay->records, g_variant_ref_sink (record));
+    offset += size;
+  }
+
+  g_free (contents);
+  return TRUE;
+}
+
+void
+gpop_client_replay_run_async (GPOPClientReplay * replay, gdouble speed,
+    GCancellable * cancellable, GAsyncReadyCallback callback,
+    gpointer user_data)
+{
+  g_return_if_fail (GPOP_IS_CLIENT_REPLAY (replay));
+  g_return_if_fail (replay->task == NULL);
+
+  replay->task = g_task_new (replay, cancellable, callback, user_data);
+  replay->speed = speed;
+  replay->index = 0;
+  replay->errors = 0;
+  replay->start = g_get_monotonic_time ();
+  g_hash_table_remove_all (replay->latencies);
+
+  gpop_client_replay_tick (replay);
+}
+
+gboolean
+gpop_client_replay_run_finish (GPOPClientReplay * replay, GAsyncResult * res,
+    GError ** error)
+{
+  g_return_val_if_fail (g_task_is_valid (res, replay), FALSE);
+
+  return g_task_propagate_boolean (G_TASK (res), error);
+}
+
+gchar *
+gpop_client_replay_get_report (GPOPClientReplay * replay)
+{
+  GString *report = g_string_new (NULL);
+  GList *methods, *l;
+
+  g_return_val_if_fail (GPOP_IS_CLIENT_REPLAY (replay), NULL);
+
+  g_string_append_printf (report,
+      "%u requests replayed in %.3f s, %u errors\n"
+      "%-24s %8s %10s %10s %10s %10s\n", replay->index,
+      (g_get_monotonic_time () - replay->start) / 1e6, replay->errors,
+      "method", "count", "mean(us)", "p50(us)", "p99(us)", "max(us)");
+
+  methods = g_list_sort (g_hash_table_get_keys (replay->latencies),
+      (GCompareFunc) g_strcmp0);
+  for (l = methods; l != NULL; l = g_list_next (l)) {
+    GArray *latencies = g_hash_table_lookup (replay->latencies, l->data);
+    gint64 sum = 0;
+    guint i;
+
+    g_array_sort (latencies, compare_latency);
+    for (i = 0; i < latencies->len; i++)
+      sum += g_array_index (latencies, gint64, i);
+
+    g_string_append_printf (report,
+        "%-24s %8u %10" G_GINT64_FORMAT " %10" G_GINT64_FORMAT " %10"
+        G_GINT64_FORMAT " %10" G_GINT64_FORMAT "\n", (gchar *) l->data,
+        latencies->len, sum / latencies->len,
+        g_array_index (latencies, gint64, latencies->len / 2),
+        g_array_index (latencies, gint64, (latencies->len * 99) / 100),
+        g_array_index (latencies, gint64, latencies->len - 1));
+  }
+  g_list_free (methods);
+
+  return g_string_free (report, FALSE);
+}
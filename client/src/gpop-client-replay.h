@@ -0,0 +1,85 @@
+/*
+ * GStreamer Prince of Parser
+ *
+ * Copyright (C) 2020 Stéphane Cerveau
+ *
+ * SPDX-License-Identifier: LGPL
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation
+ * version 2.1 of the License.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301 USA
+ *
+ */
+
+#ifndef _GPOP_CLIENT_REPLAY_H_
+#define _GPOP_CLIENT_REPLAY_H_
+
+#include <gio/gio.h>
+#include <glib-2.0/glib.h>
+
+#define GPOP_TYPE_CLIENT_REPLAY	           (gpop_client_replay_get_type())
+#define GPOP_CLIENT_REPLAY(obj)            (G_TYPE_CHECK_INSTANCE_CAST((obj),\
+                                              GPOP_TYPE_CLIENT_REPLAY, GPOPClientReplay))
+#define GPOP_CLIENT_REPLAY_CLASS(klass)    (G_TYPE_CHECK_CLASS_CAST((klass),\
+                                              GPOP_TYPE_CLIENT_REPLAY, GPOPClientReplayClass))
+#define GPOP_CLIENT_REPLAY_GET_CLASS(obj)  (G_TYPE_INSTANCE_GET_CLASS ((obj),\
+                                              GPOP_TYPE_CLIENT_REPLAY, GPOPClientReplayClass))
+#define GPOP_IS_CLIENT_REPLAY(obj)         (G_TYPE_CHECK_INSTANCE_TYPE((obj),\
+                                              GPOP_TYPE_CLIENT_REPLAY))
+#define GPOP_IS_CLIENT_REPLAY_CLASS(klass) (G_TYPE_CHECK_CLASS_TYPE((klass),\
+                                              GPOP_TYPE_CLIENT_REPLAY))
+
+typedef struct _GPOPClientReplay GPOPClientReplay;
+typedef struct _GPOPClientReplayClass GPOPClientReplayClass;
+
+/* Replays a session recorded by the daemon (StartRecording or --record)
+ * against another daemon, keeping the recorded pacing divided by the speed
+ * factor (0 sends as fast as possible). Pipeline object paths and ids of
+ * the recording are remapped to the ones created during the replay. The
+ * latency of every request is measured per method. */
+struct _GPOPClientReplay
+{
+  GObject base;
+  GDBusConnection *connection;
+  gchar *bus_name;
+  GPtrArray *records;
+  GHashTable *paths;
+  GHashTable *ids;
+  GHashTable *latencies;
+  gpointer last_add;
+  guint adds_in_flight;
+  guint in_flight;
+  guint errors;
+  guint index;
+  gdouble speed;
+  gint64 start;
+  guint timeout_id;
+  GTask *task;
+};
+
+struct _GPOPClientReplayClass
+{
+  GObjectClass base;
+};
+
+GType gpop_client_replay_get_type (void);
+
+GPOPClientReplay * gpop_client_replay_new (GDBusConnection * connection, const gchar * bus_name);
+gboolean gpop_client_replay_load (GPOPClientReplay * replay, const gchar * path, GError ** error);
+
+void gpop_client_replay_run_async (GPOPClientReplay * replay, gdouble speed, GCancellable * cancellable, GAsyncReadyCallback callback, gpointer user_data);
+gboolean gpop_client_replay_run_finish (GPOPClientReplay * replay, GAsyncResult * res, GError ** error);
+
+gchar * gpop_client_replay_get_report (GPOPClientReplay * replay);
+
+#endif /* _GPOP_CLIENT_REPLAY_H_ */
@@ -0,0 +1,563 @@
+/*
+ * GStreamer Prince of Parser
+ *
+ * Copyright (C) 2020 Stéphane Cerveau
+ *
+ * SPDX-License-Identifier: LGPL
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation
+ * version 2.1 of the License.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301 USA
+ *
+ */
+
+#include "gpop-client.h"
+
+G_DEFINE_TYPE (GPOPClient, gpop_client, G_TYPE_OBJECT);
+#define parent_class gpop_client_parent_class
+
+#define GPOP_CLIENT_PROXY_FLAGS (G_DBUS_PROXY_FLAGS_GET_INVALIDATED_PROPERTIES \
+    | G_DBUS_PROXY_FLAGS_DO_NOT_AUTO_START)
+
+static GPOPClientPipeline *
+gpop_client_track_pipeline (GPOPClient * client, GDBusProxy * proxy)
+{
+  GPOPClientPipeline *pipeline;
+  GVariant *id;
+
+  id = g_dbus_proxy_get_cached_property (proxy, "id");
+  if (!id)
+    return NULL;
+
+  pipeline = g_hash_table_lookup (client->pipelines,
+      g_variant_get_string (id, NULL));
+  if (!pipeline) {
+    pipeline = gpop_client_pipeline_new (proxy);
+    g_hash_table_insert (client->pipelines, g_strdup (pipeline->id), pipeline);
+  }
+  g_variant_unref (id);
+
+  return pipeline;
+}
+
+static void
+on_pipeline_proxy_ready (GObject * source, GAsyncResult * res,
+    gpointer user_data)
+{
+  GTask *task = (GTask *) user_data;
+  GPOPClient *client = g_task_get_source_object (task);
+  GPOPClientPipeline *pipeline;
+  GDBusProxy *proxy;
+  GError *error = NULL;
+
+  proxy = g_dbus_proxy_new_finish (res, &error);
+  if (!proxy) {
+    g_task_return_error (task, error);
+    goto done;
+  }
+
+  pipeline = gpop_client_track_pipeline (client, proxy);
+  g_object_unref (proxy);
+  if (pipeline)
+    g_task_return_pointer (task, g_object_ref (pipeline), g_object_unref);
+  else
+    g_task_return_new_error (task, G_IO_ERROR, G_IO_ERROR_NOT_FOUND,
+        "The pipeline vanished before its properties could be loaded");
+
+done:
+  g_object_unref (task);
+}
+
+static void
+gpop_client_create_pipeline_proxy (GPOPClient * client,
+    const gchar * object_path, GTask * task)
+{
+  g_dbus_proxy_new (client->connection, GPOP_CLIENT_PROXY_FLAGS, NULL,
+      GPOP_CLIENT_BUS_NAME, object_path, GPOP_CLIENT_INTERFACE_NAME,
+      g_task_get_cancellable (task), on_pipeline_proxy_ready, task);
+}
+
+static void
+on_pipelines_listed (GObject * source, GAsyncResult * res, gpointer user_data)
+{
+  GPOPClient *client = (GPOPClient *) user_data;
+  GHashTableIter hash_iter;
+  GPOPClientPipeline *pipeline;
+  GHashTable *alive;
+  GVariantIter *iter;
+  GVariant *ret;
+  const gchar *id, *object_path;
+
+  ret = g_dbus_proxy_call_finish (G_DBUS_PROXY (source), res, NULL);
+  if (!ret)
+    goto done;
+
+  alive = g_hash_table_new (g_str_hash, g_str_equal);
+  g_variant_get (ret, "(a(so))", &iter);
+  while (g_variant_iter_next (iter, "(&s&o)", &id, &object_path)) {
+    g_hash_table_add (alive, (gpointer) id);
+    if (!g_hash_table_contains (client->pipelines, id))
+      gpop_client_create_pipeline_proxy (client, object_path,
+          g_task_new (client, NULL, NULL, NULL));
+  }
+
+  g_hash_table_iter_init (&hash_iter, client->pipelines);
+  while (g_hash_table_iter_next (&hash_iter, NULL, (gpointer *) & pipeline)) {
+    if (!g_hash_table_contains (alive, pipeline->id))
+      g_hash_table_iter_remove (&hash_iter);
+  }
+
+  g_hash_table_unref (alive);
+  g_variant_iter_free (iter);
+  g_variant_unref (ret);
+
+done:
+  g_object_unref (client);
+}
+
+static void
+on_manager_properties_changed (GDBusProxy * proxy,
+    GVariant * changed_properties, GStrv invalidated_properties,
+    gpointer user_data)
+{
+  GPOPClient *client = (GPOPClient *) user_data;
+
+  GVariant *count;
+
+  /* Another client added or removed pipelines: resync the local mirror. */
+  count = g_variant_lookup_value (changed_properties, "Pipelines", NULL);
+  if (count)
+    g_variant_unref (count);
+  else if (!invalidated_properties
+      || !g_strv_contains ((const gchar * const *) invalidated_properties,
+          "Pipelines"))
+    return;
+
+  g_dbus_proxy_call (client->manager, "ListPipelines", NULL,
+      G_DBUS_CALL_FLAGS_NONE, -1, NULL, on_pipelines_listed,
+      g_object_ref (client));
+}
+
+static void
+on_pipeline_added (GObject * source, GAsyncResult * res, gpointer user_data)
+{
+  GTask *task = (GTask *) user_data;
+  GPOPClient *client = g_task_get_source_object (task);
+  GError *error = NULL;
+  const gchar *object_path;
+  GVariant *ret;
+
+  ret = g_dbus_proxy_call_finish (G_DBUS_PROXY (source), res, &error);
+  if (!ret) {
+    g_task_return_error (task, error);
+    g_object_unref (task);
+    return;
+  }
+
+  g_variant_get (ret, "(&s&o)", NULL, &object_path);
+  gpop_client_create_pipeline_proxy (client, object_path, task);
+  g_variant_unref (ret);
+}
+
+static void
+on_pipelines_added (GObject * source, GAsyncResult * res, gpointer user_data)
+{
+  GPtrArray *tasks = (GPtrArray *) user_data;
+  GError *error = NULL;
+  GVariantIter *iter;
+  const gchar *id, *object_path;
+  GVariant *ret;
+  guint i = 0;
+
+  ret = g_dbus_proxy_call_finish (G_DBUS_PROXY (source), res, &error);
+  if (!ret) {
+    for (i = 0; i < tasks->len; i++)
+      g_task_return_error (g_ptr_array_index (tasks, i), g_error_copy (error));
+    g_error_free (error);
+    g_ptr_array_unref (tasks);
+    return;
+  }
+
+  g_variant_get (ret, "(a(so))", &iter);
+  while (i < tasks->len && g_variant_iter_next (iter, "(&s&o)", &id,
+          &object_path)) {
+    GTask *task = g_ptr_array_index (tasks, i++);
+
+    if (*id == '\0') {
+      g_task_return_new_error (task, G_DBUS_ERROR, G_DBUS_ERROR_FAILED,
+          "Unable to add the pipeline");
+      continue;
+    }
+    gpop_client_create_pipeline_proxy (g_task_get_source_object (task),
+        object_path, g_object_ref (task));
+  }
+  for (; i < tasks->len; i++)
+    g_task_return_new_error (g_ptr_array_index (tasks, i), G_DBUS_ERROR,
+        G_DBUS_ERROR_FAILED, "Missing reply for the pipeline");
+
+  g_variant_iter_free (iter);
+  g_variant_unref (ret);
+  g_ptr_array_unref (tasks);
+}
+
+static void
+on_pipeline_removed (GObject * source, GAsyncResult * res, gpointer user_data)
+{
+  GTask *task = (GTask *) user_data;
+  GPOPClient *client = g_task_get_source_object (task);
+  GError *error = NULL;
+  GVariant *ret;
+
+  ret = g_dbus_proxy_call_finish (G_DBUS_PROXY (source), res, &error);
+  if (ret) {
+    g_hash_table_remove (client->pipelines, g_task_get_task_data (task));
+    g_variant_unref (ret);
+    g_task_return_boolean (task, TRUE);
+  } else
+    g_task_return_error (task, error);
+  g_object_unref (task);
+}
+
+static void
+on_pipelines_removed (GObject * source, GAsyncResult * res, gpointer user_data)
+{
+  GPtrArray *tasks = (GPtrArray *) user_data;
+  GError *error = NULL;
+  GVariantIter *iter;
+  gboolean removed;
+  GVariant *ret;
+  guint i = 0;
+
+  ret = g_dbus_proxy_call_finish (G_DBUS_PROXY (source), res, &error);
+  if (!ret) {
+    for (i = 0; i < tasks->len; i++)
+      g_task_return_error (g_ptr_array_index (tasks, i), g_error_copy (error));
+    g_error_free (error);
+    g_ptr_array_unref (tasks);
+    return;
+  }
+
+  g_variant_get (ret, "(ab)", &iter);
+  while (i < tasks->len && g_variant_iter_next (iter, "b", &removed)) {
+    GTask *task = g_ptr_array_index (tasks, i++);
+    GPOPClient *client = g_task_get_source_object (task);
+
+    if (removed) {
+      g_hash_table_remove (client->pipelines, g_task_get_task_data (task));
+      g_task_return_boolean (task, TRUE);
+    } else
+      g_task_return_new_error (task, G_DBUS_ERROR, G_DBUS_ERROR_INVALID_ARGS,
+          "No pipeline with id '%s'", (gchar *) g_task_get_task_data (task));
+  }
+  for (; i < tasks->len; i++)
+    g_task_return_new_error (g_ptr_array_index (tasks, i), G_DBUS_ERROR,
+        G_DBUS_ERROR_FAILED, "Missing reply for the pipeline");
+
+  g_variant_iter_free (iter);
+  g_variant_unref (ret);
+  g_ptr_array_unref (tasks);
+}
+
+/* Moves the queued tasks into an array and packs their string payload into
+ * an "(as)" tuple suitable for the bulk manager methods. */
+static GVariant *
+gpop_client_drain_queue (GQueue * queue, GPtrArray ** tasks)
+{
+  GVariantBuilder builder;
+  GTask *task;
+
+  *tasks = g_ptr_array_new_with_free_func (g_object_unref);
+  g_variant_builder_init (&builder, G_VARIANT_TYPE ("as"));
+  while ((task = g_queue_pop_head (queue))) {
+    g_variant_builder_add (&builder, "s", g_task_get_task_data (task));
+    g_ptr_array_add (*tasks, task);
+  }
+
+  return g_variant_new ("(as)", &builder);
+}
+
+static gboolean
+gpop_client_flush_cb (gpointer user_data)
+{
+  GPOPClient *client = (GPOPClient *) user_data;
+
+  client->flush_id = 0;
+  gpop_client_flush (client);
+
+  return G_SOURCE_REMOVE;
+}
+
+static void
+gpop_client_schedule_flush (GPOPClient * client)
+{
+  if (!client->flush_id)
+    client->flush_id = g_idle_add (gpop_client_flush_cb, client);
+}
+
+static void
+gpop_client_cancel_queue (GQueue * queue)
+{
+  GTask *task;
+
+  while ((task = g_queue_pop_head (queue))) {
+    g_task_return_new_error (task, G_IO_ERROR, G_IO_ERROR_CANCELLED,
+        "The client has been disposed");
+    g_object_unref (task);
+  }
+}
+
+/*----------------------------------------------------------------------------*
+ *                            GObject interface                               *
+ *----------------------------------------------------------------------------*/
+static void
+gpop_client_dispose (GObject * object)
+{
+  GPOPClient *client = GPOP_CLIENT (object);
+
+  if (client->flush_id) {
+    g_source_remove (client->flush_id);
+    client->flush_id = 0;
+  }
+  gpop_client_cancel_queue (&client->add_queue);
+  gpop_client_cancel_queue (&client->remove_queue);
+
+  if (client->manager)
+    g_signal_handlers_disconnect_by_data (client->manager, client);
+  g_clear_object (&client->manager);
+  g_clear_pointer (&client->pipelines, g_hash_table_unref);
+  g_clear_object (&client->connection);
+
+  if (G_OBJECT_CLASS (parent_class)->dispose)
+    G_OBJECT_CLASS (parent_class)->dispose (object);
+}
+
+static void
+gpop_client_class_init (GPOPClientClass * klass)
+{
+  GObjectClass *gobject_class = G_OBJECT_CLASS (klass);
+
+  gobject_class->dispose = gpop_client_dispose;
+}
+
+static void
+gpop_client_init (GPOPClient * client)
+{
+  client->pipelines =
+      g_hash_table_new_full (g_str_hash, g_str_equal, g_free, g_object_unref);
+  g_queue_init (&client->add_queue);
+  g_queue_init (&client->remove_queue);
+}
+
+/* Public API */
+
+GPOPClient *
+gpop_client_new_sync (GBusType bus_type, GCancellable * cancellable,
+    GError ** error)
+{
+  GPOPClient *client = g_object_new (GPOP_TYPE_CLIENT, NULL);
+  GVariantIter *iter;
+  const gchar *object_path;
+  GVariant *ret;
+
+  client->connection = g_bus_get_sync (bus_type, cancellable, error);
+  if (!client->connection)
+    goto failed;
+
+  client->manager = g_dbus_proxy_new_sync (client->connection,
+      GPOP_CLIENT_PROXY_FLAGS, NULL, GPOP_CLIENT_BUS_NAME,
+      GPOP_CLIENT_MANAGER_OBJECT_PATH, GPOP_CLIENT_INTERFACE_NAME,
+      cancellable, error);
+  if (!client->manager)
+    goto failed;
+
+  ret = g_dbus_proxy_call_sync (client->manager, "ListPipelines", NULL,
+      G_DBUS_CALL_FLAGS_NONE, -1, cancellable, error);
+  if (!ret)
+    goto failed;
+
+  g_variant_get (ret, "(a(so))", &iter);
+  while (g_variant_iter_next (iter, "(&s&o)", NULL, &object_path)) {
+    GDBusProxy *proxy = g_dbus_proxy_new_sync (client->connection,
+        GPOP_CLIENT_PROXY_FLAGS, NULL, GPOP_CLIENT_BUS_NAME, object_path,
+        GPOP_CLIENT_INTERFACE_NAME, cancellable, NULL);
+    if (proxy) {
+      gpop_client_track_pipeline (client, proxy);
+      g_object_unref (proxy);
+    }
+  }
+  g_variant_iter_free (iter);
+  g_variant_unref (ret);
+
+  g_signal_connect (client->manager, "g-properties-changed",
+      G_CALLBACK (on_manager_properties_changed), client);
+
+  return client;
+
+failed:
+  g_object_unref (client);
+  return NULL;
+}
+
+void
+gpop_client_free (GPOPClient * client)
+{
+  g_clear_object (&client);
+}
+
+void
+gpop_client_set_batching (GPOPClient * client, gboolean batching)
+{
+  g_return_if_fail (GPOP_IS_CLIENT (client));
+
+  client->batching = batching;
+  if (!batching)
+    gpop_client_flush (client);
+}
+
+void
+gpop_client_flush (GPOPClient * client)
+{
+  GPtrArray *tasks;
+  GVariant *parameters;
+
+  g_return_if_fail (GPOP_IS_CLIENT (client));
+
+  if (client->flush_id) {
+    g_source_remove (client->flush_id);
+    client->flush_id = 0;
+  }
+
+  if (!g_queue_is_empty (&client->add_queue)) {
+    parameters = gpop_client_drain_queue (&client->add_queue, &tasks);
+    g_dbus_proxy_call (client->manager, "AddPipelines", parameters,
+        G_DBUS_CALL_FLAGS_NONE, -1, NULL, on_pipelines_added, tasks);
+  }
+
+  if (!g_queue_is_empty (&client->remove_queue)) {
+    parameters = gpop_client_drain_queue (&client->remove_queue, &tasks);
+    g_dbus_proxy_call (client->manager, "RemovePipelines", parameters,
+        G_DBUS_CALL_FLAGS_NONE, -1, NULL, on_pipelines_removed, tasks);
+  }
+}
+
+gchar *
+gpop_client_get_version (GPOPClient * client)
+{
+  GVariant *value;
+  gchar *ret = NULL;
+
+  g_return_val_if_fail (GPOP_IS_CLIENT (client), NULL);
+
+  value = g_dbus_proxy_get_cached_property (client->manager, "Version");
+  if (value) {
+    ret = g_variant_dup_string (value, NULL);
+    g_variant_unref (value);
+  }
+  return ret;
+}
+
+gint
+gpop_client_get_pipelines_count (GPOPClient * client)
+{
+  GVariant *value;
+  gint ret = 0;
+
+  g_return_val_if_fail (GPOP_IS_CLIENT (client), 0);
+
+  value = g_dbus_proxy_get_cached_property (client->manager, "Pipelines");
+  if (value) {
+    ret = g_variant_get_int32 (value);
+    g_variant_unref (value);
+  }
+  return ret;
+}
+
+GList *
+gpop_client_get_pipelines (GPOPClient * client)
+{
+  g_return_val_if_fail (GPOP_IS_CLIENT (client), NULL);
+
+  return g_hash_table_get_values (client->pipelines);
+}
+
+GPOPClientPipeline *
+gpop_client_get_pipeline (GPOPClient * client, const gchar * id)
+{
+  g_return_val_if_fail (GPOP_IS_CLIENT (client), NULL);
+
+  return g_hash_table_lookup (client->pipelines, id);
+}
+
+void
+gpop_client_add_pipeline_async (GPOPClient * client, const gchar * parser_desc,
+    GCancellable * cancellable, GAsyncReadyCallback callback,
+    gpointer user_data)
+{
+  GTask *task;
+
+  g_return_if_fail (GPOP_IS_CLIENT (client));
+
+  task = g_task_new (client, cancellable, callback, user_data);
+  g_task_set_task_data (task, g_strdup (parser_desc), g_free);
+
+  if (client->batching) {
+    g_queue_push_tail (&client->add_queue, task);
+    gpop_client_schedule_flush (client);
+    return;
+  }
+
+  g_dbus_proxy_call (client->manager, "AddPipeline",
+      g_variant_new ("(s)", parser_desc), G_DBUS_CALL_FLAGS_NONE, -1,
+      cancellable, on_pipeline_added, task);
+}
+
+GPOPClientPipeline *
+gpop_client_add_pipeline_finish (GPOPClient * client, GAsyncResult * res,
+    GError ** error)
+{
+  g_return_val_if_fail (g_task_is_valid (res, client), NULL);
+
+  return g_task_propagate_pointer (G_TASK (res), error);
+}
+
+void
+gpop_client_remove_pipeline_async (GPOPClient * client, const gchar * id,
+    GCancellable * cancellable, GAsyncReadyCallback callback,
+    gpointer user_data)
+{
+  GTask *task;
+
+  g_return_if_fail (GPOP_IS_CLIENT (client));
+
+  task = g_task_new (client, cancellable, callback, user_data);
+  g_task_set_task_data (task, g_strdup (id), g_free);
+
+  if (client->batching) {
+    g_queue_push_tail (&client->remove_queue, task);
+    gpop_client_schedule_flush (client);
+    return;
+  }
+
+  g_dbus_proxy_call (client->manager, "RemovePipeline",
+      g_variant_new ("(s)", id), G_DBUS_CALL_FLAGS_NONE, -1,
+      cancellable, on_pipeline_removed, task);
+}
+
+gboolean
+gpop_client_remove_pipeline_finish (GPOPClient * client, GAsyncResult * res,
+    GError ** error)
+{
+  g_return_val_if_fail (g_task_is_valid (res, client), FALSE);
+
+  return g_task_propagate_boolean (G_TASK (res), error);
+}
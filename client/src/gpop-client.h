@@ -0,0 +1,91 @@
+/*
+ * GStreamer Prince of Parser
+ *
+ * Copyright (C) 2020 Stéphane Cerveau
+ *
+ * SPDX-License-Identifier: LGPL
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation
+ * version 2.1 of the License.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301 USA
+ *
+ */
+
+#ifndef _GPOP_CLIENT_H_
+#define _GPOP_CLIENT_H_
+
+#include <gio/gio.h>
+#include <glib-2.0/glib.h>
+
+#include "gpop-client-pipeline.h"
+
+#define GPOP_TYPE_CLIENT	           (gpop_client_get_type())
+#define GPOP_CLIENT(obj)            (G_TYPE_CHECK_INSTANCE_CAST((obj),\
+                                              GPOP_TYPE_CLIENT, GPOPClient))
+#define GPOP_CLIENT_CLASS(klass)    (G_TYPE_CHECK_CLASS_CAST((klass),\
+                                              GPOP_TYPE_CLIENT, GPOPClientClass))
+#define GPOP_CLIENT_GET_CLASS(obj)  (G_TYPE_INSTANCE_GET_CLASS ((obj),\
+                                              GPOP_TYPE_CLIENT, GPOPClientClass))
+#define GPOP_IS_CLIENT(obj)         (G_TYPE_CHECK_INSTANCE_TYPE((obj),\
+                                              GPOP_TYPE_CLIENT))
+#define GPOP_IS_CLIENT_CLASS(klass) (G_TYPE_CHECK_CLASS_TYPE((klass),\
+                                              GPOP_TYPE_CLIENT))
+
+#define GPOP_CLIENT_BUS_NAME "org.gpop"
+#define GPOP_CLIENT_MANAGER_OBJECT_PATH "/org/gpop/Manager"
+#define GPOP_CLIENT_INTERFACE_NAME "org.gpop.GPOPInterface"
+
+typedef struct _GPOPClient GPOPClient;
+typedef struct _GPOPClientClass GPOPClientClass;
+
+/* Connection to a gpop daemon. Pipelines are mirrored locally as
+ * GPOPClientPipeline proxies. When batching is enabled, the add/remove
+ * requests issued during one main loop iteration are coalesced into a
+ * single AddPipelines/RemovePipelines call. */
+struct _GPOPClient
+{
+  GObject base;
+  GDBusConnection *connection;
+  GDBusProxy *manager;
+  GHashTable *pipelines;
+  gboolean batching;
+  GQueue add_queue;
+  GQueue remove_queue;
+  guint flush_id;
+};
+
+struct _GPOPClientClass
+{
+  GObjectClass base;
+};
+
+GType gpop_client_get_type (void);
+
+GPOPClient * gpop_client_new_sync (GBusType bus_type, GCancellable * cancellable, GError ** error);
+void gpop_client_free (GPOPClient * client);
+
+void gpop_client_set_batching (GPOPClient * client, gboolean batching);
+void gpop_client_flush (GPOPClient * client);
+
+gchar * gpop_client_get_version (GPOPClient * client);
+gint gpop_client_get_pipelines_count (GPOPClient * client);
+GList * gpop_client_get_pipelines (GPOPClient * client);
+GPOPClientPipeline * gpop_client_get_pipeline (GPOPClient * client, const gchar * id);
+
+void gpop_client_add_pipeline_async (GPOPClient * client, const gchar * parser_desc, GCancellable * cancellable, GAsyncReadyCallback callback, gpointer user_data);
+GPOPClientPipeline * gpop_client_add_pipeline_finish (GPOPClient * client, GAsyncResult * res, GError ** error);
+
+void gpop_client_remove_pipeline_async (GPOPClient * client, const gchar * id, GCancellable * cancellable, GAsyncReadyCallback callback, gpointer user_data);
+gboolean gpop_client_remove_pipeline_finish (GPOPClient * client, GAsyncResult * res, GError ** error);
+
+#endif /* _GPOP_CLIENT_H_ */
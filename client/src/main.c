@@ -21,8 +21,213 @@
  *
  */
 
+#include "gpop-client.h"
+#include "gpop-client-replay.h"
+
+typedef struct _ClientApp
+{
+  GPOPClient *client;
+  GMainLoop *loop;
+  guint pending;
+  gint res;
+} ClientApp;
+
+static void
+client_app_done (ClientApp * app)
+{
+  if (--app->pending == 0)
+    g_main_loop_quit (app->loop);
+}
+
+static void
+on_pipeline_added (GObject * source, GAsyncResult * res, gpointer user_data)
+{
+  ClientApp *app = (ClientApp *) user_data;
+  GPOPClientPipeline *pipeline;
+  GError *error = NULL;
+
+  pipeline = gpop_client_add_pipeline_finish (GPOP_CLIENT (source), res, &error);
+  if (pipeline) {
+    g_print ("added %s at %s\n", gpop_client_pipeline_get_id (pipeline),
+        gpop_client_pipeline_get_object_path (pipeline));
+    g_object_unref (pipeline);
+  } else {
+    g_printerr ("Unable to add the pipeline: %s\n", error->message);
+    g_error_free (error);
+    app->res = -1;
+  }
+  client_app_done (app);
+}
+
+static void
+on_pipeline_removed (GObject * source, GAsyncResult * res, gpointer user_data)
+{
+  ClientApp *app = (ClientApp *) user_data;
+  GError *error = NULL;
+
+  if (!gpop_client_remove_pipeline_finish (GPOP_CLIENT (source), res, &error)) {
+    g_printerr ("Unable to remove the pipeline: %s\n", error->message);
+    g_error_free (error);
+    app->res = -1;
+  }
+  client_app_done (app);
+}
+
+static void
+on_replay_done (GObject * source, GAsyncResult * res, gpointer user_data)
+{
+  ClientApp *app = (ClientApp *) user_data;
+  GPOPClientReplay *replay = GPOP_CLIENT_REPLAY (source);
+  GError *error = NULL;
+  gchar *report;
+
+  if (!gpop_client_replay_run_finish (replay, res, &error)) {
+    g_printerr ("Unable to replay the session: %s\n", error->message);
+    g_error_free (error);
+    app->res = -1;
+  }
+  report = gpop_client_replay_get_report (replay);
+  g_print ("%s", report);
+  g_free (report);
+  client_app_done (app);
+}
+
+static gint
+replay_session (const gchar * path, const gchar * bus_name, gdouble speed)
+{
+  GPOPClientReplay *replay;
+  GDBusConnection *connection;
+  GError *error = NULL;
+  ClientApp app = { 0, };
+
+  connection = g_bus_get_sync (G_BUS_TYPE_SESSION, NULL, &error);
+  if (!connection) {
+    g_printerr ("Unable to connect to the bus: %s\n", error->message);
+    g_error_free (error);
+    return -1;
+  }
+
+  replay = gpop_client_replay_new (connection, bus_name);
+  if (!gpop_client_replay_load (replay, path, &error)) {
+    g_printerr ("Unable to load the session: %s\n", error->message);
+    g_error_free (error);
+    app.res = -1;
+    goto done;
+  }
+
+  app.loop = g_main_loop_new (NULL, FALSE);
+  app.pending = 1;
+  gpop_client_replay_run_async (replay, speed, NULL, on_replay_done, &app);
+  g_main_loop_run (app.loop);
+  g_main_loop_unref (app.loop);
+
+done:
+  g_object_unref (replay);
+  g_object_unref (connection);
+  return app.res;
+}
+
+static void
+list_pipelines (ClientApp * app)
+{
+  GList *pipelines, *l;
+
+  pipelines = gpop_client_get_pipelines (app->client);
+  for (l = pipelines; l != NULL; l = g_list_next (l)) {
+    GPOPClientPipeline *pipeline = (GPOPClientPipeline *) l->data;
+    gchar *state = gpop_client_pipeline_get_state (pipeline);
+    gchar *desc = gpop_client_pipeline_get_desc (pipeline);
+
+    g_print ("%s [%s] %s\n", gpop_client_pipeline_get_id (pipeline), state,
+        desc);
+    g_free (state);
+    g_free (desc);
+  }
+  g_list_free (pipelines);
+}
+
 gint
 main (gint argc, gchar * argv[])
 {
-	return 0;
+  GError *err = NULL;
+  GOptionContext *ctx;
+  gchar **add_array = NULL, **remove_array = NULL, **it;
+  gboolean list = FALSE, batch = FALSE;
+  gchar *replay_path = NULL, *bus_name = NULL;
+  gdouble speed = 1.0;
+  ClientApp app = { 0, };
+
+  GOptionEntry options[] = {
+    {"add", 'a', 0, G_OPTION_ARG_STRING_ARRAY, &add_array,
+        "Add a pipeline with the given description", NULL}
+    ,
+    {"remove", 'r', 0, G_OPTION_ARG_STRING_ARRAY, &remove_array,
+        "Remove the pipeline with the given id", NULL}
+    ,
+    {"list", 'l', 0, G_OPTION_ARG_NONE, &list,
+        "List the pipelines", NULL}
+    ,
+    {"batch", 'b', 0, G_OPTION_ARG_NONE, &batch,
+        "Send the requests through the manager bulk methods", NULL}
+    ,
+    {"replay", 0, 0, G_OPTION_ARG_FILENAME, &replay_path,
+        "Replay a session recorded by the daemon", "FILE"}
+    ,
+    {"speed", 0, 0, G_OPTION_ARG_DOUBLE, &speed,
+        "Replay speed factor, 0 to send as fast as possible (default 1)",
+        "FACTOR"}
+    ,
+    {"dest", 0, 0, G_OPTION_ARG_STRING, &bus_name,
+        "Bus name of the daemon to replay against (default org.gpop)", "NAME"}
+    ,
+    {NULL}
+  };
+
+  ctx = g_option_context_new ("- gpop client");
+  g_option_context_add_main_entries (ctx, options, NULL);
+  if (!g_option_context_parse (ctx, &argc, &argv, &err)) {
+    g_printerr ("Error initializing: %s\n", err->message);
+    g_error_free (err);
+    g_option_context_free (ctx);
+    return -1;
+  }
+  g_option_context_free (ctx);
+
+  if (replay_path) {
+    app.res = replay_session (replay_path, bus_name, speed);
+    goto done;
+  }
+
+  app.client = gpop_client_new_sync (G_BUS_TYPE_SESSION, NULL, &err);
+  if (!app.client) {
+    g_printerr ("Unable to connect to gpop: %s\n", err->message);
+    g_error_free (err);
+    app.res = -1;
+    goto done;
+  }
+  gpop_client_set_batching (app.client, batch);
+  app.loop = g_main_loop_new (NULL, FALSE);
+
+  for (it = add_array; it != NULL && *it != NULL; ++it, app.pending++)
+    gpop_client_add_pipeline_async (app.client, *it, NULL, on_pipeline_added,
+        &app);
+  for (it = remove_array; it != NULL && *it != NULL; ++it, app.pending++)
+    gpop_client_remove_pipeline_async (app.client, *it, NULL,
+        on_pipeline_removed, &app);
+
+  if (app.pending)
+    g_main_loop_run (app.loop);
+
+  if (list)
+    list_pipelines (&app);
+
+done:
+  g_clear_pointer (&app.loop, g_main_loop_unref);
+  gpop_client_free (app.client);
+  g_strfreev (add_array);
+  g_strfreev (remove_array);
+  g_free (replay_path);
+  g_free (bus_name);
+
+  return app.res;
 }
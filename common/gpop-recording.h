@@ -0,0 +1,42 @@
+/*
+ * GStreamer Prince of Parser
+ *
+ * Copyright (C) 2020 Stéphane Cerveau
+ *
+ * SPDX-License-Identifier: LGPL
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation
+ * version 2.1 of the License.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301 USA
+ *
+ */
+
+#ifndef _GPOP_RECORDING_H_
+#define _GPOP_RECORDING_H_
+
+/* Format of the session recordings of the D-Bus control plane, written by
+ * the daemon recorder and replayed with gpop-client --replay.
+ *
+ * The file starts with GPOP_RECORDER_MAGIC, followed by one entry per
+ * request: a little-endian guint32 size and a little-endian serialized
+ * GVariant of type GPOP_RECORDER_RECORD_TYPE holding the microseconds since
+ * the start of the recording, the object path, the method name and its
+ * parameters. Property reads are stored as a "Get" method with the property
+ * name as parameter. The GPOP_RECORDER_CREATED pseudo method maps the object
+ * path of a pipeline created by the previous request to its id. */
+
+#define GPOP_RECORDER_MAGIC "GPOPREC1"
+#define GPOP_RECORDER_RECORD_TYPE "(tssv)"
+#define GPOP_RECORDER_CREATED "@created"
+
+#endif /* _GPOP_RECORDING_H_ */
@@ -0,0 +1,155 @@
+/*
+ * GStreamer Prince of Parser
+ *
+ * Copyright (C) 2020 Stéphane Cerveau
+ *
+ * SPDX-License-Identifier: LGPL
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation
+ * version 2.1 of the License.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301 USA
+ *
+ */
+
+#include "gpop-bus-dispatcher.h"
+
+/* Maximum number of messages delivered per main loop iteration */
+#define GPOP_BUS_DISPATCHER_BATCH 64
+
+struct _GPOPBusWatch
+{
+  GstBus *bus;
+  GstBusSyncHandler sync_func;
+  GstBusFunc func;
+  gpointer user_data;
+};
+
+typedef struct
+{
+  GPOPBusWatch *watch;
+  GstMessage *message;
+  /* when it was posted */
+  GstClockTime posted;
+} GPOPBusEntry;
+
+static GMutex dispatcher_lock;
+static GQueue dispatcher_queue = G_QUEUE_INIT;
+static guint dispatcher_source_id = 0;
+/* of the message being delivered, only read from the main context */
+static GstClockTime dispatcher_posted = GST_CLOCK_TIME_NONE;
+
+static gboolean
+gpop_bus_dispatcher_dispatch (gpointer user_data)
+{
+  GPOPBusEntry *entry;
+  guint i;
+
+  for (i = 0; i < GPOP_BUS_DISPATCHER_BATCH; i++) {
+    g_mutex_lock (&dispatcher_lock);
+    entry = g_queue_pop_head (&dispatcher_queue);
+    if (!entry) {
+      dispatcher_source_id = 0;
+      g_mutex_unlock (&dispatcher_lock);
+      return G_SOURCE_REMOVE;
+    }
+    g_mutex_unlock (&dispatcher_lock);
+
+    /* The callback may remove its own watch, do not touch it afterwards. */
+    dispatcher_posted = entry->posted;
+    entry->watch->func (entry->watch->bus, entry->message,
+        entry->watch->user_data);
+    dispatcher_posted = GST_CLOCK_TIME_NONE;
+    gst_message_unref (entry->message);
+    g_free (entry);
+  }
+
+  return G_SOURCE_CONTINUE;
+}
+
+static GstBusSyncReply
+gpop_bus_dispatcher_sync_handler (GstBus * bus, GstMessage * message,
+    gpointer user_data)
+{
+  GPOPBusWatch *watch = (GPOPBusWatch *) user_data;
+  GPOPBusEntry *entry;
+
+  if (watch->sync_func
+      && watch->sync_func (bus, message, watch->user_data) == GST_BUS_DROP)
+    return GST_BUS_DROP;
+
+  entry = g_new (GPOPBusEntry, 1);
+  entry->watch = watch;
+  entry->message = gst_message_ref (message);
+  entry->posted = gst_util_get_timestamp ();
+
+  g_mutex_lock (&dispatcher_lock);
+  g_queue_push_tail (&dispatcher_queue, entry);
+  if (!dispatcher_source_id)
+    dispatcher_source_id = g_idle_add_full (G_PRIORITY_DEFAULT,
+        gpop_bus_dispatcher_dispatch, NULL, NULL);
+  g_mutex_unlock (&dispatcher_lock);
+
+  return GST_BUS_DROP;
+}
+
+/* Public API */
+
+GPOPBusWatch *
+gpop_bus_dispatcher_add_watch (GstBus * bus, GstBusSyncHandler sync_func,
+    GstBusFunc func, gpointer user_data)
+{
+  GPOPBusWatch *watch = g_new (GPOPBusWatch, 1);
+
+  watch->bus = bus;
+  watch->sync_func = sync_func;
+  watch->func = func;
+  watch->user_data = user_data;
+  gst_bus_set_sync_handler (bus, gpop_bus_dispatcher_sync_handler, watch,
+      NULL);
+
+  return watch;
+}
+
+/* The time the message being delivered was posted at, on the
+ * gst_util_get_timestamp() clock, GST_CLOCK_TIME_NONE outside of a
+ * delivery. */
+GstClockTime
+gpop_bus_dispatcher_get_posted_time (void)
+{
+  return dispatcher_posted;
+}
+
+/* Must be called once no streaming thread can post on the bus anymore, ie
+ * after the pipeline has been set to NULL. */
+void
+gpop_bus_dispatcher_remove_watch (GPOPBusWatch * watch)
+{
+  GList *l, *next;
+
+  gst_bus_set_sync_handler (watch->bus, NULL, NULL, NULL);
+
+  g_mutex_lock (&dispatcher_lock);
+  for (l = dispatcher_queue.head; l != NULL; l = next) {
+    GPOPBusEntry *entry = l->data;
+
+    next = l->next;
+    if (entry->watch == watch) {
+      gst_message_unref (entry->message);
+      g_free (entry);
+      g_queue_delete_link (&dispatcher_queue, l);
+    }
+  }
+  g_mutex_unlock (&dispatcher_lock);
+
+  g_free (watch);
+}
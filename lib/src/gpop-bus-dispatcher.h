@@ -0,0 +1,43 @@
+/*
+ * GStreamer Prince of Parser
+ *
+ * Copyright (C) 2020 Stéphane Cerveau
+ *
+ * SPDX-License-Identifier: LGPL
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation
+ * version 2.1 of the License.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301 USA
+ *
+ */
+
+#ifndef _GPOP_BUS_DISPATCHER_H_
+#define _GPOP_BUS_DISPATCHER_H_
+
+#include <gst/gst.h>
+
+/* Shared dispatch of GstBus messages to the default main context.
+ *
+ * gst_bus_add_signal_watch() attaches one GSource per bus. Here the messages
+ * of every watched bus are queued by a sync handler and delivered from a
+ * single idle source which only exists while messages are pending, so idle
+ * pipelines cost no GSource nor wakeup. The optional sync_func is called
+ * first from the posting thread, as a bus sync handler would be. */
+
+typedef struct _GPOPBusWatch GPOPBusWatch;
+
+GPOPBusWatch * gpop_bus_dispatcher_add_watch (GstBus * bus, GstBusSyncHandler sync_func, GstBusFunc func, gpointer user_data);
+void gpop_bus_dispatcher_remove_watch (GPOPBusWatch * watch);
+GstClockTime gpop_bus_dispatcher_get_posted_time (void);
+
+#endif /* _GPOP_BUS_DISPATCHER_H_ */
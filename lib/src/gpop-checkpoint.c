@@ -0,0 +1,557 @@
+/*
+ * GStreamer Prince of Parser
+ *
+ * Copyright (C) 2020 Stéphane Cerveau
+ *
+ * SPDX-License-Identifier: LGPL
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation
+ * version 2.1 of the License.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301 USA
+ *
+ */
+
+#include <errno.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <gst/base/gstbasesink.h>
+#include <gst/base/gstbasesrc.h>
+#include <gst/base/gsttypefindhelper.h>
+
+#include "gpop-private.h"
+
+/* Bytes read from the start of the input to find its type */
+#define GPOP_CHECKPOINT_TYPEFIND_SIZE 4096
+
+/* Reads of an output racing with its streaming thread */
+#define GPOP_CHECKPOINT_OUTPUT_TRIES 4
+
+/* Streams a demuxer or a parser picks up from any offset, the containers
+ * such as mp4 or matroska need the headers at the start of the file */
+static const gchar *const gpop_checkpoint_headerless_types[] = {
+  "video/mpegts",
+  "video/mpeg",
+  "video/x-h264",
+  "video/x-h265",
+  "audio/mpeg",
+  "audio/x-ac3",
+  "audio/x-eac3",
+  NULL
+};
+
+typedef struct
+{
+  gchar *description;
+  /* stream time written by all the outputs at the last checkpoint */
+  GstClockTime position;
+  /* locations of the outputs and the bytes they held at that time */
+  gchar **outputs;
+  gchar **sizes;
+  guint part;
+} GPOPCheckpointEntry;
+
+struct _GPOPCheckpoint
+{
+  gchar *path;
+  /* the pipelines are built from several threads on reload */
+  GMutex lock;
+  /* pipeline id -> GPOPCheckpointEntry */
+  GHashTable *entries;
+  gboolean dirty;
+};
+
+static void
+gpop_checkpoint_entry_free (GPOPCheckpointEntry * entry)
+{
+  g_free (entry->description);
+  g_strfreev (entry->outputs);
+  g_strfreev (entry->sizes);
+  g_free (entry);
+}
+
+/* Elements of the given type with a location, ie reading or writing a file */
+static GList *
+gpop_checkpoint_list_files (GstElement * pipeline, GType type)
+{
+  GstIterator *it = gst_bin_iterate_recurse (GST_BIN (pipeline));
+  GValue item = G_VALUE_INIT;
+  GList *elements = NULL;
+  gboolean done = FALSE;
+
+  while (!done) {
+    switch (gst_iterator_next (it, &item)) {
+      case GST_ITERATOR_OK:{
+        GstElement *element = g_value_get_object (&item);
+        if (G_TYPE_CHECK_INSTANCE_TYPE (element, type)
+            && g_object_class_find_property (G_OBJECT_GET_CLASS (element),
+                "location"))
+          elements = g_list_prepend (elements, gst_object_ref (element));
+        g_value_reset (&item);
+        break;
+      }
+      case GST_ITERATOR_RESYNC:
+        g_list_free_full (elements, gst_object_unref);
+        elements = NULL;
+        gst_iterator_resync (it);
+        break;
+      default:
+        done = TRUE;
+        break;
+    }
+  }
+  g_value_unset (&item);
+  gst_iterator_free (it);
+
+  return elements;
+}
+
+/* The single file source of a file pipeline */
+static GstElement *
+gpop_checkpoint_get_source (GstElement * pipeline)
+{
+  GList *sources = gpop_checkpoint_list_files (pipeline, GST_TYPE_BASE_SRC);
+  GstElement *source = NULL;
+
+  if (sources && !sources->next)
+    source = gst_object_ref (sources->data);
+  g_list_free_full (sources, gst_object_unref);
+
+  return source;
+}
+
+/* Whether the file read by source can be resumed from any point */
+static gboolean
+gpop_checkpoint_is_headerless (GstElement * source)
+{
+  guint8 data[GPOP_CHECKPOINT_TYPEFIND_SIZE];
+  gboolean res = FALSE;
+  gchar *location;
+  GstCaps *caps;
+  gsize size;
+  FILE *file;
+
+  g_object_get (source, "location", &location, NULL);
+  file = location ? fopen (location, "rb") : NULL;
+  g_free (location);
+  if (!file)
+    return FALSE;
+  size = fread (data, 1, sizeof (data), file);
+  fclose (file);
+
+  caps = gst_type_find_helper_for_data (GST_OBJECT (source), data, size,
+      NULL);
+  if (caps) {
+    res = g_strv_contains (gpop_checkpoint_headerless_types,
+        gst_structure_get_name (gst_caps_get_structure (caps, 0)));
+    gst_caps_unref (caps);
+  }
+  return res;
+}
+
+/* "out.mp4" -> "out.part1.mp4" */
+static gchar *
+gpop_checkpoint_split_location (const gchar * location, guint part)
+{
+  const gchar *ext = strrchr (location, '.');
+  const gchar *sep = strrchr (location, G_DIR_SEPARATOR);
+
+  if (!ext || (sep && ext < sep))
+    return g_strdup_printf ("%s.part%u", location, part);
+  return g_strdup_printf ("%.*s.part%u%s", (gint) (ext - location), location,
+      part, ext);
+}
+
+/* Stream time of the end of the last buffer written by sink */
+static GstClockTime
+gpop_checkpoint_get_written_time (GstElement * sink)
+{
+  GstClockTime time = GST_CLOCK_TIME_NONE;
+  GstSample *sample;
+  gint64 position;
+
+  g_object_get (sink, "last-sample", &sample, NULL);
+  if (sample) {
+    GstBuffer *buffer = gst_sample_get_buffer (sample);
+    const GstSegment *segment = gst_sample_get_segment (sample);
+
+    if (buffer && segment && segment->format == GST_FORMAT_TIME
+        && GST_BUFFER_PTS_IS_VALID (buffer)) {
+      time = GST_BUFFER_PTS (buffer);
+      if (GST_BUFFER_DURATION_IS_VALID (buffer))
+        time += GST_BUFFER_DURATION (buffer);
+      time = gst_segment_to_stream_time (segment, GST_FORMAT_TIME, time);
+    }
+    gst_sample_unref (sample);
+  }
+  if (!GST_CLOCK_TIME_IS_VALID (time)
+      && gst_element_query_position (sink, GST_FORMAT_TIME, &position))
+    time = position;
+  return time;
+}
+
+/* The bytes written by sink and the stream time they end at, read again
+ * when a buffer was rendered in between */
+static gboolean
+gpop_checkpoint_get_written (GstElement * sink, GstClockTime * time,
+    gint64 * size)
+{
+  guint tries;
+
+  for (tries = 0; tries < GPOP_CHECKPOINT_OUTPUT_TRIES; tries++) {
+    *time = gpop_checkpoint_get_written_time (sink);
+    if (!GST_CLOCK_TIME_IS_VALID (*time)
+        || !gst_element_query_position (sink, GST_FORMAT_BYTES, size))
+      return FALSE;
+    if (gpop_checkpoint_get_written_time (sink) == *time)
+      return TRUE;
+  }
+  return FALSE;
+}
+
+static gboolean
+gpop_checkpoint_load (GPOPCheckpoint * checkpoint, GError ** error)
+{
+  GKeyFile *key_file = g_key_file_new ();
+  gchar **groups, **group;
+  GError *err = NULL;
+
+  if (!g_key_file_load_from_file (key_file, checkpoint->path,
+          G_KEY_FILE_NONE, &err)) {
+    g_key_file_free (key_file);
+    /* no journal yet */
+    if (g_error_matches (err, G_FILE_ERROR, G_FILE_ERROR_NOENT)) {
+      g_error_free (err);
+      return TRUE;
+    }
+    g_propagate_error (error, err);
+    return FALSE;
+  }
+
+  groups = g_key_file_get_groups (key_file, NULL);
+  for (group = groups; *group; group++) {
+    GPOPCheckpointEntry *entry = g_new0 (GPOPCheckpointEntry, 1);
+
+    entry->description =
+        g_key_file_get_string (key_file, *group, "description", NULL);
+    entry->position =
+        g_key_file_get_uint64 (key_file, *group, "position", NULL);
+    entry->outputs =
+        g_key_file_get_string_list (key_file, *group, "outputs", NULL, NULL);
+    entry->sizes =
+        g_key_file_get_string_list (key_file, *group, "sizes", NULL, NULL);
+    entry->part = g_key_file_get_integer (key_file, *group, "part", NULL);
+    if (!entry->description || !entry->outputs || !entry->sizes
+        || g_strv_length (entry->outputs) != g_strv_length (entry->sizes)) {
+      gpop_checkpoint_entry_free (entry);
+      continue;
+    }
+    g_hash_table_replace (checkpoint->entries, g_strdup (*group), entry);
+  }
+  g_strfreev (groups);
+  g_key_file_free (key_file);
+
+  GPOP_LOG ("Loaded %u checkpoints from %s",
+      g_hash_table_size (checkpoint->entries), checkpoint->path);
+  return TRUE;
+}
+
+/* API */
+
+GPOPCheckpoint *
+gpop_checkpoint_new (const gchar * path, GError ** error)
+{
+  GPOPCheckpoint *checkpoint = g_new0 (GPOPCheckpoint, 1);
+
+  checkpoint->path = g_strdup (path);
+  g_mutex_init (&checkpoint->lock);
+  checkpoint->entries = g_hash_table_new_full (g_str_hash, g_str_equal,
+      g_free, (GDestroyNotify) gpop_checkpoint_entry_free);
+  if (!gpop_checkpoint_load (checkpoint, error)) {
+    gpop_checkpoint_free (checkpoint);
+    return NULL;
+  }
+
+  return checkpoint;
+}
+
+void
+gpop_checkpoint_free (GPOPCheckpoint * checkpoint)
+{
+  g_hash_table_unref (checkpoint->entries);
+  g_mutex_clear (&checkpoint->lock);
+  g_free (checkpoint->path);
+  g_free (checkpoint);
+}
+
+/* Records the progress of a playing pipeline, returns FALSE if it is not a
+ * file pipeline. */
+gboolean
+gpop_checkpoint_update (GPOPCheckpoint * checkpoint, const gchar * id,
+    const gchar * description, GstElement * pipeline)
+{
+  GstElement *source = gpop_checkpoint_get_source (pipeline);
+  GstClockTime position = GST_CLOCK_TIME_NONE;
+  GPOPCheckpointEntry *entry;
+  GPtrArray *outputs, *sizes;
+  GList *sinks, *l;
+
+  if (!source)
+    return FALSE;
+  gst_object_unref (source);
+
+  outputs = g_ptr_array_new ();
+  sizes = g_ptr_array_new ();
+  sinks = gpop_checkpoint_list_files (pipeline, GST_TYPE_BASE_SINK);
+  for (l = sinks; l; l = g_list_next (l)) {
+    GstClockTime time;
+    gchar *location;
+    gint64 size;
+
+    if (!gpop_checkpoint_get_written (l->data, &time, &size))
+      continue;
+    g_object_get (l->data, "location", &location, NULL);
+    if (!location)
+      continue;
+    g_ptr_array_add (outputs, location);
+    g_ptr_array_add (sizes, g_strdup_printf ("%" G_GINT64_FORMAT, size));
+    /* resumed where every output has its data */
+    if (!GST_CLOCK_TIME_IS_VALID (position) || time < position)
+      position = time;
+  }
+  g_list_free_full (sinks, gst_object_unref);
+  g_ptr_array_add (outputs, NULL);
+  g_ptr_array_add (sizes, NULL);
+
+  if (!GST_CLOCK_TIME_IS_VALID (position)) {
+    g_strfreev ((gchar **) g_ptr_array_free (outputs, FALSE));
+    g_strfreev ((gchar **) g_ptr_array_free (sizes, FALSE));
+    return FALSE;
+  }
+
+  g_mutex_lock (&checkpoint->lock);
+  entry = g_hash_table_lookup (checkpoint->entries, id);
+  if (!entry || g_strcmp0 (entry->description, description)) {
+    entry = g_new0 (GPOPCheckpointEntry, 1);
+    entry->description = g_strdup (description);
+    g_hash_table_replace (checkpoint->entries, g_strdup (id), entry);
+  }
+  entry->position = position;
+  g_strfreev (entry->outputs);
+  entry->outputs = (gchar **) g_ptr_array_free (outputs, FALSE);
+  g_strfreev (entry->sizes);
+  entry->sizes = (gchar **) g_ptr_array_free (sizes, FALSE);
+  checkpoint->dirty = TRUE;
+  g_mutex_unlock (&checkpoint->lock);
+
+  return TRUE;
+}
+
+/* To be called on a newly built pipeline before its first state change:
+ * splits its outputs into new parts. The pipeline is then to be prerolled
+ * and positioned with gpop_checkpoint_seek(). */
+gboolean
+gpop_checkpoint_resume (GPOPCheckpoint * checkpoint, const gchar * id,
+    const gchar * description, GstElement * pipeline)
+{
+  GPOPCheckpointEntry *entry;
+  GstElement *source;
+  GList *sinks, *l;
+  guint part;
+
+  g_mutex_lock (&checkpoint->lock);
+  entry = g_hash_table_lookup (checkpoint->entries, id);
+  if (!entry || g_strcmp0 (entry->description, description)
+      || !GST_CLOCK_TIME_IS_VALID (entry->position) || !entry->position) {
+    g_mutex_unlock (&checkpoint->lock);
+    return FALSE;
+  }
+  part = entry->part + 1;
+  g_mutex_unlock (&checkpoint->lock);
+
+  source = gpop_checkpoint_get_source (pipeline);
+  if (!source)
+    return FALSE;
+  /* a demuxer started after the headers of a container could not find
+   * them, such an input is restarted from the beginning */
+  if (!gpop_checkpoint_is_headerless (source)) {
+    GPOP_LOG ("Unable to resume the pipeline %s, its input can not be read "
+        "from an offset", id);
+    gst_object_unref (source);
+    return FALSE;
+  }
+  gst_object_unref (source);
+
+  sinks = gpop_checkpoint_list_files (pipeline, GST_TYPE_BASE_SINK);
+  for (l = sinks; l; l = g_list_next (l)) {
+    gchar *location, *split;
+
+    g_object_get (l->data, "location", &location, NULL);
+    if (!location)
+      continue;
+    split = gpop_checkpoint_split_location (location, part);
+    g_object_set (l->data, "location", split, NULL);
+    g_free (split);
+    g_free (location);
+  }
+  g_list_free_full (sinks, gst_object_unref);
+
+  /* the new parts are written whether the seek succeeds or not */
+  g_mutex_lock (&checkpoint->lock);
+  entry = g_hash_table_lookup (checkpoint->entries, id);
+  if (entry) {
+    entry->part = part;
+    checkpoint->dirty = TRUE;
+  }
+  g_mutex_unlock (&checkpoint->lock);
+
+  return TRUE;
+}
+
+/* To be called once a resumed pipeline prerolled, before it plays: seeks it
+ * to the checkpoint and truncates the previous parts to what they held at
+ * that time, so that the parts follow each other. The seek is done in time
+ * by the demuxers and the parsers, whether their source runs in push or in
+ * pull mode. */
+gboolean
+gpop_checkpoint_seek (GPOPCheckpoint * checkpoint, const gchar * id,
+    GstElement * pipeline)
+{
+  GPOPCheckpointEntry *entry;
+  GstClockTime position;
+  gchar **outputs, **sizes;
+  GPtrArray *parts, *empty;
+  GList *sinks, *l;
+  guint part, i;
+
+  g_mutex_lock (&checkpoint->lock);
+  entry = g_hash_table_lookup (checkpoint->entries, id);
+  if (!entry) {
+    g_mutex_unlock (&checkpoint->lock);
+    return FALSE;
+  }
+  position = entry->position;
+  outputs = g_strdupv (entry->outputs);
+  sizes = g_strdupv (entry->sizes);
+  part = entry->part;
+  g_mutex_unlock (&checkpoint->lock);
+
+  if (!gst_element_seek_simple (pipeline, GST_FORMAT_TIME,
+          GST_SEEK_FLAG_FLUSH | GST_SEEK_FLAG_ACCURATE, position)) {
+    GPOP_LOG ("Unable to resume the pipeline %s at %" GST_TIME_FORMAT, id,
+        GST_TIME_ARGS (position));
+    g_strfreev (outputs);
+    g_strfreev (sizes);
+    return FALSE;
+  }
+
+  /* drops what was written after the checkpoint, written again from it */
+  for (i = 0; outputs[i] && sizes[i]; i++) {
+    if (truncate (outputs[i], g_ascii_strtoull (sizes[i], NULL, 10)) < 0)
+      GPOP_LOG ("Unable to truncate %s: %s", outputs[i], g_strerror (errno));
+  }
+  g_strfreev (outputs);
+  g_strfreev (sizes);
+
+  /* until the next checkpoint, the new parts hold nothing */
+  parts = g_ptr_array_new ();
+  empty = g_ptr_array_new ();
+  sinks = gpop_checkpoint_list_files (pipeline, GST_TYPE_BASE_SINK);
+  for (l = sinks; l; l = g_list_next (l)) {
+    gchar *location;
+
+    g_object_get (l->data, "location", &location, NULL);
+    if (!location)
+      continue;
+    g_ptr_array_add (parts, location);
+    g_ptr_array_add (empty, g_strdup ("0"));
+  }
+  g_list_free_full (sinks, gst_object_unref);
+  g_ptr_array_add (parts, NULL);
+  g_ptr_array_add (empty, NULL);
+
+  g_mutex_lock (&checkpoint->lock);
+  entry = g_hash_table_lookup (checkpoint->entries, id);
+  if (entry) {
+    g_strfreev (entry->outputs);
+    entry->outputs = (gchar **) g_ptr_array_free (parts, FALSE);
+    g_strfreev (entry->sizes);
+    entry->sizes = (gchar **) g_ptr_array_free (empty, FALSE);
+    checkpoint->dirty = TRUE;
+  } else {
+    g_strfreev ((gchar **) g_ptr_array_free (parts, FALSE));
+    g_strfreev ((gchar **) g_ptr_array_free (empty, FALSE));
+  }
+  g_mutex_unlock (&checkpoint->lock);
+
+  GPOP_LOG ("Resuming the pipeline %s at %" GST_TIME_FORMAT " into part %u",
+      id, GST_TIME_ARGS (position), part);
+  return TRUE;
+}
+
+void
+gpop_checkpoint_remove (GPOPCheckpoint * checkpoint, const gchar * id)
+{
+  g_mutex_lock (&checkpoint->lock);
+  if (g_hash_table_remove (checkpoint->entries, id))
+    checkpoint->dirty = TRUE;
+  g_mutex_unlock (&checkpoint->lock);
+}
+
+/* Writes the journal if it changed since the last save */
+gboolean
+gpop_checkpoint_save (GPOPCheckpoint * checkpoint, GError ** error)
+{
+  GKeyFile *key_file;
+  GHashTableIter iter;
+  gpointer key, value;
+  gchar *data;
+  gsize length;
+  gboolean res;
+
+  g_mutex_lock (&checkpoint->lock);
+  if (!checkpoint->dirty) {
+    g_mutex_unlock (&checkpoint->lock);
+    return TRUE;
+  }
+
+  key_file = g_key_file_new ();
+  g_hash_table_iter_init (&iter, checkpoint->entries);
+  while (g_hash_table_iter_next (&iter, &key, &value)) {
+    GPOPCheckpointEntry *entry = value;
+
+    g_key_file_set_string (key_file, key, "description", entry->description);
+    g_key_file_set_uint64 (key_file, key, "position", entry->position);
+    g_key_file_set_string_list (key_file, key, "outputs",
+        (const gchar * const *) entry->outputs,
+        g_strv_length (entry->outputs));
+    g_key_file_set_string_list (key_file, key, "sizes",
+        (const gchar * const *) entry->sizes, g_strv_length (entry->sizes));
+    g_key_file_set_integer (key_file, key, "part", entry->part);
+  }
+  checkpoint->dirty = FALSE;
+  g_mutex_unlock (&checkpoint->lock);
+
+  data = g_key_file_to_data (key_file, &length, NULL);
+  g_key_file_free (key_file);
+  /* written to a temporary file renamed over the journal */
+  res = g_file_set_contents (checkpoint->path, data, length, error);
+  g_free (data);
+
+  if (!res) {
+    g_mutex_lock (&checkpoint->lock);
+    checkpoint->dirty = TRUE;
+    g_mutex_unlock (&checkpoint->lock);
+  }
+  return res;
+}
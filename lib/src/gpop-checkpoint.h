@@ -0,0 +1,57 @@
+/*
+ * GStreamer Prince of Parser
+ *
+ * Copyright (C) 2020 Stéphane Cerveau
+ *
+ * SPDX-License-Identifier: LGPL
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation
+ * version 2.1 of the License.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301 USA
+ *
+ */
+
+#ifndef _GPOP_CHECKPOINT_H_
+#define _GPOP_CHECKPOINT_H_
+
+#include <gst/gst.h>
+
+/* Progress journal of the file pipelines, to resume them after a restart.
+ *
+ * A pipeline reading a single file source is checkpointed periodically with
+ * the bytes held by each of its outputs and the stream time they were all
+ * written up to. When the same pipeline (same id and description) is built
+ * again, each output with a location is split into a new ".partN" file, the
+ * pipeline is prerolled and seeked to that time and the previous parts are
+ * truncated to their size at the checkpoint, so that the parts follow each
+ * other. Only the inputs which can be read from any point are resumed, such
+ * as MPEG-TS or elementary streams, the containers with headers are
+ * restarted from the beginning. A pipeline reaching EOS is dropped from the
+ * journal.
+ *
+ * The journal is a key file rewritten atomically. */
+
+#define GPOP_CHECKPOINT_DEFAULT_INTERVAL_SECONDS 10
+
+typedef struct _GPOPCheckpoint GPOPCheckpoint;
+
+GPOPCheckpoint * gpop_checkpoint_new (const gchar * path, GError ** error);
+void gpop_checkpoint_free (GPOPCheckpoint * checkpoint);
+
+gboolean gpop_checkpoint_update (GPOPCheckpoint * checkpoint, const gchar * id, const gchar * description, GstElement * pipeline);
+gboolean gpop_checkpoint_resume (GPOPCheckpoint * checkpoint, const gchar * id, const gchar * description, GstElement * pipeline);
+gboolean gpop_checkpoint_seek (GPOPCheckpoint * checkpoint, const gchar * id, GstElement * pipeline);
+void gpop_checkpoint_remove (GPOPCheckpoint * checkpoint, const gchar * id);
+gboolean gpop_checkpoint_save (GPOPCheckpoint * checkpoint, GError ** error);
+
+#endif /* _GPOP_CHECKPOINT_H_ */
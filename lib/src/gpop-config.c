@@ -0,0 +1,252 @@
+/*
+ * GStreamer Prince of Parser
+ *
+ * Copyright (C) 2020 Stéphane Cerveau
+ *
+ * SPDX-License-Identifier: LGPL
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation
+ * version 2.1 of the License.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301 USA
+ *
+ */
+
+#include <gio/gio.h>
+
+#include "gpop-private.h"
+
+/* Delay before reloading a changed file, editors write it in several steps */
+#define GPOP_CONFIG_RELOAD_DELAY_MS 200
+
+struct _GPOPConfig
+{
+  gchar *path;
+  GPOPConfigFunc func;
+  gpointer user_data;
+  GFileMonitor *monitor;
+  guint reload_id;
+};
+
+static void
+gpop_config_pipeline_free (GPOPConfigPipeline * pipeline)
+{
+  g_free (pipeline->id);
+  g_free (pipeline->description);
+  g_free (pipeline);
+}
+
+static gboolean
+gpop_config_parse_state (const gchar * name, GPOPParserState * state)
+{
+  GPOPParserState states[] =
+      { GPOP_PARSER_READY, GPOP_PARSER_PAUSED, GPOP_PARSER_PLAYING };
+  guint i;
+
+  for (i = 0; i < G_N_ELEMENTS (states); i++) {
+    if (!g_ascii_strcasecmp (name, gpop_parser_state_get_name (states[i]))) {
+      *state = states[i];
+      return TRUE;
+    }
+  }
+  return FALSE;
+}
+
+static gboolean
+gpop_config_get_objective (GKeyFile * key_file, const gchar * group,
+    const gchar * key, gdouble * value, GError ** error)
+{
+  GError *err = NULL;
+
+  if (!g_key_file_has_key (key_file, group, key, NULL))
+    return TRUE;
+
+  *value = g_key_file_get_double (key_file, group, key, &err);
+  if (err) {
+    g_propagate_error (error, err);
+    return FALSE;
+  }
+  if (*value < 0) {
+    g_set_error (error, G_KEY_FILE_ERROR, G_KEY_FILE_ERROR_INVALID_VALUE,
+        "Invalid %s for the pipeline '%s'", key, group);
+    return FALSE;
+  }
+  return TRUE;
+}
+
+static GPtrArray *
+gpop_config_load (const gchar * path, GError ** error)
+{
+  GKeyFile *key_file = g_key_file_new ();
+  GPtrArray *pipelines = NULL;
+  gchar **groups = NULL, **group;
+
+  if (!g_key_file_load_from_file (key_file, path, G_KEY_FILE_NONE, error))
+    goto done;
+
+  pipelines = g_ptr_array_new_with_free_func ((GDestroyNotify)
+      gpop_config_pipeline_free);
+  groups = g_key_file_get_groups (key_file, NULL);
+  for (group = groups; *group; group++) {
+    GPOPConfigPipeline *pipeline = g_new0 (GPOPConfigPipeline, 1);
+    gchar *state;
+
+    g_ptr_array_add (pipelines, pipeline);
+    pipeline->id = g_strdup (*group);
+    pipeline->description =
+        g_key_file_get_string (key_file, *group, "description", error);
+    if (!pipeline->description)
+      goto failed;
+
+    pipeline->state = GPOP_PARSER_READY;
+    state = g_key_file_get_string (key_file, *group, "state", NULL);
+    if (state && !gpop_config_parse_state (state, &pipeline->state)) {
+      g_set_error (error, G_KEY_FILE_ERROR, G_KEY_FILE_ERROR_INVALID_VALUE,
+          "Invalid state '%s' for the pipeline '%s'", state, *group);
+      g_free (state);
+      goto failed;
+    }
+    g_free (state);
+
+    if (g_key_file_has_key (key_file, *group, "priority", NULL)) {
+      GError *err = NULL;
+
+      pipeline->priority =
+          g_key_file_get_integer (key_file, *group, "priority", &err);
+      if (err) {
+        g_propagate_error (error, err);
+        goto failed;
+      }
+    }
+
+    if (g_key_file_has_key (key_file, *group, "prewarm", NULL)) {
+      GError *err = NULL;
+
+      pipeline->prewarm =
+          g_key_file_get_boolean (key_file, *group, "prewarm", &err);
+      if (err) {
+        g_propagate_error (error, err);
+        goto failed;
+      }
+    }
+
+    if (!gpop_config_get_objective (key_file, *group, "min-fps",
+            &pipeline->slo.min_fps, error)
+        || !gpop_config_get_objective (key_file, *group, "max-latency-ms",
+            &pipeline->slo.max_latency_ms, error)
+        || !gpop_config_get_objective (key_file, *group,
+            "max-dropped-per-minute", &pipeline->slo.max_dropped_per_minute,
+            error))
+      goto failed;
+  }
+  goto done;
+
+failed:
+  g_clear_pointer (&pipelines, g_ptr_array_unref);
+done:
+  g_strfreev (groups);
+  g_key_file_free (key_file);
+  return pipelines;
+}
+
+static gboolean
+gpop_config_on_reload (gpointer user_data)
+{
+  GPOPConfig *config = (GPOPConfig *) user_data;
+  GError *err = NULL;
+
+  config->reload_id = 0;
+  if (!gpop_config_reload (config, &err)) {
+    GPOP_LOG ("Unable to reload the configuration %s: %s", config->path,
+        err->message);
+    g_error_free (err);
+  }
+  return G_SOURCE_REMOVE;
+}
+
+static void
+gpop_config_on_changed (GFileMonitor * monitor, GFile * file,
+    GFile * other_file, GFileMonitorEvent event, gpointer user_data)
+{
+  GPOPConfig *config = (GPOPConfig *) user_data;
+
+  if (event != G_FILE_MONITOR_EVENT_CHANGES_DONE_HINT
+      && event != G_FILE_MONITOR_EVENT_CREATED
+      && event != G_FILE_MONITOR_EVENT_MOVED_IN
+      && event != G_FILE_MONITOR_EVENT_RENAMED)
+    return;
+
+  if (config->reload_id)
+    g_source_remove (config->reload_id);
+  config->reload_id = g_timeout_add (GPOP_CONFIG_RELOAD_DELAY_MS,
+      gpop_config_on_reload, config);
+}
+
+/* API */
+
+/* Loads the configuration, calls func with it and starts watching the file */
+GPOPConfig *
+gpop_config_new (const gchar * path, GPOPConfigFunc func, gpointer user_data,
+    GError ** error)
+{
+  GPOPConfig *config = g_new0 (GPOPConfig, 1);
+  GFile *file;
+
+  config->path = g_strdup (path);
+  config->func = func;
+  config->user_data = user_data;
+  if (!gpop_config_reload (config, error)) {
+    gpop_config_free (config);
+    return NULL;
+  }
+
+  /* most editors replace the file, which is then reported as RENAMED */
+  file = g_file_new_for_path (path);
+  config->monitor = g_file_monitor_file (file, G_FILE_MONITOR_WATCH_MOVES,
+      NULL, error);
+  g_object_unref (file);
+  if (!config->monitor) {
+    gpop_config_free (config);
+    return NULL;
+  }
+  g_signal_connect (config->monitor, "changed",
+      G_CALLBACK (gpop_config_on_changed), config);
+
+  return config;
+}
+
+void
+gpop_config_free (GPOPConfig * config)
+{
+  if (config->reload_id)
+    g_source_remove (config->reload_id);
+  if (config->monitor) {
+    g_file_monitor_cancel (config->monitor);
+    g_object_unref (config->monitor);
+  }
+  g_free (config->path);
+  g_free (config);
+}
+
+gboolean
+gpop_config_reload (GPOPConfig * config, GError ** error)
+{
+  GPtrArray *pipelines = gpop_config_load (config->path, error);
+
+  if (!pipelines)
+    return FALSE;
+
+  GPOP_LOG ("Loaded %u pipelines from %s", pipelines->len, config->path);
+  config->func (pipelines, config->user_data);
+  g_ptr_array_unref (pipelines);
+  return TRUE;
+}
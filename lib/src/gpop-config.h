@@ -0,0 +1,68 @@
+/*
+ * GStreamer Prince of Parser
+ *
+ * Copyright (C) 2020 Stéphane Cerveau
+ *
+ * SPDX-License-Identifier: LGPL
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation
+ * version 2.1 of the License.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301 USA
+ *
+ */
+
+#ifndef _GPOP_CONFIG_H_
+#define _GPOP_CONFIG_H_
+
+#include <glib-2.0/glib.h>
+
+/* Declarative pipeline configuration.
+ *
+ * A key file where each group declares a pipeline, named by its id:
+ *
+ *   [camera1]
+ *   description=v4l2src ! x264enc ! mp4mux ! filesink location=cam1.mp4
+ *   state=playing
+ *   priority=1
+ *   min-fps=25
+ *   max-latency-ms=200
+ *   prewarm=true
+ *
+ * state is one of ready (default), paused or playing. min-fps,
+ * max-latency-ms and max-dropped-per-minute are the service level
+ * objectives of the pipeline, see gpop-slo.h. prewarm pre-warms its buffer
+ * pools, see gpop-prewarm.h. The file is watched
+ * and reloaded on change or with gpop_config_reload(); each successful load
+ * hands the whole set of pipelines to the callback, a file which fails to
+ * load is reported and ignored. */
+
+typedef struct _GPOPConfig GPOPConfig;
+
+typedef struct
+{
+  gchar *id;
+  gchar *description;
+  GPOPParserState state;
+  gint priority;
+  GPOPSloTargets slo;
+  gboolean prewarm;
+} GPOPConfigPipeline;
+
+/* pipelines is an array of GPOPConfigPipeline */
+typedef void (*GPOPConfigFunc) (GPtrArray * pipelines, gpointer user_data);
+
+GPOPConfig * gpop_config_new (const gchar * path, GPOPConfigFunc func, gpointer user_data, GError ** error);
+void gpop_config_free (GPOPConfig * config);
+gboolean gpop_config_reload (GPOPConfig * config, GError ** error);
+
+#endif /* _GPOP_CONFIG_H_ */
@@ -0,0 +1,331 @@
+/*
+ * GStreamer Prince of Parser
+ *
+ * Copyright (C) 2020 Stéphane Cerveau
+ *
+ * SPDX-License-Identifier: LGPL
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation
+ * version 2.1 of the License.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301 USA
+ *
+ */
+
+#include "gpop-control-stats.h"
+#include "gpop-dbus-interface.h"
+
+#define GPOP_CONTROL_STATS_MAX_PENDING 4096
+#define GPOP_CONTROL_STATS_MAX_SENDERS 1024
+#define GPOP_CONTROL_STATS_OTHER_SENDER "other"
+
+typedef struct
+{
+  guint64 calls;
+  guint64 queue_us;
+  guint64 exec_us;
+  guint64 max_us;
+  guint64 buckets[GPOP_CONTROL_STATS_BUCKETS];
+} GPOPLatencyStats;
+
+static GMutex stats_lock;
+/* "sender/serial" -> received time, filled from the GDBus worker thread */
+static GHashTable *pending_calls = NULL;
+/* "sender/property" -> GQueue of received times, Get calls are dispatched in
+ * order for a given sender */
+static GHashTable *pending_gets = NULL;
+static GHashTable *method_stats = NULL;
+static GHashTable *sender_stats = NULL;
+
+static void
+gpop_control_stats_ensure (void)
+{
+  if (G_UNLIKELY (!pending_calls)) {
+    pending_calls = g_hash_table_new_full (g_str_hash, g_str_equal, g_free,
+        g_free);
+    pending_gets = g_hash_table_new_full (g_str_hash, g_str_equal, g_free,
+        (GDestroyNotify) g_queue_free);
+    method_stats = g_hash_table_new_full (g_str_hash, g_str_equal, g_free,
+        g_free);
+    sender_stats = g_hash_table_new_full (g_str_hash, g_str_equal, g_free,
+        g_free);
+  }
+}
+
+static void
+gpop_control_stats_add_pending_call (const gchar * sender, guint32 serial,
+    gint64 received)
+{
+  gint64 *value = g_new (gint64, 1);
+
+  *value = received;
+  g_mutex_lock (&stats_lock);
+  gpop_control_stats_ensure ();
+  /* Calls which are never dispatched (unknown method, Introspect...) would
+   * otherwise pile up. */
+  if (g_hash_table_size (pending_calls) >= GPOP_CONTROL_STATS_MAX_PENDING)
+    g_hash_table_remove_all (pending_calls);
+  g_hash_table_replace (pending_calls, g_strdup_printf ("%s/%u", sender,
+          serial), value);
+  g_mutex_unlock (&stats_lock);
+}
+
+static void
+gpop_control_stats_add_pending_get (const gchar * sender,
+    const gchar * property_name, gint64 received)
+{
+  gchar *key = g_strdup_printf ("%s/%s", sender, property_name);
+  gint64 *value = g_new (gint64, 1);
+  GQueue *queue;
+
+  *value = received;
+  g_mutex_lock (&stats_lock);
+  gpop_control_stats_ensure ();
+  if (g_hash_table_size (pending_gets) >= GPOP_CONTROL_STATS_MAX_PENDING)
+    g_hash_table_remove_all (pending_gets);
+  queue = g_hash_table_lookup (pending_gets, key);
+  if (!queue) {
+    queue = g_queue_new ();
+    g_hash_table_insert (pending_gets, key, queue);
+  } else
+    g_free (key);
+  g_queue_push_tail (queue, value);
+  g_mutex_unlock (&stats_lock);
+}
+
+static GDBusMessage *
+gpop_control_stats_filter (GDBusConnection * connection,
+    GDBusMessage * message, gboolean incoming, gpointer user_data)
+{
+  const gchar *interface_name, *sender;
+  GVariant *body;
+
+  if (!incoming
+      || g_dbus_message_get_message_type (message) !=
+      G_DBUS_MESSAGE_TYPE_METHOD_CALL)
+    return message;
+
+  sender = g_dbus_message_get_sender (message);
+  interface_name = g_dbus_message_get_interface (message);
+  if (!g_strcmp0 (interface_name, GPOP_DBUS_INTERFACE_NAME)) {
+    gpop_control_stats_add_pending_call (sender,
+        g_dbus_message_get_serial (message), g_get_monotonic_time ());
+  } else if (!g_strcmp0 (interface_name, "org.freedesktop.DBus.Properties")
+      && !g_strcmp0 (g_dbus_message_get_member (message), "Get")) {
+    const gchar *property_interface, *property_name;
+
+    body = g_dbus_message_get_body (message);
+    if (body && g_variant_is_of_type (body, G_VARIANT_TYPE ("(ss)"))) {
+      g_variant_get (body, "(&s&s)", &property_interface, &property_name);
+      if (!g_strcmp0 (property_interface, GPOP_DBUS_INTERFACE_NAME))
+        gpop_control_stats_add_pending_get (sender, property_name,
+            g_get_monotonic_time ());
+    }
+  }
+
+  return message;
+}
+
+static void
+gpop_control_stats_update (GHashTable * table, const gchar * key,
+    gint64 queue_us, gint64 exec_us)
+{
+  GPOPLatencyStats *stats = g_hash_table_lookup (table, key);
+  guint64 total_us = queue_us + exec_us;
+  guint bucket;
+
+  if (!stats) {
+    stats = g_new0 (GPOPLatencyStats, 1);
+    g_hash_table_insert (table, g_strdup (key), stats);
+  }
+
+  bucket = total_us ? g_bit_storage (total_us) : 0;
+  bucket = MIN (bucket, GPOP_CONTROL_STATS_BUCKETS - 1);
+
+  stats->calls++;
+  stats->queue_us += queue_us;
+  stats->exec_us += exec_us;
+  stats->max_us = MAX (stats->max_us, total_us);
+  stats->buckets[bucket]++;
+}
+
+static GVariant *
+gpop_control_stats_table_to_variant (GHashTable * table)
+{
+  GVariantBuilder builder;
+  GHashTableIter iter;
+  GPOPLatencyStats *stats;
+  const gchar *key;
+
+  g_variant_builder_init (&builder, G_VARIANT_TYPE ("a{s(ttttat)}"));
+  g_hash_table_iter_init (&iter, table);
+  while (g_hash_table_iter_next (&iter, (gpointer *) & key,
+          (gpointer *) & stats)) {
+    g_variant_builder_add (&builder, "{s(tttt@at)}", key, stats->calls,
+        stats->queue_us, stats->exec_us, stats->max_us,
+        g_variant_new_fixed_array (G_VARIANT_TYPE_UINT64, stats->buckets,
+            GPOP_CONTROL_STATS_BUCKETS, sizeof (guint64)));
+  }
+  return g_variant_builder_end (&builder);
+}
+
+static void
+gpop_control_stats_append_table (GString * metrics, GHashTable * table,
+    const gchar * prefix, const gchar * label)
+{
+  GHashTableIter iter;
+  GPOPLatencyStats *stats;
+  const gchar *key;
+  guint64 cumulative;
+  guint i;
+
+  g_string_append_printf (metrics,
+      "# TYPE gpop_control_%s_calls_total counter\n"
+      "# TYPE gpop_control_%s_queue_seconds_total counter\n"
+      "# TYPE gpop_control_%s_latency_seconds histogram\n", prefix, prefix,
+      prefix);
+
+  g_hash_table_iter_init (&iter, table);
+  while (g_hash_table_iter_next (&iter, (gpointer *) & key,
+          (gpointer *) & stats)) {
+    g_string_append_printf (metrics,
+        "gpop_control_%s_calls_total{%s=\"%s\"} %" G_GUINT64_FORMAT "\n",
+        prefix, label, key, stats->calls);
+    g_string_append_printf (metrics,
+        "gpop_control_%s_queue_seconds_total{%s=\"%s\"} %.6f\n",
+        prefix, label, key, stats->queue_us / 1e6);
+
+    cumulative = 0;
+    for (i = 0; i < GPOP_CONTROL_STATS_BUCKETS - 1; i++) {
+      cumulative += stats->buckets[i];
+      g_string_append_printf (metrics,
+          "gpop_control_%s_latency_seconds_bucket{%s=\"%s\",le=\"%g\"} %"
+          G_GUINT64_FORMAT "\n", prefix, label, key, (1 << i) / 1e6,
+          cumulative);
+    }
+    g_string_append_printf (metrics,
+        "gpop_control_%s_latency_seconds_bucket{%s=\"%s\",le=\"+Inf\"} %"
+        G_GUINT64_FORMAT "\n", prefix, label, key, stats->calls);
+    g_string_append_printf (metrics,
+        "gpop_control_%s_latency_seconds_sum{%s=\"%s\"} %.6f\n", prefix,
+        label, key, (stats->queue_us + stats->exec_us) / 1e6);
+    g_string_append_printf (metrics,
+        "gpop_control_%s_latency_seconds_count{%s=\"%s\"} %" G_GUINT64_FORMAT
+        "\n", prefix, label, key, stats->calls);
+  }
+}
+
+/* Public API */
+
+guint
+gpop_control_stats_attach (GDBusConnection * connection)
+{
+  return g_dbus_connection_add_filter (connection, gpop_control_stats_filter,
+      NULL, NULL);
+}
+
+void
+gpop_control_stats_detach (GDBusConnection * connection, guint filter_id)
+{
+  if (connection && filter_id)
+    g_dbus_connection_remove_filter (connection, filter_id);
+}
+
+gint64
+gpop_control_stats_call_received (GDBusMessage * message)
+{
+  gint64 *value, received = 0;
+  gchar *key;
+
+  key = g_strdup_printf ("%s/%u", g_dbus_message_get_sender (message),
+      g_dbus_message_get_serial (message));
+  g_mutex_lock (&stats_lock);
+  gpop_control_stats_ensure ();
+  value = g_hash_table_lookup (pending_calls, key);
+  if (value) {
+    received = *value;
+    g_hash_table_remove (pending_calls, key);
+  }
+  g_mutex_unlock (&stats_lock);
+  g_free (key);
+
+  return received;
+}
+
+gint64
+gpop_control_stats_get_received (const gchar * sender,
+    const gchar * property_name)
+{
+  gint64 *value, received = 0;
+  GQueue *queue;
+  gchar *key;
+
+  key = g_strdup_printf ("%s/%s", sender, property_name);
+  g_mutex_lock (&stats_lock);
+  gpop_control_stats_ensure ();
+  queue = g_hash_table_lookup (pending_gets, key);
+  if (queue && (value = g_queue_pop_head (queue))) {
+    received = *value;
+    g_free (value);
+    if (g_queue_is_empty (queue))
+      g_hash_table_remove (pending_gets, key);
+  }
+  g_mutex_unlock (&stats_lock);
+  g_free (key);
+
+  return received;
+}
+
+void
+gpop_control_stats_record (const gchar * method, const gchar * sender,
+    gint64 received, gint64 dispatched, gint64 done)
+{
+  gint64 queue_us = received ? MAX (dispatched - received, 0) : 0;
+  gint64 exec_us = MAX (done - dispatched, 0);
+
+  if (!sender)
+    sender = GPOP_CONTROL_STATS_OTHER_SENDER;
+
+  g_mutex_lock (&stats_lock);
+  gpop_control_stats_ensure ();
+  gpop_control_stats_update (method_stats, method, queue_us, exec_us);
+  if (g_hash_table_size (sender_stats) >= GPOP_CONTROL_STATS_MAX_SENDERS
+      && !g_hash_table_contains (sender_stats, sender))
+    sender = GPOP_CONTROL_STATS_OTHER_SENDER;
+  gpop_control_stats_update (sender_stats, sender, queue_us, exec_us);
+  g_mutex_unlock (&stats_lock);
+}
+
+GVariant *
+gpop_control_stats_to_variant (void)
+{
+  GVariant *ret;
+
+  g_mutex_lock (&stats_lock);
+  gpop_control_stats_ensure ();
+  ret = g_variant_new ("(@a{s(ttttat)}@a{s(ttttat)})",
+      gpop_control_stats_table_to_variant (method_stats),
+      gpop_control_stats_table_to_variant (sender_stats));
+  g_mutex_unlock (&stats_lock);
+
+  return ret;
+}
+
+void
+gpop_control_stats_append_metrics (GString * metrics)
+{
+  g_mutex_lock (&stats_lock);
+  gpop_control_stats_ensure ();
+  gpop_control_stats_append_table (metrics, method_stats, "method", "method");
+  gpop_control_stats_append_table (metrics, sender_stats, "sender", "sender");
+  g_mutex_unlock (&stats_lock);
+}
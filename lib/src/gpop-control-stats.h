@@ -0,0 +1,49 @@
+/*
+ * GStreamer Prince of Parser
+ *
+ * Copyright (C) 2020 Stéphane Cerveau
+ *
+ * SPDX-License-Identifier: LGPL
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation
+ * version 2.1 of the License.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301 USA
+ *
+ */
+
+#ifndef _GPOP_CONTROL_STATS_H_
+#define _GPOP_CONTROL_STATS_H_
+
+#include <gio/gio.h>
+#include <glib-2.0/glib.h>
+
+/* Latency accounting of the D-Bus control plane, per method and per sender.
+ *
+ * A connection filter timestamps the incoming calls in the GDBus worker
+ * thread, the dispatch in GPOPDBusInterface then splits the latency in
+ * queueing (waiting for the main loop) and execution. Latencies are kept in
+ * log2 histograms of microseconds. */
+
+#define GPOP_CONTROL_STATS_BUCKETS 24
+
+guint gpop_control_stats_attach (GDBusConnection * connection);
+void gpop_control_stats_detach (GDBusConnection * connection, guint filter_id);
+
+gint64 gpop_control_stats_call_received (GDBusMessage * message);
+gint64 gpop_control_stats_get_received (const gchar * sender, const gchar * property_name);
+void gpop_control_stats_record (const gchar * method, const gchar * sender, gint64 received, gint64 dispatched, gint64 done);
+
+GVariant * gpop_control_stats_to_variant (void);
+void gpop_control_stats_append_metrics (GString * metrics);
+
+#endif /* _GPOP_CONTROL_STATS_H_ */
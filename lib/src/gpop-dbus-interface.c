@@ -22,10 +22,88 @@
  */
 
 #include "gpop-dbus-interface.h"
+#include "gpop-control-stats.h"
+#include "gpop-rate-limit.h"
+#include "gpop-recorder.h"
 
 G_DEFINE_TYPE (GPOPDBusInterface, gpop_dbus_interface, G_TYPE_OBJECT);
 #define parent_class gpop_dbus_interface_parent_class
 
+/* xml_introspection -> GDBusNodeInfo, all the objects of a class share the
+ * same parsed introspection data. */
+static GHashTable *introspection_cache = NULL;
+
+static GDBusNodeInfo *
+gpop_dbus_interface_lookup_introspection (const gchar * xml_introspection)
+{
+  GDBusNodeInfo *info;
+
+  if (!introspection_cache)
+    introspection_cache = g_hash_table_new_full (g_direct_hash,
+        g_direct_equal, NULL, (GDestroyNotify) g_dbus_node_info_unref);
+
+  info = g_hash_table_lookup (introspection_cache, xml_introspection);
+  if (!info) {
+    info = g_dbus_node_info_new_for_xml (xml_introspection, NULL);
+    if (!info)
+      return NULL;
+    g_hash_table_insert (introspection_cache, (gpointer) xml_introspection,
+        info);
+  }
+
+  return g_dbus_node_info_ref (info);
+}
+
+/* A method call, possibly deferred by the rate limiting */
+typedef struct
+{
+  GPOPDBusInterface *iface;
+  GDBusMethodInvocation *invocation;
+  gint64 received;
+} GPOPDBusInterfaceCall;
+
+static void
+gpop_dbus_interface_dispatch_call (gpointer data)
+{
+  GPOPDBusInterfaceCall *call = (GPOPDBusInterfaceCall *) data;
+  GPOPDBusInterface *iface = call->iface;
+  GDBusMethodInvocation *invocation = call->invocation;
+  GDBusConnection *connection =
+      g_dbus_method_invocation_get_connection (invocation);
+  const gchar *sender = g_dbus_method_invocation_get_sender (invocation);
+  const gchar *method_name =
+      g_dbus_method_invocation_get_method_name (invocation);
+  GPOPDBusInterfaceClass *klass;
+  gint64 dispatched;
+  gchar stats_key[128];
+  klass = GPOP_DBUS_INTERFACE_GET_CLASS (iface);
+
+  dispatched = g_get_monotonic_time ();
+  g_snprintf (stats_key, sizeof (stats_key), "%s.%s",
+      G_OBJECT_TYPE_NAME (iface), method_name);
+
+  if (!iface->object_id) {
+    /* Unregistered while the call was deferred */
+    g_dbus_method_invocation_return_error (invocation, G_DBUS_ERROR,
+        G_DBUS_ERROR_UNKNOWN_OBJECT, "No such object %s",
+        g_dbus_method_invocation_get_object_path (invocation));
+  } else if (klass->method_call)
+    klass->method_call (connection, sender,
+        g_dbus_method_invocation_get_object_path (invocation),
+        g_dbus_method_invocation_get_interface_name (invocation), method_name,
+        g_dbus_method_invocation_get_parameters (invocation), invocation,
+        iface);
+  else {
+    g_dbus_method_invocation_return_value (invocation, NULL);
+    g_dbus_connection_flush (connection, NULL, NULL, NULL);
+  }
+
+  gpop_control_stats_record (stats_key, sender, call->received, dispatched,
+      g_get_monotonic_time ());
+  g_object_unref (iface);
+  g_free (call);
+}
+
 void
 gpop_dbus_interface_handle_method_call (GDBusConnection * connection,
     const gchar * sender,
@@ -36,15 +114,29 @@ gpop_dbus_interface_handle_method_call (GDBusConnection * connection,
     GDBusMethodInvocation * invocation, gpointer user_data)
 {
   GPOPDBusInterface *iface = (GPOPDBusInterface *) user_data;
-  GPOPDBusInterfaceClass *klass;
-  klass = GPOP_DBUS_INTERFACE_GET_CLASS (iface);
+  GPOPDBusInterfaceCall *call = g_new (GPOPDBusInterfaceCall, 1);
 
-  if (klass->method_call)
-    klass->method_call (connection, sender, object_path, interface_name,
-        method_name, parameters, invocation, user_data);
-  else {
-    g_dbus_method_invocation_return_value (invocation, NULL);
-    g_dbus_connection_flush (connection, NULL, NULL, NULL);
+  call->iface = g_object_ref (iface);
+  call->invocation = invocation;
+  call->received =
+      gpop_control_stats_call_received (g_dbus_method_invocation_get_message
+      (invocation));
+  if (gpop_recorder_is_active () && !g_str_has_suffix (method_name, "Recording"))
+    gpop_recorder_record (object_path, method_name, parameters);
+
+  switch (gpop_rate_limit_admit (sender, gpop_rate_limit_get_cost (method_name,
+              parameters), gpop_dbus_interface_dispatch_call, call)) {
+    case GPOP_RATE_LIMIT_ACCEPTED:
+      gpop_dbus_interface_dispatch_call (call);
+      break;
+    case GPOP_RATE_LIMIT_DEFERRED:
+      break;
+    case GPOP_RATE_LIMIT_REJECTED:
+      g_dbus_method_invocation_return_error (invocation, G_DBUS_ERROR,
+          G_DBUS_ERROR_LIMITS_EXCEEDED, "Too many requests from %s", sender);
+      g_object_unref (iface);
+      g_free (call);
+      break;
   }
 }
 
@@ -58,13 +150,32 @@ gpop_dbus_interface_handle_get_property (GDBusConnection * connection,
   GVariant *ret = NULL;
   GPOPDBusInterface *iface = (GPOPDBusInterface *) user_data;
   GPOPDBusInterfaceClass *klass;
+  gint64 received, dispatched;
+  gchar stats_key[128];
   klass = GPOP_DBUS_INTERFACE_GET_CLASS (iface);
 
+  received = gpop_control_stats_get_received (sender, property_name);
+  if (gpop_rate_limit_admit (sender, GPOP_RATE_LIMIT_COST_READ, NULL,
+          NULL) == GPOP_RATE_LIMIT_REJECTED) {
+    g_set_error (error, G_DBUS_ERROR, G_DBUS_ERROR_LIMITS_EXCEEDED,
+        "Too many requests from %s", sender);
+    return NULL;
+  }
+  dispatched = g_get_monotonic_time ();
+  if (gpop_recorder_is_active ())
+    gpop_recorder_record (object_path, "Get",
+        g_variant_new ("(s)", property_name));
+
   if (klass->get_property)
     ret =
         klass->get_property (connection, sender, object_path, interface_name,
         property_name, error, user_data);
 
+  g_snprintf (stats_key, sizeof (stats_key), "%s.Get.%s",
+      G_OBJECT_TYPE_NAME (iface), property_name);
+  gpop_control_stats_record (stats_key, sender, received, dispatched,
+      g_get_monotonic_time ());
+
   return ret;
 }
 
@@ -93,6 +204,14 @@ static const GDBusInterfaceVTable interface_vtable = {
   gpop_dbus_interface_handle_set_property
 };
 
+/* The classes without property handlers get the org.freedesktop.DBus.Properties
+ * calls in their method_call, to answer them asynchronously */
+static const GDBusInterfaceVTable interface_vtable_no_properties = {
+  gpop_dbus_interface_handle_method_call,
+  NULL,
+  NULL
+};
+
 /*----------------------------------------------------------------------------*
  *                            GObject interface                               *
  *----------------------------------------------------------------------------*/
@@ -106,6 +225,7 @@ gpop_dbus_interface_dispose (GObject * object)
   }
   iface->connection = NULL;
   g_clear_pointer (&iface->object_path, g_free);
+  g_clear_pointer (&iface->introspection_data, g_dbus_node_info_unref);
 }
 
 static void
@@ -127,9 +247,14 @@ gpop_dbus_interface_register (GPOPDBusInterface * iface,
     const gchar * object_path, const gchar * xml_introspection,
     GDBusConnection * connection)
 {
+  GPOPDBusInterfaceClass *klass = GPOP_DBUS_INTERFACE_GET_CLASS (iface);
+  const GDBusInterfaceVTable *vtable = &interface_vtable;
+
+  if (!klass->get_property && !klass->set_property)
+    vtable = &interface_vtable_no_properties;
 
   iface->introspection_data =
-      g_dbus_node_info_new_for_xml (xml_introspection, NULL);
+      gpop_dbus_interface_lookup_introspection (xml_introspection);
 
   if (!iface->introspection_data)
     return FALSE;
@@ -140,7 +265,7 @@ gpop_dbus_interface_register (GPOPDBusInterface * iface,
   g_print ("object_path: %s\n", iface->object_path);
 
 
-  iface->object_id = g_dbus_connection_register_object (connection, iface->object_path, iface->introspection_data->interfaces[0], &interface_vtable, iface,     /* user_data */
+  iface->object_id = g_dbus_connection_register_object (connection, iface->object_path, iface->introspection_data->interfaces[0], vtable, iface,     /* user_data */
       NULL,                     /* user_data_free_func */
       NULL);                    /* GError** */
 
@@ -152,3 +277,45 @@ gpop_dbus_interface_register (GPOPDBusInterface * iface,
 
   return TRUE;
 }
+
+void
+gpop_dbus_interface_emit_property_changed (GPOPDBusInterface * iface,
+    const gchar * property_name, GVariant * value)
+{
+  GVariantBuilder builder;
+  GError *error = NULL;
+
+  if (!iface->connection || !iface->introspection_data)
+    return;
+
+  g_variant_builder_init (&builder, G_VARIANT_TYPE_ARRAY);
+  g_variant_builder_add (&builder, "{sv}", property_name, value);
+
+  if (!g_dbus_connection_emit_signal (iface->connection, NULL,
+          iface->object_path, "org.freedesktop.DBus.Properties",
+          "PropertiesChanged", g_variant_new ("(sa{sv}as)",
+              iface->introspection_data->interfaces[0]->name, &builder, NULL),
+          &error)) {
+    g_printerr ("Unable to emit PropertiesChanged on %s: %s\n",
+        iface->object_path, error->message);
+    g_error_free (error);
+  }
+}
+
+void
+gpop_dbus_interface_emit_signal (GPOPDBusInterface * iface,
+    const gchar * signal_name, GVariant * parameters)
+{
+  GError *error = NULL;
+
+  g_variant_ref_sink (parameters);
+  if (iface->connection && iface->introspection_data
+      && !g_dbus_connection_emit_signal (iface->connection, NULL,
+          iface->object_path, iface->introspection_data->interfaces[0]->name,
+          signal_name, parameters, &error)) {
+    g_printerr ("Unable to emit %s on %s: %s\n", signal_name,
+        iface->object_path, error->message);
+    g_error_free (error);
+  }
+  g_variant_unref (parameters);
+}
@@ -27,6 +27,8 @@
 #include <gio/gio.h>
 #include <glib-2.0/glib.h>
 
+#define GPOP_DBUS_INTERFACE_NAME "org.gpop.GPOPInterface"
+
 #define GPOP_TYPE_DBUS_INTERFACE    (gpop_dbus_interface_get_type())
 #define GPOP_DBUS_INTERFACE(obj)            (G_TYPE_CHECK_INSTANCE_CAST((obj),\
                                               GPOP_TYPE_DBUS_INTERFACE, GPOPDBusInterface))
@@ -64,4 +66,7 @@ GType gpop_dbus_interface_get_type (void);
 
 gboolean gpop_dbus_interface_register (GPOPDBusInterface * iface, const gchar* object_path, const gchar* xml_introspection, GDBusConnection * connection);
 
+void gpop_dbus_interface_emit_property_changed (GPOPDBusInterface * iface, const gchar * property_name, GVariant * value);
+void gpop_dbus_interface_emit_signal (GPOPDBusInterface * iface, const gchar * signal_name, GVariant * parameters);
+
 #endif /* _GPOP_DBUS_INTERFACE_H_ */
@@ -0,0 +1,443 @@
+/*
+ * GStreamer Prince of Parser
+ *
+ * Copyright (C) 2020 Stéphane Cerveau
+ *
+ * SPDX-License-Identifier: LGPL
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation
+ * version 2.1 of the License.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301 USA
+ *
+ */
+
+#include "gpop-private.h"
+
+typedef struct
+{
+  gchar *key;
+  GstElement *element;
+} GPOPPooledElement;
+
+typedef struct
+{
+  GstPad *pad;
+  GstPad *peer;
+  /* of the replaced element, relinked if the swap fails */
+  GstPad *original;
+} GPOPPadLink;
+
+/* Pipelines are built and torn down from several threads on reload */
+static GMutex pool_lock;
+static guint pool_size = 0;
+/* GPOPPooledElement, least recently released first */
+static GQueue pool = G_QUEUE_INIT;
+static guint64 pool_hits = 0;
+static guint64 pool_misses = 0;
+static guint64 pool_evictions = 0;
+
+static void
+gpop_pooled_element_free (GPOPPooledElement * pooled)
+{
+  gst_element_set_state (pooled->element, GST_STATE_NULL);
+  gst_object_unref (pooled->element);
+  g_free (pooled->key);
+  g_free (pooled);
+}
+
+static gboolean
+gpop_element_pool_is_poolable (GstElement * element)
+{
+  GstElementFactory *factory = gst_element_get_factory (element);
+  const GList *l;
+
+  if (!factory || GST_IS_BIN (element))
+    return FALSE;
+  if (!gst_element_factory_list_is_type (factory,
+          GST_ELEMENT_FACTORY_TYPE_ENCODER)
+      && !gst_element_factory_list_is_type (factory,
+          GST_ELEMENT_FACTORY_TYPE_MUXER))
+    return FALSE;
+
+  /* Links to sometimes pads are made later from pad-added, they can not be
+   * moved to another instance. */
+  for (l = gst_element_factory_get_static_pad_templates (factory); l;
+      l = g_list_next (l)) {
+    GstStaticPadTemplate *templ = l->data;
+    if (templ->presence == GST_PAD_SOMETIMES)
+      return FALSE;
+  }
+  return TRUE;
+}
+
+/* Factory name and non default properties, NULL if a property can not be
+ * serialized. */
+static gchar *
+gpop_element_pool_get_key (GstElement * element)
+{
+  GString *key =
+      g_string_new (GST_OBJECT_NAME (gst_element_get_factory (element)));
+  GParamSpec **specs;
+  guint i, n_specs;
+  gboolean valid = TRUE;
+
+  specs = g_object_class_list_properties (G_OBJECT_GET_CLASS (element),
+      &n_specs);
+  for (i = 0; i < n_specs && valid; i++) {
+    GParamSpec *spec = specs[i];
+    GValue value = G_VALUE_INIT;
+    gchar *serialized;
+
+    if ((spec->flags & G_PARAM_READWRITE) != G_PARAM_READWRITE
+        || !g_strcmp0 (spec->name, "name")
+        || !g_strcmp0 (spec->name, "parent"))
+      continue;
+
+    g_value_init (&value, spec->value_type);
+    g_object_get_property (G_OBJECT (element), spec->name, &value);
+    if (!g_param_value_defaults (spec, &value)) {
+      serialized = gst_value_serialize (&value);
+      if (serialized)
+        g_string_append_printf (key, " %s=%s", spec->name, serialized);
+      else
+        valid = FALSE;
+      g_free (serialized);
+    }
+    g_value_unset (&value);
+  }
+  g_free (specs);
+
+  if (!valid) {
+    g_string_free (key, TRUE);
+    return NULL;
+  }
+  return g_string_free (key, FALSE);
+}
+
+static GstElement *
+gpop_element_pool_take (const gchar * key)
+{
+  GList *l;
+
+  for (l = pool.tail; l; l = l->prev) {
+    GPOPPooledElement *pooled = l->data;
+    if (!g_strcmp0 (pooled->key, key)) {
+      GstElement *element = pooled->element;
+      g_queue_delete_link (&pool, l);
+      g_free (pooled->key);
+      g_free (pooled);
+      return element;
+    }
+  }
+  return NULL;
+}
+
+static void
+gpop_element_pool_release_request_pads (GstElement * element)
+{
+  GList *l, *pads;
+
+  GST_OBJECT_LOCK (element);
+  pads = g_list_copy_deep (element->pads, (GCopyFunc) gst_object_ref, NULL);
+  GST_OBJECT_UNLOCK (element);
+
+  for (l = pads; l; l = g_list_next (l)) {
+    GstPadTemplate *templ = GST_PAD_PAD_TEMPLATE (l->data);
+    if (templ && GST_PAD_TEMPLATE_PRESENCE (templ) == GST_PAD_REQUEST)
+      gst_element_release_request_pad (element, l->data);
+  }
+  g_list_free_full (pads, gst_object_unref);
+}
+
+/* Gets the pads of the pooled element matching the linked pads of element */
+static GList *
+gpop_element_pool_match_pads (GstElement * element, GstElement * pooled)
+{
+  GList *l, *pads, *links = NULL;
+  gboolean matched = TRUE;
+
+  GST_OBJECT_LOCK (element);
+  pads = g_list_copy_deep (element->pads, (GCopyFunc) gst_object_ref, NULL);
+  GST_OBJECT_UNLOCK (element);
+
+  for (l = pads; l && matched; l = g_list_next (l)) {
+    GstPad *pad = l->data;
+    GstPadTemplate *templ = GST_PAD_PAD_TEMPLATE (pad);
+    GPOPPadLink *link;
+    GstPad *peer = gst_pad_get_peer (pad);
+
+    if (!peer)
+      continue;
+
+    link = g_new0 (GPOPPadLink, 1);
+    link->peer = peer;
+    link->original = gst_object_ref (pad);
+    if (templ && GST_PAD_TEMPLATE_PRESENCE (templ) == GST_PAD_REQUEST)
+      link->pad = gst_element_request_pad (pooled,
+          gst_element_get_pad_template (pooled,
+              GST_PAD_TEMPLATE_NAME_TEMPLATE (templ)), GST_PAD_NAME (pad),
+          NULL);
+    else
+      link->pad = gst_element_get_static_pad (pooled, GST_PAD_NAME (pad));
+    links = g_list_prepend (links, link);
+    matched = link->pad != NULL;
+  }
+  g_list_free_full (pads, gst_object_unref);
+
+  if (!matched) {
+    for (l = links; l; l = g_list_next (l)) {
+      GPOPPadLink *link = l->data;
+      g_clear_object (&link->pad);
+      gst_object_unref (link->peer);
+      gst_object_unref (link->original);
+      g_free (link);
+    }
+    g_list_free (links);
+    gpop_element_pool_release_request_pads (pooled);
+    return NULL;
+  }
+  return links;
+}
+
+static GstPadLinkReturn
+gpop_element_pool_link (GstPad * pad, GstPad * peer)
+{
+  if (GST_PAD_IS_SRC (pad))
+    return gst_pad_link (pad, peer);
+  return gst_pad_link (peer, pad);
+}
+
+/* Replaces element by pooled in its bin, keeping its name and links. If
+ * pooled can not be linked, element is put back as it was. */
+static gboolean
+gpop_element_pool_swap (GstElement * element, GstElement * pooled)
+{
+  GstBin *bin = GST_BIN (GST_OBJECT_PARENT (element));
+  GList *l, *links = gpop_element_pool_match_pads (element, pooled);
+  GstPadLinkReturn ret = GST_PAD_LINK_OK;
+  gchar *name;
+
+  if (!links)
+    return FALSE;
+
+  /* the bin drops its reference on removal */
+  gst_object_ref (element);
+  name = gst_object_get_name (GST_OBJECT (element));
+  gst_bin_remove (bin, element);
+  gst_object_set_name (GST_OBJECT (pooled), name);
+  g_free (name);
+  gst_bin_add (bin, pooled);
+
+  for (l = links; l && ret == GST_PAD_LINK_OK; l = g_list_next (l)) {
+    GPOPPadLink *link = l->data;
+
+    ret = gpop_element_pool_link (link->pad, link->peer);
+  }
+
+  if (ret != GST_PAD_LINK_OK) {
+    GPOP_LOG ("Unable to link the pooled %s: %s", GST_OBJECT_NAME (pooled),
+        gst_pad_link_get_name (ret));
+    /* unlinks its pads */
+    gst_bin_remove (bin, pooled);
+    gpop_element_pool_release_request_pads (pooled);
+    gst_bin_add (bin, element);
+    for (l = links; l; l = g_list_next (l)) {
+      GPOPPadLink *link = l->data;
+
+      if (gpop_element_pool_link (link->original, link->peer)
+          != GST_PAD_LINK_OK)
+        GPOP_LOG ("Unable to link back %s:%s",
+            GST_DEBUG_PAD_NAME (link->original));
+    }
+  }
+
+  for (l = links; l; l = g_list_next (l)) {
+    GPOPPadLink *link = l->data;
+
+    gst_object_unref (link->pad);
+    gst_object_unref (link->peer);
+    gst_object_unref (link->original);
+    g_free (link);
+  }
+  g_list_free (links);
+  gst_object_unref (element);
+
+  return ret == GST_PAD_LINK_OK;
+}
+
+static GList *
+gpop_element_pool_list_poolable (GstElement * pipeline)
+{
+  GstIterator *it;
+  GValue item = G_VALUE_INIT;
+  GList *elements = NULL;
+
+  if (!GST_IS_BIN (pipeline))
+    return NULL;
+
+  it = gst_bin_iterate_recurse (GST_BIN (pipeline));
+  while (gst_iterator_next (it, &item) == GST_ITERATOR_OK) {
+    GstElement *element = g_value_get_object (&item);
+    if (gpop_element_pool_is_poolable (element))
+      elements = g_list_prepend (elements, gst_object_ref (element));
+    g_value_reset (&item);
+  }
+  g_value_unset (&item);
+  gst_iterator_free (it);
+
+  return elements;
+}
+
+/* API */
+
+/* Maximum number of pooled elements, 0 disables and empties the pool */
+void
+gpop_element_pool_configure (guint size)
+{
+  g_mutex_lock (&pool_lock);
+  pool_size = size;
+  while (pool.length > pool_size) {
+    gpop_pooled_element_free (g_queue_pop_head (&pool));
+    pool_evictions++;
+  }
+  g_mutex_unlock (&pool_lock);
+}
+
+/* Swaps pooled elements in the newly parsed pipeline, returns their number */
+guint
+gpop_element_pool_acquire (GstElement * pipeline)
+{
+  GList *l, *elements;
+  guint acquired = 0;
+
+  if (!pool_size)
+    return 0;
+
+  elements = gpop_element_pool_list_poolable (pipeline);
+  for (l = elements; l; l = g_list_next (l)) {
+    GstElement *pooled;
+    gchar *key = gpop_element_pool_get_key (l->data);
+
+    g_mutex_lock (&pool_lock);
+    pooled = key ? gpop_element_pool_take (key) : NULL;
+    g_mutex_unlock (&pool_lock);
+    if (pooled && gpop_element_pool_swap (l->data, pooled)) {
+      /* held by its bin now */
+      gst_object_unref (pooled);
+      g_mutex_lock (&pool_lock);
+      pool_hits++;
+      g_mutex_unlock (&pool_lock);
+      acquired++;
+    } else {
+      g_mutex_lock (&pool_lock);
+      pool_misses++;
+      g_mutex_unlock (&pool_lock);
+      if (pooled) {
+        gst_element_set_state (pooled, GST_STATE_NULL);
+        gst_object_unref (pooled);
+      }
+    }
+    g_free (key);
+  }
+  g_list_free_full (elements, gst_object_unref);
+
+  return acquired;
+}
+
+/* To be called before setting the pipeline to NULL: brings it to READY and
+ * locks the state of the poolable elements so that they stay in READY. */
+GList *
+gpop_element_pool_reclaim (GstElement * pipeline)
+{
+  GList *l, *elements;
+
+  if (!pool_size)
+    return NULL;
+
+  if (gst_element_set_state (pipeline,
+          GST_STATE_READY) == GST_STATE_CHANGE_FAILURE)
+    return NULL;
+
+  elements = gpop_element_pool_list_poolable (pipeline);
+  for (l = elements; l; l = g_list_next (l)) {
+    if (GST_STATE (l->data) == GST_STATE_READY)
+      gst_element_set_locked_state (l->data, TRUE);
+  }
+  return elements;
+}
+
+/* To be called once the pipeline is in NULL, moves the reclaimed elements
+ * from their bin to the pool. */
+void
+gpop_element_pool_release (GList * elements)
+{
+  GList *l;
+
+  for (l = elements; l; l = g_list_next (l)) {
+    GstElement *element = l->data;
+    GstObject *parent = gst_object_get_parent (GST_OBJECT (element));
+    GPOPPooledElement *pooled;
+    gchar *key;
+
+    if (!gst_element_is_locked_state (element)) {
+      g_clear_object (&parent);
+      continue;
+    }
+    gst_element_set_locked_state (element, FALSE);
+
+    gpop_element_pool_release_request_pads (element);
+    if (parent) {
+      gst_bin_remove (GST_BIN (parent), element);
+      gst_object_unref (parent);
+    }
+    key = gpop_element_pool_get_key (element);
+    if (!key) {
+      gst_element_set_state (element, GST_STATE_NULL);
+      continue;
+    }
+
+    pooled = g_new (GPOPPooledElement, 1);
+    pooled->key = key;
+    pooled->element = gst_object_ref (element);
+    g_mutex_lock (&pool_lock);
+    g_queue_push_tail (&pool, pooled);
+    g_mutex_unlock (&pool_lock);
+  }
+  g_list_free_full (elements, gst_object_unref);
+
+  g_mutex_lock (&pool_lock);
+  while (pool.length > pool_size) {
+    gpop_pooled_element_free (g_queue_pop_head (&pool));
+    pool_evictions++;
+  }
+  g_mutex_unlock (&pool_lock);
+}
+
+void
+gpop_element_pool_append_metrics (GString * metrics)
+{
+  g_mutex_lock (&pool_lock);
+  g_string_append_printf (metrics,
+      "# TYPE gpop_element_pool_elements gauge\n"
+      "gpop_element_pool_elements %u\n"
+      "# TYPE gpop_element_pool_size gauge\n"
+      "gpop_element_pool_size %u\n"
+      "# TYPE gpop_element_pool_hits_total counter\n"
+      "gpop_element_pool_hits_total %" G_GUINT64_FORMAT "\n"
+      "# TYPE gpop_element_pool_misses_total counter\n"
+      "gpop_element_pool_misses_total %" G_GUINT64_FORMAT "\n"
+      "# TYPE gpop_element_pool_evictions_total counter\n"
+      "gpop_element_pool_evictions_total %" G_GUINT64_FORMAT "\n",
+      pool.length, pool_size, pool_hits, pool_misses, pool_evictions);
+  g_mutex_unlock (&pool_lock);
+}
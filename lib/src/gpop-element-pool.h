@@ -0,0 +1,45 @@
+/*
+ * GStreamer Prince of Parser
+ *
+ * Copyright (C) 2020 Stéphane Cerveau
+ *
+ * SPDX-License-Identifier: LGPL
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation
+ * version 2.1 of the License.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301 USA
+ *
+ */
+
+#ifndef _GPOP_ELEMENT_POOL_H_
+#define _GPOP_ELEMENT_POOL_H_
+
+#include <gst/gst.h>
+
+/* Reuse of the encoders and muxers across pipeline rebuilds.
+ *
+ * When a pipeline is destroyed, its encoders and muxers are kept in READY,
+ * so without going through their NULL to READY setup again, and are keyed
+ * by factory and non default properties. A pipeline built later for the
+ * same configuration gets them swapped in place of the freshly parsed
+ * elements. The pool is disabled until given a size. */
+
+void gpop_element_pool_configure (guint size);
+
+guint gpop_element_pool_acquire (GstElement * pipeline);
+GList * gpop_element_pool_reclaim (GstElement * pipeline);
+void gpop_element_pool_release (GList * elements);
+
+void gpop_element_pool_append_metrics (GString * metrics);
+
+#endif /* _GPOP_ELEMENT_POOL_H_ */
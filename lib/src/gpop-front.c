@@ -0,0 +1,1968 @@
+/*
+ * GStreamer Prince of Parser
+ *
+ * Copyright (C) 2020 Stéphane Cerveau
+ *
+ * SPDX-License-Identifier: LGPL
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation
+ * version 2.1 of the License.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301 USA
+ *
+ */
+
+#ifdef __linux__
+#ifndef _GNU_SOURCE
+#define _GNU_SOURCE
+#endif
+#include <sched.h>
+#endif
+#include <signal.h>
+#include <string.h>
+
+#include "gpop-private.h"
+
+G_DEFINE_TYPE (GPOPFront, gpop_front, GPOP_TYPE_DBUS_INTERFACE);
+
+typedef struct
+{
+  GPOPFront *front;
+  guint index;
+  /* org.gpop.worker<index> and its unique name, NULL while it has no owner */
+  gchar *name;
+  gchar *owner;
+  guint watch_id;
+  guint signal_id;
+  GSubprocess *process;
+  guint n_spawns;
+  guint restart_id;
+#ifdef __linux__
+  cpu_set_t cpus;
+#endif
+  gchar *cpus_name;
+  GPOPPressureLevel pressure;
+  guint n_pipelines;
+  guint n_playing;
+  /* pipelines being added */
+  guint n_placing;
+} GPOPFrontWorker;
+
+/* Proxy of a pipeline of a worker, every call is forwarded. The id and
+ * object path seen by the clients are those of the pipeline on its first
+ * worker, they are kept when the pipeline migrates. */
+typedef struct
+{
+  GPOPDBusInterface base;
+  GPOPFrontWorker *worker;
+  gchar *id;
+  gchar *remote_id;
+  gchar *remote_path;
+  gboolean playing;
+  gboolean migrating;
+} GPOPFrontPipeline;
+
+typedef struct
+{
+  GPOPDBusInterfaceClass base;
+} GPOPFrontPipelineClass;
+
+GType gpop_front_pipeline_get_type (void);
+G_DEFINE_TYPE (GPOPFrontPipeline, gpop_front_pipeline,
+    GPOP_TYPE_DBUS_INTERFACE);
+
+/* A Manager request, replied once the requests forwarded to the workers
+ * are */
+typedef struct
+{
+  GPOPFront *front;
+  GDBusMethodInvocation *invocation;
+  gchar *method_name;
+  GVariant *parameters;
+  /* set for the <Method>WithKey variants */
+  gchar *request_id;
+  /* GPOPFrontRequest */
+  GPtrArray *requests;
+  guint n_pending;
+} GPOPFrontCall;
+
+typedef struct
+{
+  GPOPFrontCall *call;
+  /* NULL for an unknown pipeline, the request is not sent */
+  GPOPFrontWorker *worker;
+  GVariant *reply;
+  GError *error;
+} GPOPFrontRequest;
+
+static void gpop_front_spawn (GPOPFrontWorker * worker);
+static void gpop_front_on_migration_properties (GPOPFront * front,
+    GPOPFrontWorker * worker, const gchar * path, GVariant * parameters);
+
+/* Returns the error of a worker as is to the client */
+static void
+gpop_front_return_error (GDBusMethodInvocation * invocation, GError * error)
+{
+  gchar *name = g_dbus_error_get_remote_error (error);
+
+  if (name) {
+    g_dbus_error_strip_remote_error (error);
+    g_dbus_method_invocation_return_dbus_error (invocation, name,
+        error->message);
+    g_free (name);
+  } else {
+    g_dbus_method_invocation_return_gerror (invocation, error);
+  }
+}
+
+static void
+gpop_front_on_forwarded (GObject * source, GAsyncResult * res,
+    gpointer user_data)
+{
+  GDBusMethodInvocation *invocation = (GDBusMethodInvocation *) user_data;
+  GError *error = NULL;
+  GVariant *ret;
+
+  ret = g_dbus_connection_call_finish (G_DBUS_CONNECTION (source), res,
+      &error);
+  if (ret) {
+    g_dbus_method_invocation_return_value (invocation, ret);
+    g_variant_unref (ret);
+  } else {
+    gpop_front_return_error (invocation, error);
+    g_error_free (error);
+  }
+}
+
+static void
+gpop_front_on_forwarded_all (GObject * source, GAsyncResult * res,
+    gpointer user_data)
+{
+  GDBusMethodInvocation *invocation = (GDBusMethodInvocation *) user_data;
+  const gchar *id = g_object_get_data (G_OBJECT (invocation), "gpop-id");
+  GVariantBuilder builder;
+  GError *error = NULL;
+  GVariantIter *iter;
+  const gchar *name;
+  GVariant *ret, *value;
+
+  ret = g_dbus_connection_call_finish (G_DBUS_CONNECTION (source), res,
+      &error);
+  if (!ret) {
+    gpop_front_return_error (invocation, error);
+    g_error_free (error);
+    return;
+  }
+
+  g_variant_builder_init (&builder, G_VARIANT_TYPE ("a{sv}"));
+  g_variant_get (ret, "(a{sv})", &iter);
+  while (g_variant_iter_loop (iter, "{&sv}", &name, &value))
+    g_variant_builder_add (&builder, "{sv}", name,
+        g_strcmp0 (name, "id") ? value : g_variant_new_string (id));
+  g_variant_iter_free (iter);
+  g_variant_unref (ret);
+  g_dbus_method_invocation_return_value (invocation,
+      g_variant_new ("(a{sv})", &builder));
+}
+
+/* ---------------------------------------------------------------------------------------------------- */
+
+static void
+gpop_front_notify_pipelines (GPOPFront * front)
+{
+  gpop_dbus_interface_emit_property_changed (GPOP_DBUS_INTERFACE (front),
+      "Pipelines", g_variant_new ("i", g_list_length (front->pipelines)));
+}
+
+static GPOPFrontPipeline *
+gpop_front_get_pipeline_by_id (GPOPFront * front, const gchar * id)
+{
+  GList *l;
+
+  for (l = front->pipelines; l != NULL; l = g_list_next (l)) {
+    GPOPFrontPipeline *pipeline = (GPOPFrontPipeline *) l->data;
+    if (!g_strcmp0 (pipeline->id, id))
+      return pipeline;
+  }
+  return NULL;
+}
+
+static GPOPFrontPipeline *
+gpop_front_get_pipeline_by_remote (GPOPFront * front,
+    GPOPFrontWorker * worker, const gchar * remote_path)
+{
+  GList *l;
+
+  for (l = front->pipelines; l != NULL; l = g_list_next (l)) {
+    GPOPFrontPipeline *pipeline = (GPOPFrontPipeline *) l->data;
+    if (pipeline->worker == worker
+        && !g_strcmp0 (pipeline->remote_path, remote_path))
+      return pipeline;
+  }
+  return NULL;
+}
+
+static GPOPFrontPipeline *
+gpop_front_get_pipeline_by_remote_id (GPOPFront * front,
+    GPOPFrontWorker * worker, const gchar * remote_id)
+{
+  GList *l;
+
+  for (l = front->pipelines; l != NULL; l = g_list_next (l)) {
+    GPOPFrontPipeline *pipeline = (GPOPFrontPipeline *) l->data;
+    if (pipeline->worker == worker
+        && !g_strcmp0 (pipeline->remote_id, remote_id))
+      return pipeline;
+  }
+  return NULL;
+}
+
+static void
+gpop_front_pipeline_set_playing (GPOPFrontPipeline * pipeline,
+    gboolean playing)
+{
+  if (!pipeline->worker || pipeline->playing == playing)
+    return;
+
+  pipeline->playing = playing;
+  if (playing)
+    pipeline->worker->n_playing++;
+  else
+    pipeline->worker->n_playing--;
+}
+
+static void
+gpop_front_on_pipeline_streaming (GObject * source, GAsyncResult * res,
+    gpointer user_data)
+{
+  GPOPFrontPipeline *pipeline = (GPOPFrontPipeline *) user_data;
+  GVariant *ret, *value;
+
+  ret = g_dbus_connection_call_finish (G_DBUS_CONNECTION (source), res, NULL);
+  if (ret) {
+    g_variant_get (ret, "(v)", &value);
+    if (g_variant_is_of_type (value, G_VARIANT_TYPE_BOOLEAN))
+      gpop_front_pipeline_set_playing (pipeline,
+          g_variant_get_boolean (value));
+    g_variant_unref (value);
+    g_variant_unref (ret);
+  }
+  g_object_unref (pipeline);
+}
+
+static gboolean
+gpop_front_is_taken (GPOPFront * front, const gchar * id, const gchar * path)
+{
+  GList *l;
+
+  for (l = front->pipelines; l != NULL; l = g_list_next (l)) {
+    GPOPFrontPipeline *pipeline = (GPOPFrontPipeline *) l->data;
+    if (!g_strcmp0 (pipeline->id, id)
+        || !g_strcmp0 (pipeline->base.object_path, path))
+      return TRUE;
+  }
+  return FALSE;
+}
+
+/* Removes the pipeline remote_id from worker, without waiting for it */
+static void
+gpop_front_drop_remote (GPOPFront * front, GPOPFrontWorker * worker,
+    const gchar * remote_id)
+{
+  if (!*remote_id || !worker->owner)
+    return;
+  g_dbus_connection_call (front->base.connection, worker->owner,
+      GPOP_MANAGER_OBJECT_PATH, GPOP_DBUS_INTERFACE_NAME, "RemovePipeline",
+      g_variant_new ("(s)", remote_id), NULL, G_DBUS_CALL_FLAGS_NO_AUTO_START,
+      -1, NULL, NULL, NULL);
+}
+
+/* Proxies the pipeline remote_id of worker, under its own id and path
+ * unless they are taken by a migrated pipeline, returns the proxy or NULL
+ * on error */
+static GPOPFrontPipeline *
+gpop_front_add_pipeline (GPOPFront * front, GPOPFrontWorker * worker,
+    const gchar * remote_id, const gchar * remote_path)
+{
+  GPOPFrontPipeline *pipeline;
+  gchar *id, *path;
+
+  if (!*remote_id)
+    return NULL;
+  pipeline = gpop_front_get_pipeline_by_remote (front, worker, remote_path);
+  if (pipeline)
+    return pipeline;
+
+  if (gpop_front_is_taken (front, remote_id, remote_path)) {
+    id = g_strdup_printf (GPOP_PIPELINE_ID, front->next_num);
+    path = g_strdup_printf (GPOP_PIPELINE_OBJECT_PATH, front->next_num);
+    front->next_num++;
+    GPOP_LOG ("The pipeline %s of the worker %u is proxied as %s",
+        remote_id, worker->index, id);
+  } else {
+    id = g_strdup (remote_id);
+    path = g_strdup (remote_path);
+  }
+
+  pipeline = g_object_new (gpop_front_pipeline_get_type (), NULL);
+  if (!gpop_dbus_interface_register (GPOP_DBUS_INTERFACE (pipeline), path,
+          gpop_pipeline_xml_introspection, front->base.connection)) {
+    GPOP_LOG ("Unable to proxy the pipeline %s at %s", id, path);
+    g_object_unref (pipeline);
+    g_free (id);
+    g_free (path);
+    return NULL;
+  }
+  g_free (path);
+  pipeline->worker = worker;
+  pipeline->id = id;
+  pipeline->remote_id = g_strdup (remote_id);
+  pipeline->remote_path = g_strdup (remote_path);
+  worker->n_pipelines++;
+  front->pipelines = g_list_append (front->pipelines, pipeline);
+  gpop_front_notify_pipelines (front);
+
+  /* it may have started streaming before the front knew it */
+  g_dbus_connection_call (front->base.connection, worker->owner, remote_path,
+      "org.freedesktop.DBus.Properties", "Get", g_variant_new ("(ss)",
+          GPOP_DBUS_INTERFACE_NAME, "streaming"), G_VARIANT_TYPE ("(v)"),
+      G_DBUS_CALL_FLAGS_NO_AUTO_START, -1, NULL,
+      gpop_front_on_pipeline_streaming, g_object_ref (pipeline));
+
+  return pipeline;
+}
+
+static void
+gpop_front_remove_pipeline (GPOPFront * front, GPOPFrontPipeline * pipeline)
+{
+  front->pipelines = g_list_remove (front->pipelines, pipeline);
+  gpop_front_pipeline_set_playing (pipeline, FALSE);
+  pipeline->worker->n_pipelines--;
+  pipeline->worker = NULL;
+  /* unregistered even if a pending call still holds it */
+  g_object_run_dispose (G_OBJECT (pipeline));
+  g_object_unref (pipeline);
+}
+
+/* ---------------------------------------------------------------------------------------------------- */
+
+static void
+gpop_front_update_pressure (GPOPFront * front)
+{
+  GPOPPressureLevel pressure = GPOP_PRESSURE_NONE;
+  guint i;
+
+  for (i = 0; i < front->workers->len; i++) {
+    GPOPFrontWorker *worker = g_ptr_array_index (front->workers, i);
+    pressure = MAX (pressure, worker->pressure);
+  }
+  if (pressure == front->pressure)
+    return;
+
+  front->pressure = pressure;
+  gpop_dbus_interface_emit_property_changed (GPOP_DBUS_INTERFACE (front),
+      "Pressure", g_variant_new ("s", gpop_pressure_level_get_name (pressure)));
+}
+
+/* The least loaded worker but exclude, NULL if none is available */
+static GPOPFrontWorker *
+gpop_front_pick_worker (GPOPFront * front, GPOPFrontWorker * exclude)
+{
+  GPOPFrontWorker *best = NULL;
+  guint i;
+
+  for (i = 0; i < front->workers->len; i++) {
+    GPOPFrontWorker *worker = g_ptr_array_index (front->workers, i);
+
+    if (!worker->owner || worker == exclude)
+      continue;
+    if (!best || worker->pressure < best->pressure
+        || (worker->pressure == best->pressure
+            && (worker->n_playing < best->n_playing
+                || (worker->n_playing == best->n_playing
+                    && worker->n_pipelines + worker->n_placing <
+                    best->n_pipelines + best->n_placing))))
+      best = worker;
+  }
+  return best;
+}
+
+static void
+gpop_front_on_worker_properties (GPOPFrontWorker * worker,
+    GVariant * parameters)
+{
+  GVariant *changed = g_variant_get_child_value (parameters, 1);
+  const gchar *name;
+  guint level;
+
+  if (g_variant_lookup (changed, "Pressure", "&s", &name)) {
+    for (level = GPOP_PRESSURE_NONE; level < GPOP_PRESSURE_LAST; level++) {
+      if (!g_strcmp0 (name, gpop_pressure_level_get_name (level)))
+        worker->pressure = level;
+    }
+    gpop_front_update_pressure (worker->front);
+  }
+  g_variant_unref (changed);
+}
+
+/* The Manager signals of a worker name the pipelines by their id on the
+ * worker, which differs from the one of the front once migrated */
+static GVariant *
+gpop_front_translate_signal (GPOPFront * front, GPOPFrontWorker * worker,
+    const gchar * signal_name, GVariant * parameters)
+{
+  GPOPFrontPipeline *pipeline = NULL;
+  GVariant **children, *child, *ret;
+  gsize i, index, n = g_variant_n_children (parameters);
+
+  if (!g_strcmp0 (signal_name, "LoadShed"))
+    index = 2;
+  else if (!g_strcmp0 (signal_name, "SloViolated")
+      || !g_strcmp0 (signal_name, "SloRecovered"))
+    index = 0;
+  else
+    return g_variant_ref (parameters);
+
+  if (index < n) {
+    child = g_variant_get_child_value (parameters, index);
+    if (g_variant_is_of_type (child, G_VARIANT_TYPE_STRING))
+      pipeline = gpop_front_get_pipeline_by_remote_id (front, worker,
+          g_variant_get_string (child, NULL));
+    g_variant_unref (child);
+  }
+  if (!pipeline || !g_strcmp0 (pipeline->id, pipeline->remote_id))
+    return g_variant_ref (parameters);
+
+  children = g_new (GVariant *, n);
+  for (i = 0; i < n; i++)
+    children[i] = i == index ? g_variant_ref_sink (g_variant_new_string
+        (pipeline->id)) : g_variant_get_child_value (parameters, i);
+  ret = g_variant_ref_sink (g_variant_new_tuple (children, n));
+  for (i = 0; i < n; i++)
+    g_variant_unref (children[i]);
+  g_free (children);
+
+  return ret;
+}
+
+/* Relays the signals of the workers: those of their Manager as the signals
+ * of the front, those of their pipelines as is */
+static void
+gpop_front_on_worker_signal (GDBusConnection * connection,
+    const gchar * sender_name, const gchar * object_path,
+    const gchar * interface_name, const gchar * signal_name,
+    GVariant * parameters, gpointer user_data)
+{
+  GPOPFrontWorker *worker = (GPOPFrontWorker *) user_data;
+  GPOPFront *front = worker->front;
+  GPOPFrontPipeline *pipeline;
+  GVariant *translated;
+  gboolean properties_changed =
+      !g_strcmp0 (interface_name, "org.freedesktop.DBus.Properties")
+      && !g_strcmp0 (signal_name, "PropertiesChanged");
+
+  if (!g_strcmp0 (object_path, GPOP_MANAGER_OBJECT_PATH)) {
+    if (properties_changed) {
+      gpop_front_on_worker_properties (worker, parameters);
+    } else {
+      translated = gpop_front_translate_signal (front, worker, signal_name,
+          parameters);
+      gpop_dbus_interface_emit_signal (GPOP_DBUS_INTERFACE (front),
+          signal_name, translated);
+      g_variant_unref (translated);
+    }
+    return;
+  }
+
+  if (properties_changed)
+    gpop_front_on_migration_properties (front, worker, object_path,
+        parameters);
+
+  pipeline = gpop_front_get_pipeline_by_remote (front, worker, object_path);
+  if (properties_changed && pipeline) {
+    GVariant *changed = g_variant_get_child_value (parameters, 1);
+    gboolean streaming;
+
+    if (g_variant_lookup (changed, "streaming", "b", &streaming))
+      gpop_front_pipeline_set_playing (pipeline, streaming);
+    g_variant_unref (changed);
+  }
+  g_dbus_connection_emit_signal (connection, NULL,
+      pipeline ? pipeline->base.object_path : object_path, interface_name,
+      signal_name, parameters, NULL);
+}
+
+static void
+gpop_front_on_worker_pipelines (GObject * source, GAsyncResult * res,
+    gpointer user_data)
+{
+  GPOPFrontWorker *worker = (GPOPFrontWorker *) user_data;
+  GError *error = NULL;
+  const gchar *id, *path;
+  GVariantIter *iter;
+  GVariant *ret;
+
+  ret = g_dbus_connection_call_finish (G_DBUS_CONNECTION (source), res,
+      &error);
+  if (!ret) {
+    /* the front is shutting down */
+    if (!g_error_matches (error, G_IO_ERROR, G_IO_ERROR_CANCELLED))
+      GPOP_LOG ("Unable to list the pipelines of the worker %u: %s",
+          worker->index, error->message);
+    g_error_free (error);
+    return;
+  }
+
+  g_variant_get (ret, "(a(so))", &iter);
+  while (g_variant_iter_loop (iter, "(&s&o)", &id, &path))
+    gpop_front_add_pipeline (worker->front, worker, id, path);
+  g_variant_iter_free (iter);
+  g_variant_unref (ret);
+}
+
+static void
+gpop_front_on_worker_appeared (GDBusConnection * connection,
+    const gchar * name, const gchar * name_owner, gpointer user_data)
+{
+  GPOPFrontWorker *worker = (GPOPFrontWorker *) user_data;
+
+  GPOP_LOG ("The worker %u is available as %s", worker->index, name_owner);
+  g_free (worker->owner);
+  worker->owner = g_strdup (name_owner);
+
+  /* an attached worker may already run pipelines */
+  g_dbus_connection_call (connection, worker->owner, GPOP_MANAGER_OBJECT_PATH,
+      GPOP_DBUS_INTERFACE_NAME, "ListPipelines", NULL,
+      G_VARIANT_TYPE ("(a(so))"), G_DBUS_CALL_FLAGS_NO_AUTO_START, -1,
+      worker->front->cancellable, gpop_front_on_worker_pipelines, worker);
+}
+
+static gboolean
+gpop_front_on_restart (gpointer user_data)
+{
+  GPOPFrontWorker *worker = (GPOPFrontWorker *) user_data;
+
+  worker->restart_id = 0;
+  if (!worker->owner && !worker->process)
+    gpop_front_spawn (worker);
+  return G_SOURCE_REMOVE;
+}
+
+static void
+gpop_front_schedule_restart (GPOPFrontWorker * worker)
+{
+  if (worker->front->stopping || worker->restart_id)
+    return;
+
+  worker->restart_id = g_timeout_add_seconds (GPOP_FRONT_RESTART_SECONDS,
+      gpop_front_on_restart, worker);
+}
+
+static void
+gpop_front_on_worker_vanished (GDBusConnection * connection,
+    const gchar * name, gpointer user_data)
+{
+  GPOPFrontWorker *worker = (GPOPFrontWorker *) user_data;
+  GPOPFront *front = worker->front;
+  GList *l, *next;
+
+  if (worker->owner) {
+    GPOP_LOG ("Lost the worker %u and its %u pipelines", worker->index,
+        worker->n_pipelines);
+    g_clear_pointer (&worker->owner, g_free);
+    for (l = front->pipelines; l; l = next) {
+      next = g_list_next (l);
+      if (((GPOPFrontPipeline *) l->data)->worker == worker)
+        gpop_front_remove_pipeline (front, l->data);
+    }
+    gpop_front_notify_pipelines (front);
+    worker->pressure = GPOP_PRESSURE_NONE;
+    gpop_front_update_pressure (front);
+  }
+
+  /* a spawned worker is restarted once it exited */
+  if (worker->process || front->stopping)
+    return;
+  if (worker->n_spawns)
+    gpop_front_schedule_restart (worker);
+  else
+    gpop_front_spawn (worker);
+}
+
+static void
+gpop_front_on_worker_exit (GObject * source, GAsyncResult * res,
+    gpointer user_data)
+{
+  GPOPFrontWorker *worker = (GPOPFrontWorker *) user_data;
+  GSubprocess *process = G_SUBPROCESS (source);
+  GError *error = NULL;
+
+  if (!g_subprocess_wait_finish (process, res, &error)) {
+    /* the front is shutting down */
+    g_error_free (error);
+    return;
+  }
+
+  if (g_subprocess_get_if_signaled (process))
+    GPOP_LOG ("The worker %u was killed by signal %d", worker->index,
+        g_subprocess_get_term_sig (process));
+  else
+    GPOP_LOG ("The worker %u exited with status %d", worker->index,
+        g_subprocess_get_exit_status (process));
+  g_clear_object (&worker->process);
+  if (!worker->owner)
+    gpop_front_schedule_restart (worker);
+}
+
+#ifdef __linux__
+/* Runs in the child, between fork() and exec() */
+static void
+gpop_front_pin_worker (gpointer user_data)
+{
+  GPOPFrontWorker *worker = (GPOPFrontWorker *) user_data;
+
+  sched_setaffinity (0, sizeof (worker->cpus), &worker->cpus);
+}
+#endif
+
+static void
+gpop_front_spawn (GPOPFrontWorker * worker)
+{
+  GPOPFront *front = worker->front;
+  GPtrArray *argv = g_ptr_array_new_with_free_func (g_free);
+  GSubprocessLauncher *launcher;
+  GError *error = NULL;
+  gchar **arg;
+
+  for (arg = front->worker_args; *arg; arg++)
+    g_ptr_array_add (argv, g_strdup (*arg));
+  g_ptr_array_add (argv, g_strdup ("--worker"));
+  g_ptr_array_add (argv, g_strdup_printf ("%u", worker->index));
+  g_ptr_array_add (argv, NULL);
+
+  launcher = g_subprocess_launcher_new (G_SUBPROCESS_FLAGS_NONE);
+#ifdef __linux__
+  if (CPU_COUNT (&worker->cpus))
+    g_subprocess_launcher_set_child_setup (launcher, gpop_front_pin_worker,
+        worker, NULL);
+#endif
+  worker->process = g_subprocess_launcher_spawnv (launcher,
+      (const gchar * const *) argv->pdata, &error);
+  worker->n_spawns++;
+  g_object_unref (launcher);
+  g_ptr_array_unref (argv);
+
+  if (!worker->process) {
+    GPOP_LOG ("Unable to spawn the worker %u: %s", worker->index,
+        error->message);
+    g_error_free (error);
+    gpop_front_schedule_restart (worker);
+    return;
+  }
+
+  GPOP_LOG ("Spawned the worker %u (pid %s) on the cpus %s", worker->index,
+      g_subprocess_get_identifier (worker->process), worker->cpus_name);
+  g_subprocess_wait_async (worker->process, front->cancellable,
+      gpop_front_on_worker_exit, worker);
+}
+
+/* Splits the cpus allowed to the front in n_workers contiguous groups */
+static void
+gpop_front_assign_cpus (GPOPFront * front)
+{
+  guint i, j, n_cpus = 0, n_workers = front->workers->len;
+  gint *cpus = g_new (gint, MAX (g_get_num_processors (), 1));
+#ifdef __linux__
+  cpu_set_t allowed;
+  gint cpu;
+
+  if (sched_getaffinity (0, sizeof (allowed), &allowed) < 0)
+    CPU_ZERO (&allowed);
+  for (cpu = 0; cpu < CPU_SETSIZE && n_cpus < g_get_num_processors (); cpu++)
+    if (CPU_ISSET (cpu, &allowed))
+      cpus[n_cpus++] = cpu;
+#endif
+
+  for (i = 0; i < n_workers; i++) {
+    GPOPFrontWorker *worker = g_ptr_array_index (front->workers, i);
+    GString *name = g_string_new (NULL);
+    guint first = i * n_cpus / n_workers, last = (i + 1) * n_cpus / n_workers;
+
+    /* more workers than cpus, they share them */
+    if (n_cpus && first == last) {
+      first = i % n_cpus;
+      last = first + 1;
+    }
+#ifdef __linux__
+    CPU_ZERO (&worker->cpus);
+#endif
+    for (j = first; j < last; j++) {
+#ifdef __linux__
+      CPU_SET (cpus[j], &worker->cpus);
+#endif
+      g_string_append_printf (name, "%s%d", name->len ? "," : "", cpus[j]);
+    }
+    worker->cpus_name = g_string_free (name, FALSE);
+    if (!*worker->cpus_name) {
+      g_free (worker->cpus_name);
+      worker->cpus_name = g_strdup ("all");
+    }
+  }
+  g_free (cpus);
+}
+
+static void
+gpop_front_worker_free (GPOPFrontWorker * worker)
+{
+  GDBusConnection *connection = worker->front->base.connection;
+
+  if (worker->watch_id)
+    g_bus_unwatch_name (worker->watch_id);
+  if (worker->signal_id && connection)
+    g_dbus_connection_signal_unsubscribe (connection, worker->signal_id);
+  if (worker->restart_id)
+    g_source_remove (worker->restart_id);
+  g_clear_object (&worker->process);
+  g_free (worker->name);
+  g_free (worker->owner);
+  g_free (worker->cpus_name);
+  g_free (worker);
+}
+
+/* ---------------------------------------------------------------------------------------------------- */
+
+static void
+gpop_front_request_free (GPOPFrontRequest * request)
+{
+  if (request->reply)
+    g_variant_unref (request->reply);
+  g_clear_error (&request->error);
+  g_free (request);
+}
+
+/* The <Method>WithKey variants take a client request id before the
+ * arguments of <Method>, see gpop_manager_handle_method_with_key() */
+static GPOPFrontCall *
+gpop_front_call_new (GPOPFront * front, GDBusMethodInvocation * invocation,
+    const gchar * method_name, GVariant * parameters)
+{
+  GPOPFrontCall *call = g_new0 (GPOPFrontCall, 1);
+
+  call->front = g_object_ref (front);
+  call->invocation = invocation;
+  call->requests =
+      g_ptr_array_new_with_free_func ((GDestroyNotify)
+      gpop_front_request_free);
+
+  if (g_str_has_suffix (method_name, GPOP_MANAGER_WITH_KEY_SUFFIX)) {
+    gsize i, n_args = g_variant_n_children (parameters);
+    GVariant **args = g_new (GVariant *, n_args);
+
+    call->method_name = g_strndup (method_name,
+        strlen (method_name) - strlen (GPOP_MANAGER_WITH_KEY_SUFFIX));
+    g_variant_get_child (parameters, 0, "s", &call->request_id);
+    for (i = 1; i < n_args; i++)
+      args[i - 1] = g_variant_get_child_value (parameters, i);
+    call->parameters =
+        g_variant_ref_sink (g_variant_new_tuple (args, n_args - 1));
+    for (i = 1; i < n_args; i++)
+      g_variant_unref (args[i - 1]);
+    g_free (args);
+  } else {
+    call->method_name = g_strdup (method_name);
+    call->parameters = g_variant_ref (parameters);
+  }
+
+  return call;
+}
+
+/* Replies to the client with ret, owned, or error, and frees the call */
+static void
+gpop_front_call_return (GPOPFrontCall * call, GVariant * ret, GError * error)
+{
+  if (error) {
+    gpop_front_return_error (call->invocation, error);
+    g_error_free (error);
+  } else {
+    if (!ret)
+      ret = g_variant_ref_sink (g_variant_new ("()"));
+    /* Failures are not cached, a retry will run again */
+    if (call->request_id)
+      gpop_request_cache_insert (call->front->requests, call->request_id,
+          call->method_name, call->parameters, ret);
+    g_dbus_method_invocation_return_value (call->invocation, ret);
+    g_variant_unref (ret);
+  }
+
+  g_ptr_array_unref (call->requests);
+  g_variant_unref (call->parameters);
+  g_free (call->method_name);
+  g_free (call->request_id);
+  g_object_unref (call->front);
+  g_free (call);
+}
+
+/* Merges the replies of the workers in the metrics of the front, labeled
+ * by worker and grouped by metric family */
+static gchar *
+gpop_front_merge_metrics (GPOPFrontCall * call)
+{
+  GPOPFront *front = call->front;
+  GHashTable *families = g_hash_table_new_full (g_str_hash, g_str_equal,
+      g_free, NULL);
+  GPtrArray *order = g_ptr_array_new ();
+  GString *metrics = g_string_new (NULL);
+  guint i, j, n_available = 0;
+
+  for (i = 0; i < front->workers->len; i++)
+    if (((GPOPFrontWorker *) g_ptr_array_index (front->workers, i))->owner)
+      n_available++;
+  g_string_append_printf (metrics,
+      "# TYPE gpop_front_workers gauge\ngpop_front_workers %u\n", n_available);
+  g_string_append (metrics, "# TYPE gpop_front_pipelines gauge\n");
+  for (i = 0; i < front->workers->len; i++) {
+    GPOPFrontWorker *worker = g_ptr_array_index (front->workers, i);
+    g_string_append_printf (metrics,
+        "gpop_front_pipelines{worker=\"%u\"} %u\n", worker->index,
+        worker->n_pipelines);
+  }
+  gpop_rate_limit_append_metrics (metrics);
+  gpop_control_stats_append_metrics (metrics);
+
+  /* the front metrics first */
+  for (i = 0; i <= call->requests->len; i++) {
+    GPOPFrontRequest *request = NULL;
+    GString *family = NULL;
+    const gchar *text = metrics->str;
+    gchar **lines;
+
+    if (i > 0) {
+      request = g_ptr_array_index (call->requests, i - 1);
+      if (!request->reply)
+        continue;
+      g_variant_get (request->reply, "(&s)", &text);
+    }
+
+    lines = g_strsplit (text, "\n", -1);
+    for (j = 0; lines[j]; j++) {
+      const gchar *line = lines[j];
+
+      if (g_str_has_prefix (line, "# TYPE ")) {
+        gchar **fields = g_strsplit (line + strlen ("# TYPE "), " ", 2);
+
+        family = g_hash_table_lookup (families, fields[0]);
+        if (!family) {
+          family = g_string_new (NULL);
+          g_string_append_printf (family, "%s\n", line);
+          g_hash_table_insert (families, g_strdup (fields[0]), family);
+          g_ptr_array_add (order, family);
+        }
+        g_strfreev (fields);
+      } else if (*line && *line != '#' && family) {
+        gsize name_len = strcspn (line, "{ ");
+
+        if (!request) {
+          g_string_append_printf (family, "%s\n", line);
+        } else if (line[name_len] == '{') {
+          g_string_append_printf (family, "%.*s{worker=\"%u\",%s\n",
+              (gint) name_len, line, request->worker->index,
+              line + name_len + 1);
+        } else {
+          g_string_append_printf (family, "%.*s{worker=\"%u\"}%s\n",
+              (gint) name_len, line, request->worker->index,
+              line + name_len);
+        }
+      }
+    }
+    g_strfreev (lines);
+  }
+
+  g_string_truncate (metrics, 0);
+  for (i = 0; i < order->len; i++) {
+    GString *family = g_ptr_array_index (order, i);
+    g_string_append (metrics, family->str);
+    g_string_free (family, TRUE);
+  }
+  g_ptr_array_unref (order);
+  g_hash_table_unref (families);
+
+  return g_string_free (metrics, FALSE);
+}
+
+/* Called once all the forwarded requests are replied */
+static void
+gpop_front_call_complete (GPOPFrontCall * call)
+{
+  GPOPFront *front = call->front;
+  const gchar *method_name = call->method_name;
+  GPOPFrontRequest *first = NULL;
+  GVariantBuilder builder;
+  GVariant *ret = NULL;
+  GError *error = NULL;
+  guint i;
+
+  if (call->requests->len)
+    first = g_ptr_array_index (call->requests, 0);
+
+  if (!g_strcmp0 (method_name, "AddPipeline")
+      || !g_strcmp0 (method_name, "PreparePipeline")
+      || !g_strcmp0 (method_name, "AddLadder")) {
+    GPOPFrontPipeline *pipeline;
+    const gchar *id, *path;
+
+    first->worker->n_placing--;
+    if (first->reply) {
+      g_variant_get (first->reply, "(&s&o)", &id, &path);
+      pipeline = gpop_front_add_pipeline (front, first->worker, id, path);
+      if (pipeline) {
+        ret = g_variant_ref_sink (g_variant_new ("(so)", pipeline->id,
+                pipeline->base.object_path));
+      } else {
+        gpop_front_drop_remote (front, first->worker, id);
+        error = g_error_new (G_DBUS_ERROR, G_DBUS_ERROR_FAILED,
+            "Unable to proxy the pipeline '%s'", id);
+      }
+    }
+  } else if (!g_strcmp0 (method_name, "AddPipelines")) {
+    g_variant_builder_init (&builder, G_VARIANT_TYPE ("a(so)"));
+    for (i = 0; i < call->requests->len; i++) {
+      GPOPFrontRequest *request = g_ptr_array_index (call->requests, i);
+      GPOPFrontPipeline *pipeline = NULL;
+      const gchar *id, *path;
+
+      if (request->worker)
+        request->worker->n_placing--;
+      if (request->reply) {
+        g_variant_get (request->reply, "(&s&o)", &id, &path);
+        pipeline = gpop_front_add_pipeline (front, request->worker, id, path);
+        if (!pipeline)
+          gpop_front_drop_remote (front, request->worker, id);
+      }
+      if (pipeline)
+        g_variant_builder_add (&builder, "(so)", pipeline->id,
+            pipeline->base.object_path);
+      else
+        g_variant_builder_add (&builder, "(so)", "", "/");
+    }
+    ret = g_variant_ref_sink (g_variant_new ("(a(so))", &builder));
+  } else if (!g_strcmp0 (method_name, "RemovePipeline")) {
+    const gchar *id;
+
+    g_variant_get (call->parameters, "(&s)", &id);
+    if (!first->worker) {
+      error = g_error_new (G_DBUS_ERROR, G_DBUS_ERROR_INVALID_ARGS,
+          "No pipeline with id '%s'", id);
+    } else if (first->reply) {
+      GPOPFrontPipeline *pipeline = gpop_front_get_pipeline_by_id (front, id);
+
+      if (pipeline) {
+        gpop_front_remove_pipeline (front, pipeline);
+        gpop_front_notify_pipelines (front);
+      }
+      ret = g_variant_ref (first->reply);
+    }
+  } else if (!g_strcmp0 (method_name, "RemovePipelines")) {
+    GVariant *ids = g_variant_get_child_value (call->parameters, 0);
+    GVariantIter iter;
+    const gchar *id;
+
+    g_variant_builder_init (&builder, G_VARIANT_TYPE ("ab"));
+    g_variant_iter_init (&iter, ids);
+    for (i = 0; g_variant_iter_next (&iter, "&s", &id); i++) {
+      GPOPFrontRequest *request = g_ptr_array_index (call->requests, i);
+      GPOPFrontPipeline *pipeline = NULL;
+
+      if (request->reply)
+        pipeline = gpop_front_get_pipeline_by_id (front, id);
+      if (pipeline)
+        gpop_front_remove_pipeline (front, pipeline);
+      g_variant_builder_add (&builder, "b", request->reply != NULL);
+    }
+    g_variant_unref (ids);
+    gpop_front_notify_pipelines (front);
+    ret = g_variant_ref_sink (g_variant_new ("(ab)", &builder));
+  } else if (!g_strcmp0 (method_name, "GetPipelineDesc")) {
+    if (!first->worker)
+      ret = g_variant_ref_sink (g_variant_new ("(s)", ""));
+    else if (first->reply)
+      ret = g_variant_ref (first->reply);
+  } else if (!g_strcmp0 (method_name, "GetHistory")) {
+    if (!first->worker)
+      error = g_error_new (G_DBUS_ERROR, G_DBUS_ERROR_INVALID_ARGS,
+          "No history for this id");
+    else if (first->reply)
+      ret = g_variant_ref (first->reply);
+  } else if (!g_strcmp0 (method_name, "GetMetrics")) {
+    gchar *metrics = gpop_front_merge_metrics (call);
+
+    ret = g_variant_ref_sink (g_variant_new ("(s)", metrics));
+    g_free (metrics);
+  } else if (!g_strcmp0 (method_name, "GetPlacement")) {
+    g_variant_builder_init (&builder, G_VARIANT_TYPE ("a(ssdu)"));
+    for (i = 0; i < call->requests->len; i++) {
+      GPOPFrontRequest *request = g_ptr_array_index (call->requests, i);
+      GVariant *placement, *entry;
+      GVariantIter iter;
+
+      if (!request->reply)
+        continue;
+      placement = g_variant_get_child_value (request->reply, 0);
+      g_variant_iter_init (&iter, placement);
+      while ((entry = g_variant_iter_next_value (&iter))) {
+        g_variant_builder_add_value (&builder, entry);
+        g_variant_unref (entry);
+      }
+      g_variant_unref (placement);
+    }
+    ret = g_variant_ref_sink (g_variant_new ("(a(ssdu))", &builder));
+  }
+
+  /* the error of a single forwarded request is returned as is */
+  if (!ret && !error && first && first->error) {
+    error = first->error;
+    first->error = NULL;
+  }
+  gpop_front_call_return (call, ret, error);
+}
+
+static void
+gpop_front_on_request_reply (GObject * source, GAsyncResult * res,
+    gpointer user_data)
+{
+  GPOPFrontRequest *request = (GPOPFrontRequest *) user_data;
+  GPOPFrontCall *call = request->call;
+
+  request->reply = g_dbus_connection_call_finish (G_DBUS_CONNECTION (source),
+      res, &request->error);
+  if (--call->n_pending == 0)
+    gpop_front_call_complete (call);
+}
+
+/* Forwards method_name to the Manager of worker, NULL for an unknown
+ * pipeline, the replies being merged by gpop_front_call_complete() */
+static void
+gpop_front_call_forward (GPOPFrontCall * call, GPOPFrontWorker * worker,
+    const gchar * method_name, GVariant * parameters)
+{
+  GPOPFrontRequest *request = g_new0 (GPOPFrontRequest, 1);
+
+  request->call = call;
+  request->worker = worker;
+  g_ptr_array_add (call->requests, request);
+  if (parameters)
+    g_variant_ref_sink (parameters);
+  if (!worker) {
+    /* nothing to send */
+  } else if (!worker->owner) {
+    request->error = g_error_new (G_DBUS_ERROR,
+        G_DBUS_ERROR_NAME_HAS_NO_OWNER, "The worker %u is not available",
+        worker->index);
+  } else {
+    call->n_pending++;
+    g_dbus_connection_call (call->front->base.connection, worker->owner,
+        GPOP_MANAGER_OBJECT_PATH, GPOP_DBUS_INTERFACE_NAME, method_name,
+        parameters, NULL, G_DBUS_CALL_FLAGS_NO_AUTO_START, -1, NULL,
+        gpop_front_on_request_reply, request);
+  }
+  if (parameters)
+    g_variant_unref (parameters);
+}
+
+/* The parameters of a pipeline request, with the id of the pipeline on its
+ * worker */
+static GVariant *
+gpop_front_translate_id (GPOPFrontPipeline * pipeline, GVariant * parameters)
+{
+  gsize i, n_args = g_variant_n_children (parameters);
+  GVariant **args = g_new (GVariant *, n_args);
+  GVariant *ret;
+
+  args[0] = g_variant_new_string (pipeline->remote_id);
+  for (i = 1; i < n_args; i++)
+    args[i] = g_variant_get_child_value (parameters, i);
+  ret = g_variant_new_tuple (args, n_args);
+  for (i = 1; i < n_args; i++)
+    g_variant_unref (args[i]);
+  g_free (args);
+
+  return ret;
+}
+
+/* Answers the requests of the front itself, returns FALSE if the request
+ * was forwarded to the workers */
+static gboolean
+gpop_front_handle_method (GPOPFrontCall * call, GVariant ** ret,
+    GError ** error)
+{
+  GPOPFront *front = call->front;
+  const gchar *method_name = call->method_name;
+  GVariant *parameters = call->parameters;
+  GPOPFrontWorker *worker;
+  GVariantBuilder builder;
+  GVariantIter iter;
+  GVariant *args;
+  const gchar *arg;
+  GList *l;
+  guint i;
+
+  if (!g_strcmp0 (method_name, "AddPipeline")
+      || !g_strcmp0 (method_name, "PreparePipeline")
+      || !g_strcmp0 (method_name, "AddLadder")) {
+    worker = gpop_front_pick_worker (front, NULL);
+    if (!worker) {
+      g_set_error (error, G_DBUS_ERROR, G_DBUS_ERROR_FAILED,
+          "No worker is available");
+      return TRUE;
+    }
+    worker->n_placing++;
+    gpop_front_call_forward (call, worker, method_name, parameters);
+  } else if (!g_strcmp0 (method_name, "AddPipelines")) {
+    /* each pipeline is placed on its own */
+    args = g_variant_get_child_value (parameters, 0);
+    g_variant_iter_init (&iter, args);
+    while (g_variant_iter_next (&iter, "&s", &arg)) {
+      worker = gpop_front_pick_worker (front, NULL);
+      if (worker)
+        worker->n_placing++;
+      gpop_front_call_forward (call, worker, "AddPipeline",
+          g_variant_new ("(s)", arg));
+    }
+    g_variant_unref (args);
+  } else if (!g_strcmp0 (method_name, "RemovePipelines")) {
+    args = g_variant_get_child_value (parameters, 0);
+    g_variant_iter_init (&iter, args);
+    while (g_variant_iter_next (&iter, "&s", &arg)) {
+      GPOPFrontPipeline *pipeline = gpop_front_get_pipeline_by_id (front, arg);
+
+      gpop_front_call_forward (call, pipeline ? pipeline->worker : NULL,
+          "RemovePipeline", g_variant_new ("(s)",
+              pipeline ? pipeline->remote_id : arg));
+    }
+    g_variant_unref (args);
+  } else if (!g_strcmp0 (method_name, "RemovePipeline")
+      || !g_strcmp0 (method_name, "GetPipelineDesc")
+      || !g_strcmp0 (method_name, "GetHistory")) {
+    GPOPFrontPipeline *pipeline;
+
+    g_variant_get_child (parameters, 0, "&s", &arg);
+    if (!*arg && !g_strcmp0 (method_name, "GetHistory")) {
+      g_set_error (error, G_DBUS_ERROR, G_DBUS_ERROR_NOT_SUPPORTED,
+          "The front keeps no history, the workers do");
+      return TRUE;
+    }
+    pipeline = gpop_front_get_pipeline_by_id (front, arg);
+    gpop_front_call_forward (call, pipeline ? pipeline->worker : NULL,
+        method_name, pipeline ? gpop_front_translate_id (pipeline,
+            parameters) : NULL);
+  } else if (!g_strcmp0 (method_name, "GetMetrics")
+      || !g_strcmp0 (method_name, "GetPlacement")) {
+    for (i = 0; i < front->workers->len; i++) {
+      worker = g_ptr_array_index (front->workers, i);
+      if (worker->owner)
+        gpop_front_call_forward (call, worker, method_name, parameters);
+    }
+  } else if (!g_strcmp0 (method_name, "ListPipelines")) {
+    g_variant_builder_init (&builder, G_VARIANT_TYPE ("a(so)"));
+    for (l = front->pipelines; l != NULL; l = g_list_next (l)) {
+      GPOPFrontPipeline *pipeline = l->data;
+      g_variant_builder_add (&builder, "(so)", pipeline->id,
+          pipeline->base.object_path);
+    }
+    *ret = g_variant_ref_sink (g_variant_new ("(a(so))", &builder));
+    return TRUE;
+  } else if (!g_strcmp0 (method_name, "GetControlStats")) {
+    *ret = g_variant_ref_sink (gpop_control_stats_to_variant ());
+    return TRUE;
+  } else if (!g_strcmp0 (method_name, "StartRecording")) {
+    g_variant_get (parameters, "(&s)", &arg);
+    gpop_recorder_start (arg, error);
+    return TRUE;
+  } else if (!g_strcmp0 (method_name, "StopRecording")) {
+    *ret = g_variant_ref_sink (g_variant_new ("(u)", gpop_recorder_stop ()));
+    return TRUE;
+  } else {
+    /* Profile and traces */
+    g_set_error (error, G_DBUS_ERROR, G_DBUS_ERROR_NOT_SUPPORTED,
+        "%s is not supported by the front, call it on the workers "
+        "(org.gpop.worker<n>)", method_name);
+    return TRUE;
+  }
+
+  return FALSE;
+}
+
+/* ---------------------------------------------------------------------------------------------------- */
+
+/* Live migration of a pipeline, see gpop-front.h */
+typedef enum
+{
+  GPOP_MIGRATION_PREPARING,
+  GPOP_MIGRATION_SWITCHING,
+  GPOP_MIGRATION_DONE,
+} GPOPMigrationStep;
+
+typedef struct
+{
+  GPOPFront *front;
+  GDBusMethodInvocation *invocation;
+  GPOPFrontPipeline *pipeline;
+  GPOPFrontWorker *source;
+  GPOPFrontWorker *target;
+  GPOPMigrationStep step;
+  /* of the pipeline on the source */
+  gchar *state;
+  gint priority;
+  GPOPSloTargets slo;
+  /* the prepared pipeline */
+  gchar *target_id;
+  gchar *target_path;
+  gint64 start;
+  /* when the source was paused, 0 if it was not playing */
+  gint64 paused;
+  gboolean played;
+  guint timeout_id;
+  /* calls in flight, the migration is freed after the last one */
+  guint n_calls;
+} GPOPFrontMigration;
+
+static void
+gpop_front_migration_release (GPOPFrontMigration * migration)
+{
+  if (migration->step != GPOP_MIGRATION_DONE || migration->n_calls)
+    return;
+
+  g_object_unref (migration->pipeline);
+  g_object_unref (migration->front);
+  g_free (migration->state);
+  g_free (migration->target_id);
+  g_free (migration->target_path);
+  g_free (migration);
+}
+
+/* Calls method_name on path of worker, without waiting for the reply if
+ * callback is NULL */
+static void
+gpop_front_migration_call (GPOPFrontMigration * migration,
+    GPOPFrontWorker * worker, const gchar * path,
+    const gchar * interface_name, const gchar * method_name,
+    GVariant * parameters, GAsyncReadyCallback callback)
+{
+  if (callback)
+    migration->n_calls++;
+  g_dbus_connection_call (migration->front->base.connection,
+      worker->owner ? worker->owner : worker->name, path,
+      interface_name ? interface_name : GPOP_DBUS_INTERFACE_NAME, method_name,
+      parameters, NULL, G_DBUS_CALL_FLAGS_NO_AUTO_START, -1, NULL, callback,
+      migration);
+}
+
+static void
+gpop_front_migration_end (GPOPFrontMigration * migration, GError * error)
+{
+  GPOPFront *front = migration->front;
+  GPOPFrontPipeline *pipeline = migration->pipeline;
+  GPOPFrontWorker *source = migration->source;
+  GPOPFrontWorker *target = migration->target;
+  gdouble gap_ms = 0;
+
+  migration->step = GPOP_MIGRATION_DONE;
+  if (migration->timeout_id) {
+    g_source_remove (migration->timeout_id);
+    migration->timeout_id = 0;
+  }
+  front->migrations = g_list_remove (front->migrations, migration);
+  pipeline->migrating = FALSE;
+
+  if (!error && pipeline->worker != source)
+    error = g_error_new (G_DBUS_ERROR, G_DBUS_ERROR_UNKNOWN_OBJECT,
+        "The pipeline '%s' was removed during the migration", pipeline->id);
+
+  if (error) {
+    GPOP_LOG ("Unable to migrate the pipeline %s to the worker %u: %s",
+        pipeline->id, target->index, error->message);
+    /* the source plays on, the prepared pipeline is dropped */
+    if (migration->paused && pipeline->worker == source)
+      gpop_front_migration_call (migration, source, pipeline->remote_path,
+          NULL, "Play", NULL, NULL);
+    if (migration->target_id)
+      gpop_front_migration_call (migration, target, GPOP_MANAGER_OBJECT_PATH,
+          NULL, "RemovePipeline", g_variant_new ("(s)",
+              migration->target_id), NULL);
+    gpop_front_return_error (migration->invocation, error);
+    g_error_free (error);
+    gpop_front_migration_release (migration);
+    return;
+  }
+
+  if (migration->paused)
+    gap_ms = (g_get_monotonic_time () - migration->paused) / 1000.0;
+  gpop_front_migration_call (migration, source, GPOP_MANAGER_OBJECT_PATH,
+      NULL, "RemovePipeline", g_variant_new ("(s)", pipeline->remote_id),
+      NULL);
+
+  /* the proxy forwards to the target from now on */
+  gpop_front_pipeline_set_playing (pipeline, FALSE);
+  source->n_pipelines--;
+  target->n_pipelines++;
+  pipeline->worker = target;
+  g_free (pipeline->remote_id);
+  pipeline->remote_id = g_steal_pointer (&migration->target_id);
+  g_free (pipeline->remote_path);
+  pipeline->remote_path = g_steal_pointer (&migration->target_path);
+  gpop_front_pipeline_set_playing (pipeline, migration->paused != 0);
+
+  GPOP_LOG ("Migrated the pipeline %s from the worker %u to the worker %u "
+      "in %.1f ms, gap %.1f ms", pipeline->id, source->index, target->index,
+      (g_get_monotonic_time () - migration->start) / 1000.0, gap_ms);
+  gpop_tracer_instant ("migration", "switched", pipeline->id);
+  g_dbus_method_invocation_return_value (migration->invocation,
+      g_variant_new ("(d)", gap_ms));
+  gpop_front_migration_release (migration);
+}
+
+/* The reply of a call of the migration, NULL if it failed, the migration
+ * being ended, or if the migration is already over */
+static GVariant *
+gpop_front_migration_reply (GPOPFrontMigration * migration,
+    GObject * source, GAsyncResult * res)
+{
+  GError *error = NULL;
+  GVariant *reply;
+
+  reply = g_dbus_connection_call_finish (G_DBUS_CONNECTION (source), res,
+      &error);
+  migration->n_calls--;
+  if (migration->step == GPOP_MIGRATION_DONE) {
+    if (reply)
+      g_variant_unref (reply);
+    g_clear_error (&error);
+    gpop_front_migration_release (migration);
+    return NULL;
+  }
+  if (!reply)
+    gpop_front_migration_end (migration, error);
+
+  return reply;
+}
+
+static gboolean
+gpop_front_migration_on_timeout (gpointer user_data)
+{
+  GPOPFrontMigration *migration = (GPOPFrontMigration *) user_data;
+
+  migration->timeout_id = 0;
+  gpop_front_migration_end (migration, g_error_new (G_DBUS_ERROR,
+          G_DBUS_ERROR_TIMEOUT, "The migration timed out"));
+  return G_SOURCE_REMOVE;
+}
+
+static void
+gpop_front_migration_on_target_played (GObject * source, GAsyncResult * res,
+    gpointer user_data)
+{
+  GVariant *reply = gpop_front_migration_reply (user_data, source, res);
+
+  /* done once the target streams */
+  if (reply)
+    g_variant_unref (reply);
+}
+
+static void
+gpop_front_migration_on_source_position (GObject * source,
+    GAsyncResult * res, gpointer user_data)
+{
+  GPOPFrontMigration *migration = (GPOPFrontMigration *) user_data;
+  GVariant *reply = gpop_front_migration_reply (migration, source, res);
+  GVariant *value;
+  gint64 position;
+
+  if (!reply)
+    return;
+  g_variant_get (reply, "(v)", &value);
+  position = g_variant_get_int64 (value);
+  g_variant_unref (value);
+  g_variant_unref (reply);
+
+  /* a live source can not seek, it is aligned by itself */
+  if (position >= 0)
+    gpop_front_migration_call (migration, migration->target,
+        migration->target_path, NULL, "Seek", g_variant_new ("(x)",
+            position), NULL);
+
+  if (!migration->paused) {
+    gpop_front_migration_end (migration, NULL);
+    return;
+  }
+  migration->played = TRUE;
+  gpop_front_migration_call (migration, migration->target,
+      migration->target_path, NULL, "Play", NULL,
+      gpop_front_migration_on_target_played);
+}
+
+static void
+gpop_front_migration_on_source_paused (GObject * source, GAsyncResult * res,
+    gpointer user_data)
+{
+  GPOPFrontMigration *migration = (GPOPFrontMigration *) user_data;
+  GVariant *reply = gpop_front_migration_reply (migration, source, res);
+
+  if (!reply)
+    return;
+  g_variant_unref (reply);
+
+  if (!g_strcmp0 (migration->state,
+          gpop_parser_state_get_name (GPOP_PARSER_PLAYING)))
+    migration->paused = g_get_monotonic_time ();
+  gpop_front_migration_call (migration, migration->source,
+      migration->pipeline->remote_path, "org.freedesktop.DBus.Properties",
+      "Get", g_variant_new ("(ss)", GPOP_DBUS_INTERFACE_NAME, "position"),
+      gpop_front_migration_on_source_position);
+}
+
+static void
+gpop_front_migration_on_target_state (GPOPFrontMigration * migration,
+    const gchar * state)
+{
+  if (migration->step != GPOP_MIGRATION_PREPARING)
+    return;
+
+  if (!g_strcmp0 (state, gpop_parser_state_get_name (GPOP_PARSER_ERROR))) {
+    gpop_front_migration_end (migration, g_error_new (G_DBUS_ERROR,
+            G_DBUS_ERROR_FAILED, "The pipeline failed on the worker %u",
+            migration->target->index));
+    return;
+  }
+  if (g_strcmp0 (state, gpop_parser_state_get_name (GPOP_PARSER_PAUSED)))
+    return;
+
+  /* prerolled, switch over */
+  migration->step = GPOP_MIGRATION_SWITCHING;
+  if (!g_strcmp0 (migration->state,
+          gpop_parser_state_get_name (GPOP_PARSER_PLAYING))
+      || !g_strcmp0 (migration->state,
+          gpop_parser_state_get_name (GPOP_PARSER_PAUSED))) {
+    gpop_front_migration_call (migration, migration->source,
+        migration->pipeline->remote_path, NULL, "Pause", NULL,
+        gpop_front_migration_on_source_paused);
+  } else {
+    gpop_front_migration_call (migration, migration->target,
+        migration->target_path, NULL, "Stop", NULL, NULL);
+    gpop_front_migration_end (migration, NULL);
+  }
+}
+
+/* The state changes of the prepared pipelines */
+static void
+gpop_front_on_migration_properties (GPOPFront * front,
+    GPOPFrontWorker * worker, const gchar * path, GVariant * parameters)
+{
+  GVariant *changed;
+  const gchar *state;
+  gboolean streaming;
+  GList *l;
+
+  for (l = front->migrations; l; l = g_list_next (l)) {
+    GPOPFrontMigration *migration = l->data;
+
+    if (migration->target != worker
+        || g_strcmp0 (migration->target_path, path))
+      continue;
+
+    changed = g_variant_get_child_value (parameters, 1);
+    if (g_variant_lookup (changed, "state", "&s", &state))
+      gpop_front_migration_on_target_state (migration, state);
+    else if (g_variant_lookup (changed, "streaming", "b", &streaming)
+        && streaming && migration->played
+        && migration->step == GPOP_MIGRATION_SWITCHING)
+      gpop_front_migration_end (migration, NULL);
+    g_variant_unref (changed);
+    return;
+  }
+}
+
+static void
+gpop_front_migration_on_prepared_state (GObject * source, GAsyncResult * res,
+    gpointer user_data)
+{
+  GPOPFrontMigration *migration = (GPOPFrontMigration *) user_data;
+  GVariant *reply = gpop_front_migration_reply (migration, source, res);
+  GVariant *value;
+
+  if (!reply)
+    return;
+  g_variant_get (reply, "(v)", &value);
+  gpop_front_migration_on_target_state (migration,
+      g_variant_get_string (value, NULL));
+  g_variant_unref (value);
+  g_variant_unref (reply);
+}
+
+static void
+gpop_front_migration_on_prepared (GObject * source, GAsyncResult * res,
+    gpointer user_data)
+{
+  GPOPFrontMigration *migration = (GPOPFrontMigration *) user_data;
+  GVariant *reply = gpop_front_migration_reply (migration, source, res);
+  GPOPSloTargets none = { 0, };
+
+  if (!reply)
+    return;
+  g_variant_get (reply, "(so)", &migration->target_id,
+      &migration->target_path);
+  g_variant_unref (reply);
+
+  /* applied in order by the target */
+  if (migration->priority)
+    gpop_front_migration_call (migration, migration->target,
+        migration->target_path, "org.freedesktop.DBus.Properties", "Set",
+        g_variant_new ("(ssv)", GPOP_DBUS_INTERFACE_NAME, "priority",
+            g_variant_new_int32 (migration->priority)), NULL);
+  if (memcmp (&migration->slo, &none, sizeof (GPOPSloTargets)))
+    gpop_front_migration_call (migration, migration->target,
+        migration->target_path, NULL, "SetSlo", g_variant_new ("(ddd)",
+            migration->slo.min_fps, migration->slo.max_latency_ms,
+            migration->slo.max_dropped_per_minute), NULL);
+
+  /* it may be prerolled already, otherwise its state change is relayed */
+  gpop_front_migration_call (migration, migration->target,
+      migration->target_path, "org.freedesktop.DBus.Properties", "Get",
+      g_variant_new ("(ss)", GPOP_DBUS_INTERFACE_NAME, "state"),
+      gpop_front_migration_on_prepared_state);
+}
+
+static void
+gpop_front_migration_on_source_properties (GObject * source,
+    GAsyncResult * res, gpointer user_data)
+{
+  GPOPFrontMigration *migration = (GPOPFrontMigration *) user_data;
+  GVariant *reply = gpop_front_migration_reply (migration, source, res);
+  GVariant *properties;
+  gboolean migratable = FALSE;
+  const gchar *desc;
+
+  if (!reply)
+    return;
+  properties = g_variant_get_child_value (reply, 0);
+  g_variant_lookup (properties, "migratable", "b", &migratable);
+  g_variant_lookup (properties, "priority", "i", &migration->priority);
+  g_variant_lookup (properties, "slo", "(ddd)", &migration->slo.min_fps,
+      &migration->slo.max_latency_ms, &migration->slo.max_dropped_per_minute);
+  if (!g_variant_lookup (properties, "state", "s", &migration->state)
+      || !g_variant_lookup (properties, "parser_desc", "&s", &desc)) {
+    gpop_front_migration_end (migration, g_error_new (G_DBUS_ERROR,
+            G_DBUS_ERROR_FAILED, "Unable to get the pipeline '%s'",
+            migration->pipeline->id));
+  } else if (!migratable) {
+    /* its copy would write the same files or bind the same ports */
+    gpop_front_migration_end (migration, g_error_new (G_DBUS_ERROR,
+            G_DBUS_ERROR_NOT_SUPPORTED, "The pipeline '%s' writes files, "
+            "serves a port or has renditions, it can not be migrated",
+            migration->pipeline->id));
+  } else {
+    gpop_front_migration_call (migration, migration->target,
+        GPOP_MANAGER_OBJECT_PATH, NULL, "PreparePipeline",
+        g_variant_new ("(s)", desc), gpop_front_migration_on_prepared);
+  }
+  g_variant_unref (properties);
+  g_variant_unref (reply);
+}
+
+/* Migrate(id, target), target being the name of a worker or empty for the
+ * least loaded one, replied with the switchover gap in milliseconds */
+static void
+gpop_front_migrate (GPOPFront * front, GVariant * parameters,
+    GDBusMethodInvocation * invocation)
+{
+  GPOPFrontMigration *migration;
+  GPOPFrontPipeline *pipeline;
+  GPOPFrontWorker *target = NULL;
+  const gchar *id, *target_name;
+  guint i;
+
+  g_variant_get (parameters, "(&s&s)", &id, &target_name);
+  pipeline = gpop_front_get_pipeline_by_id (front, id);
+  if (!pipeline) {
+    g_dbus_method_invocation_return_error (invocation, G_DBUS_ERROR,
+        G_DBUS_ERROR_INVALID_ARGS, "No pipeline with id '%s'", id);
+    return;
+  }
+  if (pipeline->migrating) {
+    g_dbus_method_invocation_return_error (invocation, G_DBUS_ERROR,
+        G_DBUS_ERROR_FAILED, "The pipeline '%s' is already migrating", id);
+    return;
+  }
+
+  if (!*target_name)
+    target = gpop_front_pick_worker (front, pipeline->worker);
+  for (i = 0; *target_name && i < front->workers->len; i++) {
+    GPOPFrontWorker *worker = g_ptr_array_index (front->workers, i);
+    if (!g_strcmp0 (worker->name, target_name))
+      target = worker;
+  }
+  if (!target || !target->owner || target == pipeline->worker) {
+    g_dbus_method_invocation_return_error (invocation, G_DBUS_ERROR,
+        G_DBUS_ERROR_INVALID_ARGS, "No other worker '%s' is available",
+        target_name);
+    return;
+  }
+
+  migration = g_new0 (GPOPFrontMigration, 1);
+  migration->front = g_object_ref (front);
+  migration->invocation = invocation;
+  migration->pipeline = g_object_ref (pipeline);
+  migration->source = pipeline->worker;
+  migration->target = target;
+  migration->start = g_get_monotonic_time ();
+  pipeline->migrating = TRUE;
+  front->migrations = g_list_prepend (front->migrations, migration);
+  migration->timeout_id =
+      g_timeout_add_seconds (GPOP_FRONT_MIGRATE_TIMEOUT_SECONDS,
+      gpop_front_migration_on_timeout, migration);
+
+  GPOP_LOG ("Migrating the pipeline %s from the worker %u to the worker %u",
+      id, migration->source->index, target->index);
+  gpop_tracer_instant ("migration", "started", id);
+  gpop_front_migration_call (migration, migration->source,
+      pipeline->remote_path, "org.freedesktop.DBus.Properties", "GetAll",
+      g_variant_new ("(s)", GPOP_DBUS_INTERFACE_NAME),
+      gpop_front_migration_on_source_properties);
+}
+
+static void
+gpop_front_dbus_method_call (GDBusConnection * connection,
+    const gchar * sender,
+    const gchar * object_path,
+    const gchar * interface_name,
+    const gchar * method_name,
+    GVariant * parameters,
+    GDBusMethodInvocation * invocation, gpointer user_data)
+{
+  GPOPFront *front = (GPOPFront *) user_data;
+  GPOPFrontCall *call;
+  GVariant *ret = NULL;
+  GError *error = NULL;
+
+  gpop_tracer_begin ("dbus", method_name, NULL);
+  if (!g_strcmp0 (method_name, "Migrate")) {
+    gpop_front_migrate (front, parameters, invocation);
+    gpop_tracer_end ("dbus", method_name, NULL);
+    return;
+  }
+
+  call = gpop_front_call_new (front, invocation, method_name, parameters);
+  if (call->request_id)
+    ret = gpop_request_cache_lookup (front->requests, call->request_id,
+        call->method_name, call->parameters, &error);
+
+  if (ret || error) {
+    /* the cached reply is not inserted again */
+    g_clear_pointer (&call->request_id, g_free);
+    gpop_front_call_return (call, ret, error);
+  } else if (gpop_front_handle_method (call, &ret, &error)) {
+    gpop_front_call_return (call, ret, error);
+  } else if (call->n_pending == 0) {
+    /* nothing was sent */
+    gpop_front_call_complete (call);
+  }
+  gpop_tracer_end ("dbus", method_name, NULL);
+}
+
+static GVariant *
+gpop_front_dbus_get_property (GDBusConnection * connection,
+    const gchar * sender,
+    const gchar * object_path,
+    const gchar * interface_name,
+    const gchar * property_name, GError ** error, gpointer user_data)
+{
+  GPOPFront *front = (GPOPFront *) user_data;
+  GVariant *ret = NULL;
+
+  if (!g_strcmp0 (property_name, "Pipelines")) {
+    ret = g_variant_new ("i", g_list_length (front->pipelines));
+  } else if (!g_strcmp0 (property_name, "Version")) {
+    ret = g_variant_new ("s", "0.0.1");
+  } else if (!g_strcmp0 (property_name, "Tracing")) {
+    ret = g_variant_new ("b", gpop_tracer_is_active ());
+  } else if (!g_strcmp0 (property_name, "Pressure")) {
+    ret = g_variant_new ("s", gpop_pressure_level_get_name (front->pressure));
+  }
+  return ret;
+}
+
+static gboolean
+gpop_front_dbus_set_property (GDBusConnection * connection,
+    const gchar * sender,
+    const gchar * object_path,
+    const gchar * interface_name,
+    const gchar * property_name,
+    GVariant * value, GError ** error, gpointer user_data)
+{
+  return *error == NULL;
+}
+
+static void
+gpop_front_dispose (GObject * object)
+{
+  GPOPFront *front = GPOP_FRONT (object);
+
+  front->stopping = TRUE;
+  if (front->cancellable)
+    g_cancellable_cancel (front->cancellable);
+  while (front->pipelines)
+    gpop_front_remove_pipeline (front, front->pipelines->data);
+  g_clear_pointer (&front->workers, g_ptr_array_unref);
+  g_clear_pointer (&front->worker_args, g_strfreev);
+  g_clear_pointer (&front->requests, gpop_request_cache_free);
+  g_clear_object (&front->cancellable);
+  if (front->stats_filter_id) {
+    gpop_control_stats_detach (front->base.connection,
+        front->stats_filter_id);
+    front->stats_filter_id = 0;
+  }
+
+  G_OBJECT_CLASS (gpop_front_parent_class)->dispose (object);
+}
+
+static void
+gpop_front_class_init (GPOPFrontClass * klass)
+{
+  GObjectClass *gobject_class = G_OBJECT_CLASS (klass);
+  GPOPDBusInterfaceClass *d_klass = GPOP_DBUS_INTERFACE_CLASS (klass);
+
+  gobject_class->dispose = gpop_front_dispose;
+
+  d_klass->method_call = gpop_front_dbus_method_call;
+  d_klass->get_property = gpop_front_dbus_get_property;
+  d_klass->set_property = gpop_front_dbus_set_property;
+}
+
+static void
+gpop_front_init (GPOPFront * front)
+{
+  front->requests =
+      gpop_request_cache_new (GPOP_REQUEST_CACHE_DEFAULT_SIZE,
+      GPOP_REQUEST_CACHE_DEFAULT_TTL_SECONDS);
+  front->cancellable = g_cancellable_new ();
+}
+
+/* ---------------------------------------------------------------------------------------------------- */
+
+/* Property calls included, they come as org.freedesktop.DBus.Properties
+ * methods as the class has no property handlers */
+static void
+gpop_front_pipeline_dbus_method_call (GDBusConnection * connection,
+    const gchar * sender,
+    const gchar * object_path,
+    const gchar * interface_name,
+    const gchar * method_name,
+    GVariant * parameters,
+    GDBusMethodInvocation * invocation, gpointer user_data)
+{
+  GPOPFrontPipeline *pipeline = (GPOPFrontPipeline *) user_data;
+
+  GAsyncReadyCallback callback = gpop_front_on_forwarded;
+
+  if (!pipeline->worker || !pipeline->worker->owner) {
+    g_dbus_method_invocation_return_error (invocation, G_DBUS_ERROR,
+        G_DBUS_ERROR_UNKNOWN_OBJECT, "No such object %s", object_path);
+    return;
+  }
+
+  /* the id of a migrated pipeline differs on its worker */
+  if (!g_strcmp0 (interface_name, "org.freedesktop.DBus.Properties")) {
+    const gchar *property_name = NULL;
+
+    if (!g_strcmp0 (method_name, "Get"))
+      g_variant_get (parameters, "(&s&s)", NULL, &property_name);
+    if (!g_strcmp0 (property_name, "id")) {
+      g_dbus_method_invocation_return_value (invocation,
+          g_variant_new ("(v)", g_variant_new_string (pipeline->id)));
+      return;
+    }
+    if (!g_strcmp0 (method_name, "GetAll")) {
+      g_object_set_data_full (G_OBJECT (invocation), "gpop-id",
+          g_strdup (pipeline->id), g_free);
+      callback = gpop_front_on_forwarded_all;
+    }
+  }
+
+  g_dbus_connection_call (connection, pipeline->worker->owner,
+      pipeline->remote_path, interface_name, method_name, parameters, NULL,
+      G_DBUS_CALL_FLAGS_NO_AUTO_START, -1, NULL, callback, invocation);
+}
+
+static void
+gpop_front_pipeline_finalize (GObject * object)
+{
+  GPOPFrontPipeline *pipeline = (GPOPFrontPipeline *) object;
+
+  g_free (pipeline->id);
+  g_free (pipeline->remote_id);
+  g_free (pipeline->remote_path);
+
+  G_OBJECT_CLASS (gpop_front_pipeline_parent_class)->finalize (object);
+}
+
+static void
+gpop_front_pipeline_class_init (GPOPFrontPipelineClass * klass)
+{
+  GObjectClass *gobject_class = G_OBJECT_CLASS (klass);
+  GPOPDBusInterfaceClass *d_klass = GPOP_DBUS_INTERFACE_CLASS (klass);
+
+  gobject_class->finalize = gpop_front_pipeline_finalize;
+
+  d_klass->method_call = gpop_front_pipeline_dbus_method_call;
+}
+
+static void
+gpop_front_pipeline_init (GPOPFrontPipeline * pipeline)
+{
+}
+
+/* ---------------------------------------------------------------------------------------------------- */
+
+/* worker_args is the command line of a worker, without --worker */
+GPOPFront *
+gpop_front_new (GDBusConnection * connection, guint n_workers,
+    const gchar * const *worker_args)
+{
+  GPOPFront *front = g_object_new (GPOP_TYPE_FRONT, NULL);
+  guint i;
+
+  g_return_val_if_fail (n_workers > 0, NULL);
+
+  if (!gpop_dbus_interface_register (GPOP_DBUS_INTERFACE (front),
+          GPOP_MANAGER_OBJECT_PATH, gpop_manager_xml_introspection,
+          connection)) {
+    g_object_unref (front);
+    return NULL;
+  }
+  front->stats_filter_id = gpop_control_stats_attach (connection);
+  front->worker_args = g_strdupv ((gchar **) worker_args);
+  front->next_num = n_workers * GPOP_FRONT_WORKER_NUMS;
+  front->workers = g_ptr_array_new_with_free_func ((GDestroyNotify)
+      gpop_front_worker_free);
+
+  for (i = 0; i < n_workers; i++) {
+    GPOPFrontWorker *worker = g_new0 (GPOPFrontWorker, 1);
+
+    worker->front = front;
+    worker->index = i;
+    worker->name = g_strdup_printf (GPOP_FRONT_WORKER_NAME, i);
+    g_ptr_array_add (front->workers, worker);
+  }
+  gpop_front_assign_cpus (front);
+
+  /* the workers are spawned unless already running, see
+   * gpop_front_on_worker_vanished() */
+  for (i = 0; i < n_workers; i++) {
+    GPOPFrontWorker *worker = g_ptr_array_index (front->workers, i);
+
+    worker->signal_id = g_dbus_connection_signal_subscribe (connection,
+        worker->name, NULL, NULL, NULL, NULL, G_DBUS_SIGNAL_FLAGS_NONE,
+        gpop_front_on_worker_signal, worker, NULL);
+    worker->watch_id = g_bus_watch_name_on_connection (connection,
+        worker->name, G_BUS_NAME_WATCHER_FLAGS_NONE,
+        gpop_front_on_worker_appeared, gpop_front_on_worker_vanished, worker,
+        NULL);
+  }
+
+  return front;
+}
+
+/* Shutdown of the spawned workers, see gpop_front_stop() */
+typedef struct
+{
+  GMainLoop *loop;
+  guint pending;
+  gboolean expired;
+} GPOPFrontStop;
+
+static void
+gpop_front_on_stop_exit (GObject * source, GAsyncResult * res,
+    gpointer user_data)
+{
+  GPOPFrontStop *stop = (GPOPFrontStop *) user_data;
+
+  g_subprocess_wait_finish (G_SUBPROCESS (source), res, NULL);
+  if (--stop->pending == 0)
+    g_main_loop_quit (stop->loop);
+}
+
+static gboolean
+gpop_front_on_stop_deadline (gpointer user_data)
+{
+  GPOPFrontStop *stop = (GPOPFrontStop *) user_data;
+
+  stop->expired = TRUE;
+  g_main_loop_quit (stop->loop);
+  return G_SOURCE_REMOVE;
+}
+
+/* Interrupts the spawned workers, which drain their pipelines within
+ * timeout_ms, and waits for them to exit for GPOP_FRONT_STOP_GRACE_SECONDS
+ * more at most before killing them. The attached workers are left
+ * running. */
+void
+gpop_front_stop (GPOPFront * front, guint timeout_ms)
+{
+  GPOPFrontStop stop = { 0, };
+  guint deadline_id;
+  guint i;
+
+  g_return_if_fail (GPOP_IS_FRONT (front));
+
+  front->stopping = TRUE;
+  g_cancellable_cancel (front->cancellable);
+  stop.loop = g_main_loop_new (NULL, FALSE);
+  for (i = 0; i < front->workers->len; i++) {
+    GPOPFrontWorker *worker = g_ptr_array_index (front->workers, i);
+
+    if (!worker->process)
+      continue;
+    g_subprocess_send_signal (worker->process, SIGINT);
+    g_subprocess_wait_async (worker->process, NULL, gpop_front_on_stop_exit,
+        &stop);
+    stop.pending++;
+  }
+
+  if (stop.pending) {
+    deadline_id = g_timeout_add (timeout_ms +
+        GPOP_FRONT_STOP_GRACE_SECONDS * 1000, gpop_front_on_stop_deadline,
+        &stop);
+    g_main_loop_run (stop.loop);
+    if (!stop.expired)
+      g_source_remove (deadline_id);
+  }
+
+  if (stop.pending) {
+    for (i = 0; i < front->workers->len; i++) {
+      GPOPFrontWorker *worker = g_ptr_array_index (front->workers, i);
+
+      /* no identifier once reaped */
+      if (worker->process && g_subprocess_get_identifier (worker->process)) {
+        GPOP_LOG ("The worker %u did not exit in time, killing it",
+            worker->index);
+        g_subprocess_force_exit (worker->process);
+      }
+    }
+    /* the waits complete once the killed workers are reaped */
+    g_main_loop_run (stop.loop);
+  }
+  g_main_loop_unref (stop.loop);
+}
+
+void
+gpop_front_free (GPOPFront * front)
+{
+  g_clear_object (&front);
+}
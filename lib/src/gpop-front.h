@@ -0,0 +1,98 @@
+/*
+ * GStreamer Prince of Parser
+ *
+ * Copyright (C) 2020 Stéphane Cerveau
+ *
+ * SPDX-License-Identifier: LGPL
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation
+ * version 2.1 of the License.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301 USA
+ *
+ */
+
+#ifndef _GPOP_FRONT_H_
+#define _GPOP_FRONT_H_
+
+/* Front of several worker daemons, sharing the pipelines of a host.
+ *
+ * The front owns org.gpop and spawns n worker daemons, or attaches to the
+ * running ones, each owning org.gpop.worker<n> and pinned to its group of
+ * the cpus. A new pipeline is placed on the least loaded worker: the lowest
+ * pressure level, then the fewest playing pipelines, then the fewest
+ * pipelines. The Manager requests are answered by the front, forwarded to
+ * the worker of the pipeline or merged from all the workers, and every
+ * pipeline is proxied at its object path, so that the clients see a single
+ * daemon. A worker which exits is restarted, without its pipelines.
+ *
+ * Migrate moves a pipeline to another worker without interrupting it for
+ * more than the switchover: the pipeline is prepared (built and prerolled)
+ * on the target, then the source is paused, the target is seeked to its
+ * position, a live source being aligned by itself, and played, the source
+ * being removed. The pipeline keeps its id and object path, so a pipeline
+ * numbered the same by the source worker once restarted is proxied under a
+ * number of the front. As both copies run until the switchover, the
+ * pipelines whose sinks write a file or serve a port are not migrated, nor
+ * the ladders, whose renditions are not part of their description. */
+
+#define GPOP_FRONT_WORKER_NAME "org.gpop.worker%u"
+/* Pipeline numbers of each worker, see gpop_manager_set_first_num() */
+#define GPOP_FRONT_WORKER_NUMS (1 << 20)
+#define GPOP_FRONT_RESTART_SECONDS 1
+#define GPOP_FRONT_MIGRATE_TIMEOUT_SECONDS 10
+/* for the workers to stop their pipelines once drained, see
+ * gpop_front_stop() */
+#define GPOP_FRONT_STOP_GRACE_SECONDS 2
+
+#define GPOP_TYPE_FRONT	           (gpop_front_get_type())
+#define GPOP_FRONT(obj)            (G_TYPE_CHECK_INSTANCE_CAST((obj),\
+                                              GPOP_TYPE_FRONT, GPOPFront))
+#define GPOP_FRONT_CLASS(klass)    (G_TYPE_CHECK_CLASS_CAST((klass),\
+                                              GPOP_TYPE_FRONT, GPOPFrontClass))
+#define GPOP_IS_FRONT(obj)         (G_TYPE_CHECK_INSTANCE_TYPE((obj),\
+                                              GPOP_TYPE_FRONT))
+
+typedef struct _GPOPFront GPOPFront;
+typedef struct _GPOPFrontClass GPOPFrontClass;
+
+struct _GPOPFront {
+  GPOPDBusInterface base;
+  /* GPOPFrontWorker */
+  GPtrArray *workers;
+  gchar **worker_args;
+  /* GPOPFrontPipeline, the proxies of the pipelines of the workers */
+  GList *pipelines;
+  /* live migrations in progress */
+  GList *migrations;
+  /* numbers of the proxies whose id is taken, past the ranges of the
+   * workers */
+  guint next_num;
+  GPOPRequestCache *requests;
+  guint stats_filter_id;
+  GPOPPressureLevel pressure;
+  GCancellable *cancellable;
+  gboolean stopping;
+};
+
+struct _GPOPFrontClass
+{
+  GPOPDBusInterfaceClass base;
+};
+
+GType gpop_front_get_type (void);
+
+GPOPFront * gpop_front_new (GDBusConnection * connection, guint n_workers, const gchar * const * worker_args);
+void gpop_front_stop (GPOPFront * front, guint timeout_ms);
+void gpop_front_free (GPOPFront * front);
+
+#endif /* _GPOP_FRONT_H_ */
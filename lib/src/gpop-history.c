@@ -0,0 +1,274 @@
+/*
+ * GStreamer Prince of Parser
+ *
+ * Copyright (C) 2020 Stéphane Cerveau
+ *
+ * SPDX-License-Identifier: LGPL
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation
+ * version 2.1 of the License.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301 USA
+ *
+ */
+
+#include <math.h>
+#include <string.h>
+
+#include "gpop-private.h"
+
+typedef struct
+{
+  guint period;
+  guint capacity;
+} GPOPHistoryLevel;
+
+static const GPOPHistoryLevel levels[GPOP_HISTORY_LAST] = {
+  {1, 600},
+  {60, 1440},
+  {3600, 168},
+};
+
+typedef struct
+{
+  /* newest stored period, in periods since the epoch */
+  gint64 last;
+  /* period being accumulated */
+  gint64 pending;
+  gdouble *sums;
+  guint *counts;
+  /* n_metrics columns of capacity values */
+  gfloat *columns;
+} GPOPHistoryRing;
+
+typedef struct
+{
+  const gchar *const *metrics;
+  guint n_metrics;
+  gint64 updated;
+  /* last recorded values */
+  gdouble *values;
+  GPOPHistoryRing rings[GPOP_HISTORY_LAST];
+} GPOPHistorySeries;
+
+struct _GPOPHistory
+{
+  /* id to GPOPHistorySeries, the manager is "" */
+  GHashTable *series;
+};
+
+static GPOPHistorySeries *
+gpop_history_series_new (const gchar * const *metrics)
+{
+  GPOPHistorySeries *series = g_new0 (GPOPHistorySeries, 1);
+  guint r, i;
+
+  series->metrics = metrics;
+  series->n_metrics = g_strv_length ((gchar **) metrics);
+  series->values = g_new0 (gdouble, series->n_metrics);
+  for (r = 0; r < GPOP_HISTORY_LAST; r++) {
+    GPOPHistoryRing *ring = &series->rings[r];
+    guint n_values = series->n_metrics * levels[r].capacity;
+
+    ring->last = ring->pending = -1;
+    ring->sums = g_new0 (gdouble, series->n_metrics);
+    ring->counts = g_new0 (guint, series->n_metrics);
+    ring->columns = g_new (gfloat, n_values);
+    for (i = 0; i < n_values; i++)
+      ring->columns[i] = NAN;
+  }
+  return series;
+}
+
+static void
+gpop_history_series_free (GPOPHistorySeries * series)
+{
+  guint r;
+
+  for (r = 0; r < GPOP_HISTORY_LAST; r++) {
+    g_free (series->rings[r].sums);
+    g_free (series->rings[r].counts);
+    g_free (series->rings[r].columns);
+  }
+  g_free (series->values);
+  g_free (series);
+}
+
+static void
+gpop_history_ring_store (GPOPHistorySeries * series, GPOPHistoryResolution r,
+    gint64 index, const gdouble * values)
+{
+  GPOPHistoryRing *ring = &series->rings[r];
+  guint capacity = levels[r].capacity;
+  gint64 i;
+  guint m;
+
+  /* the wall clock went back */
+  if (index <= ring->last)
+    return;
+
+  /* the periods without any record */
+  if (ring->last >= 0) {
+    for (i = MAX (ring->last + 1, index - capacity + 1); i < index; i++)
+      for (m = 0; m < series->n_metrics; m++)
+        ring->columns[m * capacity + i % capacity] = NAN;
+  }
+  for (m = 0; m < series->n_metrics; m++)
+    ring->columns[m * capacity + index % capacity] = values[m];
+  ring->last = index;
+}
+
+/* Accumulates the values of a period of the resolution r, the mean is
+ * stored and downsampled into the next resolution once the period is
+ * complete */
+static void
+gpop_history_ring_add (GPOPHistorySeries * series, GPOPHistoryResolution r,
+    gint64 index, const gdouble * values)
+{
+  GPOPHistoryRing *ring = &series->rings[r];
+  guint m;
+
+  if (ring->pending != index) {
+    if (ring->pending >= 0) {
+      gdouble *means = g_newa (gdouble, series->n_metrics);
+
+      for (m = 0; m < series->n_metrics; m++)
+        means[m] = ring->counts[m] ? ring->sums[m] / ring->counts[m] : NAN;
+      gpop_history_ring_store (series, r, ring->pending, means);
+      if (r + 1 < GPOP_HISTORY_LAST)
+        gpop_history_ring_add (series, r + 1,
+            ring->pending * levels[r].period / levels[r + 1].period, means);
+    }
+    for (m = 0; m < series->n_metrics; m++) {
+      ring->sums[m] = 0;
+      ring->counts[m] = 0;
+    }
+    ring->pending = index;
+  }
+
+  for (m = 0; m < series->n_metrics; m++) {
+    if (isnan (values[m]))
+      continue;
+    ring->sums[m] += values[m];
+    ring->counts[m]++;
+  }
+}
+
+/* API */
+
+GPOPHistory *
+gpop_history_new (void)
+{
+  GPOPHistory *history = g_new0 (GPOPHistory, 1);
+
+  history->series = g_hash_table_new_full (g_str_hash, g_str_equal, g_free,
+      (GDestroyNotify) gpop_history_series_free);
+  return history;
+}
+
+void
+gpop_history_free (GPOPHistory * history)
+{
+  g_hash_table_unref (history->series);
+  g_free (history);
+}
+
+/* Records the values of the metrics of a series at time, in seconds since
+ * the epoch */
+void
+gpop_history_record (GPOPHistory * history, const gchar * id,
+    const gchar * const *metrics, const gdouble * values, gint64 time)
+{
+  GPOPHistorySeries *series = g_hash_table_lookup (history->series, id);
+
+  if (!series) {
+    series = gpop_history_series_new (metrics);
+    g_hash_table_insert (history->series, g_strdup (id), series);
+  }
+  g_return_if_fail (series->metrics == metrics);
+
+  /* a series sampled less often holds its values in between */
+  if (series->updated
+      && time - series->updated <= GPOP_HISTORY_MAX_HOLD_SECONDS) {
+    gint64 second;
+
+    for (second = series->updated + 1; second < time; second++)
+      gpop_history_ring_add (series, GPOP_HISTORY_SECOND, second,
+          series->values);
+  }
+  series->updated = time;
+  memcpy (series->values, values, series->n_metrics * sizeof (gdouble));
+  gpop_history_ring_add (series, GPOP_HISTORY_SECOND, time, values);
+}
+
+/* Drops the series not recorded since time, the removed pipelines */
+void
+gpop_history_expire (GPOPHistory * history, gint64 time)
+{
+  GHashTableIter iter;
+  GPOPHistorySeries *series;
+
+  g_hash_table_iter_init (&iter, history->series);
+  while (g_hash_table_iter_next (&iter, NULL, (gpointer *) & series)) {
+    if (series->updated < time)
+      g_hash_table_iter_remove (&iter);
+  }
+}
+
+/* Returns (x start, u period, ad values): the values of the metric over the
+ * last range_seconds at the finest resolution covering it, the oldest
+ * first, start being the time of the first value. */
+GVariant *
+gpop_history_get (GPOPHistory * history, const gchar * id,
+    const gchar * metric, guint range_seconds, GError ** error)
+{
+  GPOPHistorySeries *series = g_hash_table_lookup (history->series, id);
+  GPOPHistoryResolution r;
+  GPOPHistoryRing *ring;
+  gdouble *values;
+  GVariant *ret;
+  guint m, n, capacity, i;
+  gint64 first;
+
+  if (!series) {
+    g_set_error (error, G_DBUS_ERROR, G_DBUS_ERROR_INVALID_ARGS,
+        "No history for '%s'", id);
+    return NULL;
+  }
+  for (m = 0; m < series->n_metrics; m++)
+    if (!g_strcmp0 (series->metrics[m], metric))
+      break;
+  if (m == series->n_metrics) {
+    g_set_error (error, G_DBUS_ERROR, G_DBUS_ERROR_INVALID_ARGS,
+        "No metric '%s' for '%s'", metric, id);
+    return NULL;
+  }
+
+  for (r = 0; r < GPOP_HISTORY_LAST - 1; r++)
+    if ((guint64) levels[r].period * levels[r].capacity >= range_seconds)
+      break;
+  ring = &series->rings[r];
+  capacity = levels[r].capacity;
+  n = ring->last < 0 ? 0 :
+      MIN ((range_seconds + levels[r].period - 1) / levels[r].period,
+      capacity);
+  first = ring->last - n + 1;
+
+  values = g_new (gdouble, MAX (n, 1));
+  for (i = 0; i < n; i++)
+    values[i] = ring->columns[m * capacity + (first + i) % capacity];
+  ret = g_variant_new ("(xu@ad)", first * levels[r].period, levels[r].period,
+      g_variant_new_fixed_array (G_VARIANT_TYPE_DOUBLE, values, n,
+          sizeof (gdouble)));
+  g_free (values);
+  return ret;
+}
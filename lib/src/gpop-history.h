@@ -0,0 +1,63 @@
+/*
+ * GStreamer Prince of Parser
+ *
+ * Copyright (C) 2020 Stéphane Cerveau
+ *
+ * SPDX-License-Identifier: LGPL
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation
+ * version 2.1 of the License.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301 USA
+ *
+ */
+
+#ifndef _GPOP_HISTORY_H_
+#define _GPOP_HISTORY_H_
+
+#include <glib-2.0/glib.h>
+
+/* In-memory history of the metrics.
+ *
+ * Each series, the manager or a pipeline, keeps its metrics at three
+ * resolutions: one value per second over 10 minutes, per minute over a day
+ * and per hour over a week. The values of a resolution are stored
+ * column-wise, one ring of floats per metric, so that a series has a fixed
+ * size and a range of a metric is a contiguous read. The coarser
+ * resolutions are downsampled from the finer one as periods complete, each
+ * value being the mean of the known values of the period; missing values
+ * are NaN. A series recorded less often than every second, as the daemon
+ * does while idle, holds its last values for up to
+ * GPOP_HISTORY_MAX_HOLD_SECONDS. */
+
+#define GPOP_HISTORY_MAX_HOLD_SECONDS 60
+
+typedef enum {
+  GPOP_HISTORY_SECOND,
+  GPOP_HISTORY_MINUTE,
+  GPOP_HISTORY_HOUR,
+  GPOP_HISTORY_LAST,
+} GPOPHistoryResolution;
+
+typedef struct _GPOPHistory GPOPHistory;
+
+GPOPHistory * gpop_history_new (void);
+void gpop_history_free (GPOPHistory * history);
+
+/* metrics is a NULL terminated array of static names, the same for every
+ * record of a series */
+void gpop_history_record (GPOPHistory * history, const gchar * id, const gchar * const * metrics, const gdouble * values, gint64 time);
+void gpop_history_expire (GPOPHistory * history, gint64 time);
+
+GVariant * gpop_history_get (GPOPHistory * history, const gchar * id, const gchar * metric, guint range_seconds, GError ** error);
+
+#endif /* _GPOP_HISTORY_H_ */
@@ -0,0 +1,398 @@
+/*
+ * GStreamer Prince of Parser
+ *
+ * Copyright (C) 2020 Stéphane Cerveau
+ *
+ * SPDX-License-Identifier: LGPL
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation
+ * version 2.1 of the License.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301 USA
+ *
+ */
+
+#include <string.h>
+
+#include "gpop-private.h"
+
+/* Name of the last element of the encoding part of a branch */
+#define GPOP_LADDER_OUT_NAME "out"
+
+typedef struct
+{
+  gint refcount;
+  gchar *name;
+  gint width;
+  gint height;
+  gchar *encoder_desc;
+  gchar *output_desc;
+  /* in the running pipeline */
+  GstElement *branch;
+  GstPad *tee_pad;
+  gint pending_sinks;
+  /* updated from the streaming thread */
+  GMutex lock;
+  guint64 frames;
+  guint64 bytes;
+} GPOPRendition;
+
+struct _GPOPLadder
+{
+  gchar *source_desc;
+  /* GPOPRendition, in the order of their addition */
+  GList *renditions;
+};
+
+static GPOPRendition *
+gpop_rendition_ref (GPOPRendition * rendition)
+{
+  g_atomic_int_inc (&rendition->refcount);
+  return rendition;
+}
+
+static void
+gpop_rendition_unref (GPOPRendition * rendition)
+{
+  if (!g_atomic_int_dec_and_test (&rendition->refcount))
+    return;
+
+  g_clear_object (&rendition->tee_pad);
+  g_clear_object (&rendition->branch);
+  g_mutex_clear (&rendition->lock);
+  g_free (rendition->name);
+  g_free (rendition->encoder_desc);
+  g_free (rendition->output_desc);
+  g_free (rendition);
+}
+
+static GPOPRendition *
+gpop_ladder_lookup (GPOPLadder * ladder, const gchar * name)
+{
+  GList *l;
+
+  for (l = ladder->renditions; l; l = g_list_next (l)) {
+    GPOPRendition *rendition = l->data;
+    if (!g_strcmp0 (rendition->name, name))
+      return rendition;
+  }
+  return NULL;
+}
+
+static gboolean
+gpop_ladder_is_valid_name (const gchar * name)
+{
+  const gchar *c;
+
+  if (!name || !*name)
+    return FALSE;
+  for (c = name; *c; c++) {
+    if (!g_ascii_isalnum (*c) && *c != '_' && *c != '-')
+      return FALSE;
+  }
+  return TRUE;
+}
+
+static GstPadProbeReturn
+gpop_ladder_count_buffer (GstPad * pad, GstPadProbeInfo * info,
+    gpointer user_data)
+{
+  GPOPRendition *rendition = (GPOPRendition *) user_data;
+  GstBuffer *buffer = GST_PAD_PROBE_INFO_BUFFER (info);
+
+  g_mutex_lock (&rendition->lock);
+  rendition->frames++;
+  rendition->bytes += gst_buffer_get_size (buffer);
+  g_mutex_unlock (&rendition->lock);
+
+  return GST_PAD_PROBE_OK;
+}
+
+/* Drops a branch which is not linked to the tee anymore, from the main
+ * thread */
+static gboolean
+gpop_ladder_release_branch (gpointer user_data)
+{
+  GPOPRendition *rendition = (GPOPRendition *) user_data;
+  GstElement *tee;
+  GstObject *parent;
+
+  if (rendition->tee_pad) {
+    tee = gst_pad_get_parent_element (rendition->tee_pad);
+    if (tee) {
+      gst_element_release_request_pad (tee, rendition->tee_pad);
+      gst_object_unref (tee);
+    }
+    g_clear_object (&rendition->tee_pad);
+  }
+
+  if (rendition->branch) {
+    gst_element_set_state (rendition->branch, GST_STATE_NULL);
+    parent = gst_object_get_parent (GST_OBJECT (rendition->branch));
+    if (parent) {
+      gst_bin_remove (GST_BIN (parent), rendition->branch);
+      gst_object_unref (parent);
+    }
+    g_clear_object (&rendition->branch);
+  }
+  GPOP_LOG ("Rendition %s removed", rendition->name);
+
+  return G_SOURCE_REMOVE;
+}
+
+static GstPadProbeReturn
+gpop_ladder_on_branch_eos (GstPad * pad, GstPadProbeInfo * info,
+    gpointer user_data)
+{
+  GPOPRendition *rendition = (GPOPRendition *) user_data;
+
+  if (GST_EVENT_TYPE (GST_PAD_PROBE_INFO_EVENT (info)) != GST_EVENT_EOS)
+    return GST_PAD_PROBE_OK;
+
+  /* the outputs of the branch are finalized */
+  if (g_atomic_int_dec_and_test (&rendition->pending_sinks))
+    g_idle_add_full (G_PRIORITY_DEFAULT, gpop_ladder_release_branch,
+        gpop_rendition_ref (rendition),
+        (GDestroyNotify) gpop_rendition_unref);
+
+  return GST_PAD_PROBE_REMOVE;
+}
+
+/* Once the tee pad is idle, the branch is unlinked and gets EOS */
+static GstPadProbeReturn
+gpop_ladder_unlink_branch (GstPad * pad, GstPadProbeInfo * info,
+    gpointer user_data)
+{
+  GPOPRendition *rendition = (GPOPRendition *) user_data;
+  GstPad *sink_pad = gst_element_get_static_pad (rendition->branch, "sink");
+  GstIterator *it;
+  GValue item = G_VALUE_INIT;
+
+  gst_pad_unlink (rendition->tee_pad, sink_pad);
+
+  g_atomic_int_set (&rendition->pending_sinks, 1);
+  it = gst_bin_iterate_sinks (GST_BIN (rendition->branch));
+  while (gst_iterator_next (it, &item) == GST_ITERATOR_OK) {
+    GstPad *pad = gst_element_get_static_pad (g_value_get_object (&item),
+        "sink");
+    if (pad) {
+      g_atomic_int_inc (&rendition->pending_sinks);
+      gst_pad_add_probe (pad, GST_PAD_PROBE_TYPE_EVENT_DOWNSTREAM,
+          gpop_ladder_on_branch_eos, gpop_rendition_ref (rendition),
+          (GDestroyNotify) gpop_rendition_unref);
+      gst_object_unref (pad);
+    }
+    g_value_reset (&item);
+  }
+  g_value_unset (&item);
+  gst_iterator_free (it);
+
+  gst_pad_send_event (sink_pad, gst_event_new_eos ());
+  gst_object_unref (sink_pad);
+
+  /* without any sink to wait for */
+  if (g_atomic_int_dec_and_test (&rendition->pending_sinks))
+    g_idle_add_full (G_PRIORITY_DEFAULT, gpop_ladder_release_branch,
+        gpop_rendition_ref (rendition),
+        (GDestroyNotify) gpop_rendition_unref);
+
+  return GST_PAD_PROBE_REMOVE;
+}
+
+/* Builds the branch of a rendition and links it to the tee */
+static gboolean
+gpop_ladder_link_rendition (GPOPRendition * rendition, GstElement * pipeline,
+    GError ** error)
+{
+  GstElement *tee, *branch, *out;
+  GstObject *parent;
+  GstPad *sink_pad, *src_pad;
+  gchar *desc, *name;
+  gboolean res = FALSE;
+
+  tee = gst_bin_get_by_name (GST_BIN (pipeline), GPOP_LADDER_TEE_NAME);
+  if (!tee) {
+    g_set_error (error, GST_CORE_ERROR, GST_CORE_ERROR_FAILED,
+        "No ladder tee in the pipeline");
+    return FALSE;
+  }
+
+  desc = g_strdup_printf ("queue ! videoscale ! videoconvert ! "
+      "video/x-raw,width=%d,height=%d ! %s ! identity name="
+      GPOP_LADDER_OUT_NAME " silent=true ! %s", rendition->width,
+      rendition->height, rendition->encoder_desc, rendition->output_desc);
+  branch = gst_parse_bin_from_description (desc, TRUE, error);
+  g_free (desc);
+  if (!branch)
+    goto done;
+  name = g_strdup_printf ("rendition_%s", rendition->name);
+  gst_object_set_name (GST_OBJECT (branch), name);
+  g_free (name);
+
+  out = gst_bin_get_by_name (GST_BIN (branch), GPOP_LADDER_OUT_NAME);
+  src_pad = gst_element_get_static_pad (out, "src");
+  gst_pad_add_probe (src_pad, GST_PAD_PROBE_TYPE_BUFFER,
+      gpop_ladder_count_buffer, gpop_rendition_ref (rendition),
+      (GDestroyNotify) gpop_rendition_unref);
+  gst_object_unref (src_pad);
+  gst_object_unref (out);
+
+  parent = gst_object_get_parent (GST_OBJECT (tee));
+  gst_bin_add (GST_BIN (parent), branch);
+  gst_object_unref (parent);
+  /* not to get flushing on a running tee */
+  gst_element_sync_state_with_parent (branch);
+
+  rendition->tee_pad = gst_element_get_request_pad (tee, "src_%u");
+  sink_pad = gst_element_get_static_pad (branch, "sink");
+  res = gst_pad_link (rendition->tee_pad, sink_pad) == GST_PAD_LINK_OK;
+  gst_object_unref (sink_pad);
+  rendition->branch = gst_object_ref (branch);
+  if (!res) {
+    g_set_error (error, GST_CORE_ERROR, GST_CORE_ERROR_NEGOTIATION,
+        "Unable to link the rendition %s", rendition->name);
+    gpop_ladder_release_branch (rendition);
+  }
+
+done:
+  gst_object_unref (tee);
+  return res;
+}
+
+/* API */
+
+GPOPLadder *
+gpop_ladder_new (const gchar * source_desc)
+{
+  GPOPLadder *ladder = g_new0 (GPOPLadder, 1);
+
+  ladder->source_desc = g_strdup (source_desc);
+  return ladder;
+}
+
+void
+gpop_ladder_free (GPOPLadder * ladder)
+{
+  g_list_free_full (ladder->renditions, (GDestroyNotify) gpop_rendition_unref);
+  g_free (ladder->source_desc);
+  g_free (ladder);
+}
+
+/* The decoding part, the branches are added by gpop_ladder_attach() */
+gchar *
+gpop_ladder_get_description (GPOPLadder * ladder)
+{
+  return g_strdup_printf ("%s ! decodebin ! videoconvert ! tee name="
+      GPOP_LADDER_TEE_NAME " allow-not-linked=true", ladder->source_desc);
+}
+
+/* pipeline is the built pipeline if any, the branch is then linked right
+ * away */
+gboolean
+gpop_ladder_add_rendition (GPOPLadder * ladder, const gchar * name,
+    gint width, gint height, const gchar * encoder_desc,
+    const gchar * output_desc, GstElement * pipeline, GError ** error)
+{
+  GPOPRendition *rendition;
+
+  if (!gpop_ladder_is_valid_name (name) || gpop_ladder_lookup (ladder, name)) {
+    g_set_error (error, G_IO_ERROR, G_IO_ERROR_INVALID_ARGUMENT,
+        "Invalid or duplicated rendition name '%s'", name);
+    return FALSE;
+  }
+  if (width <= 0 || height <= 0) {
+    g_set_error (error, G_IO_ERROR, G_IO_ERROR_INVALID_ARGUMENT,
+        "Invalid size %dx%d for the rendition '%s'", width, height, name);
+    return FALSE;
+  }
+
+  rendition = g_new0 (GPOPRendition, 1);
+  rendition->refcount = 1;
+  g_mutex_init (&rendition->lock);
+  rendition->name = g_strdup (name);
+  rendition->width = width;
+  rendition->height = height;
+  rendition->encoder_desc = g_strdup (encoder_desc);
+  rendition->output_desc = g_strdup (output_desc);
+
+  if (pipeline && !gpop_ladder_link_rendition (rendition, pipeline, error)) {
+    gpop_rendition_unref (rendition);
+    return FALSE;
+  }
+
+  ladder->renditions = g_list_append (ladder->renditions, rendition);
+  return TRUE;
+}
+
+gboolean
+gpop_ladder_remove_rendition (GPOPLadder * ladder, const gchar * name,
+    GError ** error)
+{
+  GPOPRendition *rendition = gpop_ladder_lookup (ladder, name);
+
+  if (!rendition) {
+    g_set_error (error, G_IO_ERROR, G_IO_ERROR_NOT_FOUND,
+        "No rendition '%s'", name);
+    return FALSE;
+  }
+  ladder->renditions = g_list_remove (ladder->renditions, rendition);
+
+  if (rendition->branch && GST_STATE (rendition->branch) >= GST_STATE_PAUSED) {
+    gst_pad_add_probe (rendition->tee_pad, GST_PAD_PROBE_TYPE_IDLE,
+        gpop_ladder_unlink_branch, gpop_rendition_ref (rendition),
+        (GDestroyNotify) gpop_rendition_unref);
+  } else {
+    gpop_ladder_release_branch (rendition);
+  }
+  gpop_rendition_unref (rendition);
+
+  return TRUE;
+}
+
+/* To be called on a newly built pipeline, before its first state change */
+gboolean
+gpop_ladder_attach (GPOPLadder * ladder, GstElement * pipeline,
+    GError ** error)
+{
+  GList *l;
+
+  for (l = ladder->renditions; l; l = g_list_next (l)) {
+    GPOPRendition *rendition = l->data;
+
+    /* the branches of a previous build went with it */
+    g_clear_object (&rendition->tee_pad);
+    g_clear_object (&rendition->branch);
+    if (!gpop_ladder_link_rendition (rendition, pipeline, error))
+      return FALSE;
+  }
+  return TRUE;
+}
+
+/* a(siisstt): name, width, height, encoder, output, frames, bytes */
+GVariant *
+gpop_ladder_to_variant (GPOPLadder * ladder)
+{
+  GVariantBuilder builder;
+  GList *l;
+
+  g_variant_builder_init (&builder, G_VARIANT_TYPE ("a(siisstt)"));
+  for (l = ladder->renditions; l; l = g_list_next (l)) {
+    GPOPRendition *rendition = l->data;
+
+    g_mutex_lock (&rendition->lock);
+    g_variant_builder_add (&builder, "(siisstt)", rendition->name,
+        rendition->width, rendition->height, rendition->encoder_desc,
+        rendition->output_desc, rendition->frames, rendition->bytes);
+    g_mutex_unlock (&rendition->lock);
+  }
+  return g_variant_builder_end (&builder);
+}
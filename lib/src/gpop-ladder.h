@@ -0,0 +1,57 @@
+/*
+ * GStreamer Prince of Parser
+ *
+ * Copyright (C) 2020 Stéphane Cerveau
+ *
+ * SPDX-License-Identifier: LGPL
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation
+ * version 2.1 of the License.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301 USA
+ *
+ */
+
+#ifndef _GPOP_LADDER_H_
+#define _GPOP_LADDER_H_
+
+#include <gst/gst.h>
+
+/* Adaptive bitrate ladder: several renditions of a single input.
+ *
+ * The source is decoded once into a tee, each rendition is a branch of the
+ * tee scaling and encoding the decoded video from its own queue thread:
+ *
+ *   <source> ! decodebin ! videoconvert ! tee
+ *     tee. ! queue ! videoscale ! videoconvert ! video/x-raw,width=W,height=H
+ *          ! <encoder> ! identity ! <output>
+ *
+ * The branches are added to the pipeline once it is built, and can be added
+ * or removed while it runs; a removed branch gets EOS so that its output is
+ * finalized. The frames and bytes produced by each encoder are counted. */
+
+#define GPOP_LADDER_TEE_NAME "ladder"
+
+typedef struct _GPOPLadder GPOPLadder;
+
+GPOPLadder * gpop_ladder_new (const gchar * source_desc);
+void gpop_ladder_free (GPOPLadder * ladder);
+
+gchar * gpop_ladder_get_description (GPOPLadder * ladder);
+
+gboolean gpop_ladder_add_rendition (GPOPLadder * ladder, const gchar * name, gint width, gint height, const gchar * encoder_desc, const gchar * output_desc, GstElement * pipeline, GError ** error);
+gboolean gpop_ladder_remove_rendition (GPOPLadder * ladder, const gchar * name, GError ** error);
+gboolean gpop_ladder_attach (GPOPLadder * ladder, GstElement * pipeline, GError ** error);
+
+GVariant * gpop_ladder_to_variant (GPOPLadder * ladder);
+
+#endif /* _GPOP_LADDER_H_ */
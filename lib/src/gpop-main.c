@@ -33,11 +33,29 @@
 typedef struct _MainApp
 {
   GPOPManager *manager;
+  /* with --workers, the front of the worker daemons */
+  GPOPFront *front;
+  gint workers;
+  gint worker;
+  gchar **worker_args;
   GMainLoop *loop;
 #ifdef G_OS_UNIX
   guint signal_watch_intr_id;
+  guint signal_watch_hup_id;
 #endif
   gchar **pipeline_desc_array;
+  gchar *record_path;
+  gboolean compact;
+  gboolean prewarm;
+  gboolean placement;
+  gint rate_limit;
+  gint element_pool;
+  gint drain_timeout;
+  gint timer_slack;
+  gchar *config_path;
+  GPOPConfig *config;
+  gchar *checkpoint_path;
+  gint checkpoint_interval;
 } MainApp;
 
 void
@@ -62,8 +80,30 @@ intr_handler (gpointer user_data)
 
   return G_SOURCE_REMOVE;
 }
+
+static gboolean
+hup_handler (gpointer user_data)
+{
+  MainApp *app = (MainApp *) user_data;
+  GError *err = NULL;
+
+  if (app->config && !gpop_config_reload (app->config, &err)) {
+    GPOP_LOG ("Unable to reload the configuration: %s", err->message);
+    g_error_free (err);
+  }
+
+  return G_SOURCE_CONTINUE;
+}
 #endif
 
+static void
+on_config (GPtrArray * pipelines, gpointer user_data)
+{
+  MainApp *app = (MainApp *) user_data;
+
+  gpop_manager_apply_config (app->manager, pipelines);
+}
+
 static void
 on_bus_acquired (GDBusConnection * connection,
     const gchar * name, gpointer user_data)
@@ -74,14 +114,51 @@ on_bus_acquired (GDBusConnection * connection,
 
   GPOP_LOG ("Acquired a message bus connection %s", name);
 
+  if (app->workers > 0) {
+    app->front = gpop_front_new (connection, app->workers,
+        (const gchar * const *) app->worker_args);
+    return;
+  }
+
   /* Create a new manager */
   app->manager = gpop_manager_new (connection);
+  if (app->worker >= 0)
+    gpop_manager_set_first_num (app->manager,
+        app->worker * GPOP_FRONT_WORKER_NUMS);
+  gpop_manager_set_compact (app->manager, app->compact);
+  gpop_manager_set_prewarm (app->manager, app->prewarm);
+  gpop_manager_set_placement (app->manager, app->placement);
+  if (app->checkpoint_path) {
+    GError *err = NULL;
+    /* each worker journals its own pipelines */
+    gchar *path = app->worker >= 0 ?
+        g_strdup_printf ("%s.%d", app->checkpoint_path, app->worker) :
+        g_strdup (app->checkpoint_path);
+
+    if (!gpop_manager_set_checkpoint (app->manager, path,
+            MAX (app->checkpoint_interval, 1), &err)) {
+      GPOP_LOG ("Unable to load the checkpoints: %s", err->message);
+      g_error_free (err);
+    }
+    g_free (path);
+  }
 
   /* Add hardcoded edge to the manager */
   for (pipeline_desc = app->pipeline_desc_array;
       pipeline_desc != NULL && *pipeline_desc != NULL; ++pipeline_desc) {
     gpop_manager_add_pipeline (app->manager, i++, NULL, *pipeline_desc);
   }
+
+  if (app->config_path) {
+    GError *err = NULL;
+
+    app->config = gpop_config_new (app->config_path, on_config, app, &err);
+    if (!app->config) {
+      GPOP_LOG ("Unable to load the configuration: %s", err->message);
+      g_error_free (err);
+      quit_app (app);
+    }
+  }
 }
 
 static void
@@ -95,9 +172,70 @@ static void
 on_name_lost (GDBusConnection * connection,
     const gchar * name, gpointer user_data)
 {
+  MainApp *app = (MainApp *) user_data;
+
   GPOP_LOG ("Lost the name %s", name);
+  /* the front restarts its workers */
+  if (app->worker >= 0)
+    quit_app (app);
+}
+
+/* Command line of the workers of the front, see gpop-front.h */
+static gchar **
+build_worker_args (MainApp * app, const gchar * argv0)
+{
+  GPtrArray *args = g_ptr_array_new ();
+  gchar *exe = g_file_read_link ("/proc/self/exe", NULL);
+
+  g_ptr_array_add (args, exe ? exe : g_strdup (argv0));
+  /* the front rate limits the clients, the workers only serve it */
+  g_ptr_array_add (args, g_strdup ("--rate-limit=0"));
+  g_ptr_array_add (args, g_strdup_printf ("--element-pool=%d",
+          app->element_pool));
+  g_ptr_array_add (args, g_strdup_printf ("--timer-slack=%d",
+          app->timer_slack));
+  g_ptr_array_add (args, g_strdup_printf ("--drain-timeout=%d",
+          app->drain_timeout));
+  if (app->compact)
+    g_ptr_array_add (args, g_strdup ("--compact"));
+  if (app->prewarm)
+    g_ptr_array_add (args, g_strdup ("--prewarm"));
+  if (app->placement)
+    g_ptr_array_add (args, g_strdup ("--placement"));
+  if (app->checkpoint_path) {
+    g_ptr_array_add (args, g_strdup_printf ("--checkpoint=%s",
+            app->checkpoint_path));
+    g_ptr_array_add (args, g_strdup_printf ("--checkpoint-interval=%d",
+            app->checkpoint_interval));
+  }
+  g_ptr_array_add (args, NULL);
+
+  return (gchar **) g_ptr_array_free (args, FALSE);
+}
+
+/* To be called before gst_init() */
+void
+gpop_prepare (void)
+{
+#ifdef GPOP_STATIC_BUILD
+  /* Everything is linked in, there are no plugins to scan and load */
+  g_setenv ("GST_REGISTRY_DISABLE", "yes", FALSE);
+#endif
 }
 
+/* Registers the elements of gpop, and the plugins of a static build, to be
+ * called after gst_init() */
+void
+gpop_register_elements (void)
+{
+#ifdef GPOP_STATIC_PLUGINS
+  gpop_static_plugins_register ();
+#endif
+  gpop_mmap_src_register ();
+#ifdef GPOP_ENABLE_IO_URING
+  gpop_uring_sink_register ();
+#endif
+}
 
 gint
 gpop_main (gint argc, gchar * argv[])
@@ -106,16 +244,71 @@ gpop_main (gint argc, gchar * argv[])
   GError *err = NULL;
   GOptionContext *ctx;
   guint dbus_id = 0;
+  gchar *bus_name;
 
   MainApp *app = g_new0 (MainApp, 1);
 
+  app->worker = -1;
+  app->rate_limit = GPOP_RATE_LIMIT_DEFAULT_RATE;
+  app->drain_timeout = GPOP_MANAGER_DEFAULT_DRAIN_TIMEOUT_SECONDS;
+  app->timer_slack = GPOP_TIMERS_DEFAULT_SLACK_MS;
+  app->checkpoint_interval = GPOP_CHECKPOINT_DEFAULT_INTERVAL_SECONDS;
+
   GOptionEntry options[] = {
     {"pipeline", 'p', 0, G_OPTION_ARG_STRING_ARRAY, &app->pipeline_desc_array,
         "Add pipeline with format ip:port ie 192.168.0.10:5555", NULL}
     ,
+    {"record", 'r', 0, G_OPTION_ARG_FILENAME, &app->record_path,
+        "Record the D-Bus requests into the given file", NULL}
+    ,
+    {"compact", 'c', 0, G_OPTION_ARG_NONE, &app->compact,
+        "Minimize the footprint of idle pipelines, they are only built on "
+          "their first state change", NULL}
+    ,
+    {"prewarm", 0, 0, G_OPTION_ARG_NONE, &app->prewarm,
+        "Pre-warm the buffer pools of the new pipelines", NULL}
+    ,
+    {"placement", 0, 0, G_OPTION_ARG_NONE, &app->placement,
+        "Place the pipelines on the cpus according to their load", NULL}
+    ,
+    {"rate-limit", 0, 0, G_OPTION_ARG_INT, &app->rate_limit,
+          "Request cost units per second allowed per client, 0 to disable "
+          "(default 50)", "RATE"}
+    ,
+    {"element-pool", 0, 0, G_OPTION_ARG_INT, &app->element_pool,
+          "Keep up to SIZE encoders and muxers for reuse by the rebuilt "
+          "pipelines (default 0, disabled)", "SIZE"}
+    ,
+    {"config", 0, 0, G_OPTION_ARG_FILENAME, &app->config_path,
+        "Pipelines configuration file, reloaded on change and on SIGHUP",
+        "FILE"}
+    ,
+    {"checkpoint", 0, 0, G_OPTION_ARG_FILENAME, &app->checkpoint_path,
+        "Journal the progress of the file pipelines to resume them after a "
+          "restart", "FILE"}
+    ,
+    {"checkpoint-interval", 0, 0, G_OPTION_ARG_INT, &app->checkpoint_interval,
+        "Seconds between two checkpoints (default 10)", "SECONDS"}
+    ,
+    {"timer-slack", 0, 0, G_OPTION_ARG_INT, &app->timer_slack,
+          "Milliseconds the periodic work may be delayed to share wakeups "
+          "(default 250)", "MS"}
+    ,
+    {"drain-timeout", 0, 0, G_OPTION_ARG_INT, &app->drain_timeout,
+          "Seconds given to the playing pipelines to finish on shutdown, "
+          "0 to stop them right away (default 10)", "SECONDS"}
+    ,
+    {"workers", 0, 0, G_OPTION_ARG_INT, &app->workers,
+          "Share the pipelines between N worker daemons, one per group of "
+          "cpus (default 0, disabled)", "N"}
+    ,
+    {"worker", 0, G_OPTION_FLAG_HIDDEN, G_OPTION_ARG_INT, &app->worker,
+        "Run as the worker N of a front", "N"}
+    ,
     {NULL}
   };
 
+  gpop_prepare ();
   ctx = g_option_context_new ("[ADDITIONAL ARGUMENTS]");
   g_option_context_add_main_entries (ctx, options, NULL);
   g_option_context_add_group (ctx, gst_init_get_option_group ());
@@ -125,28 +318,81 @@ gpop_main (gint argc, gchar * argv[])
     goto done;
   }
   g_option_context_free (ctx);
+  if (app->workers > 0 && (app->pipeline_desc_array || app->config_path)) {
+    GPOP_LOG ("Error initializing: --pipeline and --config are not "
+        "supported with --workers");
+    res = -1;
+    goto done;
+  }
+  if (app->workers > 0)
+    app->worker_args = build_worker_args (app, argv[0]);
+  gpop_rate_limit_configure (MAX (app->rate_limit, 0),
+      MAX (app->rate_limit, 0) * 2);
+  gpop_element_pool_configure (MAX (app->element_pool, 0));
+  gpop_timers_set_slack (MAX (app->timer_slack, 0));
+  gpop_register_elements ();
+
+  if (app->record_path && !gpop_recorder_start (app->record_path, &err)) {
+    GPOP_LOG ("Error initializing: %s", err->message);
+    g_error_free (err);
+    res = -1;
+    goto done;
+  }
 
   app->loop = g_main_loop_new (NULL, FALSE);
 
-  dbus_id = g_bus_own_name (G_BUS_TYPE_SESSION,
-      "org.gpop",
-      G_BUS_NAME_OWNER_FLAGS_ALLOW_REPLACEMENT |
-      G_BUS_NAME_OWNER_FLAGS_REPLACE,
-      on_bus_acquired, on_name_acquired, on_name_lost, app, NULL);
+  if (app->worker >= 0) {
+    /* a worker leaves its name to a running instance */
+    bus_name = g_strdup_printf (GPOP_FRONT_WORKER_NAME, app->worker);
+    dbus_id = g_bus_own_name (G_BUS_TYPE_SESSION, bus_name,
+        G_BUS_NAME_OWNER_FLAGS_NONE, on_bus_acquired, on_name_acquired,
+        on_name_lost, app, NULL);
+    g_free (bus_name);
+  } else {
+    dbus_id = g_bus_own_name (G_BUS_TYPE_SESSION,
+        "org.gpop",
+        G_BUS_NAME_OWNER_FLAGS_ALLOW_REPLACEMENT |
+        G_BUS_NAME_OWNER_FLAGS_REPLACE,
+        on_bus_acquired, on_name_acquired, on_name_lost, app, NULL);
+  }
 
 #ifdef G_OS_UNIX
   app->signal_watch_intr_id =
       g_unix_signal_add (SIGINT, (GSourceFunc) intr_handler, app);
+  app->signal_watch_hup_id =
+      g_unix_signal_add (SIGHUP, (GSourceFunc) hup_handler, app);
 #endif
   g_main_loop_run (app->loop);
 
+#ifdef G_OS_UNIX
+  if (app->signal_watch_hup_id)
+    g_source_remove (app->signal_watch_hup_id);
+#endif
+  g_clear_pointer (&app->config, gpop_config_free);
+  /* no new request is served by the nested loop of the drain */
+  if (dbus_id) {
+    g_bus_unown_name (dbus_id);
+    dbus_id = 0;
+  }
+  if (app->front)
+    gpop_front_stop (app->front, MAX (app->drain_timeout, 0) * 1000);
+  if (app->manager)
+    gpop_manager_drain (app->manager, MAX (app->drain_timeout, 0) * 1000);
+
 done:
   if (dbus_id)
     g_bus_unown_name (dbus_id);
   if (app->loop)
     g_main_loop_unref (app->loop);
   gpop_manage_free (app->manager);
+  gpop_front_free (app->front);
+  gpop_element_pool_configure (0);
+  gpop_recorder_stop ();
   g_strfreev (app->pipeline_desc_array);
+  g_strfreev (app->worker_args);
+  g_free (app->record_path);
+  g_free (app->config_path);
+  g_free (app->checkpoint_path);
 
   g_free (app);
 
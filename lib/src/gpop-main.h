@@ -23,3 +23,10 @@
 
 
 int gpop_main (int argc, char * argv[]);
+void gpop_prepare (void);
+void gpop_register_elements (void);
+
+#ifdef GPOP_STATIC_PLUGINS
+/* Generated from gpop-static-plugins.c.in */
+void gpop_static_plugins_register (void);
+#endif
@@ -21,13 +21,14 @@
  *
  */
 
+#include <math.h>
+#include <string.h>
+
 #include "gpop-private.h"
 
 G_DEFINE_TYPE (GPOPManager, gpop_manager, GPOP_TYPE_DBUS_INTERFACE);
 #define parent_class gpop_manager_parent_class
 
-#define GPOP_MANAGER_OBJECT_PATH "/org/gpop/Manager"
-
 const char gpop_manager_xml_introspection[] =
     "<?xml version='1.0' encoding='UTF-8' ?>"
     "<node>"
@@ -38,10 +39,114 @@ const char gpop_manager_xml_introspection[] =
     "        </method>"
     "        <method name='AddPipeline'>"
     "		<arg type='s' name='pipeline_desc' direction='in'/>"
+    "		<arg type='s' name='id' direction='out'/>"
+    "		<arg type='o' name='path' direction='out'/>"
     "        </method>"
     "        <method name='RemovePipeline'>"
     "		<arg type='s' name='id' direction='in'/>"
     "        </method>"
+    "        <method name='AddLadder'>"
+    "		<arg type='s' name='source_desc' direction='in'/>"
+    "		<arg type='a(siiss)' name='renditions' direction='in'/>"
+    "		<arg type='s' name='id' direction='out'/>"
+    "		<arg type='o' name='path' direction='out'/>"
+    "        </method>"
+    "        <method name='PreparePipeline'>"
+    "		<arg type='s' name='pipeline_desc' direction='in'/>"
+    "		<arg type='s' name='id' direction='out'/>"
+    "		<arg type='o' name='path' direction='out'/>"
+    "        </method>"
+    "        <method name='Migrate'>"
+    "		<arg type='s' name='id' direction='in'/>"
+    "		<arg type='s' name='target' direction='in'/>"
+    "		<arg type='d' name='gap_ms' direction='out'/>"
+    "        </method>"
+    "        <method name='AddPipelines'>"
+    "		<arg type='as' name='pipeline_descs' direction='in'/>"
+    "		<arg type='a(so)' name='pipelines' direction='out'/>"
+    "        </method>"
+    "        <method name='RemovePipelines'>"
+    "		<arg type='as' name='ids' direction='in'/>"
+    "		<arg type='ab' name='removed' direction='out'/>"
+    "        </method>"
+    "        <method name='AddPipelineWithKey'>"
+    "		<arg type='s' name='request_id' direction='in'/>"
+    "		<arg type='s' name='pipeline_desc' direction='in'/>"
+    "		<arg type='s' name='id' direction='out'/>"
+    "		<arg type='o' name='path' direction='out'/>"
+    "        </method>"
+    "        <method name='RemovePipelineWithKey'>"
+    "		<arg type='s' name='request_id' direction='in'/>"
+    "		<arg type='s' name='id' direction='in'/>"
+    "        </method>"
+    "        <method name='AddPipelinesWithKey'>"
+    "		<arg type='s' name='request_id' direction='in'/>"
+    "		<arg type='as' name='pipeline_descs' direction='in'/>"
+    "		<arg type='a(so)' name='pipelines' direction='out'/>"
+    "        </method>"
+    "        <method name='RemovePipelinesWithKey'>"
+    "		<arg type='s' name='request_id' direction='in'/>"
+    "		<arg type='as' name='ids' direction='in'/>"
+    "		<arg type='ab' name='removed' direction='out'/>"
+    "        </method>"
+    "        <method name='ListPipelines'>"
+    "		<arg type='a(so)' name='pipelines' direction='out'/>"
+    "        </method>"
+    "        <method name='GetControlStats'>"
+    "		<arg type='a{s(ttttat)}' name='methods' direction='out'/>"
+    "		<arg type='a{s(ttttat)}' name='senders' direction='out'/>"
+    "        </method>"
+    "        <method name='GetMetrics'>"
+    "		<arg type='s' name='metrics' direction='out'/>"
+    "        </method>"
+    "        <method name='GetHistory'>"
+    "		<arg type='s' name='id' direction='in'/>"
+    "		<arg type='s' name='metric' direction='in'/>"
+    "		<arg type='u' name='range' direction='in'/>"
+    "		<arg type='x' name='start' direction='out'/>"
+    "		<arg type='u' name='period' direction='out'/>"
+    "		<arg type='ad' name='values' direction='out'/>"
+    "        </method>"
+    "        <method name='GetPlacement'>"
+    "		<arg type='a(ssdu)' name='placement' direction='out'/>"
+    "        </method>"
+    "        <method name='StartRecording'>"
+    "		<arg type='s' name='path' direction='in'/>"
+    "        </method>"
+    "        <method name='StopRecording'>"
+    "		<arg type='u' name='records' direction='out'/>"
+    "        </method>"
+    "        <method name='Profile'>"
+    "		<arg type='u' name='duration_ms' direction='in'/>"
+    "		<arg type='u' name='frequency' direction='in'/>"
+    "		<arg type='s' name='folded' direction='out'/>"
+    "		<arg type='s' name='sampler' direction='out'/>"
+    "		<arg type='u' name='samples' direction='out'/>"
+    "        </method>"
+    "        <method name='StartTrace'/>"
+    "        <method name='StopTrace'>"
+    "		<arg type='s' name='path' direction='in'/>"
+    "		<arg type='u' name='events' direction='out'/>"
+    "        </method>"
+    "        <signal name='LoadShed'>"
+    "		<arg type='s' name='level'/>"
+    "		<arg type='s' name='action'/>"
+    "		<arg type='s' name='id'/>"
+    "        </signal>"
+    "        <signal name='SloViolated'>"
+    "		<arg type='s' name='id'/>"
+    "		<arg type='s' name='objective'/>"
+    "		<arg type='d' name='value'/>"
+    "		<arg type='d' name='target'/>"
+    "        </signal>"
+    "        <signal name='SloRecovered'>"
+    "		<arg type='s' name='id'/>"
+    "		<arg type='s' name='objective'/>"
+    "		<arg type='d' name='value'/>"
+    "		<arg type='d' name='target'/>"
+    "        </signal>"
+    "       <property name='Pressure' type='s' access='read'/>"
+    "       <property name='Tracing' type='b' access='read'/>"
     "       <property name='Pipelines' type='i' access='read'/>"
     "       <property name='Version' type='s' access='read'/>"
     "    </interface>" "</node>";
@@ -67,16 +172,200 @@ gpop_manager_get_pipeline_by_id (GPOPManager * manager, gchar * id)
 }
 
 static void
-gpop_manager_dbus_method_call (GDBusConnection * connection,
-    const gchar * sender,
-    const gchar * object_path,
-    const gchar * interface_name,
-    const gchar * method_name,
-    GVariant * parameters,
-    GDBusMethodInvocation * invocation, gpointer user_data)
+gpop_manager_add_pipeline_to_builder (GVariantBuilder * builder,
+    GPOPPipeline * pipeline)
+{
+  if (pipeline)
+    g_variant_builder_add (builder, "(so)", pipeline->id,
+        pipeline->base.object_path);
+  else
+    g_variant_builder_add (builder, "(so)", "", "/");
+}
+
+static const gchar *const manager_history_metrics[] =
+    { "pipelines", "playing", "pressure", NULL };
+static const gchar *const pipeline_history_metrics[] =
+    { "state", "fps", "latency-ms", "dropped", NULL };
+
+static void
+gpop_manager_on_slo (GPOPSloObjective objective, gboolean violated,
+    gdouble value, gdouble target, gpointer user_data)
+{
+  GPOPPipeline *pipeline = (GPOPPipeline *) user_data;
+  const gchar *name = gpop_slo_objective_get_name (objective);
+
+  GPOP_LOG ("Pipeline %s %s %s: %.1f (target %.1f)", pipeline->id,
+      violated ? "violates" : "recovered", name, value, target);
+  gpop_tracer_instant ("slo", violated ? "violated" : "recovered",
+      pipeline->id);
+  gpop_dbus_interface_emit_signal (GPOP_DBUS_INTERFACE (pipeline->manager),
+      violated ? "SloViolated" : "SloRecovered",
+      g_variant_new ("(ssdd)", pipeline->id, name, value, target));
+}
+
+/* Records the history, see gpop-history.h, and evaluates the objectives of
+ * the pipelines, see gpop-slo.h */
+static gboolean
+gpop_manager_sample (gpointer user_data)
+{
+  GPOPManager *manager = (GPOPManager *) user_data;
+  gint64 now = g_get_real_time () / G_USEC_PER_SEC;
+  gdouble values[4];
+  guint n_playing = 0;
+  GList *l;
+
+  for (l = manager->pipelines; l; l = g_list_next (l)) {
+    GPOPPipeline *pipeline = (GPOPPipeline *) l->data;
+
+    values[0] = pipeline->state;
+    values[1] = values[2] = values[3] = NAN;
+    if (pipeline->state == GPOP_PARSER_PLAYING) {
+      guint64 dropped;
+
+      n_playing++;
+      if (pipeline->slo) {
+        gpop_slo_update_latency (pipeline->slo);
+        gpop_slo_sample (pipeline->slo, &values[1], &values[2], &dropped);
+        values[2] = values[2] < 0 ? NAN : values[2];
+        values[3] = dropped;
+      }
+    }
+    gpop_history_record (manager->history, pipeline->id,
+        pipeline_history_metrics, values, now);
+    if (pipeline->slo && gpop_slo_is_set (pipeline->slo))
+      gpop_slo_evaluate (pipeline->slo,
+          pipeline->state == GPOP_PARSER_PLAYING, gpop_manager_on_slo,
+          pipeline);
+  }
+
+  values[0] = gpop_manager_pipelines_count (manager);
+  values[1] = n_playing;
+  values[2] = gpop_pressure_monitor_get_level (manager->pressure);
+  gpop_history_record (manager->history, "", manager_history_metrics, values,
+      now);
+
+  gpop_history_expire (manager->history, now);
+  gpop_manager_update_sampling (manager);
+  return G_SOURCE_CONTINUE;
+}
+
+/* The manager samples every second while a pipeline plays, and backs off
+ * to GPOP_MANAGER_IDLE_SAMPLE_MS otherwise */
+void
+gpop_manager_update_sampling (GPOPManager * manager)
+{
+  guint period = GPOP_MANAGER_IDLE_SAMPLE_MS;
+  GList *l;
+
+  g_return_if_fail (GPOP_IS_MANAGER (manager));
+
+  for (l = manager->pipelines; l; l = g_list_next (l)) {
+    if (((GPOPPipeline *) l->data)->state == GPOP_PARSER_PLAYING) {
+      period = GPOP_MANAGER_SAMPLE_MS;
+      break;
+    }
+  }
+  if (manager->sample_id)
+    gpop_timers_set_period (manager->sample_id, period);
+}
+
+static gchar *
+gpop_manager_get_metrics (GPOPManager * manager)
+{
+  GString *metrics = g_string_new (NULL);
+  guint i;
+
+  g_string_append_printf (metrics,
+      "# TYPE gpop_pipelines gauge\ngpop_pipelines %u\n",
+      gpop_manager_pipelines_count (manager));
+  g_string_append_printf (metrics,
+      "# TYPE gpop_pressure_level gauge\ngpop_pressure_level %d\n",
+      gpop_pressure_monitor_get_level (manager->pressure));
+  g_string_append (metrics, "# TYPE gpop_load_shed_actions_total counter\n");
+  for (i = 0; i < GPOP_SHED_LAST; i++)
+    g_string_append_printf (metrics,
+        "gpop_load_shed_actions_total{action=\"%s\"} %" G_GUINT64_FORMAT
+        "\n", gpop_shed_action_get_name (i), manager->shed_actions[i]);
+  g_string_append_printf (metrics,
+      "# TYPE gpop_timer_wakeups_total counter\n"
+      "gpop_timer_wakeups_total %" G_GUINT64_FORMAT "\n",
+      gpop_timers_get_wakeups ());
+  gpop_rate_limit_append_metrics (metrics);
+  gpop_element_pool_append_metrics (metrics);
+  gpop_control_stats_append_metrics (metrics);
+
+  return g_string_free (metrics, FALSE);
+}
+
+static void
+gpop_manager_on_profile (GPOPProfiler * profiler, gpointer user_data)
 {
   GPOPManager *manager = (GPOPManager *) user_data;
+  GHashTable *tags = g_hash_table_new (NULL, NULL);
+  guint i, n_samples;
+  gchar *folded;
+  GList *l;
+
+  /* each streaming thread is tagged by its pipeline */
+  for (l = manager->pipelines; l; l = g_list_next (l)) {
+    GPOPPipeline *pipeline = l->data;
+    GArray *threads;
+
+    if (!pipeline->parser)
+      continue;
+    threads = gpop_parser_get_threads (pipeline->parser);
+    for (i = 0; i < threads->len; i++)
+      g_hash_table_insert (tags,
+          GINT_TO_POINTER (g_array_index (threads, gint, i)), pipeline->id);
+    g_array_unref (threads);
+  }
+
+  folded = gpop_profiler_fold (profiler, tags, &n_samples);
+  g_dbus_method_invocation_return_value (manager->profile_invocation,
+      g_variant_new ("(ssu)", folded,
+          gpop_profiler_get_sampler_name (profiler), n_samples));
+  g_free (folded);
+  g_hash_table_unref (tags);
+
+  manager->profile_invocation = NULL;
+  g_clear_pointer (&manager->profiler, gpop_profiler_free);
+}
+
+/* Replied once the profile is done, see gpop-profiler.h */
+static void
+gpop_manager_profile (GPOPManager * manager, GVariant * parameters,
+    GDBusMethodInvocation * invocation)
+{
+  guint duration_ms, frequency;
+  GError *error = NULL;
+
+  g_variant_get (parameters, "(uu)", &duration_ms, &frequency);
+  if (manager->profiler) {
+    g_dbus_method_invocation_return_error (invocation, G_DBUS_ERROR,
+        G_DBUS_ERROR_LIMITS_EXCEEDED, "A profile is already running");
+    return;
+  }
+
+  manager->profiler = gpop_profiler_start (duration_ms, frequency,
+      gpop_manager_on_profile, manager, &error);
+  if (!manager->profiler) {
+    g_dbus_method_invocation_return_error (invocation, G_DBUS_ERROR,
+        G_DBUS_ERROR_NOT_SUPPORTED, "%s", error->message);
+    g_error_free (error);
+    return;
+  }
+  /* the reference handed over by GDBus is consumed by the reply */
+  manager->profile_invocation = invocation;
+}
+
+/* Returns the reply of the method, NULL if it has no output arguments or
+ * on error. */
+static GVariant *
+gpop_manager_handle_method (GPOPManager * manager, const gchar * method_name,
+    GVariant * parameters, GError ** error)
+{
   GVariant *ret = NULL;
+
   if (!g_strcmp0 (method_name, "GetPipelineDesc")) {
     gchar *id;
     GPOPPipeline *pipeline;
@@ -89,19 +378,240 @@ gpop_manager_dbus_method_call (GDBusConnection * connection,
     } else
       ret = g_variant_new ("(s)", "");
   } else if (!g_strcmp0 (method_name, "AddPipeline")) {
-
     gchar *parser_desc;
+    GPOPPipeline *pipeline;
     g_variant_get (parameters, "(s)", &parser_desc);
-    gpop_manager_add_pipeline (manager, gpop_manager_pipelines_count (manager),
-        parser_desc, NULL);
+    pipeline =
+        gpop_manager_add_pipeline (manager, manager->next_num, parser_desc,
+        NULL);
+    g_free (parser_desc);
+    if (!pipeline) {
+      g_set_error (error, G_DBUS_ERROR, G_DBUS_ERROR_FAILED,
+          "Unable to add the pipeline");
+      return NULL;
+    }
+    ret = g_variant_new ("(so)", pipeline->id, pipeline->base.object_path);
+  } else if (!g_strcmp0 (method_name, "PreparePipeline")) {
+    const gchar *parser_desc;
+    GPOPPipeline *pipeline;
+
+    g_variant_get (parameters, "(&s)", &parser_desc);
+    pipeline = gpop_manager_prepare_pipeline (manager, parser_desc);
+    if (!pipeline) {
+      g_set_error (error, G_DBUS_ERROR, G_DBUS_ERROR_FAILED,
+          "Unable to prepare the pipeline");
+      return NULL;
+    }
+    ret = g_variant_new ("(so)", pipeline->id, pipeline->base.object_path);
+  } else if (!g_strcmp0 (method_name, "Migrate")) {
+    /* the streaming threads of a daemon are moved by the placement */
+    g_set_error (error, G_DBUS_ERROR, G_DBUS_ERROR_NOT_SUPPORTED,
+        "The pipelines migrate between the workers of a front, see "
+        "--workers");
+    return NULL;
+  } else if (!g_strcmp0 (method_name, "AddLadder")) {
+    const gchar *source_desc;
+    GVariant *renditions;
+    GPOPPipeline *pipeline;
+
+    g_variant_get (parameters, "(&s@a(siiss))", &source_desc, &renditions);
+    pipeline = gpop_manager_add_ladder (manager, source_desc, renditions,
+        error);
+    g_variant_unref (renditions);
+    if (!pipeline)
+      return NULL;
+    ret = g_variant_new ("(so)", pipeline->id, pipeline->base.object_path);
   } else if (!g_strcmp0 (method_name, "RemovePipeline")) {
-      gchar *id;
-      g_variant_get (parameters, "(s)", &id);
-      gpop_manager_remove_pipeline (manager, id);
+    gchar *id;
+    gboolean removed;
+    g_variant_get (parameters, "(s)", &id);
+    removed = gpop_manager_remove_pipeline (manager, id);
+    if (!removed) {
+      g_set_error (error, G_DBUS_ERROR, G_DBUS_ERROR_INVALID_ARGS,
+          "No pipeline with id '%s'", id);
+      g_free (id);
+      return NULL;
+    }
+    g_free (id);
+  } else if (!g_strcmp0 (method_name, "AddPipelines")) {
+    GVariantIter *iter;
+    GVariantBuilder builder;
+    gchar *parser_desc;
+
+    g_variant_builder_init (&builder, G_VARIANT_TYPE ("a(so)"));
+    g_variant_get (parameters, "(as)", &iter);
+    while (g_variant_iter_loop (iter, "s", &parser_desc)) {
+      gpop_manager_add_pipeline_to_builder (&builder,
+          gpop_manager_add_pipeline (manager, manager->next_num,
+              parser_desc, NULL));
+    }
+    g_variant_iter_free (iter);
+    ret = g_variant_new ("(a(so))", &builder);
+  } else if (!g_strcmp0 (method_name, "RemovePipelines")) {
+    GVariantIter *iter;
+    GVariantBuilder builder;
+    gchar *id;
+
+    g_variant_builder_init (&builder, G_VARIANT_TYPE ("ab"));
+    g_variant_get (parameters, "(as)", &iter);
+    while (g_variant_iter_loop (iter, "s", &id)) {
+      g_variant_builder_add (&builder, "b",
+          gpop_manager_remove_pipeline (manager, id));
     }
+    g_variant_iter_free (iter);
+    ret = g_variant_new ("(ab)", &builder);
+  } else if (!g_strcmp0 (method_name, "ListPipelines")) {
+    GVariantBuilder builder;
+    GList *l;
+
+    g_variant_builder_init (&builder, G_VARIANT_TYPE ("a(so)"));
+    for (l = manager->pipelines; l != NULL; l = g_list_next (l))
+      gpop_manager_add_pipeline_to_builder (&builder, l->data);
+    ret = g_variant_new ("(a(so))", &builder);
+  } else if (!g_strcmp0 (method_name, "GetControlStats")) {
+    ret = gpop_control_stats_to_variant ();
+  } else if (!g_strcmp0 (method_name, "GetMetrics")) {
+    gchar *metrics = gpop_manager_get_metrics (manager);
+    ret = g_variant_new ("(s)", metrics);
+    g_free (metrics);
+  } else if (!g_strcmp0 (method_name, "GetHistory")) {
+    const gchar *id, *metric;
+    guint range;
+
+    g_variant_get (parameters, "(&s&su)", &id, &metric, &range);
+    ret = gpop_history_get (manager->history, id, metric, range, error);
+  } else if (!g_strcmp0 (method_name, "GetPlacement")) {
+    ret = g_variant_new ("(@a(ssdu))",
+        gpop_placement_to_variant (manager->placement));
+  } else if (!g_strcmp0 (method_name, "StartRecording")) {
+    gchar *path;
+
+    g_variant_get (parameters, "(s)", &path);
+    gpop_recorder_start (path, error);
+    g_free (path);
+  } else if (!g_strcmp0 (method_name, "StopRecording")) {
+    ret = g_variant_new ("(u)", gpop_recorder_stop ());
+  } else if (!g_strcmp0 (method_name, "StartTrace")) {
+    gpop_tracer_start ();
+    gpop_tracer_begin ("dbus", method_name, NULL);
+    gpop_dbus_interface_emit_property_changed (GPOP_DBUS_INTERFACE (manager),
+        "Tracing", g_variant_new ("b", TRUE));
+  } else if (!g_strcmp0 (method_name, "StopTrace")) {
+    gchar *path;
+    guint n_events = 0;
+
+    gpop_tracer_end ("dbus", method_name, NULL);
+    g_variant_get (parameters, "(s)", &path);
+    gpop_tracer_stop (path, &n_events, error);
+    g_free (path);
+    gpop_dbus_interface_emit_property_changed (GPOP_DBUS_INTERFACE (manager),
+        "Tracing", g_variant_new ("b", FALSE));
+    if (*error)
+      return NULL;
+    ret = g_variant_new ("(u)", n_events);
+  }
+
+  return ret;
+}
+
+/* The <Method>WithKey variants take a client request id before the
+ * arguments of <Method>. A retry with the same request id gets the reply of
+ * the first successful call without running it again. */
+static GVariant *
+gpop_manager_handle_method_with_key (GPOPManager * manager,
+    const gchar * method_name, GVariant * parameters, GError ** error)
+{
+  gchar *base_name = g_strndup (method_name,
+      strlen (method_name) - strlen (GPOP_MANAGER_WITH_KEY_SUFFIX));
+  gsize i, n_args = g_variant_n_children (parameters);
+  GVariant **args = g_new (GVariant *, n_args);
+  GVariant *base_parameters, *ret;
+  const gchar *request_id;
 
-  g_dbus_method_invocation_return_value (invocation, ret);
+  g_variant_get_child (parameters, 0, "&s", &request_id);
+  for (i = 1; i < n_args; i++)
+    args[i - 1] = g_variant_get_child_value (parameters, i);
+  base_parameters = g_variant_ref_sink (g_variant_new_tuple (args, n_args - 1));
+  for (i = 1; i < n_args; i++)
+    g_variant_unref (args[i - 1]);
+  g_free (args);
+
+  ret = gpop_request_cache_lookup (manager->requests, request_id, base_name,
+      base_parameters, error);
+  if (!ret && !*error) {
+    ret = gpop_manager_handle_method (manager, base_name, base_parameters,
+        error);
+    /* Failures are not cached, a retry will run again */
+    if (!*error) {
+      if (!ret)
+        ret = g_variant_new ("()");
+      g_variant_ref_sink (ret);
+      gpop_request_cache_insert (manager->requests, request_id, base_name,
+          base_parameters, ret);
+    }
+  }
+
+  g_variant_unref (base_parameters);
+  g_free (base_name);
+  return ret;
+}
+
+static void
+gpop_manager_dbus_method_call (GDBusConnection * connection,
+    const gchar * sender,
+    const gchar * object_path,
+    const gchar * interface_name,
+    const gchar * method_name,
+    GVariant * parameters,
+    GDBusMethodInvocation * invocation, gpointer user_data)
+{
+  GPOPManager *manager = (GPOPManager *) user_data;
+  GVariant *ret;
+  GError *error = NULL;
+  gboolean owned;
+  GstClockTime start = GST_CLOCK_TIME_NONE;
+
+  if (GPOP_PROBE_ENABLED (method__entry))
+    GPOP_PROBE3 (method__entry, object_path, method_name, sender);
+  if (GPOP_PROBE_ENABLED (method__return))
+    start = gst_util_get_timestamp ();
+  gpop_tracer_begin ("dbus", method_name, NULL);
+
+  if (!g_strcmp0 (method_name, "Profile")) {
+    gpop_manager_profile (manager, parameters, invocation);
+    ret = NULL;
+    goto done;
+  }
+
+  if (g_str_has_suffix (method_name, GPOP_MANAGER_WITH_KEY_SUFFIX))
+    ret = gpop_manager_handle_method_with_key (manager, method_name,
+        parameters, &error);
+  else
+    ret = gpop_manager_handle_method (manager, method_name, parameters,
+        &error);
+
+  /* Cached replies are owned, the others are floating and consumed */
+  owned = ret && !g_variant_is_floating (ret);
+  if (error)
+    g_dbus_method_invocation_take_error (invocation, error);
+  else
+    g_dbus_method_invocation_return_value (invocation, ret);
+  if (owned)
+    g_variant_unref (ret);
+
+done:
   g_dbus_connection_flush (connection, NULL, NULL, NULL);
+  gpop_tracer_end ("dbus", method_name, NULL);
+  if (GST_CLOCK_TIME_IS_VALID (start))
+    GPOP_PROBE4 (method__return, object_path, method_name, sender,
+        gst_util_get_timestamp () - start);
+}
+
+static void
+gpop_manager_notify_pipelines (GPOPManager * manager)
+{
+  gpop_dbus_interface_emit_property_changed (GPOP_DBUS_INTERFACE (manager),
+      "Pipelines", g_variant_new ("i", g_list_length (manager->pipelines)));
 }
 
 GVariant *
@@ -117,6 +627,12 @@ gpop_manager_dbus_get_property (GDBusConnection * connection,
     ret = g_variant_new ("i", g_list_length (manager->pipelines));
   } else if (!g_strcmp0 (property_name, "Version")) {
     ret = g_variant_new ("s", "0.0.1");
+  } else if (!g_strcmp0 (property_name, "Tracing")) {
+    ret = g_variant_new ("b", gpop_tracer_is_active ());
+  } else if (!g_strcmp0 (property_name, "Pressure")) {
+    ret = g_variant_new ("s",
+        gpop_pressure_level_get_name (gpop_pressure_monitor_get_level
+            (manager->pressure)));
   }
   return ret;
 }
@@ -132,13 +648,80 @@ gpop_manager_dbus_set_property (GDBusConnection * connection,
   return *error == NULL;
 }
 
+static void
+gpop_manager_shed (GPOPManager * manager, GPOPPressureLevel level,
+    GPOPShedAction action, GPOPPipeline * pipeline)
+{
+  const gchar *level_name = gpop_pressure_level_get_name (level);
+  const gchar *action_name = gpop_shed_action_get_name (action);
+
+  GPOP_LOG ("Pressure %s: %s pipeline '%s'", level_name, action_name,
+      pipeline->id);
+  manager->shed_actions[action]++;
+  gpop_tracer_instant ("pressure", action_name, pipeline->id);
+  gpop_dbus_interface_emit_signal (GPOP_DBUS_INTERFACE (manager), "LoadShed",
+      g_variant_new ("(sss)", level_name, action_name, pipeline->id));
+}
+
+/* The actions escalate with the level: idle pipelines release their
+ * GStreamer pipeline, then the queues are shrunk, then the playing
+ * pipelines with a negative priority are paused. The last two are reverted
+ * when the pressure recedes, suspended pipelines are rebuilt on demand. */
+static void
+gpop_manager_on_pressure (GPOPPressureLevel level, gpointer user_data)
+{
+  GPOPManager *manager = (GPOPManager *) user_data;
+  GList *l;
+
+  GPOP_LOG ("Pressure level is now %s", gpop_pressure_level_get_name (level));
+  gpop_dbus_interface_emit_property_changed (GPOP_DBUS_INTERFACE (manager),
+      "Pressure", g_variant_new ("s", gpop_pressure_level_get_name (level)));
+
+  for (l = manager->pipelines; l != NULL; l = g_list_next (l)) {
+    GPOPPipeline *pipeline = (GPOPPipeline *) l->data;
+
+    if (level >= GPOP_PRESSURE_SOME && gpop_pipeline_suspend (pipeline))
+      gpop_manager_shed (manager, level, GPOP_SHED_SUSPEND, pipeline);
+    if (gpop_pipeline_shrink (pipeline, level >= GPOP_PRESSURE_HIGH))
+      gpop_manager_shed (manager, level, level >= GPOP_PRESSURE_HIGH ?
+          GPOP_SHED_SHRINK : GPOP_SHED_RESTORE, pipeline);
+    if (gpop_pipeline_shed (pipeline, level >= GPOP_PRESSURE_CRITICAL))
+      gpop_manager_shed (manager, level, level >= GPOP_PRESSURE_CRITICAL ?
+          GPOP_SHED_PAUSE : GPOP_SHED_RESUME, pipeline);
+  }
+}
+
 static void
 gpop_manager_dispose (GObject * object)
 {
 
   GPOPManager *manager = GPOP_MANAGER (object);
 
+  g_clear_pointer (&manager->pressure, gpop_pressure_monitor_free);
+  g_clear_pointer (&manager->requests, gpop_request_cache_free);
+  g_clear_pointer (&manager->config, g_ptr_array_unref);
+  if (manager->checkpoint_id) {
+    gpop_timers_remove (manager->checkpoint_id);
+    manager->checkpoint_id = 0;
+  }
+  g_clear_pointer (&manager->checkpoint, gpop_checkpoint_free);
+  if (manager->sample_id) {
+    gpop_timers_remove (manager->sample_id);
+    manager->sample_id = 0;
+  }
+  g_clear_pointer (&manager->history, gpop_history_free);
+  if (manager->profiler) {
+    g_clear_pointer (&manager->profiler, gpop_profiler_free);
+    g_dbus_method_invocation_return_error (manager->profile_invocation,
+        G_DBUS_ERROR, G_DBUS_ERROR_FAILED, "The daemon is shutting down");
+    manager->profile_invocation = NULL;
+  }
+  gpop_manager_set_placement (manager, FALSE);
+  gpop_control_stats_detach (manager->base.connection,
+      manager->stats_filter_id);
+  manager->stats_filter_id = 0;
   g_list_free_full (manager->pipelines, (GDestroyNotify) gpop_pipeline_free);
+  manager->pipelines = NULL;
 
   if (G_OBJECT_CLASS (parent_class)->dispose)
     G_OBJECT_CLASS (parent_class)->dispose (object);
@@ -164,6 +747,9 @@ gpop_manager_class_init (GPOPManagerClass * klass)
 static void
 gpop_manager_init (GPOPManager * manager)
 {
+  manager->requests =
+      gpop_request_cache_new (GPOP_REQUEST_CACHE_DEFAULT_SIZE,
+      GPOP_REQUEST_CACHE_DEFAULT_TTL_SECONDS);
 }
 
 GPOPManager *
@@ -171,49 +757,604 @@ gpop_manager_new (GDBusConnection * connection)
 {
   GPOPManager *manager = g_object_new (GPOP_TYPE_MANAGER, NULL);
   if (gpop_dbus_interface_register (GPOP_DBUS_INTERFACE (manager),
-          GPOP_MANAGER_OBJECT_PATH, gpop_manager_xml_introspection, connection))
+          GPOP_MANAGER_OBJECT_PATH, gpop_manager_xml_introspection, connection)) {
+    manager->stats_filter_id = gpop_control_stats_attach (connection);
+    manager->pressure =
+        gpop_pressure_monitor_new (gpop_manager_on_pressure, manager);
+    manager->history = gpop_history_new ();
+    manager->sample_id = gpop_timers_add (GPOP_MANAGER_IDLE_SAMPLE_MS,
+        gpop_manager_sample, manager);
     return manager;
+  }
   else {
     g_object_unref (manager);
     return NULL;
   }
 }
 
+static gboolean
+gpop_manager_checkpoint (gpointer user_data)
+{
+  GPOPManager *manager = (GPOPManager *) user_data;
+  GError *err = NULL;
+  GList *l;
+
+  for (l = manager->pipelines; l; l = l->next) {
+    GPOPPipeline *pipeline = l->data;
+
+    if (pipeline->state != GPOP_PARSER_PLAYING || !pipeline->parser
+        || !gpop_parser_is_created (pipeline->parser))
+      continue;
+    gpop_checkpoint_update (manager->checkpoint, pipeline->id,
+        pipeline->parser_desc, gpop_parser_get_element (pipeline->parser));
+  }
+
+  if (!gpop_checkpoint_save (manager->checkpoint, &err)) {
+    GPOP_LOG ("Unable to save the checkpoints: %s", err->message);
+    g_error_free (err);
+  }
+  return G_SOURCE_CONTINUE;
+}
+
+/* Shutdown drain, see gpop_manager_drain() */
+typedef enum
+{
+  GPOP_DRAIN_IDLE,
+  GPOP_DRAIN_PENDING,
+  GPOP_DRAIN_DONE,
+  GPOP_DRAIN_ERROR,
+  GPOP_DRAIN_TIMEOUT,
+} GPOPDrainResult;
+
+typedef struct
+{
+  GMainLoop *loop;
+  gint64 start;
+  guint pending;
+  guint deadline_id;
+} GPOPDrain;
+
+typedef struct
+{
+  GPOPDrain *drain;
+  GPOPPipeline *pipeline;
+  GPOPParser *parser;
+  gulong handler_id;
+  GPOPDrainResult result;
+  gint64 duration;
+} GPOPDrainEntry;
+
+static void
+gpop_manager_on_drain_state (GPOPParser * parser, GPOPParserState state,
+    gpointer user_data)
+{
+  GPOPDrainEntry *entry = (GPOPDrainEntry *) user_data;
+
+  if (entry->result != GPOP_DRAIN_PENDING || state < GPOP_PARSER_EOS)
+    return;
+
+  entry->result = state == GPOP_PARSER_EOS ? GPOP_DRAIN_DONE : GPOP_DRAIN_ERROR;
+  entry->duration = g_get_monotonic_time () - entry->drain->start;
+  if (--entry->drain->pending == 0)
+    g_main_loop_quit (entry->drain->loop);
+}
+
+static gboolean
+gpop_manager_on_drain_deadline (gpointer user_data)
+{
+  GPOPDrain *drain = (GPOPDrain *) user_data;
+
+  drain->deadline_id = 0;
+  g_main_loop_quit (drain->loop);
+  return G_SOURCE_REMOVE;
+}
+
+static void
+gpop_manager_stop_parser (gpointer data, gpointer user_data)
+{
+  gpop_parser_quit (GPOP_PARSER (data));
+}
+
+static const gchar *
+gpop_drain_result_get_name (GPOPDrainResult result)
+{
+  switch (result) {
+    case GPOP_DRAIN_IDLE:
+      return "idle";
+    case GPOP_DRAIN_DONE:
+      return "drained";
+    case GPOP_DRAIN_ERROR:
+      return "error";
+    case GPOP_DRAIN_TIMEOUT:
+      return "timeout";
+    default:
+      return "pending";
+  }
+}
+
+/* Shuts the pipelines down: EOS is sent to all the playing pipelines at
+ * once so that their sinks can finalize the recordings, then they are all
+ * waited for until timeout_ms at most and finally set to NULL in parallel
+ * from a thread pool. */
+void
+gpop_manager_drain (GPOPManager * manager, guint timeout_ms)
+{
+  GPOPDrain drain = { 0, };
+  GPOPDrainEntry *entries;
+  GThreadPool *pool;
+  guint i, n_pipelines, n_drained = 0, n_failed = 0;
+  gint64 drained;
+  GList *l;
+
+  g_return_if_fail (GPOP_IS_MANAGER (manager));
+
+  /* the pipelines are resumed from there on the next start */
+  if (manager->checkpoint)
+    gpop_manager_checkpoint (manager);
+
+  n_pipelines = g_list_length (manager->pipelines);
+  entries = g_new0 (GPOPDrainEntry, n_pipelines);
+  drain.start = g_get_monotonic_time ();
+
+  for (l = manager->pipelines, i = 0; l; l = l->next, i++) {
+    GPOPDrainEntry *entry = &entries[i];
+
+    /* a D-Bus request can remove a pipeline during the drain */
+    entry->drain = &drain;
+    entry->pipeline = g_object_ref (l->data);
+    if (entry->pipeline->parser)
+      entry->parser = g_object_ref (entry->pipeline->parser);
+    if (!timeout_ms || !gpop_pipeline_drain (entry->pipeline))
+      continue;
+    entry->result = GPOP_DRAIN_PENDING;
+    entry->handler_id = g_signal_connect (entry->parser, "state-changed",
+        G_CALLBACK (gpop_manager_on_drain_state), entry);
+    drain.pending++;
+  }
+
+  if (drain.pending) {
+    GPOP_LOG ("Draining %u pipelines", drain.pending);
+    drain.loop = g_main_loop_new (NULL, FALSE);
+    drain.deadline_id = g_timeout_add (timeout_ms,
+        gpop_manager_on_drain_deadline, &drain);
+    g_main_loop_run (drain.loop);
+    if (drain.deadline_id)
+      g_source_remove (drain.deadline_id);
+    g_main_loop_unref (drain.loop);
+  }
+  drained = g_get_monotonic_time ();
+
+  pool = g_thread_pool_new (gpop_manager_stop_parser, NULL,
+      MAX (g_get_num_processors (), 1), FALSE, NULL);
+  for (i = 0; i < n_pipelines; i++) {
+    GPOPDrainEntry *entry = &entries[i];
+
+    if (entry->handler_id)
+      g_signal_handler_disconnect (entry->parser, entry->handler_id);
+    if (entry->result == GPOP_DRAIN_PENDING) {
+      entry->result = GPOP_DRAIN_TIMEOUT;
+      entry->duration = drained - drain.start;
+    }
+    if (entry->parser)
+      g_thread_pool_push (pool, entry->parser, NULL);
+  }
+  g_thread_pool_free (pool, FALSE, TRUE);
+
+  for (i = 0; i < n_pipelines; i++) {
+    GPOPDrainEntry *entry = &entries[i];
+
+    if (entry->result == GPOP_DRAIN_DONE)
+      n_drained++;
+    else if (entry->result != GPOP_DRAIN_IDLE)
+      n_failed++;
+    if (entry->result != GPOP_DRAIN_IDLE)
+      GPOP_LOG ("Pipeline %s: %s in %.1f ms", entry->pipeline->id,
+          gpop_drain_result_get_name (entry->result),
+          entry->duration / 1000.0);
+    g_clear_object (&entry->parser);
+    g_object_unref (entry->pipeline);
+  }
+  g_free (entries);
+
+  /* the pipelines hold a reference on the manager */
+  g_list_free_full (manager->pipelines, (GDestroyNotify) gpop_pipeline_free);
+  manager->pipelines = NULL;
+
+  GPOP_LOG ("Shutdown of %u pipelines in %.1f ms (drain %.1f ms): %u drained,"
+      " %u failed", n_pipelines, (g_get_monotonic_time () - drain.start)
+      / 1000.0, (drained - drain.start) / 1000.0, n_drained, n_failed);
+}
+
+/* Adds a pipeline neither built nor played whatever the compact mode, the
+ * caller brings it to its state */
+static GPOPPipeline *
+gpop_manager_add_idle_pipeline (GPOPManager * manager,
+    const gchar * parser_desc, gchar * id)
+{
+  gboolean compact = manager->compact;
+  GPOPPipeline *pipeline;
+
+  manager->compact = TRUE;
+  pipeline = gpop_manager_add_pipeline (manager, manager->next_num,
+      parser_desc, id);
+  manager->compact = compact;
+  return pipeline;
+}
+
+/* Configuration reload, see gpop_manager_apply_config() */
+typedef struct
+{
+  GPOPPipeline *pipeline;
+  /* stops the pipeline or brings it to state */
+  gboolean stop;
+  GPOPParserState state;
+  gboolean res;
+} GPOPConfigJob;
+
+static void
+gpop_manager_run_config_job (gpointer data, gpointer user_data)
+{
+  GPOPConfigJob *job = (GPOPConfigJob *) data;
+
+  if (job->stop) {
+    if (job->pipeline->parser)
+      gpop_parser_quit (job->pipeline->parser);
+    job->res = TRUE;
+  } else {
+    job->res = gpop_pipeline_set_state (job->pipeline, job->state);
+  }
+}
+
+static GPOPConfigPipeline *
+gpop_manager_lookup_config (GPtrArray * config, const gchar * id)
+{
+  guint i;
+
+  for (i = 0; config && i < config->len; i++) {
+    GPOPConfigPipeline *entry = g_ptr_array_index (config, i);
+    if (!g_strcmp0 (entry->id, id))
+      return entry;
+  }
+  return NULL;
+}
+
+static void
+gpop_manager_queue_config_job (GArray * jobs, GPOPPipeline * pipeline,
+    gboolean stop, GPOPParserState state)
+{
+  GPOPConfigJob job = { g_object_ref (pipeline), stop, state, FALSE };
+
+  g_array_append_val (jobs, job);
+}
+
+/* Applies a configuration reload: the differences with the last applied
+ * configuration are computed first, a pipeline whose description changed
+ * is replaced, a state, priority or objectives change is applied in place and the
+ * unchanged pipelines are left untouched. The state changes of all the
+ * pipelines are then run in parallel from a thread pool, the parsing and the
+ * NULL to READY transitions being the slow part. */
+void
+gpop_manager_apply_config (GPOPManager * manager, GPtrArray * pipelines)
+{
+  GArray *jobs = g_array_new (FALSE, FALSE, sizeof (GPOPConfigJob));
+  guint i, n_added = 0, n_removed = 0, n_replaced = 0, n_updated = 0,
+      n_failed = 0;
+  gint64 start = g_get_monotonic_time ();
+  GThreadPool *pool;
+
+  g_return_if_fail (GPOP_IS_MANAGER (manager));
+
+  /* removed from the configuration */
+  for (i = 0; manager->config && i < manager->config->len; i++) {
+    GPOPConfigPipeline *entry = g_ptr_array_index (manager->config, i);
+    GPOPPipeline *pipeline;
+
+    if (gpop_manager_lookup_config (pipelines, entry->id))
+      continue;
+    pipeline = gpop_manager_get_pipeline_by_id (manager, entry->id);
+    if (!pipeline)
+      continue;
+    manager->pipelines = g_list_remove (manager->pipelines, pipeline);
+    if (manager->checkpoint)
+      gpop_checkpoint_remove (manager->checkpoint, pipeline->id);
+    gpop_manager_queue_config_job (jobs, pipeline, TRUE, GPOP_PARSER_READY);
+    gpop_pipeline_free (pipeline);
+    n_removed++;
+  }
+
+  for (i = 0; i < pipelines->len; i++) {
+    GPOPConfigPipeline *entry = g_ptr_array_index (pipelines, i);
+    GPOPConfigPipeline *previous =
+        gpop_manager_lookup_config (manager->config, entry->id);
+    GPOPPipeline *pipeline =
+        gpop_manager_get_pipeline_by_id (manager, entry->id);
+
+    /* a pipeline added with the same id over D-Bus is taken over */
+    if (pipeline && !previous && pipeline->parser_desc
+        && !g_strcmp0 (pipeline->parser_desc, entry->description)) {
+      if (pipeline->priority != entry->priority)
+        gpop_pipeline_set_priority (pipeline, entry->priority);
+      gpop_pipeline_set_slo (pipeline, &entry->slo);
+      if (entry->prewarm)
+        gpop_pipeline_set_prewarm (pipeline, TRUE);
+      if (pipeline->state != entry->state)
+        gpop_manager_queue_config_job (jobs, pipeline, FALSE, entry->state);
+      n_updated++;
+      continue;
+    }
+
+    if (pipeline && previous
+        && !g_strcmp0 (previous->description, entry->description)) {
+      if (previous->state == entry->state
+          && previous->priority == entry->priority
+          && previous->prewarm == entry->prewarm
+          && !memcmp (&previous->slo, &entry->slo, sizeof (GPOPSloTargets)))
+        continue;
+      if (previous->priority != entry->priority)
+        gpop_pipeline_set_priority (pipeline, entry->priority);
+      gpop_pipeline_set_slo (pipeline, &entry->slo);
+      if (previous->prewarm != entry->prewarm)
+        gpop_pipeline_set_prewarm (pipeline, entry->prewarm);
+      if (previous->state != entry->state)
+        gpop_manager_queue_config_job (jobs, pipeline, FALSE, entry->state);
+      n_updated++;
+      continue;
+    }
+
+    if (pipeline) {
+      manager->pipelines = g_list_remove (manager->pipelines, pipeline);
+      gpop_manager_queue_config_job (jobs, pipeline, TRUE, GPOP_PARSER_READY);
+      gpop_pipeline_free (pipeline);
+      n_replaced++;
+    } else {
+      n_added++;
+    }
+
+    /* built and brought to its state by the thread pool */
+    pipeline = gpop_manager_add_idle_pipeline (manager, entry->description,
+        entry->id);
+    if (!pipeline) {
+      n_failed++;
+      continue;
+    }
+    if (entry->priority)
+      gpop_pipeline_set_priority (pipeline, entry->priority);
+    gpop_pipeline_set_slo (pipeline, &entry->slo);
+    if (entry->prewarm)
+      gpop_pipeline_set_prewarm (pipeline, TRUE);
+    gpop_manager_queue_config_job (jobs, pipeline, FALSE, entry->state);
+  }
+
+  pool = g_thread_pool_new (gpop_manager_run_config_job, NULL,
+      MAX (g_get_num_processors (), 1), FALSE, NULL);
+  for (i = 0; i < jobs->len; i++)
+    g_thread_pool_push (pool, &g_array_index (jobs, GPOPConfigJob, i), NULL);
+  g_thread_pool_free (pool, FALSE, TRUE);
+
+  for (i = 0; i < jobs->len; i++) {
+    GPOPConfigJob *job = &g_array_index (jobs, GPOPConfigJob, i);
+
+    if (!job->res) {
+      GPOP_LOG ("Unable to bring the pipeline %s to %s", job->pipeline->id,
+          gpop_parser_state_get_name (job->state));
+      n_failed++;
+    }
+    g_object_unref (job->pipeline);
+  }
+  g_array_free (jobs, TRUE);
+
+  if (n_removed || n_replaced)
+    gpop_manager_notify_pipelines (manager);
+
+  g_clear_pointer (&manager->config, g_ptr_array_unref);
+  manager->config = g_ptr_array_ref (pipelines);
+
+  GPOP_LOG ("Configuration applied in %.1f ms: %u added, %u removed, "
+      "%u replaced, %u updated, %u failed",
+      (g_get_monotonic_time () - start) / 1000.0, n_added, n_removed,
+      n_replaced, n_updated, n_failed);
+}
+
 void
 gpop_manage_free (GPOPManager * manager)
 {
   g_clear_object (&manager);
 }
 
+/* In compact mode, the pipelines are created idle: the GStreamer pipeline
+ * is only built on the first state change and the bus messages go through
+ * the shared dispatcher. */
 void
+gpop_manager_set_compact (GPOPManager * manager, gboolean compact)
+{
+  g_return_if_fail (GPOP_IS_MANAGER (manager));
+
+  manager->compact = compact;
+}
+
+/* Numbers the next pipelines from num, a worker of the front gets its own
+ * range so that the ids and object paths are unique across the workers,
+ * see gpop-front.h */
+void
+gpop_manager_set_first_num (GPOPManager * manager, guint num)
+{
+  g_return_if_fail (GPOP_IS_MANAGER (manager));
+
+  manager->next_num = MAX (manager->next_num, num);
+}
+
+/* Default of the new pipelines, see gpop_pipeline_set_prewarm() */
+void
+gpop_manager_set_prewarm (GPOPManager * manager, gboolean prewarm)
+{
+  g_return_if_fail (GPOP_IS_MANAGER (manager));
+
+  manager->prewarm = prewarm;
+}
+
+static gboolean
+gpop_manager_update_placement (gpointer user_data)
+{
+  GPOPManager *manager = (GPOPManager *) user_data;
+
+  gpop_placement_update (manager->placement, manager->pipelines);
+  return G_SOURCE_CONTINUE;
+}
+
+/* Places the streaming threads of the pipelines on the cpus according to
+ * their measured load, see gpop-placement.h */
+void
+gpop_manager_set_placement (GPOPManager * manager, gboolean placement)
+{
+  g_return_if_fail (GPOP_IS_MANAGER (manager));
+
+  if (placement == (manager->placement != NULL))
+    return;
+
+  if (placement) {
+    manager->placement = gpop_placement_new ();
+    manager->placement_id =
+        gpop_timers_add (GPOP_PLACEMENT_PERIOD_SECONDS * 1000,
+        gpop_manager_update_placement, manager);
+  } else {
+    gpop_timers_remove (manager->placement_id);
+    manager->placement_id = 0;
+    g_clear_pointer (&manager->placement, gpop_placement_free);
+  }
+}
+
+/* Journals the progress of the file pipelines every interval_seconds and
+ * resumes them from the journal, see gpop-checkpoint.h */
+gboolean
+gpop_manager_set_checkpoint (GPOPManager * manager, const gchar * path,
+    guint interval_seconds, GError ** error)
+{
+  g_return_val_if_fail (GPOP_IS_MANAGER (manager), FALSE);
+  g_return_val_if_fail (manager->checkpoint == NULL, FALSE);
+
+  manager->checkpoint = gpop_checkpoint_new (path, error);
+  if (!manager->checkpoint)
+    return FALSE;
+
+  manager->checkpoint_id =
+      gpop_timers_add (MAX (interval_seconds, 1) * 1000,
+      gpop_manager_checkpoint, manager);
+  return TRUE;
+}
+
+GPOPPipeline *
 gpop_manager_add_pipeline (GPOPManager * manager, guint num, const gchar * parser_desc, gchar* id)
 {
-  GPOPPipeline *pipeline =
-      gpop_pipeline_new (manager, manager->base.connection, num);
+  GPOPPipeline *pipeline;
+  gchar *pipeline_id;
 
+  /* Never reuse the number of a removed pipeline, it names its object */
+  manager->next_num = MAX (manager->next_num, num + 1);
   if (id)
-    pipeline->id = g_strdup (id);
+    pipeline_id = g_strdup (id);
   else
-    pipeline->id = g_strdup_printf ("pipeline_%u", num);
+    pipeline_id = g_strdup_printf (GPOP_PIPELINE_ID, num);
+
+  pipeline =
+      gpop_pipeline_new (manager, manager->base.connection, num, pipeline_id);
+  g_free (pipeline_id);
+  if (!pipeline)
+    return NULL;
 
   if (gpop_pipeline_set_parser_desc (pipeline, parser_desc)) {
     GPOP_LOG
         ("An pipeline with id '%s' has been created successfully for description '%s'",
         pipeline->id, parser_desc);
     manager->pipelines = g_list_append (manager->pipelines, pipeline);
+    gpop_manager_notify_pipelines (manager);
+    if (gpop_recorder_is_active ())
+      gpop_recorder_record (pipeline->base.object_path, GPOP_RECORDER_CREATED,
+          g_variant_new ("(s)", pipeline->id));
   } else {
     GPOP_LOG ("Unable to add the pipeline with description %s", parser_desc);
     gpop_pipeline_free (pipeline);
+    pipeline = NULL;
   }
+  return pipeline;
 }
 
-void
+/* Adds a pipeline built and prerolled, but not played whatever the compact
+ * mode, for the live migration of a pipeline, see gpop-front.h */
+GPOPPipeline *
+gpop_manager_prepare_pipeline (GPOPManager * manager,
+    const gchar * parser_desc)
+{
+  GPOPPipeline *pipeline;
+
+  /* added idle, then built by the state change */
+  pipeline = gpop_manager_add_idle_pipeline (manager, parser_desc, NULL);
+  if (pipeline && !gpop_pipeline_set_state (pipeline, GPOP_PARSER_PAUSED)) {
+    gpop_manager_remove_pipeline (manager, pipeline->id);
+    pipeline = NULL;
+  }
+  return pipeline;
+}
+
+/* Adds a pipeline decoding source_desc once and encoding each of the
+ * a(siiss) renditions: name, width, height, encoder and output description,
+ * see gpop-ladder.h */
+GPOPPipeline *
+gpop_manager_add_ladder (GPOPManager * manager, const gchar * source_desc,
+    GVariant * renditions, GError ** error)
+{
+  GPOPLadder *ladder = gpop_ladder_new (source_desc);
+  const gchar *name, *encoder_desc, *output_desc;
+  GPOPPipeline *pipeline;
+  GVariantIter iter;
+  gint width, height;
+  gchar *desc;
+
+  g_variant_iter_init (&iter, renditions);
+  while (g_variant_iter_next (&iter, "(&sii&s&s)", &name, &width, &height,
+          &encoder_desc, &output_desc)) {
+    if (!gpop_ladder_add_rendition (ladder, name, width, height,
+            encoder_desc, output_desc, NULL, error)) {
+      gpop_ladder_free (ladder);
+      return NULL;
+    }
+  }
+
+  /* the renditions are attached when the pipeline is built, see
+   * gpop_pipeline_build() */
+  desc = gpop_ladder_get_description (ladder);
+  pipeline = gpop_manager_add_idle_pipeline (manager, desc, NULL);
+  g_free (desc);
+  if (!pipeline) {
+    g_set_error (error, G_DBUS_ERROR, G_DBUS_ERROR_FAILED,
+        "Unable to add the ladder");
+    gpop_ladder_free (ladder);
+    return NULL;
+  }
+  pipeline->ladder = ladder;
+
+  if (!manager->compact
+      && !gpop_pipeline_set_state (pipeline, GPOP_PARSER_PLAYING)) {
+    g_set_error (error, G_DBUS_ERROR, G_DBUS_ERROR_FAILED,
+        "Unable to build the ladder");
+    gpop_manager_remove_pipeline (manager, pipeline->id);
+    return NULL;
+  }
+
+  return pipeline;
+}
+
+gboolean
 gpop_manager_remove_pipeline (GPOPManager * manager, gchar* id)
 {
   GPOPPipeline *pipeline =gpop_manager_get_pipeline_by_id(manager, id);
   if (!pipeline) {
     GPOP_LOG ("pipeline with id %s does not exists", id);
+    return FALSE;
   }
   manager->pipelines = g_list_remove(manager->pipelines, pipeline);
+  if (manager->checkpoint)
+    gpop_checkpoint_remove (manager->checkpoint, pipeline->id);
   gpop_pipeline_free (pipeline);
+  gpop_manager_notify_pipelines (manager);
+  return TRUE;
 }
@@ -36,12 +36,34 @@
 #define GPOP_IS_MANAGER_CLASS(klass) (G_TYPE_CHECK_CLASS_TYPE((klass),\
                                               GPOP_TYPE_MANAGER))
 
+#define GPOP_MANAGER_OBJECT_PATH "/org/gpop/Manager"
+#define GPOP_MANAGER_WITH_KEY_SUFFIX "WithKey"
+
+extern const char gpop_manager_xml_introspection[];
+
 typedef struct _GPOPManager GPOPManager;
 typedef struct _GPOPManagerClass GPOPManagerClass;
 
 struct _GPOPManager {
   GPOPDBusInterface base;
   GList* pipelines;
+  guint next_num;
+  GPOPRequestCache *requests;
+  guint stats_filter_id;
+  gboolean compact;
+  gboolean prewarm;
+  GPOPPressureMonitor *pressure;
+  guint64 shed_actions[GPOP_SHED_LAST];
+  GPOPPlacement *placement;
+  guint placement_id;
+  /* GPOPConfigPipeline, last applied configuration */
+  GPtrArray *config;
+  GPOPCheckpoint *checkpoint;
+  guint checkpoint_id;
+  GPOPProfiler *profiler;
+  GDBusMethodInvocation *profile_invocation;
+  GPOPHistory *history;
+  guint sample_id;
 };
 
 struct _GPOPManagerClass
@@ -52,6 +74,21 @@ struct _GPOPManagerClass
 GPOPManager* gpop_manager_new (GDBusConnection* connection);
 void gpop_manage_free (GPOPManager * manager);
 
-void gpop_manager_add_pipeline (GPOPManager* manager, guint num, const gchar * parser_desc, gchar* id);
-void gpop_manager_remove_pipeline (GPOPManager * manager, gchar* id);
+#define GPOP_MANAGER_DEFAULT_DRAIN_TIMEOUT_SECONDS 10
+#define GPOP_MANAGER_SAMPLE_MS 1000
+#define GPOP_MANAGER_IDLE_SAMPLE_MS 10000
+void gpop_manager_drain (GPOPManager * manager, guint timeout_ms);
+void gpop_manager_apply_config (GPOPManager * manager, GPtrArray * pipelines);
+
+void gpop_manager_set_compact (GPOPManager * manager, gboolean compact);
+void gpop_manager_set_first_num (GPOPManager * manager, guint num);
+void gpop_manager_set_prewarm (GPOPManager * manager, gboolean prewarm);
+void gpop_manager_set_placement (GPOPManager * manager, gboolean placement);
+void gpop_manager_update_sampling (GPOPManager * manager);
+gboolean gpop_manager_set_checkpoint (GPOPManager * manager, const gchar * path, guint interval_seconds, GError ** error);
+
+struct _GPOPPipeline * gpop_manager_add_pipeline (GPOPManager* manager, guint num, const gchar * parser_desc, gchar* id);
+gboolean gpop_manager_remove_pipeline (GPOPManager * manager, gchar* id);
+struct _GPOPPipeline * gpop_manager_prepare_pipeline (GPOPManager * manager, const gchar * parser_desc);
+struct _GPOPPipeline * gpop_manager_add_ladder (GPOPManager * manager, const gchar * source_desc, GVariant * renditions, GError ** error);
 #endif /* _GPOP_MANAGER_H_ */
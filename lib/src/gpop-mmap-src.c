@@ -0,0 +1,375 @@
+/*
+ * GStreamer Prince of Parser
+ *
+ * Copyright (C) 2020 Stéphane Cerveau
+ *
+ * SPDX-License-Identifier: LGPL
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation
+ * version 2.1 of the License.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301 USA
+ *
+ */
+
+#include <errno.h>
+#include <fcntl.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "gpop-private.h"
+
+G_DEFINE_TYPE (GPOPMmapSrc, gpop_mmap_src, GST_TYPE_BASE_SRC);
+#define parent_class gpop_mmap_src_parent_class
+
+GST_DEBUG_CATEGORY_STATIC (gpop_mmap_src_debug);
+#define GST_CAT_DEFAULT gpop_mmap_src_debug
+
+enum
+{
+  PROP_0,
+  PROP_LOCATION,
+  PROP_READAHEAD,
+};
+
+/* The mapping outlives the element as long as buffers wrap it */
+struct _GPOPMmapFile
+{
+  gint refcount;
+  gint fd;
+  guint8 *data;
+  gsize size;
+};
+
+static GstStaticPadTemplate src_template = GST_STATIC_PAD_TEMPLATE ("src",
+    GST_PAD_SRC,
+    GST_PAD_ALWAYS,
+    GST_STATIC_CAPS_ANY);
+
+static GPOPMmapFile *
+gpop_mmap_file_ref (GPOPMmapFile * file)
+{
+  g_atomic_int_inc (&file->refcount);
+  return file;
+}
+
+static void
+gpop_mmap_file_unref (GPOPMmapFile * file)
+{
+  if (!g_atomic_int_dec_and_test (&file->refcount))
+    return;
+
+  if (file->data)
+    munmap (file->data, file->size);
+  if (file->fd >= 0)
+    close (file->fd);
+  g_free (file);
+}
+
+static GPOPMmapFile *
+gpop_mmap_file_open (const gchar * location, GError ** error)
+{
+  GPOPMmapFile *file;
+  struct stat st;
+  gint fd;
+
+  fd = open (location, O_RDONLY | O_CLOEXEC);
+  if (fd < 0 || fstat (fd, &st) < 0) {
+    g_set_error (error, G_FILE_ERROR, g_file_error_from_errno (errno),
+        "Unable to open '%s': %s", location, g_strerror (errno));
+    if (fd >= 0)
+      close (fd);
+    return NULL;
+  }
+  if (!S_ISREG (st.st_mode)) {
+    g_set_error (error, G_FILE_ERROR, G_FILE_ERROR_INVAL,
+        "'%s' is not a regular file", location);
+    close (fd);
+    return NULL;
+  }
+
+  file = g_new0 (GPOPMmapFile, 1);
+  file->refcount = 1;
+  file->fd = fd;
+  file->size = st.st_size;
+  if (file->size) {
+    file->data = mmap (NULL, file->size, PROT_READ, MAP_PRIVATE, fd, 0);
+    if (file->data == MAP_FAILED) {
+      g_set_error (error, G_FILE_ERROR, g_file_error_from_errno (errno),
+          "Unable to map '%s': %s", location, g_strerror (errno));
+      file->data = NULL;
+      gpop_mmap_file_unref (file);
+      file = NULL;
+    } else {
+      madvise (file->data, file->size, MADV_SEQUENTIAL);
+    }
+  }
+
+  return file;
+}
+
+/* Asks for the pages of the next blocks to be read ahead */
+static void
+gpop_mmap_src_advise (GPOPMmapSrc * src, guint64 end)
+{
+  GPOPMmapFile *file = src->file;
+  guint64 page_size = sysconf (_SC_PAGESIZE);
+  guint64 start, window;
+
+  if (src->advised >= MIN (end, file->size))
+    return;
+
+  window = (guint64) MAX (src->readahead, 1) * gst_base_src_get_blocksize
+      (GST_BASE_SRC (src));
+  start = MAX (src->advised, end > window ? end - window : 0);
+  start -= start % page_size;
+  end = MIN (end + window, file->size);
+  if (start < end && madvise (file->data + start, end - start,
+          MADV_WILLNEED) < 0)
+    GST_DEBUG_OBJECT (src, "madvise failed: %s", g_strerror (errno));
+  src->advised = end;
+}
+
+/* Reading a mapped page past the end of a truncated file raises SIGBUS,
+ * the end of such a file is read with pread() */
+static GstFlowReturn
+gpop_mmap_src_read (GPOPMmapSrc * src, guint64 offset, guint size,
+    GstBuffer ** buffer)
+{
+  GstBuffer *buf = gst_buffer_new_allocate (NULL, size, NULL);
+  GstMapInfo map;
+  gsize done = 0;
+  gssize n = 0;
+
+  gst_buffer_map (buf, &map, GST_MAP_WRITE);
+  while (done < size) {
+    n = pread (src->file->fd, map.data + done, size - done, offset + done);
+    if (n < 0 && errno == EINTR)
+      continue;
+    if (n <= 0)
+      break;
+    done += n;
+  }
+  gst_buffer_unmap (buf, &map);
+
+  if (n < 0) {
+    GST_ELEMENT_ERROR (src, RESOURCE, READ, (NULL),
+        ("Error while reading '%s': %s", src->location, g_strerror (errno)));
+    gst_buffer_unref (buf);
+    return GST_FLOW_ERROR;
+  }
+  if (!done) {
+    gst_buffer_unref (buf);
+    return GST_FLOW_EOS;
+  }
+  gst_buffer_set_size (buf, done);
+  GST_BUFFER_OFFSET (buf) = offset;
+  GST_BUFFER_OFFSET_END (buf) = offset + done;
+  *buffer = buf;
+
+  return GST_FLOW_OK;
+}
+
+static gboolean
+gpop_mmap_src_start (GstBaseSrc * bsrc)
+{
+  GPOPMmapSrc *src = GPOP_MMAP_SRC (bsrc);
+  GError *error = NULL;
+
+  if (!src->location) {
+    GST_ELEMENT_ERROR (src, RESOURCE, NOT_FOUND, ("No file name specified"),
+        (NULL));
+    return FALSE;
+  }
+
+  src->file = gpop_mmap_file_open (src->location, &error);
+  if (!src->file) {
+    GST_ELEMENT_ERROR (src, RESOURCE, OPEN_READ, ("%s", error->message),
+        (NULL));
+    g_error_free (error);
+    return FALSE;
+  }
+  src->advised = 0;
+  src->truncated = FALSE;
+
+  return TRUE;
+}
+
+static gboolean
+gpop_mmap_src_stop (GstBaseSrc * bsrc)
+{
+  GPOPMmapSrc *src = GPOP_MMAP_SRC (bsrc);
+
+  g_clear_pointer (&src->file, gpop_mmap_file_unref);
+  return TRUE;
+}
+
+static gboolean
+gpop_mmap_src_is_seekable (GstBaseSrc * bsrc)
+{
+  return TRUE;
+}
+
+static gboolean
+gpop_mmap_src_get_size (GstBaseSrc * bsrc, guint64 * size)
+{
+  GPOPMmapSrc *src = GPOP_MMAP_SRC (bsrc);
+
+  if (!src->file)
+    return FALSE;
+  *size = src->file->size;
+  return TRUE;
+}
+
+static GstFlowReturn
+gpop_mmap_src_create (GstBaseSrc * bsrc, guint64 offset, guint size,
+    GstBuffer ** buffer)
+{
+  GPOPMmapSrc *src = GPOP_MMAP_SRC (bsrc);
+  GPOPMmapFile *file = src->file;
+  GstBuffer *buf;
+  struct stat st;
+
+  if (offset >= file->size)
+    return GST_FLOW_EOS;
+
+  size = MIN (size, file->size - offset);
+  if (src->truncated || (fstat (file->fd, &st) == 0
+          && (guint64) st.st_size < offset + size)) {
+    if (!src->truncated)
+      GST_WARNING_OBJECT (src, "'%s' was truncated, reading it", src->location);
+    src->truncated = TRUE;
+    return gpop_mmap_src_read (src, offset, size, buffer);
+  }
+  gpop_mmap_src_advise (src, offset + size);
+
+  buf = gst_buffer_new ();
+  gst_buffer_append_memory (buf,
+      gst_memory_new_wrapped (GST_MEMORY_FLAG_READONLY, file->data,
+          file->size, offset, size, gpop_mmap_file_ref (file),
+          (GDestroyNotify) gpop_mmap_file_unref));
+  GST_BUFFER_OFFSET (buf) = offset;
+  GST_BUFFER_OFFSET_END (buf) = offset + size;
+  *buffer = buf;
+
+  return GST_FLOW_OK;
+}
+
+static void
+gpop_mmap_src_set_property (GObject * object, guint prop_id,
+    const GValue * value, GParamSpec * pspec)
+{
+  GPOPMmapSrc *src = GPOP_MMAP_SRC (object);
+
+  switch (prop_id) {
+    case PROP_LOCATION:
+      GST_OBJECT_LOCK (src);
+      g_free (src->location);
+      src->location = g_value_dup_string (value);
+      GST_OBJECT_UNLOCK (src);
+      break;
+    case PROP_READAHEAD:
+      src->readahead = g_value_get_uint (value);
+      break;
+    default:
+      G_OBJECT_WARN_INVALID_PROPERTY_ID (object, prop_id, pspec);
+      break;
+  }
+}
+
+static void
+gpop_mmap_src_get_property (GObject * object, guint prop_id, GValue * value,
+    GParamSpec * pspec)
+{
+  GPOPMmapSrc *src = GPOP_MMAP_SRC (object);
+
+  switch (prop_id) {
+    case PROP_LOCATION:
+      GST_OBJECT_LOCK (src);
+      g_value_set_string (value, src->location);
+      GST_OBJECT_UNLOCK (src);
+      break;
+    case PROP_READAHEAD:
+      g_value_set_uint (value, src->readahead);
+      break;
+    default:
+      G_OBJECT_WARN_INVALID_PROPERTY_ID (object, prop_id, pspec);
+      break;
+  }
+}
+
+static void
+gpop_mmap_src_finalize (GObject * object)
+{
+  GPOPMmapSrc *src = GPOP_MMAP_SRC (object);
+
+  g_free (src->location);
+
+  G_OBJECT_CLASS (parent_class)->finalize (object);
+}
+
+static void
+gpop_mmap_src_class_init (GPOPMmapSrcClass * klass)
+{
+  GObjectClass *gobject_class = G_OBJECT_CLASS (klass);
+  GstElementClass *element_class = GST_ELEMENT_CLASS (klass);
+  GstBaseSrcClass *basesrc_class = GST_BASE_SRC_CLASS (klass);
+
+  gobject_class->set_property = gpop_mmap_src_set_property;
+  gobject_class->get_property = gpop_mmap_src_get_property;
+  gobject_class->finalize = gpop_mmap_src_finalize;
+
+  g_object_class_install_property (gobject_class, PROP_LOCATION,
+      g_param_spec_string ("location", "File Location",
+          "Location of the file to read", NULL,
+          G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS |
+          GST_PARAM_MUTABLE_READY));
+  g_object_class_install_property (gobject_class, PROP_READAHEAD,
+      g_param_spec_uint ("readahead", "Read ahead",
+          "Number of blocks requested ahead of the current one", 0,
+          G_MAXUINT, GPOP_MMAP_SRC_DEFAULT_READAHEAD,
+          G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS));
+
+  gst_element_class_add_static_pad_template (element_class, &src_template);
+  gst_element_class_set_static_metadata (element_class,
+      "Memory mapped file source", "Source/File",
+      "Reads a file without copy from a memory mapping",
+      "GStreamer Prince of Parser");
+
+  basesrc_class->start = GST_DEBUG_FUNCPTR (gpop_mmap_src_start);
+  basesrc_class->stop = GST_DEBUG_FUNCPTR (gpop_mmap_src_stop);
+  basesrc_class->is_seekable = GST_DEBUG_FUNCPTR (gpop_mmap_src_is_seekable);
+  basesrc_class->get_size = GST_DEBUG_FUNCPTR (gpop_mmap_src_get_size);
+  basesrc_class->create = GST_DEBUG_FUNCPTR (gpop_mmap_src_create);
+
+  GST_DEBUG_CATEGORY_INIT (gpop_mmap_src_debug, GPOP_MMAP_SRC_NAME, 0,
+      "gpop mmap file source");
+}
+
+static void
+gpop_mmap_src_init (GPOPMmapSrc * src)
+{
+  src->readahead = GPOP_MMAP_SRC_DEFAULT_READAHEAD;
+  gst_base_src_set_blocksize (GST_BASE_SRC (src),
+      GPOP_MMAP_SRC_DEFAULT_BLOCKSIZE);
+}
+
+/* Registers the element for gst_parse_launch(), to be called after
+ * gst_init(). */
+gboolean
+gpop_mmap_src_register (void)
+{
+  return gst_element_register (NULL, GPOP_MMAP_SRC_NAME, GST_RANK_NONE,
+      GPOP_TYPE_MMAP_SRC);
+}
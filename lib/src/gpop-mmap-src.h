@@ -0,0 +1,78 @@
+/*
+ * GStreamer Prince of Parser
+ *
+ * Copyright (C) 2020 Stéphane Cerveau
+ *
+ * SPDX-License-Identifier: LGPL
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation
+ * version 2.1 of the License.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301 USA
+ *
+ */
+
+#ifndef _GPOP_MMAP_SRC_H_
+#define _GPOP_MMAP_SRC_H_
+
+#include <gst/gst.h>
+#include <gst/base/gstbasesrc.h>
+
+#define GPOP_TYPE_MMAP_SRC	           (gpop_mmap_src_get_type())
+#define GPOP_MMAP_SRC(obj)            (G_TYPE_CHECK_INSTANCE_CAST((obj),\
+                                              GPOP_TYPE_MMAP_SRC, GPOPMmapSrc))
+#define GPOP_MMAP_SRC_CLASS(klass)    (G_TYPE_CHECK_CLASS_CAST((klass),\
+                                              GPOP_TYPE_MMAP_SRC, GPOPMmapSrcClass))
+#define GPOP_IS_MMAP_SRC(obj)         (G_TYPE_CHECK_INSTANCE_TYPE((obj),\
+                                              GPOP_TYPE_MMAP_SRC))
+#define GPOP_IS_MMAP_SRC_CLASS(klass) (G_TYPE_CHECK_CLASS_TYPE((klass),\
+                                              GPOP_TYPE_MMAP_SRC))
+
+/* gpopmmapsrc: file source mapping the whole file and pushing buffers
+ * wrapping the mapping, without any copy. The pages of the next blocks are
+ * requested ahead with madvise().
+ *
+ * A truncated file can not be read through the mapping, which raises
+ * SIGBUS: the size is checked before each block, and the source falls back
+ * to pread() once the file shrank. A buffer already pushed can still fault
+ * if the file is truncated while it is read downstream, so the input must
+ * not be truncated while playing. */
+
+#define GPOP_MMAP_SRC_NAME "gpopmmapsrc"
+#define GPOP_MMAP_SRC_DEFAULT_BLOCKSIZE (1024 * 1024)
+#define GPOP_MMAP_SRC_DEFAULT_READAHEAD 4
+
+typedef struct _GPOPMmapSrc GPOPMmapSrc;
+typedef struct _GPOPMmapSrcClass GPOPMmapSrcClass;
+typedef struct _GPOPMmapFile GPOPMmapFile;
+
+struct _GPOPMmapSrc
+{
+  GstBaseSrc base;
+  gchar *location;
+  guint readahead;
+  GPOPMmapFile *file;
+  guint64 advised;
+  /* read instead of mapped from then on */
+  gboolean truncated;
+};
+
+struct _GPOPMmapSrcClass
+{
+  GstBaseSrcClass base;
+};
+
+GType gpop_mmap_src_get_type (void);
+
+gboolean gpop_mmap_src_register (void);
+
+#endif /* _GPOP_MMAP_SRC_H_ */
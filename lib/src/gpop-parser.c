@@ -21,21 +21,48 @@
  *
  */
 
+#ifdef __linux__
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
 #include "gpop-private.h"
 
 struct _GPOPParser
 {
   GObject base;
+  gchar *id;
   GstElement *pipeline;
   GstBus *bus;
   GstState state;
   gboolean eos;
   gboolean buffering;
-
+  GstClockTime state_request_ts;
+  const gchar *state_ramp;
+  GPOPBusWatch *watch;
+  /* Streaming threads, maintained from the STREAM_STATUS messages */
+  GMutex threads_lock;
+  GArray *threads;
 };
 
 G_DEFINE_TYPE (GPOPParser, gpop_parser, G_TYPE_OBJECT);
 
+/* Original limits of a queue shrunk by gpop_parser_scale_queues() */
+#define GPOP_PARSER_QUEUE_LIMITS "gpop-queue-limits"
+
+typedef struct
+{
+  guint buffers;
+  guint bytes;
+  guint64 time;
+} GPOPQueueLimits;
+
+typedef struct
+{
+  gdouble scale;
+  guint count;
+} GPOPQueueScale;
+
 GST_DEBUG_CATEGORY (gpop_debug);
 #define GST_CAT_DEFAULT gpop_debug
 
@@ -49,6 +76,15 @@ static guint gpop_parser_signals[SIGNAL_LAST] = { 0 };
 
 static void gpop_parser_destroy (GPOPParser * parser);
 
+static void
+gpop_parser_end_state_ramp (GPOPParser * parser)
+{
+  if (parser->state_ramp) {
+    gpop_tracer_async_end ("state", parser->state_ramp, parser->id);
+    parser->state_ramp = NULL;
+  }
+}
+
 static void
 handle_message_application (GPOPParser * parser, const GstStructure * structure)
 {
@@ -62,6 +98,13 @@ message_cb (GstBus * bus, GstMessage * message, gpointer user_data)
   GPOPParser *parser = (GPOPParser *) user_data;
   GST_DEBUG_OBJECT (parser, "Received new message %s from %s",
       GST_MESSAGE_TYPE_NAME (message), GST_OBJECT_NAME (message->src));
+  gpop_tracer_begin ("bus", GST_MESSAGE_TYPE_NAME (message), parser->id);
+  /* the messages are stamped by the dispatcher when posted, their own
+   * timestamp is mostly unset */
+  if (GPOP_PROBE_ENABLED (bus__message))
+    GPOP_PROBE4 (bus__message, parser->id, GST_MESSAGE_TYPE_NAME (message),
+        GST_MESSAGE_TYPE (message),
+        gst_util_get_timestamp () - gpop_bus_dispatcher_get_posted_time ());
   switch (GST_MESSAGE_TYPE (message)) {
     case GST_MESSAGE_ERROR:{
       GError *err = NULL;
@@ -75,6 +118,7 @@ message_cb (GstBus * bus, GstMessage * message, gpointer user_data)
       if (debug != NULL)
         GST_ERROR_OBJECT (parser, "Additional debug info:%s", debug);
 
+      gpop_parser_end_state_ramp (parser);
       g_signal_emit (parser,
           gpop_parser_signals[SIGNAL_GPOP_PARSER_STATE], 0, GPOP_PARSER_ERROR);
 
@@ -112,11 +156,24 @@ message_cb (GstBus * bus, GstMessage * message, gpointer user_data)
       GstState old, new, pending;
       if (GST_MESSAGE_SRC (message) == GST_OBJECT_CAST (parser->pipeline)) {
         gst_message_parse_state_changed (message, &old, &new, &pending);
+        if (GPOP_PROBE_ENABLED (state__change))
+          GPOP_PROBE5 (state__change, parser->id, old, new, pending,
+              gst_util_get_timestamp () - parser->state_request_ts);
+        if (pending == GST_STATE_VOID_PENDING)
+          gpop_parser_end_state_ramp (parser);
         parser->state = new;
         if (parser->state == GST_STATE_PLAYING)
           g_signal_emit (parser,
               gpop_parser_signals[SIGNAL_GPOP_PARSER_STATE], 0,
               GPOP_PARSER_PLAYING);
+        else if (parser->state == GST_STATE_PAUSED)
+          g_signal_emit (parser,
+              gpop_parser_signals[SIGNAL_GPOP_PARSER_STATE], 0,
+              GPOP_PARSER_PAUSED);
+        else if (parser->state == GST_STATE_READY && old > GST_STATE_READY)
+          g_signal_emit (parser,
+              gpop_parser_signals[SIGNAL_GPOP_PARSER_STATE], 0,
+              GPOP_PARSER_READY);
       }
       break;
     }
@@ -155,9 +212,56 @@ message_cb (GstBus * bus, GstMessage * message, gpointer user_data)
       break;
   }
 
+  gpop_tracer_end ("bus", GST_MESSAGE_TYPE_NAME (message), parser->id);
   return TRUE;
 }
 
+static gint
+gpop_parser_get_thread_id (void)
+{
+#ifdef __linux__
+  return syscall (SYS_gettid);
+#else
+  return 0;
+#endif
+}
+
+/* The ENTER and LEAVE stream status messages are posted from the streaming
+ * thread itself, so they are handled synchronously. */
+static GstBusSyncReply
+gpop_parser_sync_handler (GstBus * bus, GstMessage * message,
+    gpointer user_data)
+{
+  GPOPParser *parser = (GPOPParser *) user_data;
+  GstStreamStatusType type;
+  GstElement *owner;
+  gint tid;
+  guint i;
+
+  if (GST_MESSAGE_TYPE (message) != GST_MESSAGE_STREAM_STATUS)
+    return GST_BUS_PASS;
+
+  gst_message_parse_stream_status (message, &type, &owner);
+  tid = gpop_parser_get_thread_id ();
+  if (!tid)
+    return GST_BUS_PASS;
+
+  g_mutex_lock (&parser->threads_lock);
+  if (type == GST_STREAM_STATUS_TYPE_ENTER) {
+    g_array_append_val (parser->threads, tid);
+  } else if (type == GST_STREAM_STATUS_TYPE_LEAVE) {
+    for (i = 0; i < parser->threads->len; i++) {
+      if (g_array_index (parser->threads, gint, i) == tid) {
+        g_array_remove_index_fast (parser->threads, i);
+        break;
+      }
+    }
+  }
+  g_mutex_unlock (&parser->threads_lock);
+
+  return GST_BUS_PASS;
+}
+
 static gboolean
 gpop_parser_set_player_state (GPOPParser * parser, GstState state)
 {
@@ -166,12 +270,22 @@ gpop_parser_set_player_state (GPOPParser * parser, GstState state)
 
   g_return_val_if_fail (GPOP_IS_PARSER (parser), FALSE);
 
+  if (!parser->pipeline)
+    return FALSE;
+
+  parser->state_request_ts = gst_util_get_timestamp ();
+  gpop_parser_end_state_ramp (parser);
+  if (state != GST_STATE_NULL && gpop_tracer_is_active ()) {
+    parser->state_ramp = gst_element_state_get_name (state);
+    gpop_tracer_async_begin ("state", parser->state_ramp, parser->id);
+  }
   ret = gst_element_set_state (parser->pipeline, state);
 
   switch (ret) {
     case GST_STATE_CHANGE_FAILURE:
       GST_INFO_OBJECT (parser, "ERROR: %s doesn't want to pause.",
           GST_ELEMENT_NAME (parser->pipeline));
+      gpop_parser_end_state_ramp (parser);
       res = FALSE;
       break;
     case GST_STATE_CHANGE_NO_PREROLL:
@@ -195,12 +309,30 @@ gpop_parser_set_player_state (GPOPParser * parser, GstState state)
 static void
 gpop_parser_destroy (GPOPParser * parser)
 {
+  GstClockTime start = GST_CLOCK_TIME_NONE;
+  GList *pooled;
+
   GST_INFO_OBJECT (parser, "About to destroy the parser");
   if (parser->pipeline) {
+    if (GPOP_PROBE_ENABLED (pipeline__destroy))
+      start = gst_util_get_timestamp ();
+    gpop_tracer_begin ("lifecycle", "teardown", parser->id);
+    pooled = gpop_element_pool_reclaim (parser->pipeline);
     gpop_parser_set_player_state (parser, GST_STATE_NULL);
+    gpop_element_pool_release (pooled);
+    gpop_bus_dispatcher_remove_watch (parser->watch);
+    parser->watch = NULL;
     g_object_unref (parser->pipeline);
     parser->pipeline = NULL;
+    parser->state = GST_STATE_NULL;
+    g_mutex_lock (&parser->threads_lock);
+    g_array_set_size (parser->threads, 0);
+    g_mutex_unlock (&parser->threads_lock);
+    gpop_tracer_end ("lifecycle", "teardown", parser->id);
     GST_INFO_OBJECT (parser, "pipeline destroyed");
+    if (GST_CLOCK_TIME_IS_VALID (start))
+      GPOP_PROBE2 (pipeline__destroy, parser->id,
+          gst_util_get_timestamp () - start);
   }
 }
 
@@ -210,6 +342,18 @@ gpop_parser_dispose (GObject * object)
   GPOPParser *parser = GPOP_PARSER (object);
   gpop_parser_destroy (parser);
   g_clear_object (&parser->bus);
+  g_clear_pointer (&parser->id, g_free);
+}
+
+static void
+gpop_parser_finalize (GObject * object)
+{
+  GPOPParser *parser = GPOP_PARSER (object);
+
+  g_array_unref (parser->threads);
+  g_mutex_clear (&parser->threads_lock);
+
+  G_OBJECT_CLASS (gpop_parser_parent_class)->finalize (object);
 }
 
 static void
@@ -219,6 +363,7 @@ gpop_parser_class_init (GPOPParserClass * klass)
 
   gobject_class = G_OBJECT_CLASS (klass);
   gobject_class->dispose = gpop_parser_dispose;
+  gobject_class->finalize = gpop_parser_finalize;
 
   gpop_parser_signals[SIGNAL_GPOP_PARSER_STATE] =
       g_signal_new ("state-changed", G_TYPE_FROM_CLASS (klass),
@@ -231,12 +376,15 @@ gpop_parser_class_init (GPOPParserClass * klass)
 static void
 gpop_parser_init (GPOPParser * parser)
 {
+  g_mutex_init (&parser->threads_lock);
+  parser->threads = g_array_new (FALSE, FALSE, sizeof (gint));
 }
 
 GPOPParser *
-gpop_parser_new ()
+gpop_parser_new (const gchar * id)
 {
   GPOPParser *parser = g_object_new (GPOP_TYPE_PARSER, NULL);
+  parser->id = g_strdup (id);
 
   GST_DEBUG_CATEGORY_INIT (gpop_debug, "gpop", 0, "gpop-parser");
 
@@ -258,9 +406,13 @@ gpop_parser_create (GPOPParser * parser, const gchar * parser_desc)
   GstBus *bus;
   GError *err = NULL;
   gchar *desc;
+  GstClockTime start = GST_CLOCK_TIME_NONE;
 
   gpop_parser_destroy (parser);
 
+  if (GPOP_PROBE_ENABLED (pipeline__create))
+    start = gst_util_get_timestamp ();
+
   if (g_getenv ("GPOP_PIPELINE"))
     desc = g_strdup (g_getenv ("GPOP_PIPELINE"));
   else
@@ -268,9 +420,15 @@ gpop_parser_create (GPOPParser * parser, const gchar * parser_desc)
   GST_INFO_OBJECT (parser, "About to instantiate the parser pipeline '%s'",
       parser_desc);
   parser->state = GST_STATE_NULL;
-  parser->pipeline = gst_pipeline_new (NULL);
+  parser->eos = FALSE;
+  parser->pipeline = gst_pipeline_new (parser->id);
+  gpop_tracer_begin ("lifecycle", "parse_launch", parser->id);
   parsed_element =
       gst_parse_launch_full (desc, NULL, GST_PARSE_FLAG_NONE, &err);
+  gpop_tracer_end ("lifecycle", "parse_launch", parser->id);
+  if (GST_CLOCK_TIME_IS_VALID (start))
+    GPOP_PROBE4 (pipeline__create, parser->id, desc, err == NULL,
+        gst_util_get_timestamp () - start);
   g_free (desc);
   if (err) {
     GST_ERROR_OBJECT (parser,
@@ -279,11 +437,14 @@ gpop_parser_create (GPOPParser * parser, const gchar * parser_desc)
     return FALSE;
   }
 
+  if (gpop_element_pool_acquire (parsed_element))
+    GST_INFO_OBJECT (parser, "Reusing pooled elements");
   gst_bin_add (GST_BIN (parser->pipeline), parsed_element);
 
   bus = gst_pipeline_get_bus (GST_PIPELINE (parser->pipeline));
-  g_signal_connect (G_OBJECT (bus), "message", G_CALLBACK (message_cb), parser);
-  gst_bus_add_signal_watch (bus);
+  /* no GSource nor wakeup per pipeline */
+  parser->watch = gpop_bus_dispatcher_add_watch (bus,
+      gpop_parser_sync_handler, message_cb, parser);
   gst_object_unref (GST_OBJECT (bus));
 
   return TRUE;
@@ -306,10 +467,169 @@ gpop_parser_quit (GPOPParser * parser)
   gpop_parser_set_player_state (parser, GST_STATE_NULL);
 }
 
+/* Sends EOS to a playing or paused pipeline so that its sinks can finalize
+ * their output, the end of the drain is signaled by the EOS or ERROR state.
+ * A paused pipeline is played for the EOS to flow past its prerolled
+ * sinks, its sources push nothing after it. */
+gboolean
+gpop_parser_send_eos (GPOPParser * parser)
+{
+  g_return_val_if_fail (GPOP_IS_PARSER (parser), FALSE);
+
+  if (!parser->pipeline || parser->eos || (parser->state != GST_STATE_PLAYING
+          && parser->state != GST_STATE_PAUSED))
+    return FALSE;
+
+  GST_INFO_OBJECT (parser, "Draining the pipeline");
+  if (!gst_element_send_event (parser->pipeline, gst_event_new_eos ()))
+    return FALSE;
+  if (parser->state == GST_STATE_PAUSED)
+    gst_element_set_state (parser->pipeline, GST_STATE_PLAYING);
+  return TRUE;
+}
+
+void
+gpop_parser_release (GPOPParser * parser)
+{
+  gpop_parser_destroy (parser);
+}
+
+static guint
+gpop_limit_scale (guint64 limit, gdouble scale)
+{
+  /* 0 means unlimited, a shrunk limit must not become unlimited */
+  if (!limit)
+    return 0;
+  return MAX (1, limit * scale);
+}
+
+static void
+gpop_parser_scale_queue (const GValue * item, gpointer user_data)
+{
+  GObject *element = g_value_get_object (item);
+  GPOPQueueScale *data = (GPOPQueueScale *) user_data;
+  GObjectClass *klass = G_OBJECT_GET_CLASS (element);
+  GPOPQueueLimits *limits;
+
+  /* queue, queue2 and multiqueue */
+  if (!g_object_class_find_property (klass, "max-size-buffers")
+      || !g_object_class_find_property (klass, "max-size-bytes")
+      || !g_object_class_find_property (klass, "max-size-time"))
+    return;
+
+  limits = g_object_get_data (element, GPOP_PARSER_QUEUE_LIMITS);
+  if (data->scale >= 1.0) {
+    if (!limits)
+      return;
+    g_object_set (element, "max-size-buffers", limits->buffers,
+        "max-size-bytes", limits->bytes, "max-size-time", limits->time, NULL);
+    g_object_set_data (element, GPOP_PARSER_QUEUE_LIMITS, NULL);
+    data->count++;
+    return;
+  }
+
+  if (!limits) {
+    limits = g_new (GPOPQueueLimits, 1);
+    g_object_get (element, "max-size-buffers", &limits->buffers,
+        "max-size-bytes", &limits->bytes, "max-size-time", &limits->time,
+        NULL);
+    g_object_set_data_full (element, GPOP_PARSER_QUEUE_LIMITS, limits, g_free);
+  }
+  g_object_set (element,
+      "max-size-buffers", gpop_limit_scale (limits->buffers, data->scale),
+      "max-size-bytes", gpop_limit_scale (limits->bytes, data->scale),
+      "max-size-time", (guint64) (limits->time * data->scale), NULL);
+  data->count++;
+}
+
+/* Scales the limits of the queues of the pipeline from their original
+ * values, a scale of 1.0 restores them. Returns the number of queues. */
+guint
+gpop_parser_scale_queues (GPOPParser * parser, gdouble scale)
+{
+  GPOPQueueScale data = { scale, 0 };
+  GstIterator *it;
+
+  if (!parser->pipeline)
+    return 0;
+
+  it = gst_bin_iterate_recurse (GST_BIN (parser->pipeline));
+  while (gst_iterator_foreach (it, gpop_parser_scale_queue,
+          &data) == GST_ITERATOR_RESYNC) {
+    gst_iterator_resync (it);
+    data.count = 0;
+  }
+  gst_iterator_free (it);
+
+  return data.count;
+}
+
+/* Returns a copy of the thread ids of the streaming threads */
+GArray *
+gpop_parser_get_threads (GPOPParser * parser)
+{
+  GArray *threads = g_array_new (FALSE, FALSE, sizeof (gint));
+
+  g_mutex_lock (&parser->threads_lock);
+  g_array_append_vals (threads, parser->threads->data, parser->threads->len);
+  g_mutex_unlock (&parser->threads_lock);
+
+  return threads;
+}
+
+GstElement *
+gpop_parser_get_element (GPOPParser * parser)
+{
+  return parser->pipeline;
+}
+
+gboolean
+gpop_parser_is_created (GPOPParser * parser)
+{
+  return parser->pipeline != NULL;
+}
+
 gboolean
 gpop_parser_is_playing (GPOPParser * parser)
 {
-  return (parser->state > GST_STATE_PLAYING);
+  return (parser->state == GST_STATE_PLAYING);
+}
+
+/* Whether the pipeline is paused or playing, or is going there: the state
+ * reported by the bus lags behind a requested state change */
+gboolean
+gpop_parser_is_active (GPOPParser * parser)
+{
+  GstState current, target;
+
+  if (!parser->pipeline)
+    return FALSE;
+
+  GST_OBJECT_LOCK (parser->pipeline);
+  current = GST_STATE (parser->pipeline);
+  target = GST_STATE_TARGET (parser->pipeline);
+  GST_OBJECT_UNLOCK (parser->pipeline);
+
+  return current >= GST_STATE_PAUSED || target >= GST_STATE_PAUSED;
+}
+
+const gchar *
+gpop_parser_state_get_name (GPOPParserState state)
+{
+  switch (state) {
+    case GPOP_PARSER_READY:
+      return "ready";
+    case GPOP_PARSER_PLAYING:
+      return "playing";
+    case GPOP_PARSER_PAUSED:
+      return "paused";
+    case GPOP_PARSER_EOS:
+      return "eos";
+    case GPOP_PARSER_ERROR:
+      return "error";
+    default:
+      return "unknown";
+  }
 }
 
 gboolean
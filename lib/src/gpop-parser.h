@@ -55,14 +55,26 @@ struct _GPOPParserClass
   void (*state_changed) (GPOPParser * parser, GPOPParserState state);
 };
 
-GPOPParser * gpop_parser_new ();
+GPOPParser * gpop_parser_new (const gchar * id);
 void gpop_parser_free (GPOPParser* parser);
 void gpop_parser_quit (GPOPParser * parser);
 
+gboolean gpop_parser_create (GPOPParser * parser, const gchar * parser_desc);
 gboolean gpop_parser_play (GPOPParser *parser, const gchar * parser_desc);
 
+gboolean gpop_parser_send_eos (GPOPParser * parser);
+void gpop_parser_release (GPOPParser * parser);
+guint gpop_parser_scale_queues (GPOPParser * parser, gdouble scale);
+
+gboolean gpop_parser_is_created (GPOPParser * parser);
+GstElement * gpop_parser_get_element (GPOPParser * parser);
+GArray * gpop_parser_get_threads (GPOPParser * parser);
+
 gboolean gpop_parser_is_playing (GPOPParser *parser);
+gboolean gpop_parser_is_active (GPOPParser * parser);
 
 gboolean gpop_parser_change_state (GPOPParser * parser, GPOPParserState state);
 
+const gchar * gpop_parser_state_get_name (GPOPParserState state);
+
 #endif /* _GPOP_PARSER_H_ */
@@ -21,23 +21,105 @@
  *
  */
 
+#include <string.h>
+
 #include "gpop-private.h"
 
 G_DEFINE_TYPE (GPOPPipeline, gpop_pipeline, GPOP_TYPE_DBUS_INTERFACE);
 #define parent_class gpop_pipeline_parent_class
 
-#define GPOP_PIPELINE_OBJECT_PATH "/org/gpop/Pipeline%d"
+/* Queue limits of a pipeline shrunk under memory pressure */
+#define GPOP_PIPELINE_SHRINK_SCALE 0.25
+
+/* Preroll of a resumed pipeline before its seek to the checkpoint */
+#define GPOP_PIPELINE_RESUME_TIMEOUT_SECONDS 5
 
 const char gpop_pipeline_xml_introspection[] =
     "<?xml version='1.0' encoding='UTF-8' ?>"
     "<node>"
     "    <interface name='org.gpop.GPOPInterface'>"
+    "        <method name='Play'/>"
+    "        <method name='Pause'/>"
+    "        <method name='Stop'/>"
+    "        <method name='AddRendition'>"
+    "		<arg type='s' name='name' direction='in'/>"
+    "		<arg type='i' name='width' direction='in'/>"
+    "		<arg type='i' name='height' direction='in'/>"
+    "		<arg type='s' name='encoder_desc' direction='in'/>"
+    "		<arg type='s' name='output_desc' direction='in'/>"
+    "        </method>"
+    "        <method name='RemoveRendition'>"
+    "		<arg type='s' name='name' direction='in'/>"
+    "        </method>"
+    "        <method name='GetRenditions'>"
+    "		<arg type='a(siisstt)' name='renditions' direction='out'/>"
+    "        </method>"
+    "        <method name='Seek'>"
+    "		<arg type='x' name='position' direction='in'/>"
+    "        </method>"
+    "        <method name='SetSlo'>"
+    "		<arg type='d' name='min_fps' direction='in'/>"
+    "		<arg type='d' name='max_latency_ms' direction='in'/>"
+    "		<arg type='d' name='max_dropped_per_minute' direction='in'/>"
+    "        </method>"
     "       <property name='parser_desc' type='s' access='read'/>"
     "       <property name='id' type='s' access='read'/>"
     "       <property name='streaming' type='b' access='read'/>"
+    "       <property name='state' type='s' access='read'/>"
+    "       <property name='priority' type='i' access='readwrite'/>"
+    "       <property name='slo' type='(ddd)' access='read'/>"
+    "       <property name='prewarm' type='b' access='readwrite'/>"
+    "       <property name='position' type='x' access='read'/>"
+    "       <property name='migratable' type='b' access='read'/>"
     "    </interface>" "</node>";
 
 
+static void
+gpop_pipeline_ladder_method_call (GPOPPipeline * pipeline,
+    const gchar * method_name, GVariant * parameters,
+    GDBusMethodInvocation * invocation)
+{
+  GstElement *element = NULL;
+  GError *err = NULL;
+  GVariant *ret = NULL;
+
+  if (!pipeline->ladder) {
+    g_dbus_method_invocation_return_error (invocation, G_DBUS_ERROR,
+        G_DBUS_ERROR_NOT_SUPPORTED, "The pipeline '%s' is not a ladder",
+        pipeline->id);
+    return;
+  }
+
+  if (pipeline->parser && gpop_parser_is_created (pipeline->parser))
+    element = gpop_parser_get_element (pipeline->parser);
+
+  if (!g_strcmp0 (method_name, "AddRendition")) {
+    const gchar *name, *encoder_desc, *output_desc;
+    gint width, height;
+
+    g_variant_get (parameters, "(&sii&s&s)", &name, &width, &height,
+        &encoder_desc, &output_desc);
+    gpop_ladder_add_rendition (pipeline->ladder, name, width, height,
+        encoder_desc, output_desc, element, &err);
+  } else if (!g_strcmp0 (method_name, "RemoveRendition")) {
+    const gchar *name;
+
+    g_variant_get (parameters, "(&s)", &name);
+    gpop_ladder_remove_rendition (pipeline->ladder, name, &err);
+  } else {
+    ret = g_variant_new ("(@a(siisstt))",
+        gpop_ladder_to_variant (pipeline->ladder));
+  }
+
+  if (err) {
+    g_dbus_method_invocation_return_error (invocation, G_DBUS_ERROR,
+        G_DBUS_ERROR_INVALID_ARGS, "%s", err->message);
+    g_error_free (err);
+  } else {
+    g_dbus_method_invocation_return_value (invocation, ret);
+  }
+}
+
 static void
 gpop_pipeline_dbus_method_call (GDBusConnection * connection,
     const gchar * sender,
@@ -47,6 +129,65 @@ gpop_pipeline_dbus_method_call (GDBusConnection * connection,
     GVariant * parameters,
     GDBusMethodInvocation * invocation, gpointer user_data)
 {
+  GPOPPipeline *pipeline = (GPOPPipeline *) user_data;
+  gboolean res = FALSE;
+
+  if (g_str_has_suffix (method_name, "Rendition")
+      || !g_strcmp0 (method_name, "GetRenditions")) {
+    gpop_pipeline_ladder_method_call (pipeline, method_name, parameters,
+        invocation);
+    g_dbus_connection_flush (connection, NULL, NULL, NULL);
+    return;
+  }
+
+  if (!g_strcmp0 (method_name, "SetSlo")) {
+    GPOPSloTargets targets;
+
+    g_variant_get (parameters, "(ddd)", &targets.min_fps,
+        &targets.max_latency_ms, &targets.max_dropped_per_minute);
+    if (targets.min_fps < 0 || targets.max_latency_ms < 0
+        || targets.max_dropped_per_minute < 0) {
+      g_dbus_method_invocation_return_error (invocation, G_DBUS_ERROR,
+          G_DBUS_ERROR_INVALID_ARGS, "An objective can not be negative");
+    } else {
+      gpop_pipeline_set_slo (pipeline, &targets);
+      g_dbus_method_invocation_return_value (invocation, NULL);
+    }
+    g_dbus_connection_flush (connection, NULL, NULL, NULL);
+    return;
+  }
+
+  if (!g_strcmp0 (method_name, "Seek")) {
+    gint64 position;
+
+    g_variant_get (parameters, "(x)", &position);
+    if (gpop_pipeline_seek (pipeline, position))
+      g_dbus_method_invocation_return_value (invocation, NULL);
+    else
+      g_dbus_method_invocation_return_error (invocation, G_DBUS_ERROR,
+          G_DBUS_ERROR_NOT_SUPPORTED, "Unable to seek the pipeline '%s'",
+          pipeline->id);
+    g_dbus_connection_flush (connection, NULL, NULL, NULL);
+    return;
+  }
+
+  /* An explicit request overrides the load shedding */
+  pipeline->shed_paused = FALSE;
+  if (!g_strcmp0 (method_name, "Play")) {
+    res = gpop_pipeline_set_state (pipeline, GPOP_PARSER_PLAYING);
+  } else if (!g_strcmp0 (method_name, "Pause")) {
+    res = gpop_pipeline_set_state (pipeline, GPOP_PARSER_PAUSED);
+  } else if (!g_strcmp0 (method_name, "Stop")) {
+    res = gpop_pipeline_set_state (pipeline, GPOP_PARSER_READY);
+  }
+
+  if (res)
+    g_dbus_method_invocation_return_value (invocation, NULL);
+  else
+    g_dbus_method_invocation_return_error (invocation, G_DBUS_ERROR,
+        G_DBUS_ERROR_FAILED, "Unable to %s the pipeline '%s'", method_name,
+        pipeline->id);
+  g_dbus_connection_flush (connection, NULL, NULL, NULL);
 }
 
 GVariant *
@@ -63,7 +204,25 @@ gpop_pipeline_dbus_get_property (GDBusConnection * connection,
   } else if (!g_strcmp0 (property_name, "id")) {
     ret = g_variant_new ("s", pipeline->id);
   } else if (!g_strcmp0 (property_name, "streaming")) {
-    ret = g_variant_new ("b", gpop_parser_is_playing (pipeline->parser));
+    ret = g_variant_new ("b", pipeline->parser
+        && gpop_parser_is_playing (pipeline->parser));
+  } else if (!g_strcmp0 (property_name, "state")) {
+    ret = g_variant_new ("s", gpop_parser_state_get_name (pipeline->state));
+  } else if (!g_strcmp0 (property_name, "priority")) {
+    ret = g_variant_new ("i", pipeline->priority);
+  } else if (!g_strcmp0 (property_name, "slo")) {
+    GPOPSloTargets targets = { 0, };
+
+    if (pipeline->slo)
+      gpop_slo_get_targets (pipeline->slo, &targets);
+    ret = g_variant_new ("(ddd)", targets.min_fps, targets.max_latency_ms,
+        targets.max_dropped_per_minute);
+  } else if (!g_strcmp0 (property_name, "prewarm")) {
+    ret = g_variant_new ("b", pipeline->prewarm);
+  } else if (!g_strcmp0 (property_name, "position")) {
+    ret = g_variant_new ("x", gpop_pipeline_get_position (pipeline));
+  } else if (!g_strcmp0 (property_name, "migratable")) {
+    ret = g_variant_new ("b", gpop_pipeline_is_migratable (pipeline));
   }
   return ret;
 }
@@ -76,6 +235,12 @@ gpop_pipeline_dbus_set_property (GDBusConnection * connection,
     const gchar * property_name,
     GVariant * value, GError ** error, gpointer user_data)
 {
+  GPOPPipeline *pipeline = (GPOPPipeline *) user_data;
+
+  if (!g_strcmp0 (property_name, "priority"))
+    gpop_pipeline_set_priority (pipeline, g_variant_get_int32 (value));
+  else if (!g_strcmp0 (property_name, "prewarm"))
+    gpop_pipeline_set_prewarm (pipeline, g_variant_get_boolean (value));
   return *error == NULL;
 }
 
@@ -94,6 +259,8 @@ gpop_pipeline_dispose (GObject * object)
   g_clear_pointer (&pipeline->id, g_free);
   g_clear_object (&pipeline->manager);
   g_clear_object (&pipeline->parser);
+  g_clear_pointer (&pipeline->ladder, gpop_ladder_free);
+  g_clear_pointer (&pipeline->slo, gpop_slo_free);
 
   if (G_OBJECT_CLASS (parent_class)->dispose)
     G_OBJECT_CLASS (parent_class)->dispose (object);
@@ -119,38 +286,118 @@ gpop_pipeline_class_init (GPOPPipelineClass * klass)
 static void
 gpop_pipeline_init (GPOPPipeline * pipeline)
 {
+  pipeline->state = GPOP_PARSER_READY;
 }
 
 static void
 on_stream_state (GPOPParser * parser, GPOPParserState state,
     gpointer user_data)
 {
+  GPOPPipeline *pipeline = (GPOPPipeline *) user_data;
   GPOP_LOG ("state %d", state);
 
-  if (state >= GPOP_PARSER_EOS) {
+  pipeline->state = state;
+  gpop_dbus_interface_emit_property_changed (GPOP_DBUS_INTERFACE (pipeline),
+      "state", g_variant_new ("s", gpop_parser_state_get_name (state)));
+  gpop_dbus_interface_emit_property_changed (GPOP_DBUS_INTERFACE (pipeline),
+      "streaming", g_variant_new ("b", state == GPOP_PARSER_PLAYING));
+  gpop_manager_update_sampling (pipeline->manager);
+
+  /* a draining pipeline is stopped by the manager shutdown */
+  if (state >= GPOP_PARSER_EOS && !pipeline->draining) {
+    /* done, not to be resumed */
+    if (state == GPOP_PARSER_EOS && pipeline->manager->checkpoint)
+      gpop_checkpoint_remove (pipeline->manager->checkpoint, pipeline->id);
     gpop_parser_quit (parser);
   }
 }
 
+static GPOPParser *
+gpop_pipeline_ensure_parser (GPOPPipeline * pipeline)
+{
+  if (!pipeline->parser) {
+    pipeline->parser = gpop_parser_new (pipeline->id);
+    g_signal_connect (pipeline->parser, "state-changed",
+        G_CALLBACK (on_stream_state), pipeline);
+  }
+  return pipeline->parser;
+}
+
+/* Builds the GStreamer pipeline from the description */
+static gboolean
+gpop_pipeline_build (GPOPPipeline * pipeline)
+{
+  GPOPParser *parser = gpop_pipeline_ensure_parser (pipeline);
+  GstElement *element;
+
+  if (!gpop_parser_create (parser, pipeline->parser_desc))
+    return FALSE;
+  element = gpop_parser_get_element (parser);
+
+  if (pipeline->ladder) {
+    GError *err = NULL;
+
+    if (!gpop_ladder_attach (pipeline->ladder, element, &err)) {
+      GPOP_LOG ("Unable to build the ladder %s: %s", pipeline->id,
+          err->message);
+      g_error_free (err);
+      gpop_parser_release (parser);
+      return FALSE;
+    }
+  }
+  /* the stats of the sinks, for the objectives and the history */
+  if (!pipeline->slo)
+    pipeline->slo = gpop_slo_new ();
+  gpop_slo_attach (pipeline->slo, element);
+  if (pipeline->prewarm)
+    gpop_prewarm_attach (element);
+  if (pipeline->manager->checkpoint)
+    pipeline->resuming =
+        gpop_checkpoint_resume (pipeline->manager->checkpoint, pipeline->id,
+        pipeline->parser_desc, element);
+  return TRUE;
+}
+
+/* Prerolls a resumed pipeline and seeks it to its checkpoint before it
+ * writes anything */
+static void
+gpop_pipeline_resume (GPOPPipeline * pipeline)
+{
+  GstElement *element = gpop_parser_get_element (pipeline->parser);
+
+  pipeline->resuming = FALSE;
+  if (!gpop_parser_change_state (pipeline->parser, GPOP_PARSER_PAUSED)
+      || gst_element_get_state (element, NULL, NULL,
+          GPOP_PIPELINE_RESUME_TIMEOUT_SECONDS * GST_SECOND) !=
+      GST_STATE_CHANGE_SUCCESS
+      || !gpop_checkpoint_seek (pipeline->manager->checkpoint, pipeline->id,
+          element))
+    GPOP_LOG ("Unable to resume the pipeline %s from its checkpoint",
+        pipeline->id);
+}
+
 /* Public API */
 
 GPOPPipeline *
 gpop_pipeline_new (GPOPManager * manager, GDBusConnection * connection,
-    guint num)
+    guint num, const gchar * id)
 {
   GPOPPipeline *pipeline = g_object_new (GPOP_TYPE_PIPELINE, NULL);
   gchar *object_path = g_strdup_printf (GPOP_PIPELINE_OBJECT_PATH, num);
   pipeline->manager = g_object_ref (manager);
+  pipeline->num = num;
+  pipeline->id = g_strdup (id);
+  pipeline->prewarm = manager->prewarm;
 
   if (!gpop_dbus_interface_register (GPOP_DBUS_INTERFACE (pipeline),
           object_path, gpop_pipeline_xml_introspection, connection)) {
-      g_object_unref (pipeline);
-      pipeline = NULL;
+    g_object_unref (pipeline);
+    g_free (object_path);
+    return NULL;
   }
 
-  pipeline->parser = gpop_parser_new ();
-  g_signal_connect (pipeline->parser, "state-changed",
-      G_CALLBACK (on_stream_state), pipeline);
+  if (!manager->compact)
+    gpop_pipeline_ensure_parser (pipeline);
 
   g_free (object_path);
   return pipeline;
@@ -168,14 +415,222 @@ gpop_pipeline_set_parser_desc (GPOPPipeline * pipeline, const gchar * parser_des
   _gpop_pipeline_clear_desc (pipeline);
 
   pipeline->parser_desc = g_strdup (parser_desc);
-  gpop_parser_play (pipeline->parser, pipeline->parser_desc);
+  /* Deferred until the first state change in compact mode */
+  if (pipeline->manager->compact)
+    return TRUE;
+
+  if (gpop_pipeline_build (pipeline)) {
+    if (pipeline->resuming)
+      gpop_pipeline_resume (pipeline);
+    gpop_parser_change_state (pipeline->parser, GPOP_PARSER_PLAYING);
+  }
   return TRUE;
 }
 
 gboolean
 gpop_pipeline_set_state (GPOPPipeline * pipeline, GPOPParserState state)
 {
+  GPOPParser *parser;
+
   g_assert (pipeline);
 
-  return gpop_parser_change_state (pipeline->parser, state);
+  parser = gpop_pipeline_ensure_parser (pipeline);
+  if (!gpop_parser_is_created (parser) && !gpop_pipeline_build (pipeline))
+    return FALSE;
+  if (pipeline->resuming && (state == GPOP_PARSER_PAUSED
+          || state == GPOP_PARSER_PLAYING))
+    gpop_pipeline_resume (pipeline);
+
+  return gpop_parser_change_state (parser, state);
+}
+
+/* Stream position in nanoseconds, -1 if unknown */
+gint64
+gpop_pipeline_get_position (GPOPPipeline * pipeline)
+{
+  gint64 position;
+
+  if (!pipeline->parser || !gpop_parser_is_created (pipeline->parser)
+      || !gst_element_query_position (gpop_parser_get_element
+          (pipeline->parser), GST_FORMAT_TIME, &position))
+    return -1;
+  return position;
+}
+
+/* Whether the sinks of element write a file or serve a port, which the
+ * copy of a migrating pipeline would do at once with the source */
+static gboolean
+gpop_pipeline_has_exclusive_outputs (GstElement * element)
+{
+  static const gchar *const properties[] = { "location", "port", "bind-port",
+    NULL
+  };
+  GObjectClass *klass = G_OBJECT_GET_CLASS (element);
+  gboolean res = FALSE;
+  guint i;
+
+  if (GST_IS_BIN (element)) {
+    GstIterator *it = gst_bin_iterate_recurse (GST_BIN (element));
+    GValue item = G_VALUE_INIT;
+
+    while (!res && gst_iterator_next (it, &item) == GST_ITERATOR_OK) {
+      res = gpop_pipeline_has_exclusive_outputs (g_value_get_object (&item));
+      g_value_reset (&item);
+    }
+    g_value_unset (&item);
+    gst_iterator_free (it);
+  }
+  /* the sinks, or the bins holding one such as splitmuxsink */
+  if (res || !GST_OBJECT_FLAG_IS_SET (element, GST_ELEMENT_FLAG_SINK))
+    return res;
+  for (i = 0; properties[i]; i++)
+    res |= g_object_class_find_property (klass, properties[i]) != NULL;
+  return res;
+}
+
+/* A migration runs a copy of the pipeline built from its description on
+ * the target until the switchover, see gpop-front.h */
+gboolean
+gpop_pipeline_is_migratable (GPOPPipeline * pipeline)
+{
+  GstElement *element;
+  gboolean res;
+
+  /* the renditions added by AddRendition are not in the description */
+  if (pipeline->ladder || !pipeline->parser_desc)
+    return FALSE;
+  if (pipeline->parser && gpop_parser_is_created (pipeline->parser))
+    return !gpop_pipeline_has_exclusive_outputs (gpop_parser_get_element
+        (pipeline->parser));
+
+  /* not built yet in compact mode, the elements are only instantiated */
+  element = gst_parse_launch (pipeline->parser_desc, NULL);
+  if (!element)
+    return FALSE;
+  gst_object_ref_sink (element);
+  res = !gpop_pipeline_has_exclusive_outputs (element);
+  gst_object_unref (element);
+  return res;
+}
+
+/* Flushing seek of a built pipeline, position in nanoseconds */
+gboolean
+gpop_pipeline_seek (GPOPPipeline * pipeline, gint64 position)
+{
+  if (position < 0 || !pipeline->parser
+      || !gpop_parser_is_created (pipeline->parser))
+    return FALSE;
+
+  return gst_element_seek_simple (gpop_parser_get_element (pipeline->parser),
+      GST_FORMAT_TIME, GST_SEEK_FLAG_FLUSH | GST_SEEK_FLAG_ACCURATE, position);
+}
+
+void
+gpop_pipeline_set_priority (GPOPPipeline * pipeline, gint priority)
+{
+  pipeline->priority = priority;
+  gpop_dbus_interface_emit_property_changed (GPOP_DBUS_INTERFACE (pipeline),
+      "priority", g_variant_new ("i", pipeline->priority));
+}
+
+/* Pre-warms the buffer pools from the next build of the pipeline, see
+ * gpop-prewarm.h */
+void
+gpop_pipeline_set_prewarm (GPOPPipeline * pipeline, gboolean prewarm)
+{
+  if (pipeline->prewarm == prewarm)
+    return;
+
+  pipeline->prewarm = prewarm;
+  gpop_dbus_interface_emit_property_changed (GPOP_DBUS_INTERFACE (pipeline),
+      "prewarm", g_variant_new ("b", pipeline->prewarm));
+}
+
+/* Sets the service level objectives of the pipeline, evaluated by the
+ * manager, see gpop-slo.h */
+void
+gpop_pipeline_set_slo (GPOPPipeline * pipeline, const GPOPSloTargets * targets)
+{
+  GPOPSloTargets current = { 0, };
+
+  if (pipeline->slo)
+    gpop_slo_get_targets (pipeline->slo, &current);
+  if (!memcmp (&current, targets, sizeof (GPOPSloTargets)))
+    return;
+
+  /* attached to the sinks once built */
+  if (!pipeline->slo)
+    pipeline->slo = gpop_slo_new ();
+  gpop_slo_set_targets (pipeline->slo, targets);
+  GPOP_LOG ("Pipeline %s objectives: min fps %.1f, max latency %.1f ms, "
+      "max dropped %.1f/min", pipeline->id, targets->min_fps,
+      targets->max_latency_ms, targets->max_dropped_per_minute);
+  gpop_dbus_interface_emit_property_changed (GPOP_DBUS_INTERFACE (pipeline),
+      "slo", g_variant_new ("(ddd)", targets->min_fps,
+          targets->max_latency_ms, targets->max_dropped_per_minute));
+}
+
+/* Starts draining a playing pipeline on shutdown, returns FALSE if there is
+ * nothing to drain. */
+gboolean
+gpop_pipeline_drain (GPOPPipeline * pipeline)
+{
+  if (!pipeline->parser || !gpop_parser_send_eos (pipeline->parser))
+    return FALSE;
+
+  pipeline->draining = TRUE;
+  return TRUE;
+}
+
+/* Load shedding: each call returns TRUE if the action has been taken. */
+
+/* Releases the GStreamer pipeline of an idle pipeline, it is built again on
+ * the next state change. */
+gboolean
+gpop_pipeline_suspend (GPOPPipeline * pipeline)
+{
+  if (!pipeline->parser || !gpop_parser_is_created (pipeline->parser))
+    return FALSE;
+  /* a pipeline still prerolling is not idle, a finished one is */
+  if (pipeline->state != GPOP_PARSER_EOS
+      && pipeline->state != GPOP_PARSER_ERROR
+      && gpop_parser_is_active (pipeline->parser))
+    return FALSE;
+
+  gpop_parser_release (pipeline->parser);
+  pipeline->shrunk = FALSE;
+  return TRUE;
+}
+
+gboolean
+gpop_pipeline_shrink (GPOPPipeline * pipeline, gboolean shrink)
+{
+  if (pipeline->shrunk == shrink || !pipeline->parser)
+    return FALSE;
+
+  if (!gpop_parser_scale_queues (pipeline->parser,
+          shrink ? GPOP_PIPELINE_SHRINK_SCALE : 1.0))
+    return FALSE;
+  pipeline->shrunk = shrink;
+  return TRUE;
+}
+
+/* Pauses a playing low priority pipeline, or resumes a pipeline paused by
+ * the load shedding. */
+gboolean
+gpop_pipeline_shed (GPOPPipeline * pipeline, gboolean shed)
+{
+  if (shed) {
+    if (pipeline->priority >= 0 || pipeline->state != GPOP_PARSER_PLAYING)
+      return FALSE;
+    if (!gpop_pipeline_set_state (pipeline, GPOP_PARSER_PAUSED))
+      return FALSE;
+    pipeline->shed_paused = TRUE;
+    return TRUE;
+  }
+
+  if (!pipeline->shed_paused)
+    return FALSE;
+  pipeline->shed_paused = FALSE;
+  return gpop_pipeline_set_state (pipeline, GPOP_PARSER_PLAYING);
 }
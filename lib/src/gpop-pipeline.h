@@ -36,6 +36,12 @@
 #define GPOP_IS_PIPELINE_CLASS(klass) (G_TYPE_CHECK_CLASS_TYPE((klass),\
                                               GPOP_TYPE_PIPELINE))
 
+/* Of the pipeline numbered num */
+#define GPOP_PIPELINE_ID "pipeline_%u"
+#define GPOP_PIPELINE_OBJECT_PATH "/org/gpop/Pipeline%u"
+
+extern const char gpop_pipeline_xml_introspection[];
+
 typedef struct _GPOPPipeline GPOPPipeline;
 typedef struct _GPOPPipelineClass GPOPPipelineClass;
 
@@ -47,6 +53,18 @@ struct _GPOPPipeline
   guint num;
   gchar * id;
   gchar * parser_desc;
+  GPOPParserState state;
+  gint priority;
+  gboolean shrunk;
+  gboolean shed_paused;
+  gboolean draining;
+  /* set for a ladder pipeline, see gpop-ladder.h */
+  GPOPLadder *ladder;
+  /* stats of the sinks and objectives, see gpop-slo.h */
+  GPOPSlo *slo;
+  gboolean prewarm;
+  /* to be seeked to its checkpoint before it plays, see gpop-checkpoint.h */
+  gboolean resuming;
 };
 
 struct _GPOPPipelineClass
@@ -54,9 +72,21 @@ struct _GPOPPipelineClass
   GPOPDBusInterfaceClass base;
 };
 
-GPOPPipeline * gpop_pipeline_new (GPOPManager* manager, GDBusConnection* connection, guint num);
+GPOPPipeline * gpop_pipeline_new (GPOPManager* manager, GDBusConnection* connection, guint num, const gchar * id);
 void gpop_pipeline_free (GPOPPipeline* pipeline);
 gboolean gpop_pipeline_set_state (GPOPPipeline* pipeline, GPOPParserState state);
 gboolean gpop_pipeline_set_parser_desc (GPOPPipeline* pipeline, const gchar * parser_desc);
+void gpop_pipeline_set_priority (GPOPPipeline * pipeline, gint priority);
+gint64 gpop_pipeline_get_position (GPOPPipeline * pipeline);
+gboolean gpop_pipeline_seek (GPOPPipeline * pipeline, gint64 position);
+gboolean gpop_pipeline_is_migratable (GPOPPipeline * pipeline);
+void gpop_pipeline_set_prewarm (GPOPPipeline * pipeline, gboolean prewarm);
+void gpop_pipeline_set_slo (GPOPPipeline * pipeline, const GPOPSloTargets * targets);
+
+gboolean gpop_pipeline_drain (GPOPPipeline * pipeline);
+
+gboolean gpop_pipeline_suspend (GPOPPipeline * pipeline);
+gboolean gpop_pipeline_shrink (GPOPPipeline * pipeline, gboolean shrink);
+gboolean gpop_pipeline_shed (GPOPPipeline * pipeline, gboolean shed);
 
 #endif /* _GPOP_PIPELINE_H_ */
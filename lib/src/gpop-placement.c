@@ -0,0 +1,471 @@
+/*
+ * GStreamer Prince of Parser
+ *
+ * Copyright (C) 2020 Stéphane Cerveau
+ *
+ * SPDX-License-Identifier: LGPL
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation
+ * version 2.1 of the License.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301 USA
+ *
+ */
+
+#ifdef __linux__
+#ifndef _GNU_SOURCE
+#define _GNU_SOURCE
+#endif
+#include <sched.h>
+#endif
+#include <errno.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "gpop-private.h"
+
+/* Fraction of a group capacity filled by the packing, and the load above
+ * which pipelines are moved out of a group. The gap is the hysteresis. */
+#define GPOP_PLACEMENT_TARGET 0.75
+#define GPOP_PLACEMENT_HIGH 0.9
+
+typedef struct
+{
+  gchar *cpus_name;
+  GArray *cpus;
+  gdouble load;
+} GPOPPlacementGroup;
+
+typedef struct
+{
+  gchar *id;
+  /* tid -> utime + stime ticks at the last update */
+  GHashTable *ticks;
+  gdouble load;
+  gint group;
+  gint previous;
+  guint n_threads;
+  /* sum of the placed thread ids, to notice new threads */
+  guint64 threads_sum;
+  gint64 moved;
+  gboolean seen;
+} GPOPPlacementEntry;
+
+struct _GPOPPlacement
+{
+  GPtrArray *groups;
+  GHashTable *entries;
+  gint64 last_update;
+  glong ticks_per_second;
+};
+
+static void
+gpop_placement_group_free (GPOPPlacementGroup * group)
+{
+  g_free (group->cpus_name);
+  g_array_unref (group->cpus);
+  g_free (group);
+}
+
+static void
+gpop_placement_entry_free (GPOPPlacementEntry * entry)
+{
+  g_free (entry->id);
+  g_hash_table_unref (entry->ticks);
+  g_free (entry);
+}
+
+static gboolean
+gpop_placement_cpu_allowed (gint cpu)
+{
+#ifdef __linux__
+  static cpu_set_t allowed;
+  static gsize initialized = 0;
+
+  if (g_once_init_enter (&initialized)) {
+    if (sched_getaffinity (0, sizeof (allowed), &allowed) < 0)
+      CPU_ZERO (&allowed);
+    g_once_init_leave (&initialized, 1);
+  }
+  return CPU_ISSET (cpu, &allowed);
+#else
+  return TRUE;
+#endif
+}
+
+static gchar *
+gpop_placement_get_cache_siblings (gint cpu)
+{
+  gchar *path, *contents = NULL;
+  gint index;
+
+  /* index3 is the L3 on most hosts, fall back to the deepest cache level */
+  for (index = 3; index >= 0 && !contents; index--) {
+    path = g_strdup_printf
+        ("/sys/devices/system/cpu/cpu%d/cache/index%d/shared_cpu_list", cpu,
+        index);
+    g_file_get_contents (path, &contents, NULL, NULL);
+    g_free (path);
+  }
+  if (!contents)
+    return g_strdup_printf ("%d", cpu);
+
+  return g_strstrip (contents);
+}
+
+static void
+gpop_placement_discover (GPOPPlacement * placement)
+{
+  GHashTable *by_siblings = g_hash_table_new_full (g_str_hash, g_str_equal,
+      g_free, NULL);
+  guint cpu, n_cpus = g_get_num_processors ();
+  glong n_configured = sysconf (_SC_NPROCESSORS_CONF);
+
+  /* the allowed cpus are not necessarily the first ones, eg for a worker
+   * of a front or under taskset */
+  if (n_configured > (glong) n_cpus)
+    n_cpus = n_configured;
+#ifdef __linux__
+  n_cpus = MIN (n_cpus, CPU_SETSIZE);
+#endif
+
+  for (cpu = 0; cpu < n_cpus; cpu++) {
+    GPOPPlacementGroup *group;
+    gchar *siblings;
+
+    if (!gpop_placement_cpu_allowed (cpu))
+      continue;
+    siblings = gpop_placement_get_cache_siblings (cpu);
+    group = g_hash_table_lookup (by_siblings, siblings);
+    if (!group) {
+      group = g_new0 (GPOPPlacementGroup, 1);
+      group->cpus = g_array_new (FALSE, FALSE, sizeof (gint));
+      g_ptr_array_add (placement->groups, group);
+      g_hash_table_insert (by_siblings, siblings, group);
+    } else {
+      g_free (siblings);
+    }
+    g_array_append_val (group->cpus, cpu);
+  }
+  g_hash_table_unref (by_siblings);
+
+  for (cpu = 0; cpu < placement->groups->len; cpu++) {
+    GPOPPlacementGroup *group = g_ptr_array_index (placement->groups, cpu);
+    GString *name = g_string_new (NULL);
+    guint i;
+
+    for (i = 0; i < group->cpus->len; i++)
+      g_string_append_printf (name, "%s%d", i ? "," : "",
+          g_array_index (group->cpus, gint, i));
+    group->cpus_name = g_string_free (name, FALSE);
+    GPOP_LOG ("Placement group %u: cpus %s", cpu, group->cpus_name);
+  }
+}
+
+static guint64
+gpop_placement_read_ticks (gint tid)
+{
+  gchar *path = g_strdup_printf ("/proc/self/task/%d/stat", tid);
+  gchar *contents = NULL, *fields;
+  gchar **tokens;
+  guint64 ticks = 0;
+
+  if (g_file_get_contents (path, &contents, NULL, NULL)
+      && (fields = strrchr (contents, ')'))) {
+    /* fields 14 and 15 of proc(5), counting from the state as field 3 */
+    tokens = g_strsplit (fields + 2, " ", 14);
+    if (g_strv_length (tokens) >= 14)
+      ticks = g_ascii_strtoull (tokens[11], NULL, 10) +
+          g_ascii_strtoull (tokens[12], NULL, 10);
+    g_strfreev (tokens);
+  }
+  g_free (contents);
+  g_free (path);
+
+  return ticks;
+}
+
+static guint64
+gpop_placement_threads_sum (GArray * threads)
+{
+  guint64 sum = 0;
+  guint i;
+
+  for (i = 0; i < threads->len; i++)
+    sum += g_array_index (threads, gint, i);
+  return sum;
+}
+
+static void
+gpop_placement_apply (GPOPPlacement * placement, GPOPPlacementEntry * entry,
+    GArray * threads)
+{
+#ifdef __linux__
+  GPOPPlacementGroup *group = g_ptr_array_index (placement->groups,
+      entry->group);
+  cpu_set_t set;
+  guint i;
+
+  CPU_ZERO (&set);
+  for (i = 0; i < group->cpus->len; i++)
+    CPU_SET (g_array_index (group->cpus, gint, i), &set);
+
+  for (i = 0; i < threads->len; i++) {
+    gint tid = g_array_index (threads, gint, i);
+    /* ESRCH: the thread has exited since its LEAVE was handled */
+    if (sched_setaffinity (tid, sizeof (set), &set) < 0 && errno != ESRCH)
+      GPOP_LOG ("Unable to place thread %d of '%s' on cpus %s: %s", tid,
+          entry->id, group->cpus_name, g_strerror (errno));
+  }
+#endif
+  entry->n_threads = threads->len;
+  entry->threads_sum = gpop_placement_threads_sum (threads);
+}
+
+/* Measures the cpu load of the pipeline since the last update, in cores */
+static void
+gpop_placement_measure (GPOPPlacement * placement, GPOPPlacementEntry * entry,
+    GArray * threads, gdouble elapsed)
+{
+  GHashTable *ticks = g_hash_table_new (g_direct_hash, g_direct_equal);
+  guint64 used = 0;
+  guint i;
+
+  for (i = 0; i < threads->len; i++) {
+    gint tid = g_array_index (threads, gint, i);
+    guint64 now = gpop_placement_read_ticks (tid);
+    guint64 before = GPOINTER_TO_SIZE (g_hash_table_lookup (entry->ticks,
+            GINT_TO_POINTER (tid)));
+
+    if (now >= before)
+      used += now - before;
+    g_hash_table_insert (ticks, GINT_TO_POINTER (tid), GSIZE_TO_POINTER (now));
+  }
+  g_hash_table_unref (entry->ticks);
+  entry->ticks = ticks;
+
+  if (elapsed > 0)
+    entry->load = (entry->load +
+        (gdouble) used / placement->ticks_per_second / elapsed) / 2;
+}
+
+static gint
+gpop_placement_compare_load (gconstpointer a, gconstpointer b)
+{
+  const GPOPPlacementEntry *ea = *(GPOPPlacementEntry **) a;
+  const GPOPPlacementEntry *eb = *(GPOPPlacementEntry **) b;
+
+  return (ea->load < eb->load) - (ea->load > eb->load);
+}
+
+/* Moves entries out of the overloaded groups, the lightest entry which
+ * removes the overload first so that the least possible is disturbed. */
+static void
+gpop_placement_evict (GPOPPlacement * placement, GPtrArray * placed,
+    gint64 now)
+{
+  guint g, i;
+
+  for (g = 0; g < placement->groups->len; g++) {
+    GPOPPlacementGroup *group = g_ptr_array_index (placement->groups, g);
+    gdouble high = group->cpus->len * GPOP_PLACEMENT_HIGH;
+
+    while (group->load > high) {
+      GPOPPlacementEntry *victim = NULL;
+
+      for (i = 0; i < placed->len; i++) {
+        GPOPPlacementEntry *entry = g_ptr_array_index (placed, i);
+        if (entry->group != (gint) g
+            || now - entry->moved < GPOP_PLACEMENT_DWELL_SECONDS * G_USEC_PER_SEC)
+          continue;
+        /* placed is sorted by decreasing load, default to the heaviest */
+        if (!victim || group->load - entry->load <= high)
+          victim = entry;
+      }
+      if (!victim)
+        break;
+      group->load -= victim->load;
+      victim->group = -1;
+    }
+  }
+}
+
+static void
+gpop_placement_pack (GPOPPlacement * placement, GPOPPlacementEntry * entry)
+{
+  GPOPPlacementGroup *group, *best = NULL;
+  gint best_index = 0;
+  guint g;
+
+  /* First fit, keeps the load on as few caches as possible */
+  for (g = 0; g < placement->groups->len; g++) {
+    group = g_ptr_array_index (placement->groups, g);
+    if (group->load + entry->load <= group->cpus->len * GPOP_PLACEMENT_TARGET) {
+      best = group;
+      best_index = g;
+      break;
+    }
+  }
+  /* Everything is full, take the least used group */
+  for (g = 0; !best && g < placement->groups->len; g++) {
+    group = g_ptr_array_index (placement->groups, g);
+    if (!best || group->load / group->cpus->len <
+        best->load / best->cpus->len) {
+      best = group;
+      best_index = g;
+    }
+  }
+
+  best->load += entry->load;
+  entry->group = best_index;
+}
+
+/* API */
+
+GPOPPlacement *
+gpop_placement_new (void)
+{
+  GPOPPlacement *placement = g_new0 (GPOPPlacement, 1);
+
+  placement->groups =
+      g_ptr_array_new_with_free_func ((GDestroyNotify)
+      gpop_placement_group_free);
+  placement->entries = g_hash_table_new_full (g_str_hash, g_str_equal, NULL,
+      (GDestroyNotify) gpop_placement_entry_free);
+  placement->ticks_per_second = sysconf (_SC_CLK_TCK);
+  placement->last_update = g_get_monotonic_time ();
+  gpop_placement_discover (placement);
+
+  return placement;
+}
+
+void
+gpop_placement_free (GPOPPlacement * placement)
+{
+  if (!placement)
+    return;
+
+  g_hash_table_unref (placement->entries);
+  g_ptr_array_unref (placement->groups);
+  g_free (placement);
+}
+
+void
+gpop_placement_update (GPOPPlacement * placement, GList * pipelines)
+{
+  GPtrArray *placed = g_ptr_array_new ();
+  GHashTable *threads = g_hash_table_new_full (g_direct_hash, g_direct_equal,
+      NULL, (GDestroyNotify) g_array_unref);
+  GHashTableIter iter;
+  GPOPPlacementEntry *entry;
+  gint64 now = g_get_monotonic_time ();
+  gdouble elapsed = (gdouble) (now - placement->last_update) / G_USEC_PER_SEC;
+  guint i;
+  GList *l;
+
+  if (!placement->groups->len)
+    goto done;
+
+  for (l = pipelines; l != NULL; l = g_list_next (l)) {
+    GPOPPipeline *pipeline = (GPOPPipeline *) l->data;
+    GArray *pipeline_threads;
+
+    if (!pipeline->parser || !gpop_parser_is_created (pipeline->parser))
+      continue;
+
+    entry = g_hash_table_lookup (placement->entries, pipeline->id);
+    if (!entry) {
+      entry = g_new0 (GPOPPlacementEntry, 1);
+      entry->id = g_strdup (pipeline->id);
+      entry->ticks = g_hash_table_new (g_direct_hash, g_direct_equal);
+      entry->group = -1;
+      g_hash_table_insert (placement->entries, entry->id, entry);
+    }
+    pipeline_threads = gpop_parser_get_threads (pipeline->parser);
+    gpop_placement_measure (placement, entry, pipeline_threads, elapsed);
+    g_hash_table_insert (threads, entry, pipeline_threads);
+    entry->seen = TRUE;
+  }
+
+  for (i = 0; i < placement->groups->len; i++)
+    ((GPOPPlacementGroup *) g_ptr_array_index (placement->groups, i))->load = 0;
+
+  g_hash_table_iter_init (&iter, placement->entries);
+  while (g_hash_table_iter_next (&iter, NULL, (gpointer *) & entry)) {
+    if (!entry->seen) {
+      g_hash_table_iter_remove (&iter);
+      continue;
+    }
+    entry->seen = FALSE;
+    if (entry->group >= 0)
+      ((GPOPPlacementGroup *) g_ptr_array_index (placement->groups,
+              entry->group))->load += entry->load;
+    g_ptr_array_add (placed, entry);
+  }
+  g_ptr_array_sort (placed, gpop_placement_compare_load);
+
+  for (i = 0; i < placed->len; i++) {
+    entry = g_ptr_array_index (placed, i);
+    entry->previous = entry->group;
+  }
+  gpop_placement_evict (placement, placed, now);
+
+  for (i = 0; i < placed->len; i++) {
+    GArray *pipeline_threads;
+
+    entry = g_ptr_array_index (placed, i);
+    pipeline_threads = g_hash_table_lookup (threads, entry);
+    if (entry->group < 0)
+      gpop_placement_pack (placement, entry);
+
+    if (entry->group != entry->previous) {
+      entry->moved = now;
+      GPOP_LOG ("Placing pipeline '%s' (%.2f cpu) on cpus %s", entry->id,
+          entry->load, ((GPOPPlacementGroup *)
+              g_ptr_array_index (placement->groups,
+                  entry->group))->cpus_name);
+      gpop_tracer_instant ("placement", "move", entry->id);
+    } else if (entry->n_threads == pipeline_threads->len
+        && entry->threads_sum == gpop_placement_threads_sum (pipeline_threads)) {
+      continue;
+    }
+    gpop_placement_apply (placement, entry, pipeline_threads);
+  }
+
+done:
+  placement->last_update = now;
+  g_hash_table_unref (threads);
+  g_ptr_array_unref (placed);
+}
+
+/* a(ssdu): pipeline id, cpus, load in cores, number of threads */
+GVariant *
+gpop_placement_to_variant (GPOPPlacement * placement)
+{
+  GVariantBuilder builder;
+  GHashTableIter iter;
+  GPOPPlacementEntry *entry;
+
+  g_variant_builder_init (&builder, G_VARIANT_TYPE ("a(ssdu)"));
+  if (placement) {
+    g_hash_table_iter_init (&iter, placement->entries);
+    while (g_hash_table_iter_next (&iter, NULL, (gpointer *) & entry)) {
+      g_variant_builder_add (&builder, "(ssdu)", entry->id,
+          entry->group >= 0 ? ((GPOPPlacementGroup *)
+              g_ptr_array_index (placement->groups,
+                  entry->group))->cpus_name : "", entry->load,
+          entry->n_threads);
+    }
+  }
+
+  return g_variant_builder_end (&builder);
+}
@@ -0,0 +1,48 @@
+/*
+ * GStreamer Prince of Parser
+ *
+ * Copyright (C) 2020 Stéphane Cerveau
+ *
+ * SPDX-License-Identifier: LGPL
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation
+ * version 2.1 of the License.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301 USA
+ *
+ */
+
+#ifndef _GPOP_PLACEMENT_H_
+#define _GPOP_PLACEMENT_H_
+
+#include <glib-2.0/glib.h>
+
+/* Placement of the pipelines streaming threads on the cpus.
+ *
+ * The cpus are grouped by shared last level cache. Each update measures the
+ * cpu time of the threads of every pipeline and packs the pipelines in the
+ * groups (first fit decreasing), so that the threads of a pipeline share a
+ * cache. A placed pipeline only moves when its group is overloaded and not
+ * more often than every GPOP_PLACEMENT_DWELL_SECONDS. */
+
+#define GPOP_PLACEMENT_PERIOD_SECONDS 5
+#define GPOP_PLACEMENT_DWELL_SECONDS 30
+
+typedef struct _GPOPPlacement GPOPPlacement;
+
+GPOPPlacement * gpop_placement_new (void);
+void gpop_placement_free (GPOPPlacement * placement);
+
+void gpop_placement_update (GPOPPlacement * placement, GList * pipelines);
+GVariant * gpop_placement_to_variant (GPOPPlacement * placement);
+
+#endif /* _GPOP_PLACEMENT_H_ */
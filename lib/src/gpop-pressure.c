@@ -0,0 +1,304 @@
+/*
+ * GStreamer Prince of Parser
+ *
+ * Copyright (C) 2020 Stéphane Cerveau
+ *
+ * SPDX-License-Identifier: LGPL
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation
+ * version 2.1 of the License.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301 USA
+ *
+ */
+
+#include <errno.h>
+#include <fcntl.h>
+#include <string.h>
+#include <unistd.h>
+#include <glib-unix.h>
+
+#include "gpop-private.h"
+
+/* Re-read period of the averages while under pressure, or without triggers */
+#define GPOP_PRESSURE_RECHECK_SECONDS 2
+
+typedef struct
+{
+  const gchar *path;
+  const gchar *trigger;
+} GPOPPressureTrigger;
+
+/* "<some|full> <stall us> <window us>", unprivileged triggers are accepted
+ * by the kernel when the window is a multiple of 2s. */
+static const GPOPPressureTrigger pressure_triggers[] = {
+  {"/proc/pressure/memory", "some 100000 2000000"},
+  {"/proc/pressure/memory", "full 50000 2000000"},
+  {"/proc/pressure/cpu", "some 800000 2000000"},
+};
+
+#define GPOP_PRESSURE_N_TRIGGERS G_N_ELEMENTS (pressure_triggers)
+
+/* avg10 percentages entering each level */
+typedef struct
+{
+  gdouble memory_some;
+  gdouble memory_full;
+  gdouble cpu_some;
+} GPOPPressureThresholds;
+
+static const GPOPPressureThresholds pressure_thresholds[GPOP_PRESSURE_LAST] = {
+  [GPOP_PRESSURE_SOME] = {5.0, 1.0, 40.0},
+  [GPOP_PRESSURE_HIGH] = {15.0, 5.0, 70.0},
+  [GPOP_PRESSURE_CRITICAL] = {30.0, 10.0, 90.0},
+};
+
+struct _GPOPPressureMonitor
+{
+  GPOPPressureFunc func;
+  gpointer user_data;
+  GPOPPressureLevel level;
+  gint fds[GPOP_PRESSURE_N_TRIGGERS];
+  guint fd_ids[GPOP_PRESSURE_N_TRIGGERS];
+  gboolean polling;
+  guint recheck_id;
+};
+
+static gboolean gpop_pressure_monitor_recheck (gpointer user_data);
+
+static gdouble
+gpop_pressure_parse_avg10 (const gchar * line)
+{
+  const gchar *avg10 = strstr (line, "avg10=");
+
+  if (!avg10)
+    return 0.0;
+  return g_ascii_strtod (avg10 + strlen ("avg10="), NULL);
+}
+
+static void
+gpop_pressure_read (const gchar * path, gdouble * some, gdouble * full)
+{
+  gchar *contents = NULL;
+  gchar **lines, **line;
+
+  *some = *full = 0.0;
+  if (!g_file_get_contents (path, &contents, NULL, NULL))
+    return;
+
+  lines = g_strsplit (contents, "\n", -1);
+  for (line = lines; *line; line++) {
+    if (g_str_has_prefix (*line, "some "))
+      *some = gpop_pressure_parse_avg10 (*line);
+    else if (g_str_has_prefix (*line, "full "))
+      *full = gpop_pressure_parse_avg10 (*line);
+  }
+  g_strfreev (lines);
+  g_free (contents);
+}
+
+static GPOPPressureLevel
+gpop_pressure_compute_level (void)
+{
+  gdouble memory_some, memory_full, cpu_some, cpu_full;
+  GPOPPressureLevel level;
+
+  gpop_pressure_read ("/proc/pressure/memory", &memory_some, &memory_full);
+  gpop_pressure_read ("/proc/pressure/cpu", &cpu_some, &cpu_full);
+
+  for (level = GPOP_PRESSURE_CRITICAL; level > GPOP_PRESSURE_NONE; level--) {
+    const GPOPPressureThresholds *t = &pressure_thresholds[level];
+    if (memory_some >= t->memory_some || memory_full >= t->memory_full
+        || cpu_some >= t->cpu_some)
+      return level;
+  }
+  return GPOP_PRESSURE_NONE;
+}
+
+static void
+gpop_pressure_monitor_update (GPOPPressureMonitor * monitor)
+{
+  GPOPPressureLevel level = gpop_pressure_compute_level ();
+
+  /* Rise at once but recover one level per recheck, the averages lag
+   * behind the actual stalls and would otherwise make the actions flap. */
+  if (level < monitor->level)
+    level = monitor->level - 1;
+
+  if (level != monitor->level) {
+    monitor->level = level;
+    monitor->func (level, monitor->user_data);
+  }
+
+  if (monitor->level > GPOP_PRESSURE_NONE && !monitor->recheck_id)
+    monitor->recheck_id =
+        gpop_timers_add (GPOP_PRESSURE_RECHECK_SECONDS * 1000,
+        gpop_pressure_monitor_recheck, monitor);
+}
+
+static gboolean
+gpop_pressure_monitor_recheck (gpointer user_data)
+{
+  GPOPPressureMonitor *monitor = (GPOPPressureMonitor *) user_data;
+
+  gpop_pressure_monitor_update (monitor);
+
+  /* Back to idle, the triggers will wake us up */
+  if (monitor->level == GPOP_PRESSURE_NONE && !monitor->polling) {
+    monitor->recheck_id = 0;
+    return G_SOURCE_REMOVE;
+  }
+  return G_SOURCE_CONTINUE;
+}
+
+static gboolean
+gpop_pressure_monitor_on_trigger (gint fd, GIOCondition condition,
+    gpointer user_data)
+{
+  GPOPPressureMonitor *monitor = (GPOPPressureMonitor *) user_data;
+  guint i;
+
+  if (condition & G_IO_ERR) {
+    /* The trigger has been destroyed by the kernel, fall back to polling */
+    for (i = 0; i < GPOP_PRESSURE_N_TRIGGERS; i++) {
+      if (monitor->fds[i] == fd) {
+        monitor->fd_ids[i] = 0;
+        close (fd);
+        monitor->fds[i] = -1;
+      }
+    }
+    monitor->polling = TRUE;
+    if (!monitor->recheck_id)
+      monitor->recheck_id =
+          gpop_timers_add (GPOP_PRESSURE_RECHECK_SECONDS * 1000,
+          gpop_pressure_monitor_recheck, monitor);
+    return G_SOURCE_REMOVE;
+  }
+
+  gpop_pressure_monitor_update (monitor);
+  return G_SOURCE_CONTINUE;
+}
+
+static gint
+gpop_pressure_open_trigger (const GPOPPressureTrigger * trigger)
+{
+  gint fd = open (trigger->path, O_RDWR | O_NONBLOCK | O_CLOEXEC);
+
+  if (fd < 0)
+    return -1;
+
+  /* The trailing NUL is part of the trigger */
+  if (write (fd, trigger->trigger, strlen (trigger->trigger) + 1) < 0) {
+    GPOP_LOG ("Unable to arm the PSI trigger '%s' on %s: %s",
+        trigger->trigger, trigger->path, g_strerror (errno));
+    close (fd);
+    return -1;
+  }
+  return fd;
+}
+
+/* API */
+
+GPOPPressureMonitor *
+gpop_pressure_monitor_new (GPOPPressureFunc func, gpointer user_data)
+{
+  GPOPPressureMonitor *monitor = g_new0 (GPOPPressureMonitor, 1);
+  guint i;
+
+  monitor->func = func;
+  monitor->user_data = user_data;
+  monitor->level = GPOP_PRESSURE_NONE;
+
+  if (!g_file_test ("/proc/pressure/memory", G_FILE_TEST_EXISTS)) {
+    GPOP_LOG ("PSI is not available, load shedding is disabled");
+    for (i = 0; i < GPOP_PRESSURE_N_TRIGGERS; i++)
+      monitor->fds[i] = -1;
+    return monitor;
+  }
+
+  for (i = 0; i < GPOP_PRESSURE_N_TRIGGERS; i++) {
+    monitor->fds[i] = gpop_pressure_open_trigger (&pressure_triggers[i]);
+    if (monitor->fds[i] < 0) {
+      monitor->polling = TRUE;
+      continue;
+    }
+    monitor->fd_ids[i] = g_unix_fd_add (monitor->fds[i],
+        G_IO_PRI | G_IO_ERR, gpop_pressure_monitor_on_trigger, monitor);
+  }
+
+  if (monitor->polling)
+    monitor->recheck_id = gpop_timers_add (GPOP_PRESSURE_RECHECK_SECONDS
+        * 1000, gpop_pressure_monitor_recheck, monitor);
+
+  return monitor;
+}
+
+void
+gpop_pressure_monitor_free (GPOPPressureMonitor * monitor)
+{
+  guint i;
+
+  if (!monitor)
+    return;
+
+  for (i = 0; i < GPOP_PRESSURE_N_TRIGGERS; i++) {
+    if (monitor->fd_ids[i])
+      g_source_remove (monitor->fd_ids[i]);
+    if (monitor->fds[i] >= 0)
+      close (monitor->fds[i]);
+  }
+  if (monitor->recheck_id)
+    gpop_timers_remove (monitor->recheck_id);
+  g_free (monitor);
+}
+
+GPOPPressureLevel
+gpop_pressure_monitor_get_level (GPOPPressureMonitor * monitor)
+{
+  return monitor ? monitor->level : GPOP_PRESSURE_NONE;
+}
+
+const gchar *
+gpop_pressure_level_get_name (GPOPPressureLevel level)
+{
+  switch (level) {
+    case GPOP_PRESSURE_NONE:
+      return "none";
+    case GPOP_PRESSURE_SOME:
+      return "some";
+    case GPOP_PRESSURE_HIGH:
+      return "high";
+    case GPOP_PRESSURE_CRITICAL:
+      return "critical";
+    default:
+      return "unknown";
+  }
+}
+
+const gchar *
+gpop_shed_action_get_name (GPOPShedAction action)
+{
+  switch (action) {
+    case GPOP_SHED_SUSPEND:
+      return "suspend";
+    case GPOP_SHED_SHRINK:
+      return "shrink";
+    case GPOP_SHED_PAUSE:
+      return "pause";
+    case GPOP_SHED_RESTORE:
+      return "restore";
+    case GPOP_SHED_RESUME:
+      return "resume";
+    default:
+      return "unknown";
+  }
+}
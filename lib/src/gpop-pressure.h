@@ -0,0 +1,66 @@
+/*
+ * GStreamer Prince of Parser
+ *
+ * Copyright (C) 2020 Stéphane Cerveau
+ *
+ * SPDX-License-Identifier: LGPL
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation
+ * version 2.1 of the License.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301 USA
+ *
+ */
+
+#ifndef _GPOP_PRESSURE_H_
+#define _GPOP_PRESSURE_H_
+
+#include <glib-2.0/glib.h>
+
+/* Host memory and cpu pressure, from the Linux PSI interface.
+ *
+ * PSI triggers are armed on /proc/pressure/{memory,cpu} and polled for
+ * G_IO_PRI from the main loop, so an unloaded host costs no wakeup. Once
+ * under pressure, the averages are re-read periodically until the pressure
+ * has receded. Without trigger support the averages are polled. */
+
+typedef enum {
+  GPOP_PRESSURE_NONE,
+  GPOP_PRESSURE_SOME,
+  GPOP_PRESSURE_HIGH,
+  GPOP_PRESSURE_CRITICAL,
+  GPOP_PRESSURE_LAST,
+} GPOPPressureLevel;
+
+/* Load shedding actions taken by the manager, from the cheapest to the most
+ * visible one, and their reverts once the pressure is gone. */
+typedef enum {
+  GPOP_SHED_SUSPEND,
+  GPOP_SHED_SHRINK,
+  GPOP_SHED_PAUSE,
+  GPOP_SHED_RESTORE,
+  GPOP_SHED_RESUME,
+  GPOP_SHED_LAST,
+} GPOPShedAction;
+
+typedef struct _GPOPPressureMonitor GPOPPressureMonitor;
+
+typedef void (*GPOPPressureFunc) (GPOPPressureLevel level, gpointer user_data);
+
+GPOPPressureMonitor * gpop_pressure_monitor_new (GPOPPressureFunc func, gpointer user_data);
+void gpop_pressure_monitor_free (GPOPPressureMonitor * monitor);
+GPOPPressureLevel gpop_pressure_monitor_get_level (GPOPPressureMonitor * monitor);
+
+const gchar * gpop_pressure_level_get_name (GPOPPressureLevel level);
+const gchar * gpop_shed_action_get_name (GPOPShedAction action);
+
+#endif /* _GPOP_PRESSURE_H_ */
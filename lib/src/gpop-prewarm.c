@@ -0,0 +1,150 @@
+/*
+ * GStreamer Prince of Parser
+ *
+ * Copyright (C) 2020 Stéphane Cerveau
+ *
+ * SPDX-License-Identifier: LGPL
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation
+ * version 2.1 of the License.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301 USA
+ *
+ */
+
+#include "gpop-private.h"
+
+#define GPOP_PREWARM_PAGE_SIZE 4096
+
+/* Writes a byte per page of the system memory of the buffer */
+static void
+gpop_prewarm_touch (GstBuffer * buffer)
+{
+  guint i;
+
+  for (i = 0; i < gst_buffer_n_memory (buffer); i++) {
+    GstMemory *memory = gst_buffer_peek_memory (buffer, i);
+    GstMapInfo map;
+    gsize offset;
+
+    if (!gst_memory_is_type (memory, GST_ALLOCATOR_SYSMEM)
+        || !gst_memory_map (memory, &map, GST_MAP_WRITE))
+      continue;
+    for (offset = 0; offset < map.size; offset += GPOP_PREWARM_PAGE_SIZE)
+      map.data[offset] = 0;
+    gst_memory_unmap (memory, &map);
+  }
+}
+
+static void
+gpop_prewarm_pool (GstPad * pad, GstBufferPool * pool)
+{
+  GstBufferPoolAcquireParams params = { 0, };
+  GstStructure *config = gst_buffer_pool_get_config (pool);
+  guint size, min_buffers, max_buffers, target, i;
+  gint64 start = g_get_monotonic_time ();
+  GPtrArray *buffers;
+
+  if (!gst_buffer_pool_config_get_params (config, NULL, &size, &min_buffers,
+          &max_buffers)) {
+    gst_structure_free (config);
+    return;
+  }
+  gst_structure_free (config);
+
+  target = max_buffers ? max_buffers : min_buffers + GPOP_PREWARM_EXTRA_BUFFERS;
+  target = MIN (target, GPOP_PREWARM_MAX_BUFFERS);
+  if (size)
+    target = MIN (target, GPOP_PREWARM_MAX_BYTES / size);
+
+  /* the buffers in use downstream are not waited for */
+  params.flags = GST_BUFFER_POOL_ACQUIRE_FLAG_DONTWAIT;
+  buffers = g_ptr_array_new_with_free_func ((GDestroyNotify) gst_buffer_unref);
+  for (i = 0; i < target; i++) {
+    GstBuffer *buffer = NULL;
+
+    if (gst_buffer_pool_acquire_buffer (pool, &buffer, &params) != GST_FLOW_OK)
+      break;
+    gpop_prewarm_touch (buffer);
+    g_ptr_array_add (buffers, buffer);
+  }
+  GPOP_LOG ("Pre-warmed %u buffers of %u bytes of %s:%s (min %u, max %u) "
+      "in %.1f ms", buffers->len, size, GST_DEBUG_PAD_NAME (pad), min_buffers,
+      max_buffers, (g_get_monotonic_time () - start) / 1000.0);
+  /* back to the pool */
+  g_ptr_array_unref (buffers);
+}
+
+/* The pool is active once the first buffer is pushed */
+static GstPadProbeReturn
+gpop_prewarm_probe (GstPad * pad, GstPadProbeInfo * info, gpointer user_data)
+{
+  GstBuffer *buffer = GST_PAD_PROBE_INFO_BUFFER (info);
+
+  if (buffer->pool && gst_buffer_pool_is_active (buffer->pool))
+    gpop_prewarm_pool (pad, buffer->pool);
+  return GST_PAD_PROBE_REMOVE;
+}
+
+static void
+gpop_prewarm_pad (GstElement * element, GstPad * pad, gpointer user_data)
+{
+  if (GST_PAD_IS_SRC (pad))
+    gst_pad_add_probe (pad, GST_PAD_PROBE_TYPE_BUFFER, gpop_prewarm_probe,
+        NULL, NULL);
+}
+
+static void
+gpop_prewarm_element (GstElement * element)
+{
+  GstIterator *it;
+  GValue item = G_VALUE_INIT;
+
+  if (GST_IS_BIN (element))
+    return;
+
+  g_signal_connect (element, "pad-added", G_CALLBACK (gpop_prewarm_pad),
+      NULL);
+  it = gst_element_iterate_src_pads (element);
+  while (gst_iterator_next (it, &item) == GST_ITERATOR_OK) {
+    gpop_prewarm_pad (element, g_value_get_object (&item), NULL);
+    g_value_reset (&item);
+  }
+  g_value_unset (&item);
+  gst_iterator_free (it);
+}
+
+static void
+gpop_prewarm_on_element_added (GstBin * bin, GstBin * sub_bin,
+    GstElement * element, gpointer user_data)
+{
+  gpop_prewarm_element (element);
+}
+
+/* To be called on a newly built pipeline, the elements added later by the
+ * bins are pre-warmed as well */
+void
+gpop_prewarm_attach (GstElement * pipeline)
+{
+  GstIterator *it;
+  GValue item = G_VALUE_INIT;
+
+  g_signal_connect (pipeline, "deep-element-added",
+      G_CALLBACK (gpop_prewarm_on_element_added), NULL);
+  it = gst_bin_iterate_recurse (GST_BIN (pipeline));
+  while (gst_iterator_next (it, &item) == GST_ITERATOR_OK) {
+    gpop_prewarm_element (g_value_get_object (&item));
+    g_value_reset (&item);
+  }
+  g_value_unset (&item);
+  gst_iterator_free (it);
+}
@@ -0,0 +1,45 @@
+/*
+ * GStreamer Prince of Parser
+ *
+ * Copyright (C) 2020 Stéphane Cerveau
+ *
+ * SPDX-License-Identifier: LGPL
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation
+ * version 2.1 of the License.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301 USA
+ *
+ */
+
+#ifndef _GPOP_PREWARM_H_
+#define _GPOP_PREWARM_H_
+
+#include <gst/gst.h>
+
+/* Buffer pool pre-warming.
+ *
+ * The pools negotiated by the elements of a pipeline only hold their
+ * minimum number of buffers once active, and grow on demand while the
+ * first frames flow, with allocations and page faults on the streaming
+ * threads. A pre-warmed pipeline allocates and touches the buffers of each
+ * pool before its first buffer leaves the element: up to the maximum of the
+ * pool, or its minimum plus GPOP_PREWARM_EXTRA_BUFFERS for an unbounded
+ * pool, within GPOP_PREWARM_MAX_BUFFERS and GPOP_PREWARM_MAX_BYTES. */
+
+#define GPOP_PREWARM_EXTRA_BUFFERS 4
+#define GPOP_PREWARM_MAX_BUFFERS 64
+#define GPOP_PREWARM_MAX_BYTES (64 * 1024 * 1024)
+
+void gpop_prewarm_attach (GstElement * pipeline);
+
+#endif /* _GPOP_PREWARM_H_ */
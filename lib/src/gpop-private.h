@@ -27,10 +27,32 @@
 #include <gio/gio.h>
 #include <glib-2.0/glib.h>
 
+#include "gpop-bus-dispatcher.h"
+#include "gpop-checkpoint.h"
 #include "gpop-dbus-interface.h"
+#include "gpop-element-pool.h"
+#include "gpop-control-stats.h"
+#include "gpop-history.h"
+#include "gpop-ladder.h"
+#include "gpop-main.h"
+#include "gpop-placement.h"
+#include "gpop-pressure.h"
+#include "gpop-prewarm.h"
+#include "gpop-profiler.h"
+#include "gpop-rate-limit.h"
+#include "gpop-request-cache.h"
+#include "gpop-front.h"
+#include "gpop-slo.h"
 #include "gpop-manager.h"
+#include "gpop-mmap-src.h"
 #include "gpop-parser.h"
 #include "gpop-pipeline.h"
+#include "gpop-config.h"
+#include "gpop-probes.h"
+#include "gpop-recorder.h"
+#include "gpop-timers.h"
+#include "gpop-tracer.h"
+#include "gpop-uring-sink.h"
 #include "gst/gst.h"
 
 
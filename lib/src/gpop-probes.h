@@ -0,0 +1,88 @@
+/*
+ * GStreamer Prince of Parser
+ *
+ * Copyright (C) 2020 Stéphane Cerveau
+ *
+ * SPDX-License-Identifier: LGPL
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation
+ * version 2.1 of the License.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301 USA
+ *
+ */
+
+#ifndef _GPOP_PROBES_H_
+#define _GPOP_PROBES_H_
+
+/* USDT probes for perf/bpftrace, enabled with -Dusdt=enabled.
+ *
+ * Every probe has a semaphore which is only non-zero while a tracer is
+ * attached, GPOP_PROBE_ENABLED() should guard any argument computation
+ * (timestamps, string formatting) so that an untraced daemon only pays for
+ * a predicted branch. Without the option, everything compiles out.
+ *
+ * List them with: perf list sdt_gpop:* or bpftrace -l 'usdt:<lib>:gpop:*' */
+
+#ifdef GPOP_ENABLE_USDT
+
+#define _SDT_HAS_SEMAPHORES 1
+#include <sys/sdt.h>
+
+#define GPOP_PROBE_SEMAPHORE(name) gpop_##name##_semaphore
+#define GPOP_PROBE_DECLARE(name) \
+  extern unsigned short GPOP_PROBE_SEMAPHORE (name)
+#define GPOP_PROBE_DEFINE(name) \
+  __extension__ unsigned short GPOP_PROBE_SEMAPHORE (name) \
+  __attribute__ ((unused)) __attribute__ ((section (".probes")))
+
+#define GPOP_PROBE_ENABLED(name) G_UNLIKELY (GPOP_PROBE_SEMAPHORE (name))
+
+#define GPOP_PROBE2(name, a1, a2) \
+  DTRACE_PROBE2 (gpop, name, a1, a2)
+#define GPOP_PROBE3(name, a1, a2, a3) \
+  DTRACE_PROBE3 (gpop, name, a1, a2, a3)
+#define GPOP_PROBE4(name, a1, a2, a3, a4) \
+  DTRACE_PROBE4 (gpop, name, a1, a2, a3, a4)
+#define GPOP_PROBE5(name, a1, a2, a3, a4, a5) \
+  DTRACE_PROBE5 (gpop, name, a1, a2, a3, a4, a5)
+
+#else
+
+#define GPOP_PROBE_DECLARE(name) extern int gpop_probes_disabled
+#define GPOP_PROBE_DEFINE(name) extern int gpop_probes_disabled
+
+#define GPOP_PROBE_ENABLED(name) (FALSE)
+
+#define GPOP_PROBE2(name, a1, a2) do { } while (0)
+#define GPOP_PROBE3(name, a1, a2, a3) do { } while (0)
+#define GPOP_PROBE4(name, a1, a2, a3, a4) do { } while (0)
+#define GPOP_PROBE5(name, a1, a2, a3, a4, a5) do { } while (0)
+
+#endif /* GPOP_ENABLE_USDT */
+
+/* method__entry (object_path, method_name, sender) */
+GPOP_PROBE_DECLARE (method__entry);
+/* method__return (object_path, method_name, sender, duration_ns) */
+GPOP_PROBE_DECLARE (method__return);
+/* pipeline__create (pipeline_id, parser_desc, success, duration_ns) */
+GPOP_PROBE_DECLARE (pipeline__create);
+/* pipeline__destroy (pipeline_id, duration_ns) */
+GPOP_PROBE_DECLARE (pipeline__destroy);
+/* state__change (pipeline_id, old_state, new_state, pending_state,
+ *     ns_since_request) */
+GPOP_PROBE_DECLARE (state__change);
+/* bus__message (pipeline_id, message_type_name, message_type,
+ *     dispatch_latency_ns) */
+GPOP_PROBE_DECLARE (bus__message);
+
+#endif /* _GPOP_PROBES_H_ */
@@ -0,0 +1,606 @@
+/*
+ * GStreamer Prince of Parser
+ *
+ * Copyright (C) 2020 Stéphane Cerveau
+ *
+ * SPDX-License-Identifier: LGPL
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation
+ * version 2.1 of the License.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301 USA
+ *
+ */
+
+#ifdef __linux__
+#ifndef _GNU_SOURCE
+#define _GNU_SOURCE
+#endif
+#include <dlfcn.h>
+#include <execinfo.h>
+#include <linux/perf_event.h>
+#include <signal.h>
+#include <sys/ioctl.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <time.h>
+#endif
+#include <errno.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <gio/gio.h>
+
+#include "gpop-private.h"
+
+#define GPOP_PROFILER_MAX_FRAMES 64
+#define GPOP_PROFILER_MAX_SAMPLES 65536
+/* Period of the perf ring buffers drain, and their size in pages */
+#define GPOP_PROFILER_DRAIN_MS 50
+#define GPOP_PROFILER_RING_PAGES 64
+/* backtrace() from the SIGPROF handler starts with the handler and the
+ * signal trampoline */
+#define GPOP_PROFILER_SIGNAL_FRAMES 2
+/* tid, number of frames, frames */
+#define GPOP_PROFILER_SLOT_SIZE (2 + GPOP_PROFILER_MAX_FRAMES)
+
+#ifdef __linux__
+#ifndef sigev_notify_thread_id
+#define sigev_notify_thread_id _sigev_un._tid
+#endif
+#endif
+
+typedef enum
+{
+  GPOP_PROFILER_PERF,
+  GPOP_PROFILER_TIMER,
+} GPOPProfilerSampler;
+
+typedef struct
+{
+  gint fd;
+  gpointer base;
+} GPOPPerfRing;
+
+struct _GPOPProfiler
+{
+  GPOPProfilerFunc func;
+  gpointer user_data;
+  GPOPProfilerSampler sampler;
+  /* guint64 slots of GPOP_PROFILER_SLOT_SIZE, innermost frame first */
+  GArray *samples;
+  /* tid -> thread name */
+  GHashTable *names;
+  guint stop_id;
+  gboolean running;
+#ifdef __linux__
+  gsize page_size;
+  GArray *rings;
+  guint8 *record;
+  guint drain_id;
+  GArray *timers;
+#endif
+};
+
+/* Only one profile at a time, the timer sampler state is global */
+static GPOPProfiler *running_profiler = NULL;
+
+#ifdef __linux__
+static guint64 *timer_slots = NULL;
+static gint timer_capacity = 0;
+static gint timer_next = 0;
+static gint timer_active = 0;
+/* handlers running, the slots are read and freed once none is */
+static gint timer_in_handler = 0;
+/* installed once for the life of the process, a SIGPROF still pending
+ * after the timers are deleted must not reach the default action */
+static gboolean timer_installed = FALSE;
+#endif
+
+static void
+gpop_profiler_add_sample (GPOPProfiler * profiler, gint tid,
+    const guint64 * frames, guint n_frames)
+{
+  guint64 slot[GPOP_PROFILER_SLOT_SIZE] = { 0, };
+  guint i, n = 0;
+
+  if (profiler->samples->len / GPOP_PROFILER_SLOT_SIZE >=
+      GPOP_PROFILER_MAX_SAMPLES)
+    return;
+
+  slot[0] = tid;
+  for (i = 0; i < n_frames && n < GPOP_PROFILER_MAX_FRAMES; i++) {
+#ifdef __linux__
+    /* PERF_CONTEXT_USER and friends */
+    if (frames[i] >= (guint64) PERF_CONTEXT_MAX)
+      continue;
+#endif
+    slot[2 + n++] = frames[i];
+  }
+  slot[1] = n;
+  g_array_append_vals (profiler->samples, slot, GPOP_PROFILER_SLOT_SIZE);
+}
+
+static GArray *
+gpop_profiler_list_threads (GHashTable * names)
+{
+  GArray *threads = g_array_new (FALSE, FALSE, sizeof (gint));
+  GDir *dir = g_dir_open ("/proc/self/task", 0, NULL);
+  const gchar *entry;
+
+  if (!dir)
+    return threads;
+  while ((entry = g_dir_read_name (dir))) {
+    gint tid = atoi (entry);
+    gchar *path, *name = NULL;
+
+    if (tid <= 0)
+      continue;
+    g_array_append_val (threads, tid);
+    path = g_strdup_printf ("/proc/self/task/%d/comm", tid);
+    if (g_file_get_contents (path, &name, NULL, NULL))
+      g_hash_table_insert (names, GINT_TO_POINTER (tid),
+          g_strdup (g_strstrip (name)));
+    g_free (name);
+    g_free (path);
+  }
+  g_dir_close (dir);
+
+  return threads;
+}
+
+#ifdef __linux__
+
+/* perf sampler */
+
+static void
+gpop_profiler_ring_copy (const guint8 * data, gsize size, guint64 offset,
+    gpointer dest, gsize length)
+{
+  gsize start = offset % size;
+  gsize first = MIN (length, size - start);
+
+  memcpy (dest, data + start, first);
+  if (first < length)
+    memcpy ((guint8 *) dest + first, data, length - first);
+}
+
+static void
+gpop_profiler_read_ring (GPOPProfiler * profiler, GPOPPerfRing * ring)
+{
+  struct perf_event_mmap_page *meta = ring->base;
+  const guint8 *data = (const guint8 *) ring->base + profiler->page_size;
+  gsize size = GPOP_PROFILER_RING_PAGES * profiler->page_size;
+  guint64 head, tail = meta->data_tail;
+
+  head = meta->data_head;
+  /* the records are read after data_head */
+  __sync_synchronize ();
+
+  while (tail + sizeof (struct perf_event_header) <= head) {
+    struct perf_event_header header;
+
+    gpop_profiler_ring_copy (data, size, tail, &header, sizeof (header));
+    if (header.size < sizeof (header) || tail + header.size > head)
+      break;
+
+    if (header.type == PERF_RECORD_SAMPLE) {
+      /* u32 pid, tid; u64 nr; u64 ips[nr] */
+      guint32 *ids;
+      guint64 nr;
+
+      gpop_profiler_ring_copy (data, size, tail, profiler->record,
+          header.size);
+      ids = (guint32 *) (profiler->record + sizeof (header));
+      nr = *(guint64 *) (profiler->record + sizeof (header) + 8);
+      if (sizeof (header) + 16 + nr * 8 <= header.size)
+        gpop_profiler_add_sample (profiler, ids[1],
+            (guint64 *) (profiler->record + sizeof (header) + 16), nr);
+    }
+    tail += header.size;
+  }
+
+  /* the records are read before the space is given back */
+  __sync_synchronize ();
+  meta->data_tail = tail;
+}
+
+static gboolean
+gpop_profiler_drain (gpointer user_data)
+{
+  GPOPProfiler *profiler = (GPOPProfiler *) user_data;
+  guint i;
+
+  for (i = 0; i < profiler->rings->len; i++)
+    gpop_profiler_read_ring (profiler,
+        &g_array_index (profiler->rings, GPOPPerfRing, i));
+  return G_SOURCE_CONTINUE;
+}
+
+static void
+gpop_profiler_close_rings (GPOPProfiler * profiler)
+{
+  gsize length = (1 + GPOP_PROFILER_RING_PAGES) * profiler->page_size;
+  guint i;
+
+  for (i = 0; i < profiler->rings->len; i++) {
+    GPOPPerfRing *ring = &g_array_index (profiler->rings, GPOPPerfRing, i);
+    ioctl (ring->fd, PERF_EVENT_IOC_DISABLE, 0);
+    munmap (ring->base, length);
+    close (ring->fd);
+  }
+  g_array_set_size (profiler->rings, 0);
+}
+
+static gboolean
+gpop_profiler_start_perf (GPOPProfiler * profiler, GArray * threads,
+    guint frequency)
+{
+  gsize length = (1 + GPOP_PROFILER_RING_PAGES) * profiler->page_size;
+  struct perf_event_attr attr;
+  guint i;
+
+  memset (&attr, 0, sizeof (attr));
+  attr.size = sizeof (attr);
+  /* a software clock, available without PMU such as in VMs */
+  attr.type = PERF_TYPE_SOFTWARE;
+  attr.config = PERF_COUNT_SW_CPU_CLOCK;
+  attr.freq = 1;
+  attr.sample_freq = frequency;
+  attr.sample_type = PERF_SAMPLE_TID | PERF_SAMPLE_CALLCHAIN;
+  attr.exclude_kernel = 1;
+  attr.exclude_hv = 1;
+  attr.exclude_callchain_kernel = 1;
+  attr.disabled = 1;
+
+  for (i = 0; i < threads->len; i++) {
+    GPOPPerfRing ring;
+
+    ring.fd = syscall (SYS_perf_event_open, &attr,
+        g_array_index (threads, gint, i), -1, -1, PERF_FLAG_FD_CLOEXEC);
+    if (ring.fd < 0) {
+      /* not allowed or not supported, the thread may also be gone */
+      if (errno == ESRCH)
+        continue;
+      gpop_profiler_close_rings (profiler);
+      return FALSE;
+    }
+    ring.base = mmap (NULL, length, PROT_READ | PROT_WRITE, MAP_SHARED,
+        ring.fd, 0);
+    if (ring.base == MAP_FAILED) {
+      close (ring.fd);
+      gpop_profiler_close_rings (profiler);
+      return FALSE;
+    }
+    g_array_append_val (profiler->rings, ring);
+  }
+
+  profiler->record = g_malloc (G_MAXUINT16 + 1);
+  for (i = 0; i < profiler->rings->len; i++)
+    ioctl (g_array_index (profiler->rings, GPOPPerfRing, i).fd,
+        PERF_EVENT_IOC_ENABLE, 0);
+  profiler->drain_id = g_timeout_add (GPOP_PROFILER_DRAIN_MS,
+      gpop_profiler_drain, profiler);
+
+  return TRUE;
+}
+
+/* timer sampler */
+
+static void
+gpop_profiler_on_sigprof (int signum, siginfo_t * info, void *context)
+{
+  gpointer frames[GPOP_PROFILER_MAX_FRAMES + GPOP_PROFILER_SIGNAL_FRAMES];
+  gint saved_errno = errno;
+  guint64 *slot;
+  gint index, n, i;
+
+  g_atomic_int_inc (&timer_in_handler);
+  if (!g_atomic_int_get (&timer_active))
+    goto done;
+  index = g_atomic_int_add (&timer_next, 1);
+  if (index >= timer_capacity)
+    goto done;
+
+  slot = timer_slots + (gsize) index * GPOP_PROFILER_SLOT_SIZE;
+  n = backtrace (frames, G_N_ELEMENTS (frames));
+  n = MAX (n - GPOP_PROFILER_SIGNAL_FRAMES, 0);
+  for (i = 0; i < n; i++)
+    slot[2 + i] = (guintptr) frames[GPOP_PROFILER_SIGNAL_FRAMES + i];
+  slot[0] = syscall (SYS_gettid);
+  /* a slot is complete once its frame count is set */
+  __sync_synchronize ();
+  slot[1] = n + 1;
+
+done:
+  g_atomic_int_dec_and_test (&timer_in_handler);
+  errno = saved_errno;
+}
+
+static void
+gpop_profiler_stop_timers (GPOPProfiler * profiler)
+{
+  guint i;
+  gint n;
+
+  g_atomic_int_set (&timer_active, 0);
+  for (i = 0; i < profiler->timers->len; i++)
+    timer_delete (g_array_index (profiler->timers, timer_t, i));
+  g_array_set_size (profiler->timers, 0);
+  /* the handlers which saw the sampler active are still writing */
+  while (g_atomic_int_get (&timer_in_handler))
+    g_thread_yield ();
+
+  n = MIN (g_atomic_int_get (&timer_next), timer_capacity);
+  for (i = 0; i < (guint) n; i++) {
+    guint64 *slot = timer_slots + (gsize) i * GPOP_PROFILER_SLOT_SIZE;
+    if (slot[1])
+      gpop_profiler_add_sample (profiler, slot[0], slot + 2, slot[1] - 1);
+  }
+  g_clear_pointer (&timer_slots, g_free);
+}
+
+static gboolean
+gpop_profiler_start_timers (GPOPProfiler * profiler, GArray * threads,
+    guint duration_ms, guint frequency)
+{
+  gpointer frames[1];
+  struct sigaction action;
+  struct itimerspec interval;
+  guint i;
+
+  /* backtrace() loads libgcc on its first call, not from the handler */
+  backtrace (frames, 1);
+
+  timer_capacity = MIN ((guint64) duration_ms * frequency / 1000 *
+      threads->len + threads->len, GPOP_PROFILER_MAX_SAMPLES);
+  timer_slots = g_new0 (guint64, (gsize) timer_capacity *
+      GPOP_PROFILER_SLOT_SIZE);
+  timer_next = 0;
+
+  if (!timer_installed) {
+    memset (&action, 0, sizeof (action));
+    action.sa_sigaction = gpop_profiler_on_sigprof;
+    action.sa_flags = SA_SIGINFO | SA_RESTART;
+    sigemptyset (&action.sa_mask);
+    if (sigaction (SIGPROF, &action, NULL) < 0) {
+      g_clear_pointer (&timer_slots, g_free);
+      return FALSE;
+    }
+    timer_installed = TRUE;
+  }
+  g_atomic_int_set (&timer_active, 1);
+
+  interval.it_interval.tv_sec = 0;
+  interval.it_interval.tv_nsec = 1000000000 / frequency;
+  interval.it_value = interval.it_interval;
+  for (i = 0; i < threads->len; i++) {
+    gint tid = g_array_index (threads, gint, i);
+    struct sigevent event;
+    timer_t timer;
+    /* the cpu clock of the thread, CPUCLOCK_SCHED | CPUCLOCK_PERTHREAD */
+    clockid_t clock = (~(clockid_t) tid << 3) | 6;
+
+    memset (&event, 0, sizeof (event));
+    event.sigev_notify = SIGEV_THREAD_ID;
+    event.sigev_signo = SIGPROF;
+    event.sigev_notify_thread_id = tid;
+    if (timer_create (clock, &event, &timer) < 0)
+      continue;
+    g_array_append_val (profiler->timers, timer);
+    timer_settime (timer, 0, &interval, NULL);
+  }
+
+  if (!profiler->timers->len) {
+    gpop_profiler_stop_timers (profiler);
+    return FALSE;
+  }
+  return TRUE;
+}
+
+static gchar *
+gpop_profiler_symbolize (guint64 address, GHashTable * symbols)
+{
+  gchar *symbol = g_hash_table_lookup (symbols, &address);
+  guint64 *key;
+  Dl_info info;
+
+  if (symbol)
+    return symbol;
+
+  memset (&info, 0, sizeof (info));
+  if (!dladdr ((gpointer) (guintptr) address, &info))
+    symbol = g_strdup_printf ("0x%" G_GINT64_MODIFIER "x", address);
+  else if (info.dli_sname)
+    symbol = g_strdup (info.dli_sname);
+  else if (info.dli_fname)
+    symbol = g_strdup_printf ("%s+0x%" G_GINT64_MODIFIER "x",
+        strrchr (info.dli_fname, '/') ? strrchr (info.dli_fname, '/') + 1 :
+        info.dli_fname, address - (guintptr) info.dli_fbase);
+  else
+    symbol = g_strdup_printf ("0x%" G_GINT64_MODIFIER "x", address);
+
+  key = g_new (guint64, 1);
+  *key = address;
+  g_hash_table_insert (symbols, key, symbol);
+  return symbol;
+}
+
+#endif /* __linux__ */
+
+static gboolean
+gpop_profiler_stop (gpointer user_data)
+{
+  GPOPProfiler *profiler = (GPOPProfiler *) user_data;
+
+  profiler->stop_id = 0;
+  profiler->running = FALSE;
+#ifdef __linux__
+  if (profiler->sampler == GPOP_PROFILER_PERF) {
+    g_source_remove (profiler->drain_id);
+    profiler->drain_id = 0;
+    gpop_profiler_drain (profiler);
+    gpop_profiler_close_rings (profiler);
+  } else {
+    gpop_profiler_stop_timers (profiler);
+  }
+#endif
+  running_profiler = NULL;
+
+  profiler->func (profiler, profiler->user_data);
+  return G_SOURCE_REMOVE;
+}
+
+/* API */
+
+/* Samples all the threads during duration_ms, func is called from the main
+ * loop once done and owns the profiler. */
+GPOPProfiler *
+gpop_profiler_start (guint duration_ms, guint frequency,
+    GPOPProfilerFunc func, gpointer user_data, GError ** error)
+{
+#ifdef __linux__
+  GPOPProfiler *profiler;
+  GArray *threads;
+
+  if (running_profiler) {
+    g_set_error (error, G_IO_ERROR, G_IO_ERROR_BUSY,
+        "A profile is already running");
+    return NULL;
+  }
+  if (!frequency)
+    frequency = GPOP_PROFILER_DEFAULT_FREQUENCY;
+  frequency = MIN (frequency, GPOP_PROFILER_MAX_FREQUENCY);
+  duration_ms = CLAMP (duration_ms, 1, GPOP_PROFILER_MAX_DURATION_MS);
+
+  profiler = g_new0 (GPOPProfiler, 1);
+  profiler->func = func;
+  profiler->user_data = user_data;
+  profiler->samples = g_array_new (FALSE, FALSE, sizeof (guint64));
+  profiler->names = g_hash_table_new_full (NULL, NULL, NULL, g_free);
+  profiler->page_size = sysconf (_SC_PAGESIZE);
+  profiler->rings = g_array_new (FALSE, FALSE, sizeof (GPOPPerfRing));
+  profiler->timers = g_array_new (FALSE, FALSE, sizeof (timer_t));
+
+  threads = gpop_profiler_list_threads (profiler->names);
+  if (gpop_profiler_start_perf (profiler, threads, frequency)) {
+    profiler->sampler = GPOP_PROFILER_PERF;
+  } else if (gpop_profiler_start_timers (profiler, threads, duration_ms,
+          frequency)) {
+    profiler->sampler = GPOP_PROFILER_TIMER;
+  } else {
+    g_set_error (error, G_IO_ERROR, G_IO_ERROR_PERMISSION_DENIED,
+        "Unable to sample the threads: %s", g_strerror (errno));
+    g_array_unref (threads);
+    gpop_profiler_free (profiler);
+    return NULL;
+  }
+  GPOP_LOG ("Profiling %u threads at %u Hz during %u ms with the %s sampler",
+      threads->len, frequency, duration_ms,
+      gpop_profiler_get_sampler_name (profiler));
+  g_array_unref (threads);
+
+  profiler->running = TRUE;
+  profiler->stop_id = g_timeout_add (duration_ms, gpop_profiler_stop,
+      profiler);
+  running_profiler = profiler;
+
+  return profiler;
+#else
+  g_set_error (error, G_IO_ERROR, G_IO_ERROR_NOT_SUPPORTED,
+      "Profiling is only supported on Linux");
+  return NULL;
+#endif
+}
+
+/* Also cancels a running profile, func is then not called */
+void
+gpop_profiler_free (GPOPProfiler * profiler)
+{
+  if (profiler->running) {
+    g_source_remove (profiler->stop_id);
+#ifdef __linux__
+    if (profiler->sampler == GPOP_PROFILER_PERF) {
+      g_source_remove (profiler->drain_id);
+      gpop_profiler_close_rings (profiler);
+    } else {
+      gpop_profiler_stop_timers (profiler);
+    }
+#endif
+    running_profiler = NULL;
+  }
+#ifdef __linux__
+  g_array_unref (profiler->rings);
+  g_array_unref (profiler->timers);
+  g_free (profiler->record);
+#endif
+  g_hash_table_unref (profiler->names);
+  g_array_unref (profiler->samples);
+  g_free (profiler);
+}
+
+const gchar *
+gpop_profiler_get_sampler_name (GPOPProfiler * profiler)
+{
+  return profiler->sampler == GPOP_PROFILER_PERF ? "perf" : "timer";
+}
+
+/* Folded stacks, one "tag;thread;outermost;...;innermost count" line per
+ * distinct stack, where tag is the value of the thread id in tags or
+ * "gpop" for the threads out of any pipeline. */
+gchar *
+gpop_profiler_fold (GPOPProfiler * profiler, GHashTable * tags,
+    guint * n_samples)
+{
+  GHashTable *stacks = g_hash_table_new_full (g_str_hash, g_str_equal,
+      g_free, NULL);
+  GHashTable *symbols = g_hash_table_new_full (g_int64_hash, g_int64_equal,
+      g_free, g_free);
+  GString *folded = g_string_new (NULL);
+  GHashTableIter iter;
+  gpointer key, value;
+  guint i;
+
+  for (i = 0; i < profiler->samples->len; i += GPOP_PROFILER_SLOT_SIZE) {
+    guint64 *slot = &g_array_index (profiler->samples, guint64, i);
+    gpointer tid = GINT_TO_POINTER ((gint) slot[0]);
+    const gchar *tag = tags ? g_hash_table_lookup (tags, tid) : NULL;
+    const gchar *name = g_hash_table_lookup (profiler->names, tid);
+    GString *stack = g_string_new (NULL);
+#ifdef __linux__
+    gint frame;
+#endif
+
+    g_string_append_printf (stack, "%s;%s", tag ? tag : "gpop",
+        name ? name : "unknown");
+#ifdef __linux__
+    for (frame = slot[1] - 1; frame >= 0; frame--)
+      g_string_append_printf (stack, ";%s",
+          gpop_profiler_symbolize (slot[2 + frame], symbols));
+#endif
+    key = g_string_free (stack, FALSE);
+    value = g_hash_table_lookup (stacks, key);
+    g_hash_table_replace (stacks, key,
+        GUINT_TO_POINTER (GPOINTER_TO_UINT (value) + 1));
+  }
+
+  g_hash_table_iter_init (&iter, stacks);
+  while (g_hash_table_iter_next (&iter, &key, &value))
+    g_string_append_printf (folded, "%s %u\n", (gchar *) key,
+        GPOINTER_TO_UINT (value));
+  if (n_samples)
+    *n_samples = profiler->samples->len / GPOP_PROFILER_SLOT_SIZE;
+
+  g_hash_table_unref (symbols);
+  g_hash_table_unref (stacks);
+  return g_string_free (folded, FALSE);
+}
@@ -0,0 +1,56 @@
+/*
+ * GStreamer Prince of Parser
+ *
+ * Copyright (C) 2020 Stéphane Cerveau
+ *
+ * SPDX-License-Identifier: LGPL
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation
+ * version 2.1 of the License.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301 USA
+ *
+ */
+
+#ifndef _GPOP_PROFILER_H_
+#define _GPOP_PROFILER_H_
+
+#include <glib-2.0/glib.h>
+
+/* In-process cpu sampling profiler.
+ *
+ * All the threads of the process are sampled at the given frequency with a
+ * perf_event_open() cpu-clock event per thread, recording the user call
+ * chains in a ring buffer drained from the main loop. When perf events are
+ * not allowed (perf_event_paranoid, seccomp), each thread gets a SIGPROF
+ * timer on its own cpu clock and the handler records a backtrace().
+ *
+ * The stacks are walked with the frame pointers (perf) or the unwind tables
+ * (timer), and symbolized in-process with dladdr(), so only the exported
+ * symbols are named, the other frames are reported as module+offset.
+ * Threads created during the profile are not sampled. */
+
+#define GPOP_PROFILER_DEFAULT_FREQUENCY 99
+#define GPOP_PROFILER_MAX_FREQUENCY 1000
+#define GPOP_PROFILER_MAX_DURATION_MS 60000
+
+typedef struct _GPOPProfiler GPOPProfiler;
+
+typedef void (*GPOPProfilerFunc) (GPOPProfiler * profiler, gpointer user_data);
+
+GPOPProfiler * gpop_profiler_start (guint duration_ms, guint frequency, GPOPProfilerFunc func, gpointer user_data, GError ** error);
+void gpop_profiler_free (GPOPProfiler * profiler);
+
+const gchar * gpop_profiler_get_sampler_name (GPOPProfiler * profiler);
+gchar * gpop_profiler_fold (GPOPProfiler * profiler, GHashTable * tags, guint * n_samples);
+
+#endif /* _GPOP_PROFILER_H_ */
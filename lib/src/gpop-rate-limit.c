@@ -0,0 +1,272 @@
+/*
+ * GStreamer Prince of Parser
+ *
+ * Copyright (C) 2020 Stéphane Cerveau
+ *
+ * SPDX-License-Identifier: LGPL
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation
+ * version 2.1 of the License.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301 USA
+ *
+ */
+
+#include <string.h>
+
+#include "gpop-private.h"
+
+/* Period at which the deferred requests are served */
+#define GPOP_RATE_LIMIT_TICK_MS 20
+/* Deferred requests per sender before rejecting */
+#define GPOP_RATE_LIMIT_MAX_PENDING 64
+/* Number of senders above which the idle buckets are dropped */
+#define GPOP_RATE_LIMIT_MAX_SENDERS 1024
+
+typedef struct
+{
+  guint cost;
+  GPOPRateLimitDispatch dispatch;
+  gpointer data;
+} GPOPRateLimitCall;
+
+typedef struct
+{
+  gchar *sender;
+  gdouble tokens;
+  gint64 updated;
+  GQueue pending;
+} GPOPRateLimitBucket;
+
+typedef struct
+{
+  const gchar *method_name;
+  guint cost;
+} GPOPRateLimitCost;
+
+static const GPOPRateLimitCost rate_limit_costs[] = {
+  {"AddPipeline", GPOP_RATE_LIMIT_COST_CREATE},
+  {"RemovePipeline", GPOP_RATE_LIMIT_COST_CREATE},
+  {"AddPipelines", GPOP_RATE_LIMIT_COST_CREATE},
+  {"RemovePipelines", GPOP_RATE_LIMIT_COST_CREATE},
+  {"AddLadder", GPOP_RATE_LIMIT_COST_CREATE},
+  {"PreparePipeline", GPOP_RATE_LIMIT_COST_CREATE},
+  {"Migrate", GPOP_RATE_LIMIT_COST_CREATE},
+  {"AddRendition", GPOP_RATE_LIMIT_COST_CREATE},
+  {"RemoveRendition", GPOP_RATE_LIMIT_COST_CREATE},
+  {"StopTrace", GPOP_RATE_LIMIT_COST_CREATE},
+  {"Profile", GPOP_RATE_LIMIT_COST_CREATE},
+  {"Play", GPOP_RATE_LIMIT_COST_STATE},
+  {"Pause", GPOP_RATE_LIMIT_COST_STATE},
+  {"Stop", GPOP_RATE_LIMIT_COST_STATE},
+  {"Seek", GPOP_RATE_LIMIT_COST_STATE},
+  {"SetSlo", GPOP_RATE_LIMIT_COST_STATE},
+  {"StartTrace", GPOP_RATE_LIMIT_COST_STATE},
+  {"StartRecording", GPOP_RATE_LIMIT_COST_STATE},
+  {"StopRecording", GPOP_RATE_LIMIT_COST_STATE},
+  {"GetControlStats", GPOP_RATE_LIMIT_COST_STATE},
+  {"GetMetrics", GPOP_RATE_LIMIT_COST_STATE},
+  {"GetHistory", GPOP_RATE_LIMIT_COST_STATE},
+};
+
+static guint rate_limit_rate = GPOP_RATE_LIMIT_DEFAULT_RATE;
+static guint rate_limit_burst = GPOP_RATE_LIMIT_DEFAULT_BURST;
+/* sender -> GPOPRateLimitBucket */
+static GHashTable *rate_limit_buckets = NULL;
+/* Buckets with deferred requests, in round robin order */
+static GQueue rate_limit_active = G_QUEUE_INIT;
+static guint rate_limit_tick_id = 0;
+static guint64 rate_limit_deferred = 0;
+static guint64 rate_limit_rejected = 0;
+
+static void
+gpop_rate_limit_bucket_free (GPOPRateLimitBucket * bucket)
+{
+  g_free (bucket->sender);
+  g_free (bucket);
+}
+
+static void
+gpop_rate_limit_refill (GPOPRateLimitBucket * bucket, gint64 now)
+{
+  bucket->tokens = MIN (rate_limit_burst,
+      bucket->tokens + (gdouble) (now - bucket->updated) * rate_limit_rate /
+      G_USEC_PER_SEC);
+  bucket->updated = now;
+}
+
+static void
+gpop_rate_limit_prune (gint64 now)
+{
+  GHashTableIter iter;
+  GPOPRateLimitBucket *bucket;
+
+  g_hash_table_iter_init (&iter, rate_limit_buckets);
+  while (g_hash_table_iter_next (&iter, NULL, (gpointer *) & bucket)) {
+    gpop_rate_limit_refill (bucket, now);
+    if (g_queue_is_empty (&bucket->pending)
+        && bucket->tokens >= rate_limit_burst)
+      g_hash_table_iter_remove (&iter);
+  }
+}
+
+static GPOPRateLimitBucket *
+gpop_rate_limit_get_bucket (const gchar * sender, gint64 now)
+{
+  GPOPRateLimitBucket *bucket;
+
+  if (!rate_limit_buckets)
+    rate_limit_buckets = g_hash_table_new_full (g_str_hash, g_str_equal,
+        NULL, (GDestroyNotify) gpop_rate_limit_bucket_free);
+
+  bucket = g_hash_table_lookup (rate_limit_buckets, sender);
+  if (bucket) {
+    gpop_rate_limit_refill (bucket, now);
+    return bucket;
+  }
+
+  if (g_hash_table_size (rate_limit_buckets) >= GPOP_RATE_LIMIT_MAX_SENDERS)
+    gpop_rate_limit_prune (now);
+
+  bucket = g_new0 (GPOPRateLimitBucket, 1);
+  bucket->sender = g_strdup (sender);
+  bucket->tokens = rate_limit_burst;
+  bucket->updated = now;
+  g_queue_init (&bucket->pending);
+  g_hash_table_insert (rate_limit_buckets, bucket->sender, bucket);
+
+  return bucket;
+}
+
+/* Serves at most one deferred request per throttled sender */
+static gboolean
+gpop_rate_limit_tick (gpointer user_data)
+{
+  gint64 now = g_get_monotonic_time ();
+  guint i, n_active = rate_limit_active.length;
+
+  for (i = 0; i < n_active; i++) {
+    GPOPRateLimitBucket *bucket = g_queue_pop_head (&rate_limit_active);
+    GPOPRateLimitCall *call = g_queue_peek_head (&bucket->pending);
+
+    gpop_rate_limit_refill (bucket, now);
+    if (bucket->tokens >= call->cost) {
+      g_queue_pop_head (&bucket->pending);
+      bucket->tokens -= call->cost;
+      call->dispatch (call->data);
+      g_free (call);
+    }
+    if (!g_queue_is_empty (&bucket->pending))
+      g_queue_push_tail (&rate_limit_active, bucket);
+  }
+
+  if (g_queue_is_empty (&rate_limit_active)) {
+    rate_limit_tick_id = 0;
+    return G_SOURCE_REMOVE;
+  }
+  return G_SOURCE_CONTINUE;
+}
+
+/* API */
+
+/* A rate of 0 disables the rate limiting */
+void
+gpop_rate_limit_configure (guint rate, guint burst)
+{
+  rate_limit_rate = rate;
+  rate_limit_burst = MAX (burst, GPOP_RATE_LIMIT_COST_CREATE);
+}
+
+guint
+gpop_rate_limit_get_cost (const gchar * method_name, GVariant * parameters)
+{
+  guint i, cost = GPOP_RATE_LIMIT_COST_READ;
+  gsize length = strlen (method_name);
+
+  /* <Method>WithKey costs as much as <Method> */
+  if (g_str_has_suffix (method_name, "WithKey"))
+    length -= strlen ("WithKey");
+
+  for (i = 0; i < G_N_ELEMENTS (rate_limit_costs); i++) {
+    if (strlen (rate_limit_costs[i].method_name) == length
+        && !strncmp (method_name, rate_limit_costs[i].method_name, length)) {
+      cost = rate_limit_costs[i].cost;
+      break;
+    }
+  }
+
+  /* The bulk methods cost as much as their items */
+  for (i = 0; parameters && i < g_variant_n_children (parameters); i++) {
+    GVariant *arg = g_variant_get_child_value (parameters, i);
+    if (g_variant_is_of_type (arg, G_VARIANT_TYPE_STRING_ARRAY))
+      cost *= MAX (1, g_variant_n_children (arg));
+    g_variant_unref (arg);
+  }
+
+  return cost;
+}
+
+/* The dispatch function is called later from the main loop when the request
+ * is deferred, a NULL dispatch function means that the request can not be
+ * deferred. */
+GPOPRateLimitResult
+gpop_rate_limit_admit (const gchar * sender, guint cost,
+    GPOPRateLimitDispatch dispatch, gpointer data)
+{
+  GPOPRateLimitBucket *bucket;
+  GPOPRateLimitCall *call;
+
+  if (!rate_limit_rate)
+    return GPOP_RATE_LIMIT_ACCEPTED;
+
+  /* Peer to peer connections have no sender */
+  bucket = gpop_rate_limit_get_bucket (sender ? sender : "",
+      g_get_monotonic_time ());
+  /* Even the largest bulk request must eventually be admitted */
+  cost = MIN (cost, rate_limit_burst);
+
+  if (g_queue_is_empty (&bucket->pending) && bucket->tokens >= cost) {
+    bucket->tokens -= cost;
+    return GPOP_RATE_LIMIT_ACCEPTED;
+  }
+
+  if (!dispatch || bucket->pending.length >= GPOP_RATE_LIMIT_MAX_PENDING) {
+    rate_limit_rejected++;
+    return GPOP_RATE_LIMIT_REJECTED;
+  }
+
+  call = g_new (GPOPRateLimitCall, 1);
+  call->cost = cost;
+  call->dispatch = dispatch;
+  call->data = data;
+  if (g_queue_is_empty (&bucket->pending))
+    g_queue_push_tail (&rate_limit_active, bucket);
+  g_queue_push_tail (&bucket->pending, call);
+  rate_limit_deferred++;
+
+  if (!rate_limit_tick_id)
+    rate_limit_tick_id = g_timeout_add (GPOP_RATE_LIMIT_TICK_MS,
+        gpop_rate_limit_tick, NULL);
+
+  return GPOP_RATE_LIMIT_DEFERRED;
+}
+
+void
+gpop_rate_limit_append_metrics (GString * metrics)
+{
+  g_string_append_printf (metrics,
+      "# TYPE gpop_requests_deferred_total counter\n"
+      "gpop_requests_deferred_total %" G_GUINT64_FORMAT "\n"
+      "# TYPE gpop_requests_rejected_total counter\n"
+      "gpop_requests_rejected_total %" G_GUINT64_FORMAT "\n",
+      rate_limit_deferred, rate_limit_rejected);
+}
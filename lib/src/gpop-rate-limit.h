@@ -0,0 +1,61 @@
+/*
+ * GStreamer Prince of Parser
+ *
+ * Copyright (C) 2020 Stéphane Cerveau
+ *
+ * SPDX-License-Identifier: LGPL
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation
+ * version 2.1 of the License.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301 USA
+ *
+ */
+
+#ifndef _GPOP_RATE_LIMIT_H_
+#define _GPOP_RATE_LIMIT_H_
+
+#include <glib-2.0/glib.h>
+
+/* Per-sender admission of the D-Bus control requests.
+ *
+ * Every sender owns a token bucket, refilled at the configured rate and
+ * holding up to the burst size. A request costs according to its weight:
+ * reads are cheap, state changes and pipeline creations are not. A request
+ * which can not be paid is deferred in the sender queue, the queues of the
+ * throttled senders being served round robin as their buckets refill, or
+ * rejected when its queue is full. Requests which can not wait, such as
+ * property reads, are rejected at once. */
+
+#define GPOP_RATE_LIMIT_DEFAULT_RATE 50
+#define GPOP_RATE_LIMIT_DEFAULT_BURST 100
+
+#define GPOP_RATE_LIMIT_COST_READ 1
+#define GPOP_RATE_LIMIT_COST_STATE 5
+#define GPOP_RATE_LIMIT_COST_CREATE 10
+
+typedef enum {
+  GPOP_RATE_LIMIT_ACCEPTED,
+  GPOP_RATE_LIMIT_DEFERRED,
+  GPOP_RATE_LIMIT_REJECTED,
+} GPOPRateLimitResult;
+
+typedef void (*GPOPRateLimitDispatch) (gpointer data);
+
+void gpop_rate_limit_configure (guint rate, guint burst);
+
+guint gpop_rate_limit_get_cost (const gchar * method_name, GVariant * parameters);
+GPOPRateLimitResult gpop_rate_limit_admit (const gchar * sender, guint cost, GPOPRateLimitDispatch dispatch, gpointer data);
+
+void gpop_rate_limit_append_metrics (GString * metrics);
+
+#endif /* _GPOP_RATE_LIMIT_H_ */
@@ -0,0 +1,121 @@
+/*
+ * GStreamer Prince of Parser
+ *
+ * Copyright (C) 2020 Stéphane Cerveau
+ *
+ * SPDX-License-Identifier: LGPL
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation
+ * version 2.1 of the License.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301 USA
+ *
+ */
+
+#include "gpop-recorder.h"
+
+#include <errno.h>
+#include <stdio.h>
+#include <string.h>
+
+typedef struct
+{
+  FILE *file;
+  gint64 start;
+  guint records;
+} GPOPRecorder;
+
+static GPOPRecorder *recorder = NULL;
+
+/* Public API */
+
+gboolean
+gpop_recorder_start (const gchar * path, GError ** error)
+{
+  FILE *file;
+
+  gpop_recorder_stop ();
+
+  file = fopen (path, "wb");
+  if (!file || fwrite (GPOP_RECORDER_MAGIC, 1, strlen (GPOP_RECORDER_MAGIC),
+          file) != strlen (GPOP_RECORDER_MAGIC)) {
+    g_set_error (error, G_FILE_ERROR, g_file_error_from_errno (errno),
+        "Unable to record into '%s': %s", path, g_strerror (errno));
+    if (file)
+      fclose (file);
+    return FALSE;
+  }
+
+  recorder = g_new0 (GPOPRecorder, 1);
+  recorder->file = file;
+  recorder->start = g_get_monotonic_time ();
+
+  return TRUE;
+}
+
+guint
+gpop_recorder_stop (void)
+{
+  guint records;
+
+  if (!recorder)
+    return 0;
+
+  fclose (recorder->file);
+  records = recorder->records;
+  g_clear_pointer (&recorder, g_free);
+
+  return records;
+}
+
+gboolean
+gpop_recorder_is_active (void)
+{
+  return recorder != NULL;
+}
+
+void
+gpop_recorder_record (const gchar * object_path, const gchar * method_name,
+    GVariant * parameters)
+{
+  GVariant *record, *normal;
+  guint32 size;
+
+  if (G_LIKELY (!recorder))
+    return;
+
+  if (!parameters)
+    parameters = g_variant_new_tuple (NULL, 0);
+
+  record = g_variant_ref_sink (g_variant_new (GPOP_RECORDER_RECORD_TYPE,
+          (guint64) (g_get_monotonic_time () - recorder->start),
+          object_path, method_name, parameters));
+  normal = g_variant_get_normal_form (record);
+  g_variant_unref (record);
+  if (G_BYTE_ORDER == G_BIG_ENDIAN) {
+    record = g_variant_byteswap (normal);
+    g_variant_unref (normal);
+    normal = record;
+  }
+
+  size = GUINT32_TO_LE ((guint32) g_variant_get_size (normal));
+  if (fwrite (&size, sizeof (size), 1, recorder->file) != 1
+      || fwrite (g_variant_get_data (normal), 1, g_variant_get_size (normal),
+          recorder->file) != g_variant_get_size (normal)) {
+    g_printerr ("Unable to write the record, stopping the recorder: %s\n",
+        g_strerror (errno));
+    gpop_recorder_stop ();
+  } else
+    recorder->records++;
+
+  g_variant_unref (normal);
+}
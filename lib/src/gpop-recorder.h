@@ -0,0 +1,40 @@
+/*
+ * GStreamer Prince of Parser
+ *
+ * Copyright (C) 2020 Stéphane Cerveau
+ *
+ * SPDX-License-Identifier: LGPL
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation
+ * version 2.1 of the License.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301 USA
+ *
+ */
+
+#ifndef _GPOP_RECORDER_H_
+#define _GPOP_RECORDER_H_
+
+#include <glib-2.0/glib.h>
+
+#include "gpop-recording.h"
+
+/* Session recorder of the D-Bus control plane, the file can be replayed with
+ * gpop-client --replay, see gpop-recording.h for its format. */
+
+gboolean gpop_recorder_start (const gchar * path, GError ** error);
+guint gpop_recorder_stop (void);
+gboolean gpop_recorder_is_active (void);
+
+void gpop_recorder_record (const gchar * object_path, const gchar * method_name, GVariant * parameters);
+
+#endif /* _GPOP_RECORDER_H_ */
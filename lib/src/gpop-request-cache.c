@@ -0,0 +1,148 @@
+/*
+ * GStreamer Prince of Parser
+ *
+ * Copyright (C) 2020 Stéphane Cerveau
+ *
+ * SPDX-License-Identifier: LGPL
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation
+ * version 2.1 of the License.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301 USA
+ *
+ */
+
+#include "gpop-private.h"
+
+typedef struct
+{
+  gchar *request_id;
+  gchar *method_name;
+  GVariant *parameters;
+  GVariant *reply;
+  gint64 inserted;
+  GList *link;
+} GPOPRequestEntry;
+
+struct _GPOPRequestCache
+{
+  guint size;
+  gint64 ttl;
+  /* request id -> GPOPRequestEntry */
+  GHashTable *entries;
+  /* GPOPRequestEntry, oldest first */
+  GQueue order;
+};
+
+static void
+gpop_request_entry_free (GPOPRequestEntry * entry)
+{
+  g_free (entry->request_id);
+  g_free (entry->method_name);
+  g_variant_unref (entry->parameters);
+  g_variant_unref (entry->reply);
+  g_free (entry);
+}
+
+static void
+gpop_request_cache_remove (GPOPRequestCache * cache, GPOPRequestEntry * entry)
+{
+  g_queue_delete_link (&cache->order, entry->link);
+  g_hash_table_remove (cache->entries, entry->request_id);
+}
+
+static void
+gpop_request_cache_expire (GPOPRequestCache * cache)
+{
+  gint64 now = g_get_monotonic_time ();
+  GPOPRequestEntry *entry;
+
+  while ((entry = g_queue_peek_head (&cache->order))
+      && (now - entry->inserted > cache->ttl
+          || cache->order.length > cache->size))
+    gpop_request_cache_remove (cache, entry);
+}
+
+/* API */
+
+GPOPRequestCache *
+gpop_request_cache_new (guint size, guint ttl_seconds)
+{
+  GPOPRequestCache *cache = g_new0 (GPOPRequestCache, 1);
+
+  cache->size = size;
+  cache->ttl = (gint64) ttl_seconds * G_USEC_PER_SEC;
+  cache->entries = g_hash_table_new_full (g_str_hash, g_str_equal, NULL,
+      (GDestroyNotify) gpop_request_entry_free);
+  g_queue_init (&cache->order);
+
+  return cache;
+}
+
+void
+gpop_request_cache_free (GPOPRequestCache * cache)
+{
+  if (!cache)
+    return;
+
+  g_queue_clear (&cache->order);
+  g_hash_table_unref (cache->entries);
+  g_free (cache);
+}
+
+/* Returns a new reference on the reply of the original request, or NULL if
+ * the request id is unknown. A request id reused for another request is an
+ * error. */
+GVariant *
+gpop_request_cache_lookup (GPOPRequestCache * cache, const gchar * request_id,
+    const gchar * method_name, GVariant * parameters, GError ** error)
+{
+  GPOPRequestEntry *entry;
+
+  gpop_request_cache_expire (cache);
+
+  entry = g_hash_table_lookup (cache->entries, request_id);
+  if (!entry)
+    return NULL;
+
+  if (g_strcmp0 (entry->method_name, method_name)
+      || !g_variant_equal (entry->parameters, parameters)) {
+    g_set_error (error, G_DBUS_ERROR, G_DBUS_ERROR_INVALID_ARGS,
+        "Request id '%s' has already been used by another request",
+        request_id);
+    return NULL;
+  }
+
+  return g_variant_ref (entry->reply);
+}
+
+void
+gpop_request_cache_insert (GPOPRequestCache * cache, const gchar * request_id,
+    const gchar * method_name, GVariant * parameters, GVariant * reply)
+{
+  GPOPRequestEntry *entry = g_hash_table_lookup (cache->entries, request_id);
+
+  if (entry)
+    gpop_request_cache_remove (cache, entry);
+
+  entry = g_new (GPOPRequestEntry, 1);
+  entry->request_id = g_strdup (request_id);
+  entry->method_name = g_strdup (method_name);
+  entry->parameters = g_variant_ref_sink (parameters);
+  entry->reply = g_variant_ref_sink (reply);
+  entry->inserted = g_get_monotonic_time ();
+  g_queue_push_tail (&cache->order, entry);
+  entry->link = cache->order.tail;
+  g_hash_table_insert (cache->entries, entry->request_id, entry);
+
+  gpop_request_cache_expire (cache);
+}
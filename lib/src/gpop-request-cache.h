@@ -0,0 +1,45 @@
+/*
+ * GStreamer Prince of Parser
+ *
+ * Copyright (C) 2020 Stéphane Cerveau
+ *
+ * SPDX-License-Identifier: LGPL
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation
+ * version 2.1 of the License.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301 USA
+ *
+ */
+
+#ifndef _GPOP_REQUEST_CACHE_H_
+#define _GPOP_REQUEST_CACHE_H_
+
+#include <glib-2.0/glib.h>
+
+/* Replies of the mutating requests by client supplied request id, so that a
+ * retried request returns the reply of the original one instead of running
+ * again. The cache is bounded in size and in age, the oldest replies are
+ * dropped first. */
+
+#define GPOP_REQUEST_CACHE_DEFAULT_SIZE 1024
+#define GPOP_REQUEST_CACHE_DEFAULT_TTL_SECONDS 600
+
+typedef struct _GPOPRequestCache GPOPRequestCache;
+
+GPOPRequestCache * gpop_request_cache_new (guint size, guint ttl_seconds);
+void gpop_request_cache_free (GPOPRequestCache * cache);
+
+GVariant * gpop_request_cache_lookup (GPOPRequestCache * cache, const gchar * request_id, const gchar * method_name, GVariant * parameters, GError ** error);
+void gpop_request_cache_insert (GPOPRequestCache * cache, const gchar * request_id, const gchar * method_name, GVariant * parameters, GVariant * reply);
+
+#endif /* _GPOP_REQUEST_CACHE_H_ */
@@ -0,0 +1,501 @@
+/*
+ * GStreamer Prince of Parser
+ *
+ * Copyright (C) 2020 Stéphane Cerveau
+ *
+ * SPDX-License-Identifier: LGPL
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation
+ * version 2.1 of the License.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301 USA
+ *
+ */
+
+#include <gst/base/gstbasesink.h>
+
+#include "gpop-private.h"
+
+/* A bucket is only written by the streaming thread of its sink and read by
+ * the main loop, so a buffer costs no lock */
+#define GPOP_SLO_LOAD(ptr) __atomic_load_n ((ptr), __ATOMIC_ACQUIRE)
+#define GPOP_SLO_STORE(ptr, val) __atomic_store_n ((ptr), (val), __ATOMIC_RELEASE)
+
+typedef struct
+{
+  /* -1 while the bucket is being reset */
+  gint64 second;
+  guint64 frames;
+  guint64 dropped;
+  /* us */
+  gint64 latency_sum;
+  guint64 latency_count;
+} GPOPSloBucket;
+
+typedef struct
+{
+  GPOPSlo *slo;
+  GstBaseSink *sink;
+  gulong probe;
+  /* only used by the streaming thread */
+  GstSegment segment;
+  gint video;
+  /* latency of the pipeline, refreshed by gpop_slo_update_latency() */
+  GstClockTime latency;
+  GPOPSloBucket buckets[GPOP_SLO_DROPPED_WINDOW_SECONDS];
+} GPOPSloSink;
+
+typedef struct
+{
+  gboolean violated;
+  guint failed;
+  guint passed;
+} GPOPSloState;
+
+struct _GPOPSlo
+{
+  gint refcount;
+  /* the sinks are added and removed from the streaming threads */
+  GMutex lock;
+  GList *sinks;
+  GPOPSloTargets targets;
+  GPOPSloState states[GPOP_SLO_LAST];
+  gint64 playing_since;
+};
+
+static GPOPSlo *
+gpop_slo_ref (GPOPSlo * slo)
+{
+  g_atomic_int_inc (&slo->refcount);
+  return slo;
+}
+
+static void
+gpop_slo_unref (GPOPSlo * slo)
+{
+  if (!g_atomic_int_dec_and_test (&slo->refcount))
+    return;
+
+  g_mutex_clear (&slo->lock);
+  g_free (slo);
+}
+
+static void
+gpop_slo_sink_free (GPOPSloSink * sink)
+{
+  GPOPSlo *slo = sink->slo;
+
+  g_mutex_lock (&slo->lock);
+  slo->sinks = g_list_remove (slo->sinks, sink);
+  g_mutex_unlock (&slo->lock);
+  g_free (sink);
+  gpop_slo_unref (slo);
+}
+
+static gint64
+gpop_slo_get_second (void)
+{
+  return g_get_monotonic_time () / G_USEC_PER_SEC;
+}
+
+/* From the streaming thread of the sink */
+static void
+gpop_slo_sink_render (GPOPSloSink * sink, GstBuffer * buffer)
+{
+  gint64 second = gpop_slo_get_second ();
+  GPOPSloBucket *bucket = &sink->buckets[second % G_N_ELEMENTS (sink->buckets)];
+  GstClockTime running;
+  GstClock *clock;
+
+  if (bucket->second != second) {
+    GPOP_SLO_STORE (&bucket->second, -1);
+    GPOP_SLO_STORE (&bucket->frames, 0);
+    GPOP_SLO_STORE (&bucket->dropped, 0);
+    GPOP_SLO_STORE (&bucket->latency_sum, 0);
+    GPOP_SLO_STORE (&bucket->latency_count, 0);
+    GPOP_SLO_STORE (&bucket->second, second);
+  }
+  GPOP_SLO_STORE (&bucket->frames, bucket->frames + 1);
+
+  if (sink->segment.format != GST_FORMAT_TIME
+      || !GST_BUFFER_PTS_IS_VALID (buffer))
+    return;
+  running = gst_segment_to_running_time (&sink->segment, GST_FORMAT_TIME,
+      GST_BUFFER_PTS (buffer));
+  clock = gst_element_get_clock (GST_ELEMENT (sink->sink));
+  if (clock && GST_CLOCK_TIME_IS_VALID (running)) {
+    GstClockTimeDiff latency = GST_CLOCK_DIFF (running,
+        gst_clock_get_time (clock) -
+        gst_element_get_base_time (GST_ELEMENT (sink->sink)));
+    gint64 max_lateness = gst_base_sink_get_max_lateness (sink->sink);
+
+    latency = MAX (latency, 0);
+    GPOP_SLO_STORE (&bucket->latency_sum,
+        bucket->latency_sum + latency / GST_USECOND);
+    GPOP_SLO_STORE (&bucket->latency_count, bucket->latency_count + 1);
+    /* what a synchronized sink drops as too late */
+    if (gst_base_sink_get_sync (sink->sink) && max_lateness >= 0
+        && latency - (GstClockTimeDiff) GPOP_SLO_LOAD (&sink->latency) >
+        max_lateness)
+      GPOP_SLO_STORE (&bucket->dropped, bucket->dropped + 1);
+  }
+  if (clock)
+    gst_object_unref (clock);
+}
+
+static GstPadProbeReturn
+gpop_slo_sink_probe (GstPad * pad, GstPadProbeInfo * info,
+    gpointer user_data)
+{
+  GPOPSloSink *sink = (GPOPSloSink *) user_data;
+
+  if (info->type & GST_PAD_PROBE_TYPE_BUFFER) {
+    gpop_slo_sink_render (sink, GST_PAD_PROBE_INFO_BUFFER (info));
+  } else if (info->type & GST_PAD_PROBE_TYPE_BUFFER_LIST) {
+    GstBufferList *list = GST_PAD_PROBE_INFO_BUFFER_LIST (info);
+    guint i;
+
+    for (i = 0; i < gst_buffer_list_length (list); i++)
+      gpop_slo_sink_render (sink, gst_buffer_list_get (list, i));
+  } else {
+    GstEvent *event = GST_PAD_PROBE_INFO_EVENT (info);
+
+    switch (GST_EVENT_TYPE (event)) {
+      case GST_EVENT_SEGMENT:
+        gst_event_copy_segment (event, &sink->segment);
+        break;
+      case GST_EVENT_FLUSH_STOP:
+        gst_segment_init (&sink->segment, GST_FORMAT_UNDEFINED);
+        break;
+      case GST_EVENT_CAPS:{
+        GstCaps *caps;
+
+        gst_event_parse_caps (event, &caps);
+        GPOP_SLO_STORE (&sink->video,
+            g_str_has_prefix (gst_structure_get_name (gst_caps_get_structure
+                    (caps, 0)), "video/"));
+        break;
+      }
+      default:
+        break;
+    }
+  }
+
+  return GST_PAD_PROBE_OK;
+}
+
+/* Sums the buckets of the sinks over the seconds [from, to[, and the
+ * dropped buffers over [dropped_from, to[. The frame rate is the one of the
+ * slowest video sink, or of the slowest sink without video. Called with the
+ * lock. */
+static void
+gpop_slo_sum (GPOPSlo * slo, gint64 from, gint64 dropped_from, gint64 to,
+    gdouble * fps, gdouble * latency_ms, guint64 * dropped)
+{
+  gboolean has_video = FALSE;
+  gint64 latency_sum = 0;
+  guint64 latency_count = 0;
+  GList *l;
+
+  for (l = slo->sinks; l; l = g_list_next (l))
+    has_video |= GPOP_SLO_LOAD (&((GPOPSloSink *) l->data)->video);
+
+  *fps = -1;
+  *dropped = 0;
+  for (l = slo->sinks; l; l = g_list_next (l)) {
+    GPOPSloSink *sink = l->data;
+    guint64 frames = 0;
+    guint i;
+
+    for (i = 0; i < G_N_ELEMENTS (sink->buckets); i++) {
+      GPOPSloBucket *bucket = &sink->buckets[i];
+      gint64 second = GPOP_SLO_LOAD (&bucket->second);
+      GPOPSloBucket copy;
+
+      if (second < dropped_from || second >= to)
+        continue;
+      copy.frames = GPOP_SLO_LOAD (&bucket->frames);
+      copy.dropped = GPOP_SLO_LOAD (&bucket->dropped);
+      copy.latency_sum = GPOP_SLO_LOAD (&bucket->latency_sum);
+      copy.latency_count = GPOP_SLO_LOAD (&bucket->latency_count);
+      /* reset by the streaming thread meanwhile */
+      if (GPOP_SLO_LOAD (&bucket->second) != second)
+        continue;
+      *dropped += copy.dropped;
+      if (second < from)
+        continue;
+      frames += copy.frames;
+      latency_sum += copy.latency_sum;
+      latency_count += copy.latency_count;
+    }
+    if (GPOP_SLO_LOAD (&sink->video) == has_video && (*fps < 0
+            || (gdouble) frames / (to - from) < *fps))
+      *fps = (gdouble) frames / (to - from);
+  }
+
+  *fps = MAX (*fps, 0);
+  *latency_ms = latency_count ? latency_sum / 1000.0 / latency_count : -1;
+}
+
+/* API */
+
+GPOPSlo *
+gpop_slo_new (void)
+{
+  GPOPSlo *slo = g_new0 (GPOPSlo, 1);
+
+  slo->refcount = 1;
+  g_mutex_init (&slo->lock);
+  return slo;
+}
+
+/* The probes of a built pipeline keep their own reference */
+void
+gpop_slo_free (GPOPSlo * slo)
+{
+  gpop_slo_unref (slo);
+}
+
+void
+gpop_slo_set_targets (GPOPSlo * slo, const GPOPSloTargets * targets)
+{
+  slo->targets = *targets;
+}
+
+void
+gpop_slo_get_targets (GPOPSlo * slo, GPOPSloTargets * targets)
+{
+  *targets = slo->targets;
+}
+
+gboolean
+gpop_slo_is_set (GPOPSlo * slo)
+{
+  return slo->targets.min_fps > 0 || slo->targets.max_latency_ms > 0
+      || slo->targets.max_dropped_per_minute > 0;
+}
+
+static void
+gpop_slo_add_sink (GPOPSlo * slo, GstElement * element)
+{
+  GPOPSloSink *sink;
+
+  if (!GST_IS_BASE_SINK (element))
+    return;
+
+  sink = g_new0 (GPOPSloSink, 1);
+  sink->slo = gpop_slo_ref (slo);
+  sink->sink = GST_BASE_SINK (element);
+  gst_segment_init (&sink->segment, GST_FORMAT_UNDEFINED);
+  g_mutex_lock (&slo->lock);
+  slo->sinks = g_list_prepend (slo->sinks, sink);
+  g_mutex_unlock (&slo->lock);
+  sink->probe = gst_pad_add_probe (GST_BASE_SINK_PAD (element),
+      GST_PAD_PROBE_TYPE_BUFFER | GST_PAD_PROBE_TYPE_BUFFER_LIST |
+      GST_PAD_PROBE_TYPE_EVENT_DOWNSTREAM, gpop_slo_sink_probe, sink,
+      (GDestroyNotify) gpop_slo_sink_free);
+}
+
+static void
+gpop_slo_on_element_added (GstBin * bin, GstBin * sub_bin,
+    GstElement * element, gpointer user_data)
+{
+  gpop_slo_add_sink ((GPOPSlo *) user_data, element);
+}
+
+/* A sink replaced by its bin, such as the fakesink of autovideosink, is no
+ * longer counted */
+static void
+gpop_slo_on_element_removed (GstBin * bin, GstBin * sub_bin,
+    GstElement * element, gpointer user_data)
+{
+  GPOPSlo *slo = (GPOPSlo *) user_data;
+  gulong probe = 0;
+  GList *l;
+
+  if (!GST_IS_BASE_SINK (element))
+    return;
+
+  g_mutex_lock (&slo->lock);
+  for (l = slo->sinks; l; l = g_list_next (l)) {
+    GPOPSloSink *sink = l->data;
+
+    if (sink->sink == GST_BASE_SINK (element)) {
+      probe = sink->probe;
+      break;
+    }
+  }
+  g_mutex_unlock (&slo->lock);
+
+  /* frees the sink */
+  if (probe)
+    gst_pad_remove_probe (GST_BASE_SINK_PAD (element), probe);
+}
+
+/* To be called on a newly built pipeline, counts the buffers of its sinks,
+ * including the ones added later by the bins and the ladder renditions */
+void
+gpop_slo_attach (GPOPSlo * slo, GstElement * pipeline)
+{
+  GstIterator *it;
+  GValue item = G_VALUE_INIT;
+
+  g_signal_connect_data (pipeline, "deep-element-added",
+      G_CALLBACK (gpop_slo_on_element_added), gpop_slo_ref (slo),
+      (GClosureNotify) gpop_slo_unref, 0);
+  g_signal_connect_data (pipeline, "deep-element-removed",
+      G_CALLBACK (gpop_slo_on_element_removed), gpop_slo_ref (slo),
+      (GClosureNotify) gpop_slo_unref, 0);
+  it = gst_bin_iterate_recurse (GST_BIN (pipeline));
+  while (gst_iterator_next (it, &item) == GST_ITERATOR_OK) {
+    gpop_slo_add_sink (slo, g_value_get_object (&item));
+    g_value_reset (&item);
+  }
+  g_value_unset (&item);
+  gst_iterator_free (it);
+}
+
+/* Every second from the main loop while the pipeline plays, queries the
+ * latency of the sinks, used to tell the buffers dropped as too late. The
+ * query goes upstream, so it is not sent from the streaming threads. */
+void
+gpop_slo_update_latency (GPOPSlo * slo)
+{
+  GList *sinks = NULL, *l;
+
+  g_mutex_lock (&slo->lock);
+  for (l = slo->sinks; l; l = g_list_next (l))
+    sinks = g_list_prepend (sinks,
+        gst_object_ref (((GPOPSloSink *) l->data)->sink));
+  g_mutex_unlock (&slo->lock);
+
+  for (l = sinks; l; l = g_list_next (l)) {
+    GstBaseSink *element = l->data;
+    GstClockTime min_latency = 0, latency;
+    gboolean live, upstream_live;
+    GList *s;
+
+    if (!gst_base_sink_query_latency (element, &live, &upstream_live,
+            &min_latency, NULL))
+      min_latency = 0;
+    latency = min_latency + gst_base_sink_get_render_delay (element);
+
+    g_mutex_lock (&slo->lock);
+    for (s = slo->sinks; s; s = g_list_next (s)) {
+      GPOPSloSink *sink = s->data;
+
+      if (sink->sink == element)
+        GPOP_SLO_STORE (&sink->latency, latency);
+    }
+    g_mutex_unlock (&slo->lock);
+  }
+  g_list_free_full (sinks, gst_object_unref);
+}
+
+/* Every second from the main loop, func is called on each violation and
+ * recovery */
+void
+gpop_slo_evaluate (GPOPSlo * slo, gboolean playing, GPOPSloFunc func,
+    gpointer user_data)
+{
+  gdouble values[GPOP_SLO_LAST], targets[GPOP_SLO_LAST];
+  gint64 second = gpop_slo_get_second ();
+  gdouble fps, latency_ms;
+  guint64 dropped;
+  guint i;
+
+  /* the pipeline is not expected to be streaming */
+  if (!playing) {
+    slo->playing_since = 0;
+    for (i = 0; i < GPOP_SLO_LAST; i++)
+      slo->states[i].failed = slo->states[i].passed = 0;
+    return;
+  }
+  if (!slo->playing_since)
+    slo->playing_since = second;
+  /* the first complete window */
+  if (second - slo->playing_since <= GPOP_SLO_WINDOW_SECONDS)
+    return;
+
+  g_mutex_lock (&slo->lock);
+  gpop_slo_sum (slo, second - GPOP_SLO_WINDOW_SECONDS,
+      second - GPOP_SLO_DROPPED_WINDOW_SECONDS, second, &fps, &latency_ms,
+      &dropped);
+  g_mutex_unlock (&slo->lock);
+
+  values[GPOP_SLO_FPS] = fps;
+  values[GPOP_SLO_LATENCY] = latency_ms;
+  values[GPOP_SLO_DROPPED] = dropped;
+  targets[GPOP_SLO_FPS] = slo->targets.min_fps;
+  targets[GPOP_SLO_LATENCY] = slo->targets.max_latency_ms;
+  targets[GPOP_SLO_DROPPED] = slo->targets.max_dropped_per_minute;
+
+  for (i = 0; i < GPOP_SLO_LAST; i++) {
+    GPOPSloState *state = &slo->states[i];
+    gboolean failed, passed;
+
+    if (targets[i] <= 0 || values[i] < 0)
+      continue;
+    if (i == GPOP_SLO_FPS) {
+      failed = values[i] < targets[i];
+      passed = values[i] >= targets[i] * (1 + GPOP_SLO_RECOVERY_MARGIN);
+    } else {
+      failed = values[i] > targets[i];
+      passed = values[i] <= targets[i] * (1 - GPOP_SLO_RECOVERY_MARGIN);
+    }
+
+    if (!state->violated) {
+      state->failed = failed ? state->failed + 1 : 0;
+      if (state->failed >= GPOP_SLO_VIOLATION_COUNT) {
+        state->violated = TRUE;
+        state->passed = 0;
+        func (i, TRUE, values[i], targets[i], user_data);
+      }
+    } else {
+      state->passed = passed ? state->passed + 1 : 0;
+      if (state->passed >= GPOP_SLO_RECOVERY_COUNT) {
+        state->violated = FALSE;
+        state->failed = 0;
+        func (i, FALSE, values[i], targets[i], user_data);
+      }
+    }
+  }
+}
+
+/* The stats of the last complete second, the latency is negative when no
+ * buffer had a timestamp */
+void
+gpop_slo_sample (GPOPSlo * slo, gdouble * fps, gdouble * latency_ms,
+    guint64 * dropped)
+{
+  gint64 second = gpop_slo_get_second ();
+
+  g_mutex_lock (&slo->lock);
+  gpop_slo_sum (slo, second - 1, second - 1, second, fps, latency_ms,
+      dropped);
+  g_mutex_unlock (&slo->lock);
+}
+
+const gchar *
+gpop_slo_objective_get_name (GPOPSloObjective objective)
+{
+  switch (objective) {
+    case GPOP_SLO_FPS:
+      return "min-fps";
+    case GPOP_SLO_LATENCY:
+      return "max-latency-ms";
+    case GPOP_SLO_DROPPED:
+      return "max-dropped-per-minute";
+    default:
+      return "unknown";
+  }
+}
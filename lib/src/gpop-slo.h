@@ -0,0 +1,81 @@
+/*
+ * GStreamer Prince of Parser
+ *
+ * Copyright (C) 2020 Stéphane Cerveau
+ *
+ * SPDX-License-Identifier: LGPL
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation
+ * version 2.1 of the License.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301 USA
+ *
+ */
+
+#ifndef _GPOP_SLO_H_
+#define _GPOP_SLO_H_
+
+#include <gst/gst.h>
+
+/* Service level objectives of a pipeline.
+ *
+ * The buffers reaching the sinks of the pipeline are counted in one second
+ * buckets along with their latency, the running time of their arrival minus
+ * their running timestamp, and the buffers late enough to be dropped by a
+ * synchronized sink. The objectives are evaluated every second on sliding
+ * windows: the frame rate of the slowest video sink and the mean latency
+ * over 5 seconds, the dropped buffers over one minute. The sinks of every
+ * pipeline are counted, the stats are also sampled for the history.
+ *
+ * An objective is violated after 3 failed evaluations in a row, and only
+ * recovers after 10 evaluations in a row within its target with a 10%
+ * margin, so that a pipeline close to its target does not flap. */
+
+#define GPOP_SLO_WINDOW_SECONDS 5
+#define GPOP_SLO_DROPPED_WINDOW_SECONDS 60
+#define GPOP_SLO_VIOLATION_COUNT 3
+#define GPOP_SLO_RECOVERY_COUNT 10
+#define GPOP_SLO_RECOVERY_MARGIN 0.1
+
+typedef enum {
+  GPOP_SLO_FPS,
+  GPOP_SLO_LATENCY,
+  GPOP_SLO_DROPPED,
+  GPOP_SLO_LAST,
+} GPOPSloObjective;
+
+/* 0 leaves an objective unset */
+typedef struct {
+  gdouble min_fps;
+  gdouble max_latency_ms;
+  gdouble max_dropped_per_minute;
+} GPOPSloTargets;
+
+typedef struct _GPOPSlo GPOPSlo;
+
+typedef void (*GPOPSloFunc) (GPOPSloObjective objective, gboolean violated, gdouble value, gdouble target, gpointer user_data);
+
+GPOPSlo * gpop_slo_new (void);
+void gpop_slo_free (GPOPSlo * slo);
+
+void gpop_slo_set_targets (GPOPSlo * slo, const GPOPSloTargets * targets);
+void gpop_slo_get_targets (GPOPSlo * slo, GPOPSloTargets * targets);
+gboolean gpop_slo_is_set (GPOPSlo * slo);
+
+void gpop_slo_attach (GPOPSlo * slo, GstElement * pipeline);
+void gpop_slo_update_latency (GPOPSlo * slo);
+void gpop_slo_evaluate (GPOPSlo * slo, gboolean playing, GPOPSloFunc func, gpointer user_data);
+void gpop_slo_sample (GPOPSlo * slo, gdouble * fps, gdouble * latency_ms, guint64 * dropped);
+
+const gchar * gpop_slo_objective_get_name (GPOPSloObjective objective);
+
+#endif /* _GPOP_SLO_H_ */
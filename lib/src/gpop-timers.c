@@ -0,0 +1,206 @@
+/*
+ * GStreamer Prince of Parser
+ *
+ * Copyright (C) 2020 Stéphane Cerveau
+ *
+ * SPDX-License-Identifier: LGPL
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation
+ * version 2.1 of the License.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301 USA
+ *
+ */
+
+#include "gpop-private.h"
+
+typedef struct
+{
+  guint id;
+  guint period_ms;
+  gint64 deadline;
+  GSourceFunc func;
+  gpointer user_data;
+} GPOPTimer;
+
+/* Sorted by deadline, the timers live in the main context */
+static GList *timers = NULL;
+static guint timers_next_id = 1;
+static guint timers_source_id = 0;
+static gint64 timers_scheduled = 0;
+static guint timers_slack_ms = GPOP_TIMERS_DEFAULT_SLACK_MS;
+static guint64 timers_wakeups = 0;
+
+static gint64
+gpop_timers_round (gint64 time)
+{
+  gint64 slack = (gint64) timers_slack_ms * 1000;
+
+  if (!slack)
+    return time;
+  return (time + slack - 1) / slack * slack;
+}
+
+static gint
+gpop_timers_compare (gconstpointer a, gconstpointer b)
+{
+  const GPOPTimer *ta = a, *tb = b;
+
+  return ta->deadline < tb->deadline ? -1 : ta->deadline > tb->deadline;
+}
+
+static GList *
+gpop_timers_find (guint id)
+{
+  GList *l;
+
+  for (l = timers; l; l = g_list_next (l))
+    if (((GPOPTimer *) l->data)->id == id)
+      return l;
+  return NULL;
+}
+
+static gboolean gpop_timers_dispatch (gpointer user_data);
+
+static void
+gpop_timers_schedule (void)
+{
+  gint64 wakeup, delay;
+
+  if (!timers) {
+    if (timers_source_id)
+      g_source_remove (timers_source_id);
+    timers_source_id = 0;
+    return;
+  }
+
+  wakeup = gpop_timers_round (((GPOPTimer *) timers->data)->deadline);
+  if (timers_source_id && wakeup == timers_scheduled)
+    return;
+  if (timers_source_id)
+    g_source_remove (timers_source_id);
+
+  delay = MAX (wakeup - g_get_monotonic_time (), 0);
+  timers_scheduled = wakeup;
+  timers_source_id = g_timeout_add ((delay + 999) / 1000,
+      gpop_timers_dispatch, NULL);
+}
+
+static gboolean
+gpop_timers_dispatch (gpointer user_data)
+{
+  gint64 now = g_get_monotonic_time (), limit = gpop_timers_round (now);
+  GArray *due = g_array_new (FALSE, FALSE, sizeof (guint));
+  GList *l;
+  guint i;
+
+  timers_source_id = 0;
+  timers_wakeups++;
+
+  for (l = timers; l && ((GPOPTimer *) l->data)->deadline <= limit;
+      l = g_list_next (l))
+    g_array_append_val (due, ((GPOPTimer *) l->data)->id);
+
+  /* a callback may add or remove timers */
+  for (i = 0; i < due->len; i++) {
+    guint id = g_array_index (due, guint, i);
+    GList *link = gpop_timers_find (id);
+    GPOPTimer *timer;
+
+    if (!link)
+      continue;
+    timer = link->data;
+    timers = g_list_delete_link (timers, link);
+    timer->deadline += (gint64) timer->period_ms * 1000;
+    if (timer->deadline <= now)
+      timer->deadline = now + (gint64) timer->period_ms * 1000;
+    timers = g_list_insert_sorted (timers, timer, gpop_timers_compare);
+
+    if (!timer->func (timer->user_data) && gpop_timers_find (id))
+      gpop_timers_remove (id);
+  }
+  g_array_free (due, TRUE);
+
+  gpop_timers_schedule ();
+  return G_SOURCE_REMOVE;
+}
+
+/* API */
+
+/* Calls func every period_ms until it returns G_SOURCE_REMOVE or the timer
+ * is removed */
+guint
+gpop_timers_add (guint period_ms, GSourceFunc func, gpointer user_data)
+{
+  GPOPTimer *timer = g_new0 (GPOPTimer, 1);
+
+  timer->id = timers_next_id++;
+  timer->period_ms = MAX (period_ms, 1);
+  timer->deadline = g_get_monotonic_time () + (gint64) timer->period_ms * 1000;
+  timer->func = func;
+  timer->user_data = user_data;
+  timers = g_list_insert_sorted (timers, timer, gpop_timers_compare);
+  gpop_timers_schedule ();
+
+  return timer->id;
+}
+
+void
+gpop_timers_remove (guint id)
+{
+  GList *link = gpop_timers_find (id);
+
+  g_return_if_fail (link != NULL);
+
+  g_free (link->data);
+  timers = g_list_delete_link (timers, link);
+  gpop_timers_schedule ();
+}
+
+/* A shorter period applies right away, a longer one from the next run */
+void
+gpop_timers_set_period (guint id, guint period_ms)
+{
+  GList *link = gpop_timers_find (id);
+  GPOPTimer *timer;
+  gint64 deadline;
+
+  g_return_if_fail (link != NULL);
+
+  timer = link->data;
+  timer->period_ms = MAX (period_ms, 1);
+  deadline = g_get_monotonic_time () + (gint64) timer->period_ms * 1000;
+  if (deadline < timer->deadline) {
+    timer->deadline = deadline;
+    timers = g_list_delete_link (timers, link);
+    timers = g_list_insert_sorted (timers, timer, gpop_timers_compare);
+    gpop_timers_schedule ();
+  }
+}
+
+void
+gpop_timers_set_slack (guint slack_ms)
+{
+  timers_slack_ms = slack_ms;
+  if (timers_source_id) {
+    g_source_remove (timers_source_id);
+    timers_source_id = 0;
+  }
+  gpop_timers_schedule ();
+}
+
+/* Wakeups of the shared source */
+guint64
+gpop_timers_get_wakeups (void)
+{
+  return timers_wakeups;
+}
@@ -0,0 +1,47 @@
+/*
+ * GStreamer Prince of Parser
+ *
+ * Copyright (C) 2020 Stéphane Cerveau
+ *
+ * SPDX-License-Identifier: LGPL
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation
+ * version 2.1 of the License.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301 USA
+ *
+ */
+
+#ifndef _GPOP_TIMERS_H_
+#define _GPOP_TIMERS_H_
+
+#include <glib-2.0/glib.h>
+
+/* Coalesced periodic work of the daemon.
+ *
+ * Instead of one GSource per periodic task, the timers share a single
+ * source scheduled for the earliest deadline, rounded up to a multiple of
+ * the slack on the monotonic clock. The timers due within the same slack
+ * interval thus run from the same wakeup, and no source exists at all when
+ * no timer is registered. A timer keeps its period from its previous
+ * deadline, it is only late by up to the slack. */
+
+#define GPOP_TIMERS_DEFAULT_SLACK_MS 250
+
+guint gpop_timers_add (guint period_ms, GSourceFunc func, gpointer user_data);
+void gpop_timers_remove (guint id);
+void gpop_timers_set_period (guint id, guint period_ms);
+
+void gpop_timers_set_slack (guint slack_ms);
+guint64 gpop_timers_get_wakeups (void);
+
+#endif /* _GPOP_TIMERS_H_ */
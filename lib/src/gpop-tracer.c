@@ -0,0 +1,301 @@
+/*
+ * GStreamer Prince of Parser
+ *
+ * Copyright (C) 2020 Stéphane Cerveau
+ *
+ * SPDX-License-Identifier: LGPL
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation
+ * version 2.1 of the License.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301 USA
+ *
+ */
+
+#include "gpop-tracer.h"
+
+#include <errno.h>
+#include <stdio.h>
+#include <unistd.h>
+#ifdef __linux__
+#include <sys/syscall.h>
+#endif
+
+typedef struct
+{
+  gint64 ts;
+  gchar phase;
+  const gchar *category;
+  const gchar *name;
+  const gchar *pipeline_id;
+} GPOPTraceEvent;
+
+typedef struct
+{
+  GMutex lock;
+  gint tid;
+  gchar *thread_name;
+  gint session;
+  GArray *events;
+} GPOPTraceBuffer;
+
+static gint tracer_active = 0;
+static gint tracer_session = 0;
+static gint64 tracer_origin = 0;
+static GMutex tracer_lock;
+static GList *tracer_buffers = NULL;
+static GPrivate tracer_buffer_key;
+
+static gint
+gpop_tracer_get_tid (void)
+{
+#ifdef __linux__
+  return (gint) syscall (SYS_gettid);
+#else
+  static gint next_tid = 1;
+  return g_atomic_int_add (&next_tid, 1);
+#endif
+}
+
+static gchar *
+gpop_tracer_get_thread_name (gint tid)
+{
+  gchar *path, *name = NULL;
+
+  path = g_strdup_printf ("/proc/self/task/%d/comm", tid);
+  if (g_file_get_contents (path, &name, NULL, NULL))
+    g_strstrip (name);
+  g_free (path);
+
+  return name ? name : g_strdup_printf ("thread-%d", tid);
+}
+
+/* Buffers are never freed: a thread may exit with events that have not been
+ * exported yet, they stay in the registry until the next stop. */
+static GPOPTraceBuffer *
+gpop_tracer_get_buffer (void)
+{
+  GPOPTraceBuffer *buffer = g_private_get (&tracer_buffer_key);
+
+  if (G_UNLIKELY (!buffer)) {
+    buffer = g_new0 (GPOPTraceBuffer, 1);
+    g_mutex_init (&buffer->lock);
+    buffer->tid = gpop_tracer_get_tid ();
+    buffer->thread_name = gpop_tracer_get_thread_name (buffer->tid);
+    buffer->events = g_array_sized_new (FALSE, FALSE,
+        sizeof (GPOPTraceEvent), 256);
+    g_private_set (&tracer_buffer_key, buffer);
+
+    g_mutex_lock (&tracer_lock);
+    tracer_buffers = g_list_prepend (tracer_buffers, buffer);
+    g_mutex_unlock (&tracer_lock);
+  }
+  return buffer;
+}
+
+static void
+gpop_tracer_record (gchar phase, const gchar * category, const gchar * name,
+    const gchar * pipeline_id)
+{
+  GPOPTraceBuffer *buffer;
+  GPOPTraceEvent event;
+  gint session;
+
+  if (G_LIKELY (!g_atomic_int_get (&tracer_active)))
+    return;
+
+  event.ts = g_get_monotonic_time ();
+  event.phase = phase;
+  event.category = g_intern_string (category);
+  event.name = g_intern_string (name);
+  event.pipeline_id = g_intern_string (pipeline_id);
+
+  session = g_atomic_int_get (&tracer_session);
+  buffer = gpop_tracer_get_buffer ();
+  g_mutex_lock (&buffer->lock);
+  if (buffer->session != session) {
+    g_array_set_size (buffer->events, 0);
+    buffer->session = session;
+  }
+  g_array_append_val (buffer->events, event);
+  g_mutex_unlock (&buffer->lock);
+}
+
+static void
+gpop_tracer_write_string (FILE * file, const gchar * str)
+{
+  const gchar *p;
+
+  fputc ('"', file);
+  for (p = str; p && *p; p++) {
+    switch (*p) {
+      case '"':
+        fputs ("\\\"", file);
+        break;
+      case '\\':
+        fputs ("\\\\", file);
+        break;
+      case '\n':
+        fputs ("\\n", file);
+        break;
+      case '\t':
+        fputs ("\\t", file);
+        break;
+      default:
+        if ((guchar) * p < 0x20)
+          fprintf (file, "\\u%04x", (guchar) * p);
+        else
+          fputc (*p, file);
+        break;
+    }
+  }
+  fputc ('"', file);
+}
+
+static guint
+gpop_tracer_write_buffer (FILE * file, GPOPTraceBuffer * buffer, gint session,
+    gint pid, gboolean * first)
+{
+  guint i, n_events = 0;
+
+  g_mutex_lock (&buffer->lock);
+  if (buffer->session != session || buffer->events->len == 0)
+    goto done;
+
+  fprintf (file, "%s\n{\"ph\":\"M\",\"name\":\"thread_name\",\"pid\":%d,"
+      "\"tid\":%d,\"args\":{\"name\":", *first ? "" : ",", pid, buffer->tid);
+  gpop_tracer_write_string (file, buffer->thread_name);
+  fputs ("}}", file);
+  *first = FALSE;
+
+  for (i = 0; i < buffer->events->len; i++) {
+    GPOPTraceEvent *event =
+        &g_array_index (buffer->events, GPOPTraceEvent, i);
+
+    fprintf (file, ",\n{\"ph\":\"%c\",\"ts\":%" G_GINT64_FORMAT
+        ",\"pid\":%d,\"tid\":%d,\"cat\":", event->phase,
+        event->ts - tracer_origin, pid, buffer->tid);
+    gpop_tracer_write_string (file, event->category);
+    fputs (",\"name\":", file);
+    gpop_tracer_write_string (file, event->name);
+    if (event->pipeline_id) {
+      if (event->phase == 'b' || event->phase == 'e') {
+        fputs (",\"id2\":{\"local\":", file);
+        gpop_tracer_write_string (file, event->pipeline_id);
+        fputc ('}', file);
+      }
+      fputs (",\"args\":{\"pipeline\":", file);
+      gpop_tracer_write_string (file, event->pipeline_id);
+      fputc ('}', file);
+    }
+    if (event->phase == 'i')
+      fputs (",\"s\":\"t\"", file);
+    fputc ('}', file);
+  }
+  n_events = buffer->events->len;
+  g_array_set_size (buffer->events, 0);
+
+done:
+  g_mutex_unlock (&buffer->lock);
+  return n_events;
+}
+
+/* Public API */
+
+void
+gpop_tracer_start (void)
+{
+  g_mutex_lock (&tracer_lock);
+  tracer_origin = g_get_monotonic_time ();
+  g_atomic_int_inc (&tracer_session);
+  g_atomic_int_set (&tracer_active, 1);
+  g_mutex_unlock (&tracer_lock);
+}
+
+gboolean
+gpop_tracer_stop (const gchar * path, guint * n_events, GError ** error)
+{
+  gboolean first = TRUE;
+  guint count = 0;
+  gint session;
+  FILE *file;
+  GList *l;
+
+  g_atomic_int_set (&tracer_active, 0);
+  session = g_atomic_int_get (&tracer_session);
+
+  file = fopen (path, "w");
+  if (!file) {
+    g_set_error (error, G_FILE_ERROR, g_file_error_from_errno (errno),
+        "Unable to open '%s': %s", path, g_strerror (errno));
+    return FALSE;
+  }
+
+  fputs ("{\"displayTimeUnit\":\"ms\",\"traceEvents\":[", file);
+  g_mutex_lock (&tracer_lock);
+  for (l = tracer_buffers; l != NULL; l = g_list_next (l))
+    count += gpop_tracer_write_buffer (file, l->data, session, getpid (),
+        &first);
+  g_mutex_unlock (&tracer_lock);
+  fputs ("\n]}\n", file);
+
+  if (fclose (file) != 0) {
+    g_set_error (error, G_FILE_ERROR, g_file_error_from_errno (errno),
+        "Unable to write '%s': %s", path, g_strerror (errno));
+    return FALSE;
+  }
+
+  if (n_events)
+    *n_events = count;
+  return TRUE;
+}
+
+gboolean
+gpop_tracer_is_active (void)
+{
+  return g_atomic_int_get (&tracer_active);
+}
+
+void
+gpop_tracer_begin (const gchar * category, const gchar * name,
+    const gchar * pipeline_id)
+{
+  gpop_tracer_record ('B', category, name, pipeline_id);
+}
+
+void
+gpop_tracer_end (const gchar * category, const gchar * name,
+    const gchar * pipeline_id)
+{
+  gpop_tracer_record ('E', category, name, pipeline_id);
+}
+
+void
+gpop_tracer_async_begin (const gchar * category, const gchar * name,
+    const gchar * pipeline_id)
+{
+  gpop_tracer_record ('b', category, name, pipeline_id);
+}
+
+void
+gpop_tracer_async_end (const gchar * category, const gchar * name,
+    const gchar * pipeline_id)
+{
+  gpop_tracer_record ('e', category, name, pipeline_id);
+}
+
+void
+gpop_tracer_instant (const gchar * category, const gchar * name,
+    const gchar * pipeline_id)
+{
+  gpop_tracer_record ('i', category, name, pipeline_id);
+}
@@ -0,0 +1,51 @@
+/*
+ * GStreamer Prince of Parser
+ *
+ * Copyright (C) 2020 Stéphane Cerveau
+ *
+ * SPDX-License-Identifier: LGPL
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation
+ * version 2.1 of the License.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301 USA
+ *
+ */
+
+#ifndef _GPOP_TRACER_H_
+#define _GPOP_TRACER_H_
+
+#include <glib-2.0/glib.h>
+
+/* Timeline capture of the control plane, exported as Chrome trace-event
+ * JSON (chrome://tracing, https://ui.perfetto.dev).
+ *
+ * Events are appended to a buffer owned by the calling thread, so recording
+ * never contends between threads. When no capture is running, each call
+ * costs a single atomic read. Names, categories and pipeline ids are
+ * interned, callers may pass transient strings. */
+
+void gpop_tracer_start (void);
+gboolean gpop_tracer_stop (const gchar * path, guint * n_events, GError ** error);
+gboolean gpop_tracer_is_active (void);
+
+/* Synchronous span, begin and end must happen on the same thread. */
+void gpop_tracer_begin (const gchar * category, const gchar * name, const gchar * pipeline_id);
+void gpop_tracer_end (const gchar * category, const gchar * name, const gchar * pipeline_id);
+
+/* Asynchronous span, grouped per pipeline in the viewer. */
+void gpop_tracer_async_begin (const gchar * category, const gchar * name, const gchar * pipeline_id);
+void gpop_tracer_async_end (const gchar * category, const gchar * name, const gchar * pipeline_id);
+
+void gpop_tracer_instant (const gchar * category, const gchar * name, const gchar * pipeline_id);
+
+#endif /* _GPOP_TRACER_H_ */
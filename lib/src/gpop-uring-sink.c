@@ -0,0 +1,667 @@
+/*
+ * GStreamer Prince of Parser
+ *
+ * Copyright (C) 2020 Stéphane Cerveau
+ *
+ * SPDX-License-Identifier: LGPL
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation
+ * version 2.1 of the License.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301 USA
+ *
+ */
+
+#ifndef _GNU_SOURCE
+#define _GNU_SOURCE
+#endif
+#include <errno.h>
+#include <fcntl.h>
+#include <string.h>
+#include <unistd.h>
+#include <liburing.h>
+
+#include "gpop-private.h"
+
+#define GPOP_URING_SINK_DEFAULT_QUEUE_DEPTH 64
+#define GPOP_URING_SINK_DEFAULT_BATCH 8
+#define GPOP_URING_SINK_DEFAULT_MAX_INFLIGHT (16 * 1024 * 1024)
+#define GPOP_URING_SINK_DEFAULT_PREALLOCATE (64 * 1024 * 1024)
+/* Staging blocks of o-direct, a multiple of any logical block size */
+#define GPOP_URING_SINK_DIRECT_BLOCK (1024 * 1024)
+#define GPOP_URING_SINK_DIRECT_ALIGN 4096
+/* Queued writes are submitted at the latest after this delay */
+#define GPOP_URING_SINK_MAX_DELAY_US 10000
+
+enum
+{
+  PROP_0,
+  PROP_LOCATION,
+  PROP_O_DIRECT,
+  PROP_PREALLOCATE,
+  PROP_MAX_INFLIGHT,
+  PROP_QUEUE_DEPTH,
+  PROP_BATCH,
+};
+
+typedef struct
+{
+  GstBuffer *buffer;
+  GstMapInfo map;
+  /* o-direct staging block */
+  guint8 *block;
+  const guint8 *data;
+  gsize size;
+  guint64 offset;
+} GPOPUringWrite;
+
+struct _GPOPUringSink
+{
+  GstBaseSink base;
+
+  gchar *location;
+  gboolean o_direct;
+  guint64 preallocate;
+  guint64 max_inflight;
+  guint queue_depth;
+  guint batch;
+
+  gint fd;
+  struct io_uring ring;
+  gboolean ring_initialized;
+  guint64 offset;
+  /* end of the written data, the offset is behind after a seek back */
+  guint64 size;
+  guint64 allocated;
+  guint64 inflight_bytes;
+  guint inflight;
+  guint queued;
+  gint64 first_queued;
+  /* o-direct is in use, until the first seek */
+  gboolean direct;
+  /* o-direct block being filled */
+  guint8 *block;
+  gsize block_filled;
+};
+
+struct _GPOPUringSinkClass
+{
+  GstBaseSinkClass base;
+};
+
+G_DEFINE_TYPE (GPOPUringSink, gpop_uring_sink, GST_TYPE_BASE_SINK);
+#define parent_class gpop_uring_sink_parent_class
+
+GST_DEBUG_CATEGORY_STATIC (gpop_uring_sink_debug);
+#define GST_CAT_DEFAULT gpop_uring_sink_debug
+
+static GstStaticPadTemplate sink_template = GST_STATIC_PAD_TEMPLATE ("sink",
+    GST_PAD_SINK,
+    GST_PAD_ALWAYS,
+    GST_STATIC_CAPS_ANY);
+
+static void
+gpop_uring_write_free (GPOPUringWrite * req)
+{
+  if (req->buffer) {
+    gst_buffer_unmap (req->buffer, &req->map);
+    gst_buffer_unref (req->buffer);
+  }
+  free (req->block);
+  g_free (req);
+}
+
+static guint8 *
+gpop_uring_sink_alloc_block (void)
+{
+  void *block = NULL;
+
+  if (posix_memalign (&block, GPOP_URING_SINK_DIRECT_ALIGN,
+          GPOP_URING_SINK_DIRECT_BLOCK))
+    return NULL;
+  return block;
+}
+
+static gboolean
+gpop_uring_sink_submit (GPOPUringSink * sink)
+{
+  gint ret;
+
+  if (!sink->queued)
+    return TRUE;
+
+  ret = io_uring_submit (&sink->ring);
+  if (ret < 0) {
+    GST_ELEMENT_ERROR (sink, RESOURCE, WRITE, (NULL),
+        ("io_uring_submit failed: %s", g_strerror (-ret)));
+    return FALSE;
+  }
+  sink->queued = 0;
+  return TRUE;
+}
+
+/* Handles the completions, waiting for at least min_complete of them */
+static gboolean
+gpop_uring_sink_reap (GPOPUringSink * sink, guint min_complete)
+{
+  struct io_uring_cqe *cqe;
+  GPOPUringWrite *req;
+  gboolean res = TRUE;
+  guint reaped = 0;
+  gint ret;
+
+  while (sink->inflight) {
+    if (reaped < min_complete)
+      ret = io_uring_wait_cqe (&sink->ring, &cqe);
+    else
+      ret = io_uring_peek_cqe (&sink->ring, &cqe);
+    if (ret == -EAGAIN)
+      break;
+    if (ret < 0) {
+      GST_ELEMENT_ERROR (sink, RESOURCE, WRITE, (NULL),
+          ("Unable to get the io_uring completions: %s", g_strerror (-ret)));
+      return FALSE;
+    }
+
+    req = io_uring_cqe_get_data (cqe);
+    if (cqe->res < 0) {
+      GST_ELEMENT_ERROR (sink, RESOURCE, WRITE, (NULL),
+          ("Error while writing to '%s': %s", sink->location,
+              g_strerror (-cqe->res)));
+      res = FALSE;
+    } else if ((gsize) cqe->res < req->size) {
+      /* Short writes are rare, finish them synchronously */
+      gsize done = cqe->res;
+      while (res && done < req->size) {
+        gssize n = pwrite (sink->fd, req->data + done, req->size - done,
+            req->offset + done);
+        /* nothing written, the device is full */
+        if (n == 0)
+          errno = ENOSPC;
+        if (n == 0 || (n < 0 && errno != EINTR)) {
+          GST_ELEMENT_ERROR (sink, RESOURCE, WRITE, (NULL),
+              ("Error while writing to '%s': %s", sink->location,
+                  g_strerror (errno)));
+          res = FALSE;
+        } else if (n > 0) {
+          done += n;
+        }
+      }
+    }
+    io_uring_cqe_seen (&sink->ring, cqe);
+    sink->inflight--;
+    sink->inflight_bytes -= req->size;
+    gpop_uring_write_free (req);
+    reaped++;
+  }
+
+  return res;
+}
+
+static gboolean
+gpop_uring_sink_preallocate (GPOPUringSink * sink, guint64 end)
+{
+  if (!sink->preallocate || end <= sink->allocated)
+    return TRUE;
+
+  /* Keep the file size, the writes extend it */
+  while (sink->allocated < end) {
+    if (fallocate (sink->fd, FALLOC_FL_KEEP_SIZE, sink->allocated,
+            sink->preallocate) < 0) {
+      GST_DEBUG_OBJECT (sink, "fallocate failed, disabling it: %s",
+          g_strerror (errno));
+      sink->preallocate = 0;
+      break;
+    }
+    sink->allocated += sink->preallocate;
+  }
+  return TRUE;
+}
+
+static gboolean
+gpop_uring_sink_queue (GPOPUringSink * sink, GPOPUringWrite * req)
+{
+  struct io_uring_sqe *sqe;
+
+  /* Bound the memory in flight and the ring occupation */
+  while (sink->inflight && (sink->inflight_bytes + req->size >
+          sink->max_inflight || sink->inflight >= sink->queue_depth)) {
+    if (!gpop_uring_sink_submit (sink) || !gpop_uring_sink_reap (sink, 1)) {
+      gpop_uring_write_free (req);
+      return FALSE;
+    }
+  }
+
+  gpop_uring_sink_preallocate (sink, req->offset + req->size);
+
+  sqe = io_uring_get_sqe (&sink->ring);
+  if (!sqe) {
+    if (!gpop_uring_sink_submit (sink)
+        || !(sqe = io_uring_get_sqe (&sink->ring))) {
+      gpop_uring_write_free (req);
+      return FALSE;
+    }
+  }
+  io_uring_prep_write (sqe, sink->fd, req->data, req->size,
+      req->offset);
+  io_uring_sqe_set_data (sqe, req);
+  sink->inflight++;
+  sink->inflight_bytes += req->size;
+  if (!sink->queued++)
+    sink->first_queued = g_get_monotonic_time ();
+
+  if (sink->queued >= sink->batch
+      || g_get_monotonic_time () - sink->first_queued >=
+      GPOP_URING_SINK_MAX_DELAY_US)
+    return gpop_uring_sink_submit (sink);
+
+  /* Free what has completed meanwhile */
+  return gpop_uring_sink_reap (sink, 0);
+}
+
+/* Queues the o-direct staging block, size is padded to the alignment */
+static gboolean
+gpop_uring_sink_queue_block (GPOPUringSink * sink)
+{
+  GPOPUringWrite *req;
+
+  if (!sink->block_filled)
+    return TRUE;
+
+  req = g_new0 (GPOPUringWrite, 1);
+  req->block = sink->block;
+  req->data = sink->block;
+  req->size = GST_ROUND_UP_N (sink->block_filled,
+      GPOP_URING_SINK_DIRECT_ALIGN);
+  req->offset = sink->offset - sink->block_filled;
+  memset (sink->block + sink->block_filled, 0,
+      req->size - sink->block_filled);
+
+  sink->block = gpop_uring_sink_alloc_block ();
+  sink->block_filled = 0;
+  if (!sink->block) {
+    gpop_uring_write_free (req);
+    GST_ELEMENT_ERROR (sink, RESOURCE, NO_SPACE_LEFT, (NULL),
+        ("Unable to allocate an aligned block"));
+    return FALSE;
+  }
+
+  return gpop_uring_sink_queue (sink, req);
+}
+
+static gboolean
+gpop_uring_sink_drain (GPOPUringSink * sink)
+{
+  gboolean res = TRUE;
+
+  /* The last block is padded and the preallocated chunks are kept past
+   * the end, the file is truncated after */
+  if (sink->direct)
+    res = gpop_uring_sink_queue_block (sink);
+  res = gpop_uring_sink_submit (sink) && res;
+  res = gpop_uring_sink_reap (sink, sink->inflight) && res;
+  sink->size = MAX (sink->size, sink->offset);
+  if (ftruncate (sink->fd, sink->size) < 0)
+    GST_WARNING_OBJECT (sink, "Unable to truncate '%s': %s", sink->location,
+        g_strerror (errno));
+
+  return res;
+}
+
+/* The muxers seek back to rewrite their headers when finalizing. The
+ * writes in flight are completed first, and since an unaligned rewrite
+ * can not go through o-direct, the file is written through the page cache
+ * from then on. */
+static gboolean
+gpop_uring_sink_do_seek (GPOPUringSink * sink, guint64 offset)
+{
+  gboolean res = TRUE;
+  gint flags;
+
+  if (offset == sink->offset)
+    return TRUE;
+
+  GST_DEBUG_OBJECT (sink, "Seeking from %" G_GUINT64_FORMAT " to %"
+      G_GUINT64_FORMAT, sink->offset, offset);
+  if (sink->direct)
+    res = gpop_uring_sink_queue_block (sink);
+  res = gpop_uring_sink_submit (sink) && res;
+  res = gpop_uring_sink_reap (sink, sink->inflight) && res;
+  if (!res)
+    return FALSE;
+
+  if (sink->direct) {
+    flags = fcntl (sink->fd, F_GETFL);
+    if (flags < 0 || fcntl (sink->fd, F_SETFL, flags & ~O_DIRECT) < 0) {
+      GST_ELEMENT_ERROR (sink, RESOURCE, SEEK, (NULL),
+          ("Unable to disable O_DIRECT on '%s': %s", sink->location,
+              g_strerror (errno)));
+      return FALSE;
+    }
+    sink->direct = FALSE;
+  }
+  sink->size = MAX (sink->size, sink->offset);
+  sink->offset = offset;
+
+  return TRUE;
+}
+
+static GstFlowReturn
+gpop_uring_sink_render (GstBaseSink * bsink, GstBuffer * buffer)
+{
+  GPOPUringSink *sink = GPOP_URING_SINK (bsink);
+  GPOPUringWrite *req;
+  GstMapInfo map;
+  gsize done = 0;
+
+  if (!sink->direct) {
+    req = g_new0 (GPOPUringWrite, 1);
+    if (!gst_buffer_map (buffer, &req->map, GST_MAP_READ)) {
+      g_free (req);
+      GST_ELEMENT_ERROR (sink, RESOURCE, WRITE, (NULL),
+          ("Unable to map the buffer"));
+      return GST_FLOW_ERROR;
+    }
+    req->buffer = gst_buffer_ref (buffer);
+    req->data = req->map.data;
+    req->size = req->map.size;
+    req->offset = sink->offset;
+    sink->offset += req->size;
+    if (!req->size) {
+      gpop_uring_write_free (req);
+      return GST_FLOW_OK;
+    }
+    return gpop_uring_sink_queue (sink, req) ? GST_FLOW_OK : GST_FLOW_ERROR;
+  }
+
+  if (!gst_buffer_map (buffer, &map, GST_MAP_READ)) {
+    GST_ELEMENT_ERROR (sink, RESOURCE, WRITE, (NULL),
+        ("Unable to map the buffer"));
+    return GST_FLOW_ERROR;
+  }
+  while (done < map.size) {
+    gsize n = MIN (map.size - done,
+        GPOP_URING_SINK_DIRECT_BLOCK - sink->block_filled);
+
+    memcpy (sink->block + sink->block_filled, map.data + done, n);
+    sink->block_filled += n;
+    sink->offset += n;
+    done += n;
+    if (sink->block_filled == GPOP_URING_SINK_DIRECT_BLOCK
+        && !gpop_uring_sink_queue_block (sink)) {
+      gst_buffer_unmap (buffer, &map);
+      return GST_FLOW_ERROR;
+    }
+  }
+  gst_buffer_unmap (buffer, &map);
+
+  return GST_FLOW_OK;
+}
+
+static gboolean
+gpop_uring_sink_event (GstBaseSink * bsink, GstEvent * event)
+{
+  GPOPUringSink *sink = GPOP_URING_SINK (bsink);
+  const GstSegment *segment;
+  gboolean res = TRUE;
+
+  switch (GST_EVENT_TYPE (event)) {
+    case GST_EVENT_SEGMENT:
+      gst_event_parse_segment (event, &segment);
+      if (segment->format == GST_FORMAT_BYTES)
+        res = gpop_uring_sink_do_seek (sink, segment->start);
+      break;
+    case GST_EVENT_EOS:
+      res = gpop_uring_sink_drain (sink);
+      break;
+    default:
+      break;
+  }
+  if (!res) {
+    gst_event_unref (event);
+    return FALSE;
+  }
+
+  return GST_BASE_SINK_CLASS (parent_class)->event (bsink, event);
+}
+
+static gboolean
+gpop_uring_sink_query (GstBaseSink * bsink, GstQuery * query)
+{
+  GstFormat format;
+
+  switch (GST_QUERY_TYPE (query)) {
+    case GST_QUERY_SEEKING:
+      /* the muxers rewrite their headers with a BYTES segment */
+      gst_query_parse_seeking (query, &format, NULL, NULL, NULL);
+      gst_query_set_seeking (query, format, format == GST_FORMAT_BYTES, 0,
+          -1);
+      return TRUE;
+    default:
+      return GST_BASE_SINK_CLASS (parent_class)->query (bsink, query);
+  }
+}
+
+static gboolean
+gpop_uring_sink_start (GstBaseSink * bsink)
+{
+  GPOPUringSink *sink = GPOP_URING_SINK (bsink);
+  gint flags = O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC;
+  gint ret;
+
+  if (!sink->location) {
+    GST_ELEMENT_ERROR (sink, RESOURCE, NOT_FOUND, ("No file name specified"),
+        (NULL));
+    return FALSE;
+  }
+
+  if (sink->o_direct)
+    flags |= O_DIRECT;
+  sink->fd = open (sink->location, flags, 0644);
+  if (sink->fd < 0) {
+    GST_ELEMENT_ERROR (sink, RESOURCE, OPEN_WRITE,
+        ("Unable to open '%s': %s", sink->location, g_strerror (errno)),
+        (NULL));
+    return FALSE;
+  }
+
+  ret = io_uring_queue_init (sink->queue_depth, &sink->ring, 0);
+  if (ret < 0) {
+    GST_ELEMENT_ERROR (sink, RESOURCE, OPEN_WRITE, (NULL),
+        ("io_uring_queue_init failed: %s", g_strerror (-ret)));
+    close (sink->fd);
+    sink->fd = -1;
+    return FALSE;
+  }
+  sink->ring_initialized = TRUE;
+
+  if (sink->o_direct && !(sink->block = gpop_uring_sink_alloc_block ())) {
+    GST_ELEMENT_ERROR (sink, RESOURCE, NO_SPACE_LEFT, (NULL),
+        ("Unable to allocate an aligned block"));
+    /* stop() is not called after a failed start() */
+    io_uring_queue_exit (&sink->ring);
+    sink->ring_initialized = FALSE;
+    close (sink->fd);
+    sink->fd = -1;
+    return FALSE;
+  }
+
+  sink->direct = sink->o_direct;
+  sink->offset = sink->size = sink->allocated = 0;
+  sink->inflight = sink->inflight_bytes = sink->queued = 0;
+  sink->block_filled = 0;
+
+  return TRUE;
+}
+
+static gboolean
+gpop_uring_sink_stop (GstBaseSink * bsink)
+{
+  GPOPUringSink *sink = GPOP_URING_SINK (bsink);
+
+  if (sink->ring_initialized) {
+    gpop_uring_sink_drain (sink);
+    io_uring_queue_exit (&sink->ring);
+    sink->ring_initialized = FALSE;
+  }
+  g_clear_pointer (&sink->block, free);
+  if (sink->fd >= 0) {
+    close (sink->fd);
+    sink->fd = -1;
+  }
+
+  return TRUE;
+}
+
+static void
+gpop_uring_sink_set_property (GObject * object, guint prop_id,
+    const GValue * value, GParamSpec * pspec)
+{
+  GPOPUringSink *sink = GPOP_URING_SINK (object);
+
+  switch (prop_id) {
+    case PROP_LOCATION:
+      g_free (sink->location);
+      sink->location = g_value_dup_string (value);
+      break;
+    case PROP_O_DIRECT:
+      sink->o_direct = g_value_get_boolean (value);
+      break;
+    case PROP_PREALLOCATE:
+      sink->preallocate = g_value_get_uint64 (value);
+      break;
+    case PROP_MAX_INFLIGHT:
+      sink->max_inflight = g_value_get_uint64 (value);
+      break;
+    case PROP_QUEUE_DEPTH:
+      sink->queue_depth = g_value_get_uint (value);
+      break;
+    case PROP_BATCH:
+      sink->batch = g_value_get_uint (value);
+      break;
+    default:
+      G_OBJECT_WARN_INVALID_PROPERTY_ID (object, prop_id, pspec);
+      break;
+  }
+}
+
+static void
+gpop_uring_sink_get_property (GObject * object, guint prop_id,
+    GValue * value, GParamSpec * pspec)
+{
+  GPOPUringSink *sink = GPOP_URING_SINK (object);
+
+  switch (prop_id) {
+    case PROP_LOCATION:
+      g_value_set_string (value, sink->location);
+      break;
+    case PROP_O_DIRECT:
+      g_value_set_boolean (value, sink->o_direct);
+      break;
+    case PROP_PREALLOCATE:
+      g_value_set_uint64 (value, sink->preallocate);
+      break;
+    case PROP_MAX_INFLIGHT:
+      g_value_set_uint64 (value, sink->max_inflight);
+      break;
+    case PROP_QUEUE_DEPTH:
+      g_value_set_uint (value, sink->queue_depth);
+      break;
+    case PROP_BATCH:
+      g_value_set_uint (value, sink->batch);
+      break;
+    default:
+      G_OBJECT_WARN_INVALID_PROPERTY_ID (object, prop_id, pspec);
+      break;
+  }
+}
+
+static void
+gpop_uring_sink_finalize (GObject * object)
+{
+  GPOPUringSink *sink = GPOP_URING_SINK (object);
+
+  g_free (sink->location);
+
+  G_OBJECT_CLASS (parent_class)->finalize (object);
+}
+
+static void
+gpop_uring_sink_class_init (GPOPUringSinkClass * klass)
+{
+  GObjectClass *gobject_class = G_OBJECT_CLASS (klass);
+  GstElementClass *element_class = GST_ELEMENT_CLASS (klass);
+  GstBaseSinkClass *basesink_class = GST_BASE_SINK_CLASS (klass);
+  GParamFlags flags = G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS |
+      GST_PARAM_MUTABLE_READY;
+
+  gobject_class->set_property = gpop_uring_sink_set_property;
+  gobject_class->get_property = gpop_uring_sink_get_property;
+  gobject_class->finalize = gpop_uring_sink_finalize;
+
+  g_object_class_install_property (gobject_class, PROP_LOCATION,
+      g_param_spec_string ("location", "File Location",
+          "Location of the file to write", NULL, flags));
+  g_object_class_install_property (gobject_class, PROP_O_DIRECT,
+      g_param_spec_boolean ("o-direct", "O_DIRECT",
+          "Write bypassing the page cache", FALSE, flags));
+  g_object_class_install_property (gobject_class, PROP_PREALLOCATE,
+      g_param_spec_uint64 ("preallocate", "Preallocate",
+          "Size of the chunks preallocated with fallocate, 0 to disable", 0,
+          G_MAXUINT64, GPOP_URING_SINK_DEFAULT_PREALLOCATE, flags));
+  g_object_class_install_property (gobject_class, PROP_MAX_INFLIGHT,
+      g_param_spec_uint64 ("max-inflight", "Max in flight",
+          "Maximum number of bytes being written", 1, G_MAXUINT64,
+          GPOP_URING_SINK_DEFAULT_MAX_INFLIGHT, flags));
+  g_object_class_install_property (gobject_class, PROP_QUEUE_DEPTH,
+      g_param_spec_uint ("queue-depth", "Queue depth",
+          "Number of entries of the io_uring", 1, 4096,
+          GPOP_URING_SINK_DEFAULT_QUEUE_DEPTH, flags));
+  g_object_class_install_property (gobject_class, PROP_BATCH,
+      g_param_spec_uint ("batch", "Batch",
+          "Number of writes submitted at once", 1, 4096,
+          GPOP_URING_SINK_DEFAULT_BATCH, flags));
+
+  gst_element_class_add_static_pad_template (element_class, &sink_template);
+  gst_element_class_set_static_metadata (element_class,
+      "io_uring file sink", "Sink/File",
+      "Writes to a file through io_uring", "GStreamer Prince of Parser");
+
+  basesink_class->start = GST_DEBUG_FUNCPTR (gpop_uring_sink_start);
+  basesink_class->stop = GST_DEBUG_FUNCPTR (gpop_uring_sink_stop);
+  basesink_class->render = GST_DEBUG_FUNCPTR (gpop_uring_sink_render);
+  basesink_class->event = GST_DEBUG_FUNCPTR (gpop_uring_sink_event);
+  basesink_class->query = GST_DEBUG_FUNCPTR (gpop_uring_sink_query);
+
+  GST_DEBUG_CATEGORY_INIT (gpop_uring_sink_debug, GPOP_URING_SINK_NAME, 0,
+      "gpop io_uring file sink");
+}
+
+static void
+gpop_uring_sink_init (GPOPUringSink * sink)
+{
+  sink->fd = -1;
+  sink->preallocate = GPOP_URING_SINK_DEFAULT_PREALLOCATE;
+  sink->max_inflight = GPOP_URING_SINK_DEFAULT_MAX_INFLIGHT;
+  sink->queue_depth = GPOP_URING_SINK_DEFAULT_QUEUE_DEPTH;
+  sink->batch = GPOP_URING_SINK_DEFAULT_BATCH;
+  gst_base_sink_set_sync (GST_BASE_SINK (sink), FALSE);
+}
+
+/* Registers the element for gst_parse_launch(), to be called after
+ * gst_init(). */
+gboolean
+gpop_uring_sink_register (void)
+{
+  return gst_element_register (NULL, GPOP_URING_SINK_NAME, GST_RANK_NONE,
+      GPOP_TYPE_URING_SINK);
+}
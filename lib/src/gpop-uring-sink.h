@@ -0,0 +1,55 @@
+/*
+ * GStreamer Prince of Parser
+ *
+ * Copyright (C) 2020 Stéphane Cerveau
+ *
+ * SPDX-License-Identifier: LGPL
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation
+ * version 2.1 of the License.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301 USA
+ *
+ */
+
+#ifndef _GPOP_URING_SINK_H_
+#define _GPOP_URING_SINK_H_
+
+#include <gst/gst.h>
+#include <gst/base/gstbasesink.h>
+
+/* gpopuringsink: file sink submitting its writes through io_uring.
+ *
+ * The writes are queued as submission entries and submitted by batches,
+ * the buffers staying mapped until their completion. The file is
+ * preallocated by chunks with fallocate(). With o-direct, the data is
+ * staged in aligned blocks and written bypassing the page cache, until a
+ * muxer seeks back to rewrite its headers. The memory of the writes in
+ * flight is bounded, the streaming thread waits for completions beyond it.
+ * Only built with liburing, see GPOP_ENABLE_IO_URING */
+
+#define GPOP_URING_SINK_NAME "gpopuringsink"
+
+#define GPOP_TYPE_URING_SINK	           (gpop_uring_sink_get_type())
+#define GPOP_URING_SINK(obj)            (G_TYPE_CHECK_INSTANCE_CAST((obj),\
+                                              GPOP_TYPE_URING_SINK, GPOPUringSink))
+#define GPOP_IS_URING_SINK(obj)         (G_TYPE_CHECK_INSTANCE_TYPE((obj),\
+                                              GPOP_TYPE_URING_SINK))
+
+typedef struct _GPOPUringSink GPOPUringSink;
+typedef struct _GPOPUringSinkClass GPOPUringSinkClass;
+
+GType gpop_uring_sink_get_type (void);
+
+gboolean gpop_uring_sink_register (void);
+
+#endif /* _GPOP_URING_SINK_H_ */